@@ -0,0 +1,33 @@
+#include "AssetSource.h"
+#include <fstream>
+#include <stdexcept>
+
+class FileAsset : public Asset{
+public:
+    explicit FileAsset(std::vector<uint8_t> &&bytes) : mBytes(std::move(bytes)) {};
+    const uint8_t *data() const override { return mBytes.data(); };
+    size_t size() const override { return mBytes.size(); };
+
+private:
+    std::vector<uint8_t> mBytes;
+};
+
+std::vector<char> AssetSource::read(const std::string &path) const {
+    std::unique_ptr<Asset> asset = open(path);
+    if(asset == nullptr){
+        throw std::runtime_error("Failed to open " + path);
+    }
+    const char *bytes = reinterpret_cast<const char *>(asset->data());
+    return std::vector<char>(bytes, bytes + asset->size());
+}
+
+std::unique_ptr<Asset> FileAssetSource::open(const std::string &path) const {
+    std::ifstream stream(mRootDir + "/" + path, std::ios::binary | std::ios::ate);
+    if(!stream.is_open()){
+        return nullptr;
+    }
+    std::vector<uint8_t> bytes(stream.tellg());
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+    return std::unique_ptr<Asset>(new FileAsset(std::move(bytes)));
+}
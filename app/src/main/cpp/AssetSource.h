@@ -0,0 +1,56 @@
+/*!
+ * @brief  Read only files the renderers load by path, APK assets on the device and plain files in a host build
+ * @date 2023/8/24
+ */
+#ifndef CAMERA2VK_ASSETSOURCE_H
+#define CAMERA2VK_ASSETSOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct AAssetManager;
+
+// an opened file, its bytes stay valid until it is destroyed
+class Asset{
+public:
+    virtual ~Asset() = default;
+    virtual const uint8_t *data() const = 0;
+    virtual size_t size() const = 0;
+};
+
+/**
+ * open() is safe from any thread, the texture workers call it while the render thread reads shaders.
+ */
+class AssetSource{
+public:
+    virtual ~AssetSource() = default;
+    // null when there is no such file
+    virtual std::unique_ptr<Asset> open(const std::string &path) const = 0;
+    // the whole file copied out, throws when there is no such file
+    std::vector<char> read(const std::string &path) const;
+};
+
+// paths relative to a directory, the working directory of a headless run without an activity
+class FileAssetSource : public AssetSource{
+public:
+    explicit FileAssetSource(const std::string &rootDir) : mRootDir(rootDir) {};
+    std::unique_ptr<Asset> open(const std::string &path) const override;
+
+private:
+    std::string mRootDir;
+};
+
+// in AssetSourceDevice.cpp, AASSET_MODE_BUFFER maps uncompressed APK entries instead of copying them
+class AndroidAssetSource : public AssetSource{
+public:
+    explicit AndroidAssetSource(AAssetManager *assetManager) : mAssetManager(assetManager) {};
+    std::unique_ptr<Asset> open(const std::string &path) const override;
+
+private:
+    AAssetManager *mAssetManager;
+};
+
+#endif //CAMERA2VK_ASSETSOURCE_H
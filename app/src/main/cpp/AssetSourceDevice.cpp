@@ -0,0 +1,22 @@
+#include "AssetSource.h"
+#include <android/asset_manager.h>
+
+// the device side of AssetSource, kept apart so the rest builds on a host
+class AndroidAsset : public Asset{
+public:
+    explicit AndroidAsset(AAsset *asset) : mAsset(asset) {};
+    ~AndroidAsset() override { AAsset_close(mAsset); };
+    const uint8_t *data() const override { return static_cast<const uint8_t *>(AAsset_getBuffer(mAsset)); };
+    size_t size() const override { return AAsset_getLength(mAsset); };
+
+private:
+    AAsset *mAsset;
+};
+
+std::unique_ptr<Asset> AndroidAssetSource::open(const std::string &path) const {
+    AAsset *asset = AAssetManager_open(mAssetManager, path.c_str(), AASSET_MODE_BUFFER);
+    if(asset == nullptr){
+        return nullptr;
+    }
+    return std::unique_ptr<Asset>(new AndroidAsset(asset));
+}
@@ -4,7 +4,7 @@
 #include "CameraImageReader.h"
 #include "../Common.h"
 
-CameraImageReader::CameraImageReader(uint32_t width, uint32_t height, uint32_t format, uint32_t maxImages)
+CameraImageReader::CameraImageReader(uint32_t width, uint32_t height, uint32_t format, uint32_t maxImages, uint64_t usage)
                             : mCurIndex{maxImages - 1}, mReader{nullptr, AImageReader_delete}{
 
     if(maxImages < 2)
@@ -14,8 +14,13 @@ CameraImageReader::CameraImageReader(uint32_t width, uint32_t height, uint32_t f
         mImages.push_back({nullptr, AImage_delete});
 
     auto pt = mReader.release();
-    //AImageReader_newWithUsage(width, height, format, usage, mImages.size() + 2, &pt);
-    auto rt = AImageReader_new(width, height, format, mImages.size() + 2, &pt);
+    media_status_t rt;
+    if(usage != 0){
+        // the CPU keeps reading the planes, whoever asks for GPU usage may still fall back to uploads
+        rt = AImageReader_newWithUsage(width, height, format, usage | AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, mImages.size() + 2, &pt);
+    } else {
+        rt = AImageReader_new(width, height, format, mImages.size() + 2, &pt);
+    }
     if(rt != AMEDIA_OK){
         LOG_E("Failed to create image reader.");
     }
@@ -12,7 +12,8 @@
 class CameraImageReader {
 public:
 
-    CameraImageReader(uint32_t width, uint32_t height, uint32_t format, uint32_t maxImages);
+    // usage adds AHARDWAREBUFFER_USAGE_* bits to the buffers, for importing them into a graphics API
+    CameraImageReader(uint32_t width, uint32_t height, uint32_t format, uint32_t maxImages, uint64_t usage = 0);
     AImage *getLatestImage();
     ANativeWindow *getWindow();
 
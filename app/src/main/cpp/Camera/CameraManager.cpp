@@ -75,6 +75,18 @@ CameraManager::CameraManager(ANativeWindow *nativeWindow, uint8_t selectCamIndex
     selectedCamera = std::to_string(selectCamIndex);
 #endif
 
+    //clock of the sensor timestamps
+    {
+        ACameraMetadata* metadata = nullptr;
+        result = ACameraManager_getCameraCharacteristics(mManager.get(), selectedCamera.c_str(), &metadata);
+        if(result == ACAMERA_OK && metadata){
+            ACameraMetadata_const_entry entry;
+            if(ACameraMetadata_getConstEntry(metadata, ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, &entry) == ACAMERA_OK && entry.count > 0)
+                mTimestampSource = entry.data.u8[0];
+            ACameraMetadata_free(metadata);
+        }
+    }
+
     //device
     {
         auto pt = mDevice.release();
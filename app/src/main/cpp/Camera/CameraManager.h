@@ -1,6 +1,7 @@
 #pragma once
 
 #include <android/native_window.h>
+#include <camera/NdkCameraMetadata.h>
 #include <camera/NdkCaptureRequest.h>
 #include <camera/NdkCameraCaptureSession.h>
 #include <camera/NdkCameraDevice.h>
@@ -13,6 +14,8 @@ public:
     CameraManager(ANativeWindow *nativeWindow, uint8_t selectCamIndex);
     void startCapturing();
     void stopCapturing();
+    // ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, UNKNOWN when the camera does not say
+    uint8_t getTimestampSource() const { return mTimestampSource; };
 
     using ACameraManager_ptr = std::unique_ptr<ACameraManager, decltype(&ACameraManager_delete)>;
     using ACameraIdList_ptr = std::unique_ptr<ACameraIdList, decltype(&ACameraManager_deleteCameraIdList)>;
@@ -42,6 +45,7 @@ private:
 
     ANativeWindow *mNativeWindow;
     uint8_t mSelectCamIndex;
+    uint8_t mTimestampSource = ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN;
 
     ACameraManager_ptr mManager;
     ACameraIdList_ptr mIds;
@@ -0,0 +1,136 @@
+#include "ChoreographerVsyncSource.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include "Common.h"
+#include "ThreadManager.h"
+
+// newer than minSdk, looked up at runtime. the callback data is only passed through, so it stays opaque here
+typedef void (*fp_AChoreographer_frameCallback64)(int64_t frameTimeNanos, void *data);
+typedef void (*fp_AChoreographer_vsyncCallback)(const void *callbackData, void *data);
+typedef int (*fp_AChoreographer_postFrameCallback64)(AChoreographer *choreographer, fp_AChoreographer_frameCallback64 callback, void *data);
+typedef int (*fp_AChoreographer_postVsyncCallback)(AChoreographer *choreographer, fp_AChoreographer_vsyncCallback callback, void *data);
+typedef int64_t (*fp_AChoreographerFrameCallbackData_getFrameTimeNanos)(const void *callbackData);
+typedef size_t (*fp_AChoreographerFrameCallbackData_getPreferredFrameTimelineIndex)(const void *callbackData);
+typedef int64_t (*fp_AChoreographerFrameCallbackData_getFrameTimelineNanos)(const void *callbackData, size_t index);
+
+static fp_AChoreographer_postFrameCallback64 gPostFrameCallback64 = nullptr;
+static fp_AChoreographer_postVsyncCallback gPostVsyncCallback = nullptr;
+static fp_AChoreographerFrameCallbackData_getFrameTimeNanos gGetFrameTimeNanos = nullptr;
+static fp_AChoreographerFrameCallbackData_getPreferredFrameTimelineIndex gGetPreferredFrameTimelineIndex = nullptr;
+static fp_AChoreographerFrameCallbackData_getFrameTimelineNanos gGetExpectedPresentationTimeNanos = nullptr;
+static fp_AChoreographerFrameCallbackData_getFrameTimelineNanos gGetDeadlineNanos = nullptr;
+
+static void loadChoreographerSymbols() {
+    static std::once_flag once;
+    std::call_once(once, []{
+        void *lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if(lib == nullptr){
+            return;
+        }
+        gPostFrameCallback64 = reinterpret_cast<fp_AChoreographer_postFrameCallback64>(dlsym(lib, "AChoreographer_postFrameCallback64"));
+        gPostVsyncCallback = reinterpret_cast<fp_AChoreographer_postVsyncCallback>(dlsym(lib, "AChoreographer_postVsyncCallback"));
+        gGetFrameTimeNanos = reinterpret_cast<fp_AChoreographerFrameCallbackData_getFrameTimeNanos>(
+                dlsym(lib, "AChoreographerFrameCallbackData_getFrameTimeNanos"));
+        gGetPreferredFrameTimelineIndex = reinterpret_cast<fp_AChoreographerFrameCallbackData_getPreferredFrameTimelineIndex>(
+                dlsym(lib, "AChoreographerFrameCallbackData_getPreferredFrameTimelineIndex"));
+        gGetExpectedPresentationTimeNanos = reinterpret_cast<fp_AChoreographerFrameCallbackData_getFrameTimelineNanos>(
+                dlsym(lib, "AChoreographerFrameCallbackData_getFrameTimelineExpectedPresentationTimeNanos"));
+        gGetDeadlineNanos = reinterpret_cast<fp_AChoreographerFrameCallbackData_getFrameTimelineNanos>(
+                dlsym(lib, "AChoreographerFrameCallbackData_getFrameTimelineDeadlineNanos"));
+        if(!gGetFrameTimeNanos || !gGetPreferredFrameTimelineIndex || !gGetExpectedPresentationTimeNanos || !gGetDeadlineNanos){
+            gPostVsyncCallback = nullptr;
+        }
+    });
+}
+
+ChoreographerVsyncSource::~ChoreographerVsyncSource() {
+    stop();
+}
+
+void ChoreographerVsyncSource::start(VsyncTimeline *timeline) {
+    if(mThread.joinable()){
+        return;
+    }
+    mTimeline = timeline;
+    loadChoreographerSymbols();
+    bRunning = true;
+    mThread = std::thread(&ChoreographerVsyncSource::threadLoop, this);
+    // stop() needs the looper to wake the thread
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCond.wait(lock, [this]{ return mLooper != nullptr; });
+    LOG_D("VsyncTimeline: %s", gPostVsyncCallback ? "vsync callbacks with frame timelines" :
+                               gPostFrameCallback64 ? "64 bit frame callbacks" : "frame callbacks");
+}
+
+void ChoreographerVsyncSource::stop() {
+    if(!mThread.joinable()){
+        return;
+    }
+    bRunning = false;
+    ALooper_wake(mLooper);
+    mThread.join();
+    mLooper = nullptr;
+}
+
+void ChoreographerVsyncSource::threadLoop() {
+    pthread_setname_np(pthread_self(), "Camera-Vsync");
+    // only records timestamps the kernel took, a late wakeup costs nothing
+    ThreadManager::get().place(ThreadRole::METRICS, "Camera-Vsync");
+    ALooper *looper = ALooper_prepare(0);
+    ALooper_acquire(looper);
+    // the instance belongs to this thread and its looper
+    mChoreographer = AChoreographer_getInstance();
+    postCallback();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLooper = looper;
+    }
+    mCond.notify_all();
+
+    while(bRunning){
+        ALooper_pollOnce(-1, nullptr, nullptr, nullptr);
+    }
+    ALooper_release(looper);
+}
+
+void ChoreographerVsyncSource::postCallback() {
+    if(gPostVsyncCallback){
+        gPostVsyncCallback(mChoreographer, vsyncCallback, this);
+    } else if(gPostFrameCallback64){
+        gPostFrameCallback64(mChoreographer, frameCallback64, this);
+    } else {
+        AChoreographer_postFrameCallback(mChoreographer, frameCallback, this);
+    }
+}
+
+void ChoreographerVsyncSource::frameCallback(long frameTimeNanos, void *data) {
+    uint64_t vsyncNs = (uint64_t)frameTimeNanos;
+    if(sizeof(long) < sizeof(int64_t)){
+        // a long is 32 bits on armv7, the high half comes from the clock, the vsync is a few ms in the past
+        uint64_t nowNs = getTimeNano(CLOCK_MONOTONIC);
+        vsyncNs = (nowNs & ~(uint64_t)UINT32_MAX) | (uint32_t)frameTimeNanos;
+        if(vsyncNs > nowNs){
+            vsyncNs -= (uint64_t)UINT32_MAX + 1;
+        }
+    }
+    static_cast<ChoreographerVsyncSource*>(data)->publish(vsyncNs, 0, 0);
+}
+
+void ChoreographerVsyncSource::frameCallback64(int64_t frameTimeNanos, void *data) {
+    static_cast<ChoreographerVsyncSource*>(data)->publish(frameTimeNanos, 0, 0);
+}
+
+void ChoreographerVsyncSource::vsyncCallback(const void *callbackData, void *data) {
+    size_t preferred = gGetPreferredFrameTimelineIndex(callbackData);
+    static_cast<ChoreographerVsyncSource*>(data)->publish(gGetFrameTimeNanos(callbackData),
+                                                          gGetExpectedPresentationTimeNanos(callbackData, preferred),
+                                                          gGetDeadlineNanos(callbackData, preferred));
+}
+
+void ChoreographerVsyncSource::publish(uint64_t vsyncNs, uint64_t presentNs, uint64_t deadlineNs) {
+    if(!bRunning){
+        return;
+    }
+    postCallback();
+    mTimeline->publish(vsyncNs, presentNs, deadlineNs);
+}
@@ -0,0 +1,49 @@
+/*!
+ * @brief  Vsync timestamps from AChoreographer on a looper thread of its own, the device VsyncSource
+ * @date 2023/8/24
+ */
+#ifndef CAMERA2VK_CHOREOGRAPHERVSYNCSOURCE_H
+#define CAMERA2VK_CHOREOGRAPHERVSYNCSOURCE_H
+
+#include <android/choreographer.h>
+#include <android/looper.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "VsyncTimeline.h"
+
+/**
+ * The thread prepares an ALooper of its own and keeps one Choreographer callback posted on it, so vsync arrives no
+ * matter what the render thread is polling. AChoreographer_postVsyncCallback with frame timelines is used from API 33,
+ * postFrameCallback64 from API 29 and postFrameCallback before that.
+ */
+class ChoreographerVsyncSource : public VsyncSource{
+public:
+    ~ChoreographerVsyncSource() override;
+
+    void start(VsyncTimeline *timeline) override;
+    void stop() override;
+
+private:
+    void threadLoop();
+    void postCallback();
+    void publish(uint64_t vsyncNs, uint64_t presentNs, uint64_t deadlineNs);
+
+    static void frameCallback(long frameTimeNanos, void *data);
+    static void frameCallback64(int64_t frameTimeNanos, void *data);
+    static void vsyncCallback(const void *callbackData, void *data);
+
+    VsyncTimeline *mTimeline = nullptr;
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    ALooper *mLooper = nullptr;
+    std::atomic<bool> bRunning{false};
+
+    // vsync thread only
+    AChoreographer *mChoreographer = nullptr;
+};
+
+#endif //CAMERA2VK_CHOREOGRAPHERVSYNCSOURCE_H
@@ -5,31 +5,14 @@
 #ifndef CAMERA2VK_COMMON_H
 #define CAMERA2VK_COMMON_H
 
-#include <android/log.h>
-#include <android/asset_manager.h>
+#include <cstdint>
 #include <ctime>
+#include "Log.h"
 
-#define LOG_TAG "Camera2Vk"
-#define GRAPHIC_API_GLES
+#define GRAPHIC_API_GLES               // backends RendererFactory may pick at launch, GLES is the default when built in
 #define GRAPHIC_API_VK
 #define RENDER_USE_SINGLE_BUFFER
-
-#ifndef ALOG
-#define ALOG(priority, tag, fmt...) \
-    __android_log_print(ANDROID_##priority, tag, fmt)
-#endif
-
-#ifndef LOG_D
-#define LOG_D(...) ((void)ALOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__))
-#endif
-
-#ifndef LOG_W
-#define LOG_W(...) ((void)ALOG(LOG_WARN, LOG_TAG, __VA_ARGS__))
-#endif
-
-#ifndef LOG_E
-#define LOG_E(...) ((void)ALOG(LOG_ERROR, LOG_TAG, __VA_ARGS__))
-#endif
+//#define VK_PIPELINE_BENCHMARK          // run the headless vulkan benchmark once at startup, on the device
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 #define SAFE_DELETE(p)       { if(p) { delete (p);     (p)=NULL; } }
@@ -0,0 +1,36 @@
+/*!
+ * @brief  Per frame stage times and startup milestones, filled the same way by every renderer backend
+ * @date 2023/8/17
+ */
+#ifndef CAMERA2VK_FRAMETIMING_H
+#define CAMERA2VK_FRAMETIMING_H
+
+#include <cstdint>
+
+// CPU time spent in each stage of the last ProcessFrame, and what came back about earlier frames
+struct FrameStageTimes{
+    uint64_t startNs = 0;                    // this frame after the wait, on CLOCK_MONOTONIC, what the fields below refer back to
+    uint64_t frameWaitNs = 0;                // blocked on the oldest frame in flight, the only wait on the GPU
+    uint64_t acquireNs = 0;                  // 0 where the swap acquires implicitly (GLES)
+    uint64_t uploadNs = 0;
+    uint64_t renderNs = 0;
+    uint64_t presentNs = 0;                  // nothing to present in headless mode
+    uint64_t totalNs = 0;
+    uint64_t latencyNs = 0;                  // start to GPU completion of the frame the wait retired
+    uint64_t retiredStartNs = 0;             // startNs of that frame, 0 when none retired
+    uint64_t gpuNs = 0;                      // GPU time of that frame, 0 without timestamps
+    uint64_t gpuEyeNs[2] = {};               // GPU time of the draws of each eye of that frame, 0 where one pass draws both
+    uint64_t latchNs = 0;                    // start to compositor latch of the last frame whose display times came back
+    uint64_t displayNs = 0;                  // start to scanout of that frame, both 0 without display timestamps
+    uint64_t displayedStartNs = 0;           // startNs of that frame
+};
+
+// startup milestones on CLOCK_MONOTONIC
+struct StartupTimes{
+    uint64_t launchNs = 0;                   // SetLaunchTime, the start of Init when it was not set
+    uint64_t initStartNs = 0;
+    uint64_t initEndNs = 0;
+    uint64_t firstFrameNs = 0;               // the first frame submitted, 0 until then
+};
+
+#endif //CAMERA2VK_FRAMETIMING_H
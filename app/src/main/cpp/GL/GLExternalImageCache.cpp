@@ -0,0 +1,97 @@
+#include "GLExternalImageCache.h"
+#include "GLShaderUtil.h"
+#include "../Common.h"
+
+GLExternalImageCache::GLExternalImageCache(EGLDisplay display, uint32_t maxEntries)
+        : mDisplay(display), mMaxEntries(maxEntries) {
+}
+
+GLExternalImageCache::~GLExternalImageCache() {
+    clear();
+}
+
+bool GLExternalImageCache::isSupported(EGLDisplay display) {
+    const char *eglExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    const char *glExtensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    bool bSupported = HasGLExtension(eglExtensions, "EGL_KHR_image_base") &&
+                      HasGLExtension(eglExtensions, "EGL_ANDROID_image_native_buffer") &&
+                      HasGLExtension(eglExtensions, "EGL_ANDROID_get_native_client_buffer") &&
+                      HasGLExtension(glExtensions, "GL_OES_EGL_image_external_essl3");
+    if(!bSupported){
+        LOG_W("GLExternalImageCache: EGLImage import of camera buffers is not supported.");
+    }
+    return bSupported;
+}
+
+GLuint GLExternalImageCache::getTexture(AHardwareBuffer *buffer) {
+    mUseCount++;
+    auto it = mEntries.find(buffer);
+    if(it != mEntries.end()){
+        it->second.lastUse = mUseCount;
+        return it->second.texture;
+    }
+
+    EGLClientBuffer clientBuffer = eglGetNativeClientBufferANDROID(buffer);
+    const EGLint imageAttr[] = {
+            EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+            EGL_NONE
+    };
+    EGLImageKHR image = eglCreateImageKHR(mDisplay, EGL_NO_CONTEXT, EGL_NATIVE_BUFFER_ANDROID, clientBuffer, imageAttr);
+    if(image == EGL_NO_IMAGE_KHR){
+        LOG_E("GLExternalImageCache: eglCreateImageKHR failed: 0x%x", eglGetError());
+        return 0;
+    }
+    // an error left over from earlier calls must not fail the import
+    glGetError();
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, static_cast<GLeglImageOES>(image));
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+    GLenum error = glGetError();
+    if(error != GL_NO_ERROR){
+        LOG_E("GLExternalImageCache: glEGLImageTargetTexture2DOES failed: 0x%x", error);
+        glDeleteTextures(1, &texture);
+        eglDestroyImageKHR(mDisplay, image);
+        return 0;
+    }
+
+    if(mEntries.size() >= mMaxEntries){
+        auto oldest = mEntries.begin();
+        for(auto item = mEntries.begin(); item != mEntries.end(); item++){
+            if(item->second.lastUse < oldest->second.lastUse){
+                oldest = item;
+            }
+        }
+        release(oldest->second, oldest->first);
+        mEntries.erase(oldest);
+    }
+    AHardwareBuffer_acquire(buffer);
+    mEntries[buffer] = {
+            .image = image,
+            .texture = texture,
+            .lastUse = mUseCount
+    };
+    AHardwareBuffer_Desc desc;
+    AHardwareBuffer_describe(buffer, &desc);
+    LOG_D("GLExternalImageCache: imported buffer %p [%u x %u, format:%u], %zu cached", buffer, desc.width, desc.height,
+          desc.format, mEntries.size());
+    return texture;
+}
+
+void GLExternalImageCache::clear() {
+    for(auto &item : mEntries){
+        release(item.second, item.first);
+    }
+    mEntries.clear();
+}
+
+void GLExternalImageCache::release(Entry &entry, AHardwareBuffer *buffer) {
+    glDeleteTextures(1, &entry.texture);
+    eglDestroyImageKHR(mDisplay, entry.image);
+    AHardwareBuffer_release(buffer);
+}
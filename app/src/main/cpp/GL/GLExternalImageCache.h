@@ -0,0 +1,55 @@
+/*!
+ * @brief  Camera AHardwareBuffers wrapped as GL_TEXTURE_EXTERNAL_OES textures through EGLImages, cached per buffer
+ * @date 2023/8/16
+ */
+#ifndef CAMERA2VK_GLEXTERNALIMAGECACHE_H
+#define CAMERA2VK_GLEXTERNALIMAGECACHE_H
+
+#include <cstdint>
+#include <map>
+#include <android/hardware_buffer.h>
+#include <EGL/egl.h>
+#ifndef EGL_EGLEXT_PROTOTYPES
+#define EGL_EGLEXT_PROTOTYPES
+#endif
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+/**
+ * An image reader cycles through a handful of buffers, so after the first few frames every buffer it hands out has an
+ * EGLImage and an external texture already and a frame costs a map lookup, no copy and no EGL call. Each cached buffer
+ * is acquired, its address can not be reused by another buffer while the entry lives. Past maxEntries the least
+ * recently used entry goes. Needs the context current, GL thread only.
+ */
+class GLExternalImageCache{
+public:
+    explicit GLExternalImageCache(EGLDisplay display, uint32_t maxEntries = 16);
+    ~GLExternalImageCache();
+
+    // the EGL and GLES extensions the import needs, with the context current
+    static bool isSupported(EGLDisplay display);
+
+    // the external texture sampling buffer, 0 when it can not be imported
+    GLuint getTexture(AHardwareBuffer *buffer);
+    void clear();
+
+private:
+    struct Entry{
+        EGLImageKHR image;
+        GLuint texture;
+        uint64_t lastUse;
+    };
+
+    void release(Entry &entry, AHardwareBuffer *buffer);
+
+    EGLDisplay mDisplay;
+    uint32_t mMaxEntries;
+    uint64_t mUseCount = 0;
+    std::map<AHardwareBuffer*, Entry> mEntries;
+};
+
+#endif //CAMERA2VK_GLEXTERNALIMAGECACHE_H
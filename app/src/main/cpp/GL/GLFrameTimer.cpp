@@ -0,0 +1,246 @@
+#include "GLFrameTimer.h"
+#include <algorithm>
+#include <cerrno>
+#include <linux/sync_file.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "GLShaderUtil.h"
+#include "../Common.h"
+
+// display timestamps of frames older than this never come back, the queue drops them
+static const size_t gMaxPendingFrames = 8;
+
+GLFrameTimer::GLFrameTimer(EGLDisplay display, EGLSurface surface, uint32_t depth, uint32_t passCount, bool bSwapped)
+        : mDisplay(display), mSurface(surface), mPassCount(std::min(passCount, (uint32_t)GL_FRAME_TIMER_MAX_PASSES)),
+          mSlots(std::max(depth, 1u)) {
+    const char *eglExtensions = eglQueryString(mDisplay, EGL_EXTENSIONS);
+    const char *glExtensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+
+    mDupNativeFenceFD = (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress("eglDupNativeFenceFDANDROID");
+    bNativeFences = HasGLExtension(eglExtensions, "EGL_ANDROID_native_fence_sync") && mDupNativeFenceFD != nullptr;
+
+    mGenQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    mDeleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    mBeginQuery = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+    mEndQuery = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+    mGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+    bTimerQueries = HasGLExtension(glExtensions, "GL_EXT_disjoint_timer_query") && mGenQueries && mDeleteQueries &&
+                    mBeginQuery && mEndQuery && mGetQueryObjectui64v;
+
+    mGetNextFrameId = (PFNEGLGETNEXTFRAMEIDANDROIDPROC)eglGetProcAddress("eglGetNextFrameIdANDROID");
+    mGetFrameTimestamps = (PFNEGLGETFRAMETIMESTAMPSANDROIDPROC)eglGetProcAddress("eglGetFrameTimestampsANDROID");
+    bFrameTimestamps = bSwapped && HasGLExtension(eglExtensions, "EGL_ANDROID_get_frame_timestamps") &&
+                       mGetNextFrameId && mGetFrameTimestamps &&
+                       eglSurfaceAttrib(mDisplay, mSurface, EGL_TIMESTAMPS_ANDROID, EGL_TRUE);
+
+    if(bTimerQueries){
+        for(auto &slot : mSlots){
+            mGenQueries(mPassCount, slot.queries);
+        }
+        // reading the flag clears it, whatever happened before the first frame does not count
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    }
+    LOG_D("GLFrameTimer: %zu frames in flight, native fences %s, timer queries %s, frame timestamps %s", mSlots.size(),
+          bNativeFences ? "on" : "off", bTimerQueries ? "on" : "off", bFrameTimestamps ? "on" : "off");
+}
+
+GLFrameTimer::~GLFrameTimer() {
+    for(auto &slot : mSlots){
+        for(int &fd : slot.fenceFds){
+            if(fd >= 0){
+                close(fd);
+                fd = -1;
+            }
+        }
+        if(bTimerQueries){
+            mDeleteQueries(mPassCount, slot.queries);
+        }
+    }
+}
+
+void GLFrameTimer::beginFrame(FrameStageTimes *io_times) {
+    mCurrent = (mCurrent + 1) % mSlots.size();
+    Slot &slot = mSlots[mCurrent];
+    uint64_t startNs = getTimeNano(CLOCK_MONOTONIC);
+    io_times->frameWaitNs = 0;
+    if(slot.bInFlight){
+        int lastFd = slot.fenceFds[mPassCount - 1];
+        if(lastFd >= 0){
+            pollfd pfd = { .fd = lastFd, .events = POLLIN, .revents = 0 };
+            while(poll(&pfd, 1, -1) < 0 && (errno == EINTR || errno == EAGAIN));
+        }
+        io_times->frameWaitNs = getTimeNano(CLOCK_MONOTONIC) - startNs;
+        mWaitNs += io_times->frameWaitNs;
+        mMaxWaitNs = std::max(mMaxWaitNs, io_times->frameWaitNs);
+        retire(slot, io_times);
+    }
+    if(bFrameTimestamps){
+        collectDisplayTimes(io_times);
+    }
+    slot.bInFlight = true;
+    slot.startNs = startNs + io_times->frameWaitNs;
+    io_times->startNs = slot.startNs;
+    mFrameCount++;
+}
+
+void GLFrameTimer::beginPass(uint32_t passIndex) {
+    if(bTimerQueries && passIndex < mPassCount){
+        mBeginQuery(GL_TIME_ELAPSED_EXT, mSlots[mCurrent].queries[passIndex]);
+    }
+}
+
+void GLFrameTimer::endPass(uint32_t passIndex) {
+    if(passIndex >= mPassCount){
+        return;
+    }
+    Slot &slot = mSlots[mCurrent];
+    if(bTimerQueries){
+        mEndQuery(GL_TIME_ELAPSED_EXT);
+        slot.bQueried[passIndex] = true;
+    }
+    if(bNativeFences){
+        EGLSyncKHR sync = eglCreateSyncKHR(mDisplay, EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
+        if(sync != EGL_NO_SYNC_KHR){
+            // the fd only exists once the fence was flushed
+            glFlush();
+            slot.fenceFds[passIndex] = mDupNativeFenceFD(mDisplay, sync);
+            eglDestroySyncKHR(mDisplay, sync);
+        }
+    }
+}
+
+void GLFrameTimer::beforeSwap() {
+    if(!bFrameTimestamps){
+        return;
+    }
+    EGLuint64KHR frameId = 0;
+    if(mGetNextFrameId(mDisplay, mSurface, &frameId)){
+        if(mPendingFrames.size() == gMaxPendingFrames){
+            mPendingFrames.pop_front();
+        }
+        mPendingFrames.push_back({frameId, mSlots[mCurrent].startNs});
+    }
+}
+
+void GLFrameTimer::retire(Slot &slot, FrameStageTimes *io_times) {
+    slot.bInFlight = false;
+    io_times->latencyNs = 0;
+    io_times->retiredStartNs = 0;
+    io_times->gpuNs = 0;
+    int lastFd = slot.fenceFds[mPassCount - 1];
+    uint64_t signalNs = lastFd >= 0 ? fenceSignalTime(lastFd) : 0;
+    if(signalNs > slot.startNs){
+        io_times->latencyNs = signalNs - slot.startNs;
+        io_times->retiredStartNs = slot.startNs;
+        mLatencyNs += io_times->latencyNs;
+        mMaxLatencyNs = std::max(mMaxLatencyNs, io_times->latencyNs);
+        mRetiredCount++;
+    }
+    for(int &fd : slot.fenceFds){
+        if(fd >= 0){
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if(!bTimerQueries){
+        return;
+    }
+    // the fence covered the passes, their results are there without a stall
+    uint64_t passNs[GL_FRAME_TIMER_MAX_PASSES] = {0, 0};
+    bool bComplete = true;
+    for(uint32_t passIndex = 0; passIndex < mPassCount; passIndex++){
+        if(!slot.bQueried[passIndex]){
+            bComplete = false;
+            continue;
+        }
+        GLuint64 elapsedNs = 0;
+        mGetQueryObjectui64v(slot.queries[passIndex], GL_QUERY_RESULT_EXT, &elapsedNs);
+        passNs[passIndex] = elapsedNs;
+        slot.bQueried[passIndex] = false;
+    }
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if(disjoint){
+        mDisjointCount++;
+        return;
+    }
+    if(!bComplete){
+        return;
+    }
+    for(uint32_t passIndex = 0; passIndex < mPassCount; passIndex++){
+        io_times->gpuNs += passNs[passIndex];
+        mPassGpuNs[passIndex] += passNs[passIndex];
+    }
+    mGpuSampleCount++;
+}
+
+void GLFrameTimer::collectDisplayTimes(FrameStageTimes *io_times) {
+    io_times->latchNs = 0;
+    io_times->displayNs = 0;
+    io_times->displayedStartNs = 0;
+    const EGLint names[] = {EGL_COMPOSITION_LATCH_TIME_ANDROID, EGL_DISPLAY_PRESENT_TIME_ANDROID};
+    while(!mPendingFrames.empty()){
+        PendingFrame &frame = mPendingFrames.front();
+        EGLnsecsANDROID values[ARRAY_SIZE(names)] = {0, 0};
+        if(!mGetFrameTimestamps(mDisplay, mSurface, frame.frameId, ARRAY_SIZE(names), names, values)){
+            // too old, the surface forgot it
+            mPendingFrames.pop_front();
+            continue;
+        }
+        if(values[0] == EGL_TIMESTAMP_PENDING_ANDROID || values[1] == EGL_TIMESTAMP_PENDING_ANDROID){
+            return;
+        }
+        if(values[0] > 0 && values[1] > 0 && (uint64_t)values[1] > frame.startNs){
+            io_times->latchNs = values[0] - frame.startNs;
+            io_times->displayNs = values[1] - frame.startNs;
+            io_times->displayedStartNs = frame.startNs;
+            mLatchNs += io_times->latchNs;
+            mDisplayNs += io_times->displayNs;
+            mDisplaySampleCount++;
+        }
+        mPendingFrames.pop_front();
+    }
+}
+
+uint64_t GLFrameTimer::fenceSignalTime(int fd) {
+    // a first call with no room only asks how many fences the sync file merges
+    sync_file_info info = {};
+    if(ioctl(fd, SYNC_IOC_FILE_INFO, &info) < 0 || info.num_fences == 0){
+        return 0;
+    }
+    std::vector<sync_fence_info> fences(info.num_fences);
+    info.sync_fence_info = reinterpret_cast<uint64_t>(fences.data());
+    if(ioctl(fd, SYNC_IOC_FILE_INFO, &info) < 0 || info.status != 1){
+        return 0;
+    }
+    uint64_t signalNs = 0;
+    for(const auto &fence : fences){
+        signalNs = std::max(signalNs, (uint64_t)fence.timestamp_ns);
+    }
+    return signalNs;
+}
+
+void GLFrameTimer::printStats() {
+    if(mFrameCount == 0){
+        return;
+    }
+    LOG_D("GLFrameTimer: %zu frames in flight, fence wait %.3f ms avg %.3f ms max over %u frames", mSlots.size(),
+          mWaitNs * 1.f / mFrameCount / U_TIME_1MS_IN_NS, mMaxWaitNs * 1.f / U_TIME_1MS_IN_NS, mFrameCount);
+    if(mRetiredCount > 0){
+        LOG_D("GLFrameTimer: GPU done %.3f ms avg %.3f ms max after the frame start", mLatencyNs * 1.f / mRetiredCount / U_TIME_1MS_IN_NS,
+              mMaxLatencyNs * 1.f / U_TIME_1MS_IN_NS);
+    }
+    if(mGpuSampleCount > 0){
+        LOG_D("GLFrameTimer: GPU first pass %.3f ms, second pass %.3f ms avg over %u frames, %u disjoint",
+              mPassGpuNs[0] * 1.f / mGpuSampleCount / U_TIME_1MS_IN_NS, mPassGpuNs[1] * 1.f / mGpuSampleCount / U_TIME_1MS_IN_NS,
+              mGpuSampleCount, mDisjointCount);
+    }
+    if(mDisplaySampleCount > 0){
+        LOG_D("GLFrameTimer: latch %.3f ms, on display %.3f ms avg after the frame start over %u frames",
+              mLatchNs * 1.f / mDisplaySampleCount / U_TIME_1MS_IN_NS, mDisplayNs * 1.f / mDisplaySampleCount / U_TIME_1MS_IN_NS,
+              mDisplaySampleCount);
+    }
+}
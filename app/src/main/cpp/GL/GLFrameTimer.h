@@ -0,0 +1,97 @@
+/*!
+ * @brief  GPU completion, per pass GPU time and display timestamps of GL frames, the GLES side of FrameStageTimes
+ * @date 2023/8/17
+ */
+#ifndef CAMERA2VK_GLFRAMETIMER_H
+#define CAMERA2VK_GLFRAMETIMER_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <EGL/egl.h>
+#ifndef EGL_EGLEXT_PROTOTYPES
+#define EGL_EGLEXT_PROTOTYPES
+#endif
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include "../FrameTiming.h"
+
+#define GL_FRAME_TIMER_MAX_PASSES 2
+
+/**
+ * The GL counterpart of VkFrameRing and VkQueueTimer. Every pass ends in an EGL_ANDROID_native_fence_sync fence; the
+ * sync file of the last one tells when the GPU finished the frame, on CLOCK_MONOTONIC. beginFrame() blocks on the
+ * fence of the frame depth frames back, which bounds the frames in flight the way the Vulkan fences do.
+ * GL_EXT_disjoint_timer_query times each pass, and results from a disjoint period are dropped.
+ * EGL_ANDROID_get_frame_timestamps reports latch and present of swapped frames a few frames later, so a single
+ * buffered surface has none. Each feature is off when its extension is missing. GL thread only.
+ */
+class GLFrameTimer{
+public:
+    GLFrameTimer(EGLDisplay display, EGLSurface surface, uint32_t depth, uint32_t passCount, bool bSwapped);
+    ~GLFrameTimer();
+
+    // waits for the frame that last used the next slot and fills the wait, latency, GPU and display times
+    void beginFrame(FrameStageTimes *io_times);
+    void beginPass(uint32_t passIndex);
+    // the fence is flushed right away, so it reaches the driver along with the pass
+    void endPass(uint32_t passIndex);
+    // right before eglSwapBuffers, the display timestamps are asked for by the id of the next frame
+    void beforeSwap();
+    void printStats();
+
+private:
+    struct Slot{
+        bool bInFlight = false;
+        uint64_t startNs = 0;
+        int fenceFds[GL_FRAME_TIMER_MAX_PASSES] = {-1, -1};
+        GLuint queries[GL_FRAME_TIMER_MAX_PASSES] = {0, 0};
+        bool bQueried[GL_FRAME_TIMER_MAX_PASSES] = {false, false};
+    };
+    struct PendingFrame{
+        EGLuint64KHR frameId;
+        uint64_t startNs;
+    };
+
+    void retire(Slot &slot, FrameStageTimes *io_times);
+    void collectDisplayTimes(FrameStageTimes *io_times);
+    static uint64_t fenceSignalTime(int fd);
+
+    EGLDisplay mDisplay;
+    EGLSurface mSurface;
+    uint32_t mPassCount;
+    std::vector<Slot> mSlots;
+    uint32_t mCurrent = 0;
+    std::deque<PendingFrame> mPendingFrames;
+
+    bool bNativeFences = false;
+    bool bTimerQueries = false;
+    bool bFrameTimestamps = false;
+    PFNEGLDUPNATIVEFENCEFDANDROIDPROC mDupNativeFenceFD = nullptr;
+    PFNGLGENQUERIESEXTPROC mGenQueries = nullptr;
+    PFNGLDELETEQUERIESEXTPROC mDeleteQueries = nullptr;
+    PFNGLBEGINQUERYEXTPROC mBeginQuery = nullptr;
+    PFNGLENDQUERYEXTPROC mEndQuery = nullptr;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC mGetQueryObjectui64v = nullptr;
+    PFNEGLGETNEXTFRAMEIDANDROIDPROC mGetNextFrameId = nullptr;
+    PFNEGLGETFRAMETIMESTAMPSANDROIDPROC mGetFrameTimestamps = nullptr;
+
+    uint64_t mWaitNs = 0;
+    uint64_t mMaxWaitNs = 0;
+    uint64_t mLatencyNs = 0;
+    uint64_t mMaxLatencyNs = 0;
+    uint64_t mPassGpuNs[GL_FRAME_TIMER_MAX_PASSES] = {0, 0};
+    uint64_t mLatchNs = 0;
+    uint64_t mDisplayNs = 0;
+    uint32_t mFrameCount = 0;
+    uint32_t mRetiredCount = 0;
+    uint32_t mGpuSampleCount = 0;
+    uint32_t mDisjointCount = 0;
+    uint32_t mDisplaySampleCount = 0;
+};
+
+#endif //CAMERA2VK_GLFRAMETIMER_H
@@ -0,0 +1,98 @@
+#include "GLProgramCache.h"
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "../Common.h"
+
+static const uint32_t gProgramCacheMagic = 0x4750524d;   // 'GPRM'
+
+struct ProgramBinaryHeader{
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+    uint32_t length;
+};
+
+GLProgramCache::GLProgramCache(const std::string &directory) : mDirectory(directory) {
+    const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for(GLenum name : names){
+        const char *value = reinterpret_cast<const char*>(glGetString(name));
+        mDriverVersion += value ? value : "";
+        mDriverVersion += '\n';
+    }
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if(formatCount == 0){
+        LOG_W("GLProgramCache: the driver has no program binary format, every launch compiles.");
+    }
+}
+
+uint64_t GLProgramCache::key(const char *vertexSource, const char *fragSource) const {
+    std::hash<std::string> hasher;
+    uint64_t value = hasher(mDriverVersion);
+    value = value * 31 + hasher(vertexSource);
+    value = value * 31 + hasher(fragSource);
+    return value;
+}
+
+std::string GLProgramCache::path(const char *name) const {
+    return mDirectory + "/gl_program_" + name + ".bin";
+}
+
+GLuint GLProgramCache::load(const char *name, const char *vertexSource, const char *fragSource) {
+    FILE *file = fopen(path(name).c_str(), "rb");
+    if(!file){
+        return 0;
+    }
+    ProgramBinaryHeader header = {};
+    std::vector<char> binary;
+    bool bRead = fread(&header, sizeof(header), 1, file) == 1 && header.magic == gProgramCacheMagic &&
+                 header.key == key(vertexSource, fragSource);
+    if(bRead){
+        binary.resize(header.length);
+        bRead = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if(!bRead){
+        LOG_D("GLProgramCache: %s binary is stale or truncated.", name);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), binary.size());
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status == 0){
+        // drivers may refuse a binary for reasons the key does not cover
+        LOG_W("GLProgramCache: %s binary was rejected by the driver.", name);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void GLProgramCache::store(const char *name, const char *vertexSource, const char *fragSource, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0){
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    ProgramBinaryHeader header = {
+            .magic = gProgramCacheMagic,
+            .format = format,
+            .key = key(vertexSource, fragSource),
+            .length = static_cast<uint32_t>(length)
+    };
+    // a torn write leaves a file that fails the length check next time
+    FILE *file = fopen(path(name).c_str(), "wb");
+    if(!file){
+        LOG_W("GLProgramCache: can not write %s.", path(name).c_str());
+        return;
+    }
+    bool bWritten = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, length, file) == (size_t)length;
+    fclose(file);
+    LOG_D("GLProgramCache: %s %s, %d bytes", name, bWritten ? "stored" : "store failed", length);
+}
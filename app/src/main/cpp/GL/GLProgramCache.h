@@ -0,0 +1,34 @@
+/*!
+ * @brief  Linked GL programs kept as driver binaries on disk, so later launches skip compiling and linking
+ * @date 2023/8/17
+ */
+#ifndef CAMERA2VK_GLPROGRAMCACHE_H
+#define CAMERA2VK_GLPROGRAMCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <GLES3/gl3.h>
+
+/**
+ * One file per program name in directory. A binary is only good for the driver that wrote it and for the sources it
+ * was built from, both go into the key stored with it, so a driver update or a shader change falls back to a normal
+ * build which then replaces the file. Needs the context current.
+ */
+class GLProgramCache{
+public:
+    explicit GLProgramCache(const std::string &directory);
+
+    // the program from its binary, 0 when there is none for this driver and these sources or the driver rejects it
+    GLuint load(const char *name, const char *vertexSource, const char *fragSource);
+    // program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    void store(const char *name, const char *vertexSource, const char *fragSource, GLuint program);
+
+private:
+    uint64_t key(const char *vertexSource, const char *fragSource) const;
+    std::string path(const char *name) const;
+
+    std::string mDirectory;
+    std::string mDriverVersion;     // vendor, renderer and version strings
+};
+
+#endif //CAMERA2VK_GLPROGRAMCACHE_H
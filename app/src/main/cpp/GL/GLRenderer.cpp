@@ -1,16 +1,19 @@
 #include "GLRenderer.h"
+#include <cstring>
 #include <string>
-#include <android/choreographer.h>
+#include <android_native_app_glue.h>
 #include "GLShaderUtil.h"
+#include "../Camera/CameraImageReader.h"
 #include "../Common.h"
-#include "../Camera/AndroidCameraPermission.h"
 #include "../ProfileTrace.h"
 
-const int64_t gFramePeriodNs = (int64_t)(1e9 / 90);  //90FPS
-const float gTimeWarpWaitFramePercentage = 0.5f;
-const bool gTimeWarpDelayBetweenEyes = false;
-const int gWarpMeshType = 2; //0 = Columns (Left To Right); 1 = Columns (Right To Left); 2 = Rows (Top To Bottom); 3 = Rows (Bottom To Top)
+const bool gZeroCopyImport = true;   // sample the camera buffers through EGLImages instead of uploading the planes
+const bool gPboUpload = true;        // otherwise planes stream through a ring of unpack buffers into immutable textures
+const uint32_t gUploadRingSlots = 6; // three frames of both eyes
+const uint32_t gUploadStatsEyes = 600;  // uploads per upload cost report
+const uint32_t gFramesInFlight = 2;  // the frame timer blocks on the GPU beyond this many frames
 
+// the position of both eyes and the shared texcoords live in one vertex buffer in this order
 const GLfloat gLeftMeshVertices[] = {
         -0.95f, 0.95f,
         -0.95f, -0.95f,
@@ -30,29 +33,29 @@ const GLfloat gMeshTexcoords[] = {
         1, 1
 };
 
-static uint64_t gLastVsyncTimeNs = 0;
-static void VsyncCallback(long frameTimeNanos, void* data) {
-    gLastVsyncTimeNs = frameTimeNanos;
-}
-
-std::vector<char> GLRenderer::ReadFileFromAndroidRes(const std::string& filePath) {
-    AAsset* file = AAssetManager_open(mApp->activity->assetManager, filePath.c_str(), AASSET_MODE_BUFFER);
-    size_t fileLength = AAsset_getLength(file);
-
-    std::vector<char> buffer(fileLength);
-
-    AAsset_read(file, buffer.data(), fileLength);
-    AAsset_close(file);
-
-    return buffer;
-}
-
 void GLRenderer::Init(struct android_app *app) {
-    mApp = app;
+    AttachApp(app);
+    BeginInit();
 
-    OpenCameras();
+    // sampled by the GPU when the EGLImage import is available, the planes stay readable for the upload path
+    OpenCameras(gZeroCopyImport ? AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE : 0);
     InitEGLEnv();
+    bZeroCopy = gZeroCopyImport && GLExternalImageCache::isSupported(m_EglDisplay);
+    if(bZeroCopy){
+        mExternalImages = new GLExternalImageCache(m_EglDisplay);
+    }
+    LOG_D("GLRenderer: camera frames are %s", bZeroCopy ? "imported as external textures" : "uploaded per plane");
+    // the surface keeps its size for as long as the window lives
+    eglQuerySurface(m_EglDisplay, m_EglSurface, EGL_WIDTH, &mSurfaceWidth);
+    eglQuerySurface(m_EglDisplay, m_EglSurface, EGL_HEIGHT, &mSurfaceHeight);
+    glEnable(GL_SCISSOR_TEST);
     CreateProgram();
+    CreateVertexState();
+#ifdef RENDER_USE_SINGLE_BUFFER
+    mFrameTimer = new GLFrameTimer(m_EglDisplay, m_EglSurface, gFramesInFlight, 2, false);
+#else
+    mFrameTimer = new GLFrameTimer(m_EglDisplay, m_EglSurface, gFramesInFlight, 2, true);
+#endif
 
     glGenTextures(1, &mLeftTextureY);
     glBindTexture(GL_TEXTURE_2D, mLeftTextureY);
@@ -83,78 +86,36 @@ void GLRenderer::Init(struct android_app *app) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
+    EndInit();
     bRunning = true;
 }
 
 void GLRenderer::Destroy() {
     bRunning = false;
+    mVsyncTimeline.stop();
     glDeleteTextures(1, &mLeftTextureY);
     glDeleteTextures(1, &mLeftTextureUV);
     glDeleteTextures(1, &mRightTextureY);
     glDeleteTextures(1, &mRightTextureUV);
-    glDeleteShader(mVertexShader);
-    glDeleteShader(mFragShader);
+    SAFE_DELETE(mUploadRing);
+    SAFE_DELETE(mExternalImages);
+    mFrameTimer->printStats();
+    SAFE_DELETE(mFrameTimer);
+    mLatency.printStats();
+    glDeleteVertexArrays(2, mVertexArrays);
+    glDeleteBuffers(1, &mVertexBuffer);
     glDeleteProgram(mProgram);
+    if(mProgramExternal){
+        glDeleteProgram(mProgramExternal);
+    }
     DestroyEGLEnv();
     CloseCameras();
 }
 
-bool GLRenderer::IsRunning() {
-    return bRunning;
-}
-
 void GLRenderer::ProcessFrame(uint64_t frameIndex) {
     TRACE_BEGIN("ProcessFrame:%lu", frameIndex);
-    AChoreographer *grapher = AChoreographer_getInstance();
-    AChoreographer_postFrameCallback(grapher, VsyncCallback, nullptr);
-    uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
-    mLastVsyncTimeNs = gLastVsyncTimeNs;
-    if (mLastVsyncTimeNs > startTimeNs) {
-        LOG_W("%lu: verify that the qvr timestamp is actually in the past...", startTimeNs);
-        mLastVsyncTimeNs = startTimeNs;
-    }
-    if ((startTimeNs - mLastVsyncTimeNs) > gFramePeriodNs) {
-        //We've managed to get here prior to the next vsync occuring so set it based on the previous (interrupt may have been delayed)
-        LOG_W("%lu:Adding frame period time (%0.2f) to vsync time, Last VSync was %0.4f ms ago!", frameIndex,
-             gFramePeriodNs * 1.f / U_TIME_1MS_IN_NS, (startTimeNs - mLastVsyncTimeNs) * 1.f / U_TIME_1MS_IN_NS);
-        mLastVsyncTimeNs = mLastVsyncTimeNs + gFramePeriodNs;
-    }
-    mVsyncCount++;
-    int64_t vsyncDiffTimeNs = startTimeNs - mLastVsyncTimeNs;
-    double framePct = (double)mVsyncCount + ((double)vsyncDiffTimeNs) / (gFramePeriodNs);
-    double fractFrame = framePct - ((long)framePct);
-
-    int64_t waitTimeNs = 0;
-    if (fractFrame < gTimeWarpWaitFramePercentage) {
-        //We are currently in the first half of the display so wait until we hit the halfway point
-        waitTimeNs = (int64_t)((gTimeWarpWaitFramePercentage - fractFrame) * gFramePeriodNs);
-    } else {
-        //We are currently past the halfway point in the display so wait until halfway through the next vsync cycle
-        waitTimeNs = (int64_t)((0.9 + gTimeWarpWaitFramePercentage - fractFrame) * gFramePeriodNs);
-        LOG_W("%lu: jank...", frameIndex);
-    }
-    LOG_D("%lu: Left EyeBuffer Wait : %.2f ms, Vsync diff : %.2f ms, Frame diff : %.2f ms, [%lu: %.2f, %.2f]", frameIndex, waitTimeNs * 1.f / U_TIME_1MS_IN_NS,
-          vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS, (startTimeNs - mLastFrameTime) * 1.f / U_TIME_1MS_IN_NS, mVsyncCount, framePct, fractFrame);
-    mLastFrameTime = startTimeNs;
-    TRACE_BEGIN("Left wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-    NanoSleep(waitTimeNs);
-    TRACE_END("Left wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-    uint64_t postLeftWaitTimeStamp = getTimeNano(CLOCK_MONOTONIC);
-
-    RenderMeshOrder gMeshOrderEnum = MeshOrderLeftToRight;
-    if (gWarpMeshType == 0) {
-        gMeshOrderEnum = MeshOrderLeftToRight;
-    } else if (gWarpMeshType == 1) {
-        gMeshOrderEnum = MeshOrderRightToLeft;
-    } else if (gWarpMeshType == 2) {
-        gMeshOrderEnum = MeshOrderTopToBottom;
-    } else if (gWarpMeshType == 3) {
-        gMeshOrderEnum = MeshOrderBottomToTop;
-    }
-
-    glUseProgram(mProgram);
-    glUniform1i(glGetUniformLocation(mProgram, "y_texture"), 0);
-    glUniform1i(glGetUniformLocation(mProgram, "uv_texture"), 1);
+    uint64_t postLeftWaitTimeStamp = WaitForFirstHalf(frameIndex);
+    RenderMeshOrder gMeshOrderEnum = MeshOrder();
 
     AImage *imageLeft = mImageReaderLeft->getLatestImage();
     if(!imageLeft){
@@ -164,13 +125,29 @@ void GLRenderer::ProcessFrame(uint64_t frameIndex) {
     if(!imageRight){
         return;
     }
-
+    uint64_t acquireNs = getTimeNano(CLOCK_MONOTONIC);
+    int64_t timeStampLeft = 0, timeStampRight = 0;
+    AImage_getTimestamp(imageLeft, &timeStampLeft);
+    AImage_getTimestamp(imageRight, &timeStampRight);
+    mLatency.cameraFrame(0, timeStampLeft, acquireNs);
+    mLatency.cameraFrame(1, timeStampRight, acquireNs);
+
+    mFrameStageTimes = FrameStageTimes{};
+    TRACE_BEGIN("Frame wait");
+    mFrameTimer->beginFrame(&mFrameStageTimes);
+    TRACE_END("Frame wait");
+
+    uint64_t stageStartNs = getTimeNano(CLOCK_MONOTONIC);
     TRACE_BEGIN("UpdateDescriptorSets");
     UpdateTextures(0, imageLeft);
     UpdateTextures(1, imageRight);
     TRACE_END("UpdateDescriptorSets");
+    mFrameStageTimes.uploadNs = getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    mLatency.markUploaded(stageStartNs + mFrameStageTimes.uploadNs);
 
     TRACE_BEGIN("First Render");
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+    mFrameTimer->beginPass(0);
     switch (gMeshOrderEnum) {
         case MeshOrderLeftToRight:
             RenderSubArea(imageLeft, MeshLeft);
@@ -190,31 +167,18 @@ void GLRenderer::ProcessFrame(uint64_t frameIndex) {
             RenderSubArea(imageRight, MeshLowerRight);
             break;
     }
+    mFrameTimer->endPass(0);
 #ifdef RENDER_USE_SINGLE_BUFFER
     glFlush(); // its important
 #endif
+    mFrameStageTimes.renderNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
     TRACE_END("First Render");
 
-    if (gTimeWarpDelayBetweenEyes) {
-        uint64_t rightTimestamp = getTimeNano(CLOCK_MONOTONIC);
-        //We started the left eye half way through vsync, figure out how long
-        //we have left in the half frame until the raster starts over so we can render the right eye
-        uint64_t delta = rightTimestamp - postLeftWaitTimeStamp;
-        uint64_t waitTimeNs = 0;
-        if (delta < ((uint64_t)(gFramePeriodNs / 2.0))) {
-            waitTimeNs = ((uint64_t)(gFramePeriodNs / 2.0)) - delta;
-            LOG_D("%lu: Right EyeBuffer Wait : %.2f ms, Left take : %.2f ms", frameIndex, waitTimeNs * 1.f / U_TIME_1MS_IN_NS, delta * 1.f / U_TIME_1MS_IN_NS);
-            TRACE_BEGIN("Right wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-            NanoSleep(waitTimeNs + gFramePeriodNs / 8);
-            TRACE_END("Right wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-        } else {
-            //The left eye took longer than 1/2 the refresh so the raster has already wrapped around and is
-            //in the left half of the screen.  Skip the wait and get right on rendering the right eye.
-            LOG_D("Left Eye took too long!!! ( %.2f ms )", delta * 1.f / U_TIME_1MS_IN_NS);
-        }
-    }
+    WaitForSecondHalf(frameIndex, postLeftWaitTimeStamp);
 
     TRACE_BEGIN("Second Render");
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+    mFrameTimer->beginPass(1);
     switch (gMeshOrderEnum) {
         case MeshOrderLeftToRight:
             RenderSubArea(imageRight, MeshRight);
@@ -234,37 +198,24 @@ void GLRenderer::ProcessFrame(uint64_t frameIndex) {
             RenderSubArea(imageRight, MeshUpperRight);
             break;
     }
+    mFrameTimer->endPass(1);
+    mFrameStageTimes.renderNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
 #ifdef RENDER_USE_SINGLE_BUFFER
     glFlush(); // its important
 #else
+    mFrameTimer->beforeSwap();
     eglSwapBuffers(m_EglDisplay, m_EglSurface);
 #endif
+    mFrameStageTimes.presentNs = getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    mFrameStageTimes.totalNs = getTimeNano(CLOCK_MONOTONIC) - postLeftWaitTimeStamp;
+    mLatency.markPresented(stageStartNs + mFrameStageTimes.presentNs);
+    mLatency.endFrame(mFrameStageTimes);
+    ReportFirstFrame();
     TRACE_END("Second Render");
     TRACE_END("ProcessFrame:%lu", frameIndex);
 }
 
-void GLRenderer::OpenCameras() {
-    if(!AndroidCameraPermission::isCameraPermitted(mApp)){
-        AndroidCameraPermission::requestCameraPermission(mApp);
-    }
-    mImageReaderLeft = new CameraImageReader(1920, 1440, AIMAGE_FORMAT_YUV_420_888, 4);
-    mCameraLeft = new CameraManager(mImageReaderLeft->getWindow(), 2);
-    mCameraLeft->startCapturing();
-
-    mImageReaderRight= new CameraImageReader(1920, 1440, AIMAGE_FORMAT_YUV_420_888, 4);
-    mCameraRight = new CameraManager(mImageReaderRight->getWindow(), 3);
-    mCameraRight->startCapturing();
-}
-
-void GLRenderer::CloseCameras() {
-    mCameraLeft->stopCapturing();
-    mCameraRight->stopCapturing();
-    SAFE_DELETE(mImageReaderLeft);
-    SAFE_DELETE(mImageReaderRight);
-    SAFE_DELETE(mCameraLeft);
-    SAFE_DELETE(mCameraRight);
-}
-
 int GLRenderer::InitEGLEnv() {
     const EGLint confAttr[] = {
             EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
@@ -382,40 +333,183 @@ void GLRenderer::CreateProgram() {
 //    std::vector<char> fsSource = ReadFileFromAndroidRes("shaders/gles/camera_preview.frag");
 //    mVertexShader = CreateGLShader(std::string(vsSource.data(), vsSource.size()).c_str(), GL_VERTEX_SHADER);
 //    mFragShader = CreateGLShader(std::string(fsSource.data(), fsSource.size()).c_str(), GL_FRAGMENT_SHADER);
-    mVertexShader = CreateGLShader(vertexShader, GL_VERTEX_SHADER);
-    mFragShader = CreateGLShader(fragYUV420P, GL_FRAGMENT_SHADER);
-    mProgram = CreateGLProgram(mVertexShader, mFragShader);
+    uint64_t startNs = getTimeNano(CLOCK_MONOTONIC);
+    GLProgramCache cache(mDataDir);
+    mProgram = BuildProgram(&cache, "camera_yuv", fragYUV420P);
+    glUseProgram(mProgram);
+    glUniform1i(glGetUniformLocation(mProgram, "y_texture"), 0);
+    glUniform1i(glGetUniformLocation(mProgram, "uv_texture"), 1);
+    if(bZeroCopy){
+        mProgramExternal = BuildProgram(&cache, "camera_external", fragExternalOES);
+        glUseProgram(mProgramExternal);
+        glUniform1i(glGetUniformLocation(mProgramExternal, "camera_texture"), 0);
+    }
+    mBoundProgram = mProgramExternal ? mProgramExternal : mProgram;
+    LOG_D("GLRenderer: programs ready in %.2f ms", (getTimeNano(CLOCK_MONOTONIC) - startNs) * 1.f / U_TIME_1MS_IN_NS);
+}
+
+GLuint GLRenderer::BuildProgram(GLProgramCache *cache, const char *name, const char *fragSource) {
+    uint64_t startNs = getTimeNano(CLOCK_MONOTONIC);
+    GLuint program = cache->load(name, vertexShader, fragSource);
+    bool bCached = program != 0;
+    if(!bCached){
+        GLint vertShader = CreateGLShader(vertexShader, GL_VERTEX_SHADER);
+        GLint fragShader = CreateGLShader(fragSource, GL_FRAGMENT_SHADER);
+        program = CreateGLProgram(vertShader, fragShader, true);
+        // the program holds on to them until it goes
+        glDeleteShader(vertShader);
+        glDeleteShader(fragShader);
+        cache->store(name, vertexShader, fragSource, program);
+    }
+    LOG_D("GLRenderer: %s program %s in %.2f ms", name, bCached ? "loaded from its binary" : "compiled",
+          (getTimeNano(CLOCK_MONOTONIC) - startNs) * 1.f / U_TIME_1MS_IN_NS);
+    return program;
+}
+
+void GLRenderer::CreateVertexState() {
+    // the vertex shader fixes the locations, both programs share them
+    GLint posLoc = glGetAttribLocation(mProgram, "a_position");
+    GLint texcoordLoc = glGetAttribLocation(mProgram, "a_texcoord");
+    glGenBuffers(1, &mVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(gLeftMeshVertices) + sizeof(gRightMeshVertices) + sizeof(gMeshTexcoords), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(gLeftMeshVertices), gLeftMeshVertices);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(gLeftMeshVertices), sizeof(gRightMeshVertices), gRightMeshVertices);
+    size_t texcoordOffset = sizeof(gLeftMeshVertices) + sizeof(gRightMeshVertices);
+    glBufferSubData(GL_ARRAY_BUFFER, texcoordOffset, sizeof(gMeshTexcoords), gMeshTexcoords);
+
+    glGenVertexArrays(2, mVertexArrays);
+    for(uint32_t eyeIndex = 0; eyeIndex < 2; eyeIndex++){
+        glBindVertexArray(mVertexArrays[eyeIndex]);
+        glEnableVertexAttribArray(posLoc);
+        glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(eyeIndex * sizeof(gLeftMeshVertices)));
+        glEnableVertexAttribArray(texcoordLoc);
+        glVertexAttribPointer(texcoordLoc, 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(texcoordOffset));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void GLRenderer::UpdateTextures(uint32_t eyeIndex, const AImage *image) {
-    int64_t timeStamp = 0;
-    AImage_getTimestamp(image, &timeStamp);
-    int64_t diffNs = getTimeNano(CLOCK_MONOTONIC) - timeStamp;
-    LOG_D("%s Update:%.2f, %lu", eyeIndex == 0 ? "Left" : "Right", (diffNs * 1.f) / U_TIME_1MS_IN_NS, timeStamp);
     int width, height;
     int numPlanes = 0;
     uint8_t *yData, *uvData;
     int32_t yDataLen = 0, uvDataLen = 0;
-    TRACE_BEGIN("%s Update:%.2f", eyeIndex == 0 ? "Left" : "Right", (diffNs * 1.f) / U_TIME_1MS_IN_NS);
+    TRACE_BEGIN("%s Update", eyeIndex == 0 ? "Left" : "Right");
+    if(bZeroCopy && ImportTexture(eyeIndex, image)){
+        TRACE_END("%s Update", eyeIndex == 0 ? "Left" : "Right");
+        return;
+    }
+    uint64_t cpuStartNs = getTimeNano(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t wallStartNs = getTimeNano(CLOCK_MONOTONIC);
     AImage_getWidth(image, &width);
     AImage_getHeight(image, &height);
     AImage_getNumberOfPlanes(image, &numPlanes);
     AImage_getPlaneData(image, 0, &yData, &yDataLen);
     AImage_getPlaneData(image, 2, &uvData, &uvDataLen);
 
-    glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureY : mRightTextureY);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, yData);
+    // once the textures are immutable glTexImage2D can not respecify them, a frame that does not stream is dropped
+    bool bStreamed = gPboUpload && StreamPlanes(eyeIndex, image, width, height);
+    if(!bStreamed && !mUploadRing){
+        glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureY : mRightTextureY);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, yData);
+
+        glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureUV : mRightTextureUV);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, width / 2, height / 2, 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, uvData);
+    }
+
+    mUploadStats.cpuNs += getTimeNano(CLOCK_THREAD_CPUTIME_ID) - cpuStartNs;
+    mUploadStats.wallNs += getTimeNano(CLOCK_MONOTONIC) - wallStartNs;
+    if(++mUploadStats.eyes == gUploadStatsEyes){
+        LOG_D("GLRenderer: %s upload %.3f ms CPU, %.3f ms wall per eye over %u eyes, %lu ring waits",
+              mUploadRing ? "unpack buffer ring" : "glTexImage2D", mUploadStats.cpuNs * 1.f / mUploadStats.eyes / U_TIME_1MS_IN_NS,
+              mUploadStats.wallNs * 1.f / mUploadStats.eyes / U_TIME_1MS_IN_NS, mUploadStats.eyes,
+              mUploadRing ? mUploadRing->waitCount() : 0);
+        mUploadStats = {};
+    }
+    TRACE_END("%s Update", eyeIndex == 0 ? "Left" : "Right");
+}
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool GLRenderer::StreamPlanes(uint32_t eyeIndex, const AImage *image, int width, int height) {
+    uint8_t *yData, *uvData;
+    int32_t yDataLen = 0, uvDataLen = 0, yRowStride = 0, uvRowStride = 0, uvPixelStride = 0;
+    AImage_getPlaneData(image, 0, &yData, &yDataLen);
+    AImage_getPlaneRowStride(image, 0, &yRowStride);
+    AImage_getPlaneData(image, 2, &uvData, &uvDataLen);
+    AImage_getPlaneRowStride(image, 2, &uvRowStride);
+    AImage_getPlanePixelStride(image, 2, &uvPixelStride);
+    if(uvPixelStride != 2){
+        // planar chroma does not fit one RG texture
+        return false;
+    }
+    // the rows of the last chroma line reach one byte past the plane, the padding covers it
+    uint32_t uvOffset = alignUp(yDataLen, 256);
+    uint32_t slotSize = uvOffset + alignUp(uvDataLen + 1, 256);
+    if(!mUploadRing || width != mUploadWidth || height != mUploadHeight || slotSize > mUploadRing->slotSize()){
+        CreateUploadTextures(width, height, slotSize);
+    }
 
+    // a failed map keeps the last frame in the textures
+    uint8_t *slot = mUploadRing->map();
+    if(!slot){
+        return true;
+    }
+    memcpy(slot, yData, yDataLen);
+    memcpy(slot + uvOffset, uvData, uvDataLen);
+    if(!mUploadRing->unmap()){
+        return true;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, yRowStride);
+    glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureY : mRightTextureY);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, uvRowStride / uvPixelStride);
     glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureUV : mRightTextureUV);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, width / 2, height / 2, 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, uvData);
-    TRACE_END("%s Update:%.2f", eyeIndex == 0 ? "Left" : "Right", (diffNs * 1.f) / U_TIME_1MS_IN_NS);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width / 2, height / 2, GL_RG, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(uvOffset));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    mUploadRing->submit();
+    return true;
+}
+
+void GLRenderer::CreateUploadTextures(int width, int height, uint32_t slotSize) {
+    // immutable storage can not be resized, the textures are made anew when the camera size changes
+    GLuint *textures[] = {&mLeftTextureY, &mLeftTextureUV, &mRightTextureY, &mRightTextureUV};
+    for(uint32_t i = 0; i < ARRAY_SIZE(textures); i++){
+        bool bChroma = (i % 2) == 1;
+        glDeleteTextures(1, textures[i]);
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, bChroma ? GL_RG8 : GL_R8, bChroma ? width / 2 : width, bChroma ? height / 2 : height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    SAFE_DELETE(mUploadRing);
+    mUploadRing = new GLUploadRing(slotSize, gUploadRingSlots);
+    mUploadWidth = width;
+    mUploadHeight = height;
+}
+
+bool GLRenderer::ImportTexture(uint32_t eyeIndex, const AImage *image) {
+    mExternalTextures[eyeIndex] = 0;
+    AHardwareBuffer *buffer = nullptr;
+    if(AImage_getHardwareBuffer(image, &buffer) != AMEDIA_OK || !buffer){
+        return false;
+    }
+    // the reader keeps the image acquired for a few more frames, long enough for the GPU to be done sampling it
+    mExternalTextures[eyeIndex] = mExternalImages->getTexture(buffer);
+    return mExternalTextures[eyeIndex] != 0;
 }
 
 void GLRenderer::RenderSubArea(const AImage *image, RenderMeshArea area) {
-    int surfaceWidth, surfaceHeight;
-    eglQuerySurface(m_EglDisplay, m_EglSurface, EGL_WIDTH, &surfaceWidth);
-    eglQuerySurface(m_EglDisplay, m_EglSurface, EGL_HEIGHT, &surfaceHeight);
-    glEnable(GL_SCISSOR_TEST);
+    int surfaceWidth = mSurfaceWidth, surfaceHeight = mSurfaceHeight;
     switch (area) {
         case MeshLeft:
             glScissor(0, 0, surfaceWidth / 2, surfaceHeight);
@@ -449,29 +543,21 @@ void GLRenderer::RenderSubArea(const AImage *image, RenderMeshArea area) {
             break;
     }
 
-    int eyeIndex = 0;
-    if(area == MeshLeft | area == MeshUpperLeft | area == MeshLowerLeft){
-        eyeIndex = 0;
-        GLuint posLoc = glGetAttribLocation(mProgram, "a_position");
-        glEnableVertexAttribArray(posLoc);
-        glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, gLeftMeshVertices);
+    int eyeIndex = (area == MeshLeft || area == MeshUpperLeft || area == MeshLowerLeft) ? 0 : 1;
+    GLuint program = mExternalTextures[eyeIndex] ? mProgramExternal : mProgram;
+    if(program != mBoundProgram){
+        glUseProgram(program);
+        mBoundProgram = program;
+    }
+    glBindVertexArray(mVertexArrays[eyeIndex]);
+    if(mExternalTextures[eyeIndex]){
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mLeftTextureY);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mLeftTextureUV);
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, mExternalTextures[eyeIndex]);
     } else {
-        eyeIndex = 1;
-        GLuint posLoc = glGetAttribLocation(mProgram, "a_position");
-        glEnableVertexAttribArray(posLoc);
-        glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, gRightMeshVertices);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mRightTextureY);
+        glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureY : mRightTextureY);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mRightTextureUV);
+        glBindTexture(GL_TEXTURE_2D, eyeIndex == 0 ? mLeftTextureUV : mRightTextureUV);
     }
-    GLuint texcoordLoc = glGetAttribLocation(mProgram, "a_texcoord");
-    glEnableVertexAttribArray(texcoordLoc);
-    glVertexAttribPointer(texcoordLoc, 2, GL_FLOAT, GL_FALSE, 0, gMeshTexcoords);
-
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
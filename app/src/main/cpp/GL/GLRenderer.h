@@ -8,63 +8,58 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <GLES2/gl2platform.h>
-#include "../Camera/CameraImageReader.h"
-#include "../Camera/CameraManager.h"
+#include <media/NdkImage.h>
+#include "../Renderer.h"
+#include "GLExternalImageCache.h"
+#include "GLFrameTimer.h"
+#include "GLProgramCache.h"
+#include "GLUploadRing.h"
 
-enum RenderMeshOrder{
-    MeshOrderLeftToRight = 0,
-    MeshOrderRightToLeft,
-    MeshOrderTopToBottom,
-    MeshOrderBottomToTop
-};
-
-enum RenderMeshArea{
-    MeshLeft = 0,      // Columns Left to Right [-1, 0]
-    MeshRight,         // Columns Left to Right [0, 1]
-    MeshUpperLeft,     // Rows Top to Bottom [Upper Left]
-    MeshUpperRight,    // Rows Top to Bottom [Upper Right]
-    MeshLowerLeft,     // Rows Top to Bottom [Lower Left]
-    MeshLowerRight,    // Rows Top to Bottom [Lower Right]
-};
-
-class GLRenderer{
+class GLRenderer : public Renderer{
 public:
-    void Init(struct android_app *app);
-    void Destroy();
-    bool IsRunning();
-    void ProcessFrame(uint64_t frameIndex);
+    void Init(struct android_app *app) override;
+    void Destroy() override;
+    void ProcessFrame(uint64_t frameIndex) override;
+    const char *GetName() const override { return "GLES"; };
 private:
-    void OpenCameras();
-    void CloseCameras();
     int InitEGLEnv();
     void DestroyEGLEnv();
-    std::vector<char> ReadFileFromAndroidRes(const std::string& filePath);
     void CreateProgram();
+    GLuint BuildProgram(GLProgramCache *cache, const char *name, const char *fragSource);
+    void CreateVertexState();
     void UpdateTextures(uint32_t eyeIndex, const AImage *image);
     void RenderSubArea(const AImage *image, RenderMeshArea area);
-
-    struct android_app *mApp;
-    bool bRunning = false;
-    CameraImageReader *mImageReaderLeft;     // camera image reader
-    CameraImageReader *mImageReaderRight;    // camera image reader
-    CameraManager *mCameraLeft;              // camera left
-    CameraManager *mCameraRight;             // camera right
+    bool ImportTexture(uint32_t eyeIndex, const AImage *image);
+    bool StreamPlanes(uint32_t eyeIndex, const AImage *image, int width, int height);
+    void CreateUploadTextures(int width, int height, uint32_t slotSize);
 
     EGLDisplay m_EglDisplay = EGL_NO_DISPLAY;
     EGLSurface m_EglSurface = EGL_NO_SURFACE;
     EGLContext m_EglContext = EGL_NO_CONTEXT;
     EGLConfig mEglConfig;
-    GLint mVertexShader;
-    GLint mFragShader;
     GLuint mProgram;
+    GLuint mBoundProgram = 0;
+    GLuint mVertexBuffer = 0;
+    GLuint mVertexArrays[2] = {0, 0};                       // per eye, the mesh and the texcoords
+    EGLint mSurfaceWidth = 0;
+    EGLint mSurfaceHeight = 0;
     GLuint mLeftTextureY;
     GLuint mLeftTextureUV;
     GLuint mRightTextureY;
     GLuint mRightTextureUV;
-
-    uint64_t mLastVsyncTimeNs = 0;
-    uint64_t mVsyncCount = 0;
-    uint64_t mLastFrameTime = 0;
+    bool bZeroCopy = false;                                 // camera buffers sampled in place through EGLImages
+    GLExternalImageCache *mExternalImages = nullptr;
+    GLuint mProgramExternal = 0;
+    GLuint mExternalTextures[2] = {0, 0};                   // per eye, 0 when the frame went through the upload
+    GLUploadRing *mUploadRing = nullptr;                    // plane streaming, made with the immutable textures
+    int mUploadWidth = 0;
+    int mUploadHeight = 0;
+    GLFrameTimer *mFrameTimer = nullptr;
+    struct {
+        uint32_t eyes;
+        uint64_t cpuNs;
+        uint64_t wallNs;
+    } mUploadStats = {};
 
     const char *vertexShader = "#version 300 es\n"
                          "layout(location=0) in vec2 a_position;\n"
@@ -90,4 +85,14 @@ private:
                               "                           1.4075, -0.7169,  0) * yuv;\n"
                               "    FragColor = vec4(rgb, 1.0);\n"
                               "}";
+    // the driver converts to RGB with the color space the camera tagged the buffer with
+    const char *fragExternalOES = "#version 300 es\n"
+                                  "#extension GL_OES_EGL_image_external_essl3 : require\n"
+                                  "precision mediump float;\n"
+                                  "in vec2 v_texcoord;\n"
+                                  "uniform samplerExternalOES camera_texture;\n"
+                                  "out vec4 FragColor;\n"
+                                  "void main() {\n"
+                                  "    FragColor = vec4(texture(camera_texture, v_texcoord).rgb, 1.0);\n"
+                                  "}";
 };
\ No newline at end of file
@@ -1,8 +1,23 @@
 #pragma once
 
 #include "../Common.h"
+#include <cstring>
 #include <GLES3/gl3.h>
 
+// whole word match in an EGL or GL extension string
+static bool HasGLExtension(const char *extensions, const char *name) {
+    if (!extensions) {
+        return false;
+    }
+    size_t length = strlen(name);
+    for (const char *p = strstr(extensions, name); p; p = strstr(p + length, name)) {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static GLint CreateGLShader(const char* source, GLenum type) {
     GLint glShader = glCreateShader(type);
     if (glShader == 0) {
@@ -25,7 +40,8 @@ static GLint CreateGLShader(const char* source, GLenum type) {
     return glShader;
 }
 
-static GLint CreateGLProgram(GLint vertexShader, GLint fragmentShader){
+// bRetrievable keeps the binary around for glGetProgramBinary
+static GLint CreateGLProgram(GLint vertexShader, GLint fragmentShader, bool bRetrievable = false){
     GLint program{0};
     if (!vertexShader || !fragmentShader) {
         return program;
@@ -37,6 +53,9 @@ static GLint CreateGLProgram(GLint vertexShader, GLint fragmentShader){
     }
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
+    if (bRetrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
 
     GLint status = 0;
@@ -0,0 +1,64 @@
+#include "GLUploadRing.h"
+#include "../Common.h"
+
+// long enough for any frame the GPU is behind on, a timeout means the fence is lost
+static const GLuint64 gFenceTimeoutNs = 100 * U_TIME_1MS_IN_NS;
+
+GLUploadRing::GLUploadRing(uint32_t slotSize, uint32_t slotCount) : mSlots(slotCount), mSlotSize(slotSize) {
+    for(auto &slot : mSlots){
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, mSlotSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    LOG_D("GLUploadRing: %zu slots of %u bytes", mSlots.size(), mSlotSize);
+}
+
+GLUploadRing::~GLUploadRing() {
+    for(auto &slot : mSlots){
+        if(slot.fence){
+            glDeleteSync(slot.fence);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+uint8_t *GLUploadRing::map() {
+    Slot &slot = mSlots[mIndex];
+    if(slot.fence){
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if(status == GL_TIMEOUT_EXPIRED){
+            mWaitCount++;
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, gFenceTimeoutNs);
+        }
+        if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED){
+            LOG_W("GLUploadRing: slot %u fence wait failed: 0x%x", mIndex, status);
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    void *data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mSlotSize,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(!data){
+        LOG_E("GLUploadRing: glMapBufferRange failed: 0x%x", glGetError());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    return static_cast<uint8_t*>(data);
+}
+
+bool GLUploadRing::unmap() {
+    // the store can be lost while mapped, the slot then holds garbage and the caller skips the upload
+    if(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE){
+        LOG_W("GLUploadRing: slot %u was corrupted while mapped", mIndex);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    return true;
+}
+
+void GLUploadRing::submit() {
+    mSlots[mIndex].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    mIndex = (mIndex + 1) % mSlots.size();
+}
@@ -0,0 +1,46 @@
+/*!
+ * @brief  Ring of pixel unpack buffers for streaming camera planes into textures, fences guard slot reuse
+ * @date 2023/8/16
+ */
+#ifndef CAMERA2VK_GLUPLOADRING_H
+#define CAMERA2VK_GLUPLOADRING_H
+
+#include <cstdint>
+#include <vector>
+#include <GLES3/gl3.h>
+
+/**
+ * Each slot is a pixel unpack buffer of its own. map() hands out the next slot, writes land in a fresh store
+ * (invalidate) without the driver syncing against earlier draws (unsynchronized), the fence left by submit() is what
+ * keeps the GPU from reading a slot that is written again. Between unmap() and submit() the slot is bound to
+ * GL_PIXEL_UNPACK_BUFFER, so glTexSubImage2D takes offsets into it and returns without touching client memory.
+ * GL thread only.
+ */
+class GLUploadRing{
+public:
+    GLUploadRing(uint32_t slotSize, uint32_t slotCount);
+    ~GLUploadRing();
+
+    // maps the next slot for writing, waits when the GPU has not consumed its last upload yet, nullptr on failure
+    uint8_t *map();
+    // unmaps the slot and binds it as GL_PIXEL_UNPACK_BUFFER
+    bool unmap();
+    // fences the uploads issued from the slot and unbinds it
+    void submit();
+
+    uint32_t slotSize() const { return mSlotSize; };
+    uint64_t waitCount() const { return mWaitCount; };
+
+private:
+    struct Slot{
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+    };
+
+    std::vector<Slot> mSlots;
+    uint32_t mSlotSize;
+    uint32_t mIndex = 0;
+    uint64_t mWaitCount = 0;        // maps that found their slot still in use
+};
+
+#endif //CAMERA2VK_GLUPLOADRING_H
@@ -0,0 +1,119 @@
+#include "InitTaskGraph.h"
+#include <algorithm>
+#include <pthread.h>
+#include <stdexcept>
+#include <thread>
+#include "Common.h"
+#include "ProfileTrace.h"
+
+InitTaskGraph::InitTaskGraph(uint32_t workerCount) : mWorkerCount(std::max(workerCount, 1u)) {
+}
+
+InitTaskId InitTaskGraph::add(const char *name, std::function<void()> fn, std::initializer_list<InitTaskId> deps) {
+    InitTaskId id = mTasks.size();
+    mTasks.emplace_back();
+    Task &task = mTasks.back();
+    task.name = name;
+    task.fn = std::move(fn);
+    for(InitTaskId dep : deps){
+        if(dep == INVALID_INIT_TASK){
+            continue;
+        }
+        if(dep >= id){
+            throw std::runtime_error("InitTaskGraph: " + task.name + " depends on a task added after it.");
+        }
+        task.deps.push_back(dep);
+        mTasks[dep].dependents.push_back(id);
+    }
+    task.pendingDeps = task.deps.size();
+    return id;
+}
+
+void InitTaskGraph::run() {
+    mRunStartNs = getTimeNano(CLOCK_MONOTONIC);
+    for(InitTaskId id = 0; id < mTasks.size(); id++){
+        if(mTasks[id].pendingDeps == 0){
+            mReady.push_back(id);
+        }
+    }
+    // the calling thread is worker 0
+    std::vector<std::thread> threads;
+    for(uint32_t i = 1; i < mWorkerCount; i++){
+        threads.emplace_back(&InitTaskGraph::workerLoop, this, i);
+    }
+    workerLoop(0);
+    for(auto &thread : threads){
+        thread.join();
+    }
+    mRunEndNs = getTimeNano(CLOCK_MONOTONIC);
+    if(mError){
+        std::rethrow_exception(mError);
+    }
+}
+
+void InitTaskGraph::workerLoop(uint32_t threadIndex) {
+    if(threadIndex > 0){
+        std::string threadName = "InitTask-" + std::to_string(threadIndex);
+        pthread_setname_np(pthread_self(), threadName.c_str());
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    while(true){
+        mCond.wait(lock, [this]{ return mError || !mReady.empty() || mFinished == mTasks.size(); });
+        if(mError || mReady.empty()){
+            return;
+        }
+        // tasks added first go first, the order they were added in is their priority
+        InitTaskId id = mReady.front();
+        mReady.erase(mReady.begin());
+        mRunning++;
+        lock.unlock();
+
+        Task &task = mTasks[id];
+        task.thread = threadIndex;
+        task.startNs = getTimeNano(CLOCK_MONOTONIC);
+        TRACE_BEGIN("Init:%s", task.name.c_str());
+        std::exception_ptr error;
+        try{
+            task.fn();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        TRACE_END("Init:%s", task.name.c_str());
+        task.endNs = getTimeNano(CLOCK_MONOTONIC);
+
+        lock.lock();
+        mRunning--;
+        if(error){
+            LOG_E("InitTaskGraph: %s failed.", task.name.c_str());
+            if(!mError){
+                mError = error;
+            }
+        } else {
+            mFinished++;
+            for(InitTaskId dependent : task.dependents){
+                if(--mTasks[dependent].pendingDeps == 0){
+                    mReady.push_back(dependent);
+                }
+            }
+        }
+        mCond.notify_all();
+    }
+}
+
+void InitTaskGraph::printTimeline(uint64_t originNs) {
+    uint64_t workNs = 0;
+    for(const auto &task : mTasks){
+        workNs += task.endNs - task.startNs;
+    }
+    LOG_D("InitTaskGraph: %zu tasks on %u threads, %.2f ms wall, %.2f ms of work", mTasks.size(), mWorkerCount,
+          (mRunEndNs - mRunStartNs) * 1.f / U_TIME_1MS_IN_NS, workNs * 1.f / U_TIME_1MS_IN_NS);
+    for(const auto &task : mTasks){
+        if(task.endNs == 0){
+            LOG_D("    %-20s never ran", task.name.c_str());
+            continue;
+        }
+        LOG_D("    %-20s thread %u  %8.2f -> %8.2f ms  (%.2f ms)", task.name.c_str(), task.thread,
+              (task.startNs - originNs) * 1.f / U_TIME_1MS_IN_NS, (task.endNs - originNs) * 1.f / U_TIME_1MS_IN_NS,
+              (task.endNs - task.startNs) * 1.f / U_TIME_1MS_IN_NS);
+    }
+}
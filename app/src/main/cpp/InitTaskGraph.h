@@ -0,0 +1,63 @@
+/*!
+ * @brief  Startup steps as a dependency graph, independent ones run in parallel on a few threads, with a timeline
+ * @date 2023/8/14
+ */
+#ifndef CAMERA2VK_INITTASKGRAPH_H
+#define CAMERA2VK_INITTASKGRAPH_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef uint32_t InitTaskId;
+const InitTaskId INVALID_INIT_TASK = UINT32_MAX;
+
+/**
+ * Tasks are added with the ids of the tasks they need, so they can only depend on earlier ones and the graph has no
+ * cycles. run() starts a task as soon as everything it needs is done, the calling thread works along with the pool.
+ * Tasks that touch the same externally synchronized object (a command pool, a queue) must depend on each other.
+ * After the first failure no new task starts, run() rethrows it once the running ones are done.
+ */
+class InitTaskGraph{
+public:
+    explicit InitTaskGraph(uint32_t workerCount);
+
+    // INVALID_INIT_TASK entries in deps are ignored, for steps that are left out
+    InitTaskId add(const char *name, std::function<void()> fn, std::initializer_list<InitTaskId> deps = {});
+    void run();
+    // start and end of every task relative to originNs, which is usually the launch of the app
+    void printTimeline(uint64_t originNs);
+
+private:
+    struct Task{
+        std::string name;
+        std::function<void()> fn;
+        std::vector<InitTaskId> deps;
+        uint32_t pendingDeps = 0;
+        std::vector<InitTaskId> dependents;
+        uint32_t thread = 0;
+        uint64_t startNs = 0;
+        uint64_t endNs = 0;
+    };
+
+    void workerLoop(uint32_t threadIndex);
+
+    uint32_t mWorkerCount;
+    std::vector<Task> mTasks;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::vector<InitTaskId> mReady;
+    uint32_t mRunning = 0;
+    uint32_t mFinished = 0;
+    std::exception_ptr mError;
+    uint64_t mRunStartNs = 0;
+    uint64_t mRunEndNs = 0;
+};
+
+#endif //CAMERA2VK_INITTASKGRAPH_H
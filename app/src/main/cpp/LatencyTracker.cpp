@@ -0,0 +1,225 @@
+#include "LatencyTracker.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include "Common.h"
+#ifdef __ANDROID__
+#include <camera/NdkCameraMetadataTags.h>
+#else
+// the host build has no camera NDK, only headless runs without a timestamp source
+#define ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME 1
+#endif
+
+static const uint32_t gSubBuckets = 1u << LATENCY_HISTOGRAM_SUB_BITS;
+// a camera timestamp older than this, or from the future, is on a clock we did not guess right
+static const uint64_t gMaxCameraAgeNs = 1000ULL * U_TIME_1MS_IN_NS;
+
+void LatencyHistogram::add(uint64_t valueNs) {
+    mBuckets[bucketOf(valueNs)]++;
+    mCount++;
+    mMaxNs = std::max(mMaxNs, valueNs);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if(mCount == 0){
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(fraction * mCount));
+    uint64_t seen = 0;
+    for(uint32_t bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++){
+        seen += mBuckets[bucket];
+        if(seen >= target){
+            return std::min(bucketValue(bucket), mMaxNs);
+        }
+    }
+    return mMaxNs;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(std::begin(mBuckets), std::end(mBuckets), 0);
+    mCount = 0;
+    mMaxNs = 0;
+}
+
+uint32_t LatencyHistogram::bucketOf(uint64_t valueNs) {
+    if(valueNs < gSubBuckets){
+        return (uint32_t)valueNs;
+    }
+    // the highest bit picks the power of two, the next SUB_BITS bits the bucket within it
+    uint32_t exponent = 63 - __builtin_clzll(valueNs);
+    uint32_t bucket = (exponent - LATENCY_HISTOGRAM_SUB_BITS + 1) * gSubBuckets +
+                      (uint32_t)((valueNs >> (exponent - LATENCY_HISTOGRAM_SUB_BITS)) & (gSubBuckets - 1));
+    return std::min(bucket, (uint32_t)LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketValue(uint32_t bucket) {
+    if(bucket < gSubBuckets){
+        return bucket;
+    }
+    // the middle of the bucket
+    uint32_t shift = bucket / gSubBuckets - 1;
+    uint64_t lower = (uint64_t)(gSubBuckets + bucket % gSubBuckets) << shift;
+    return lower + ((1ULL << shift) >> 1);
+}
+
+LatencyTracker::LatencyTracker(uint64_t reportPeriodNs) : mReportPeriodNs(reportPeriodNs) {
+}
+
+void LatencyTracker::setTimestampSource(uint32_t eyeIndex, uint8_t source) {
+    if(eyeIndex >= LATENCY_TRACKER_MAX_EYES){
+        return;
+    }
+    mTimestampSources[eyeIndex] = source;
+    bUnknownOnBootTime[eyeIndex] = false;
+    LOG_D("LatencyTracker: camera %u timestamps are %s", eyeIndex,
+          source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME ? "on CLOCK_BOOTTIME" : "of an unknown source");
+}
+
+int64_t LatencyTracker::bootTimeOffset() {
+    // the tightest of a few brackets, a preemption between the reads only widens one of them
+    int64_t offsetNs = 0;
+    uint64_t bestWidthNs = UINT64_MAX;
+    for(int i = 0; i < 3; i++){
+        uint64_t beforeNs = getTimeNano(CLOCK_MONOTONIC);
+        uint64_t bootNs = getTimeNano(CLOCK_BOOTTIME);
+        uint64_t afterNs = getTimeNano(CLOCK_MONOTONIC);
+        if(afterNs - beforeNs < bestWidthNs){
+            bestWidthNs = afterNs - beforeNs;
+            offsetNs = (int64_t)bootNs - (int64_t)(beforeNs + bestWidthNs / 2);
+        }
+    }
+    return offsetNs;
+}
+
+bool LatencyTracker::toMonotonic(uint32_t eyeIndex, int64_t sensorTimestampNs, uint64_t nowNs, uint64_t *out_monotonicNs) {
+    if(sensorTimestampNs <= 0 || eyeIndex >= LATENCY_TRACKER_MAX_EYES){
+        mDroppedTimestamps++;
+        return false;
+    }
+    auto plausible = [nowNs](uint64_t timestampNs){ return timestampNs <= nowNs && nowNs - timestampNs < gMaxCameraAgeNs; };
+    uint64_t fromBootNs = (uint64_t)(sensorTimestampNs - mBootTimeOffsetNs);
+    bool bBootTime = mTimestampSources[eyeIndex] == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME || bUnknownOnBootTime[eyeIndex];
+    uint64_t timestampNs = bBootTime ? fromBootNs : (uint64_t)sensorTimestampNs;
+    if(plausible(timestampNs)){
+        *out_monotonicNs = timestampNs;
+        return true;
+    }
+    if(!bBootTime && plausible(fromBootNs)){
+        LOG_W("LatencyTracker: camera %u has an unknown timestamp source, its timestamps are on CLOCK_BOOTTIME", eyeIndex);
+        bUnknownOnBootTime[eyeIndex] = true;
+        *out_monotonicNs = fromBootNs;
+        return true;
+    }
+    mDroppedTimestamps++;
+    return false;
+}
+
+void LatencyTracker::cameraFrame(uint32_t eyeIndex, int64_t sensorTimestampNs, uint64_t acquireNs) {
+    // it grows with every suspend, a stale one would be off by the whole suspend
+    mBootTimeOffsetNs = bootTimeOffset();
+    uint64_t exposureNs = 0;
+    if(toMonotonic(eyeIndex, sensorTimestampNs, acquireNs, &exposureNs)){
+        mCurrent.exposureNs = mCurrent.exposureNs == 0 ? exposureNs : std::min(mCurrent.exposureNs, exposureNs);
+    }
+    // the frame has its images once the later eye is in
+    mCurrent.acquireNs = std::max(mCurrent.acquireNs, acquireNs);
+}
+
+void LatencyTracker::markUploaded(uint64_t nowNs) {
+    mCurrent.uploadedNs = nowNs;
+}
+
+void LatencyTracker::markPresented(uint64_t nowNs) {
+    mCurrent.presentedNs = nowNs;
+}
+
+LatencyTracker::FrameRecord *LatencyTracker::findFrame(uint64_t startNs) {
+    for(auto &frame : mFrames){
+        if(frame.startNs == startNs){
+            return &frame;
+        }
+    }
+    return nullptr;
+}
+
+void LatencyTracker::sample(LatencyStage stage, uint64_t fromNs, uint64_t toNs) {
+    if(fromNs == 0 || toNs < fromNs){
+        return;
+    }
+    mHistograms[(int)stage].add(toNs - fromNs);
+}
+
+void LatencyTracker::endFrame(const FrameStageTimes &times) {
+    uint64_t nowNs = getTimeNano(CLOCK_MONOTONIC);
+    if(mReportStartNs == 0){
+        mReportStartNs = nowNs;
+    }
+    if(times.startNs != 0){
+        mCurrent.startNs = times.startNs;
+        sample(LatencyStage::EXPOSURE_TO_ACQUIRE, mCurrent.exposureNs, mCurrent.acquireNs);
+        sample(LatencyStage::ACQUIRE_TO_UPLOAD, mCurrent.acquireNs, mCurrent.uploadedNs);
+        sample(LatencyStage::EXPOSURE_TO_PRESENT, mCurrent.exposureNs, mCurrent.presentedNs);
+        mFrames[mNextFrame] = mCurrent;
+        mNextFrame = (mNextFrame + 1) % LATENCY_TRACKER_FRAMES;
+    }
+    mCurrent = {};
+
+    FrameRecord *frame = times.latencyNs != 0 && times.retiredStartNs != 0 ? findFrame(times.retiredStartNs) : nullptr;
+    if(frame != nullptr){
+        frame->gpuDoneNs = frame->startNs + times.latencyNs;
+        sample(LatencyStage::UPLOAD_TO_GPU, frame->uploadedNs, frame->gpuDoneNs);
+        sample(LatencyStage::EXPOSURE_TO_GPU, frame->exposureNs, frame->gpuDoneNs);
+    }
+    frame = times.displayNs != 0 && times.displayedStartNs != 0 ? findFrame(times.displayedStartNs) : nullptr;
+    if(frame != nullptr){
+        uint64_t displayNs = frame->startNs + times.displayNs;
+        sample(LatencyStage::GPU_TO_DISPLAY, frame->gpuDoneNs, displayNs);
+        sample(LatencyStage::EXPOSURE_TO_DISPLAY, frame->exposureNs, displayNs);
+    }
+
+    if(nowNs - mReportStartNs >= mReportPeriodNs){
+        printStats();
+    }
+}
+
+void LatencyTracker::printStats() {
+    uint64_t nowNs = getTimeNano(CLOCK_MONOTONIC);
+    if(mReportStartNs != 0){
+        LOG_D("LatencyTracker: last %.1f s, %u camera timestamps dropped", (nowNs - mReportStartNs) * 1.f / 1e9f, mDroppedTimestamps);
+    }
+    for(int i = 0; i < (int)LatencyStage::COUNT; i++){
+        LatencyHistogram &histogram = mHistograms[i];
+        if(histogram.getCount() == 0){
+            continue;
+        }
+        LOG_D("LatencyTracker: %-20s p50 %7.2f ms, p99 %7.2f ms, p99.9 %7.2f ms, max %7.2f ms over %lu frames",
+              stageName((LatencyStage)i), histogram.percentile(0.5) * 1.f / U_TIME_1MS_IN_NS,
+              histogram.percentile(0.99) * 1.f / U_TIME_1MS_IN_NS, histogram.percentile(0.999) * 1.f / U_TIME_1MS_IN_NS,
+              histogram.getMax() * 1.f / U_TIME_1MS_IN_NS, (unsigned long)histogram.getCount());
+        histogram.reset();
+    }
+    mReportStartNs = nowNs;
+    mDroppedTimestamps = 0;
+}
+
+const char *LatencyTracker::stageName(LatencyStage stage) {
+    switch (stage) {
+        case LatencyStage::EXPOSURE_TO_ACQUIRE:
+            return "exposure->acquire";
+        case LatencyStage::ACQUIRE_TO_UPLOAD:
+            return "acquire->upload";
+        case LatencyStage::UPLOAD_TO_GPU:
+            return "upload->gpu done";
+        case LatencyStage::GPU_TO_DISPLAY:
+            return "gpu done->scanout";
+        case LatencyStage::EXPOSURE_TO_PRESENT:
+            return "exposure->present";
+        case LatencyStage::EXPOSURE_TO_GPU:
+            return "exposure->gpu done";
+        case LatencyStage::EXPOSURE_TO_DISPLAY:
+            return "exposure->scanout";
+        case LatencyStage::COUNT:
+            break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,103 @@
+/*!
+ * @brief  Capture to display latency per frame, stage by stage, on one clock, as streaming percentiles
+ * @date 2023/8/22
+ */
+#ifndef CAMERA2VK_LATENCYTRACKER_H
+#define CAMERA2VK_LATENCYTRACKER_H
+
+#include <cstdint>
+#include "FrameTiming.h"
+
+#define LATENCY_HISTOGRAM_SUB_BITS 5
+#define LATENCY_HISTOGRAM_BUCKETS 1024          // 32 per power of two up to 2^36 ns, about 3% resolution
+#define LATENCY_TRACKER_MAX_EYES 2
+#define LATENCY_TRACKER_FRAMES 8                // frames kept until their GPU and display times come back
+
+enum class LatencyStage{
+    EXPOSURE_TO_ACQUIRE = 0,    // sensor, ISP and image queue
+    ACQUIRE_TO_UPLOAD,
+    UPLOAD_TO_GPU,
+    GPU_TO_DISPLAY,
+    EXPOSURE_TO_PRESENT,
+    EXPOSURE_TO_GPU,
+    EXPOSURE_TO_DISPLAY,        // motion to photon
+    COUNT
+};
+
+/**
+ * Log-linear buckets, so memory and insert cost are fixed however many samples come in and any percentile is
+ * within one bucket width of the exact one. Values past the last bucket land in it.
+ */
+class LatencyHistogram{
+public:
+    void add(uint64_t valueNs);
+    uint64_t percentile(double fraction) const;
+    uint64_t getCount() const { return mCount; };
+    uint64_t getMax() const { return mMaxNs; };
+    void reset();
+
+private:
+    static uint32_t bucketOf(uint64_t valueNs);
+    static uint64_t bucketValue(uint32_t bucket);
+
+    uint32_t mBuckets[LATENCY_HISTOGRAM_BUCKETS] = {};
+    uint64_t mCount = 0;
+    uint64_t mMaxNs = 0;
+};
+
+/**
+ * The sensor timestamp is the start of exposure. ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME puts it on
+ * CLOCK_BOOTTIME, which is moved to CLOCK_MONOTONIC with an offset measured every frame, since it grows with every
+ * suspend. UNKNOWN is taken as CLOCK_MONOTONIC as long as the timestamps look like it, and as CLOCK_BOOTTIME when only
+ * that is plausible; a timestamp neither explains is dropped rather than reported.
+ * A frame is keyed by FrameStageTimes::startNs. Exposure, acquire, upload and present are known by endFrame(), GPU
+ * completion and scanout come back frames later through retiredStartNs and displayedStartNs. A stage is only
+ * sampled when both of its ends are known, so a backend without display timestamps has no scanout stages.
+ * Every reportPeriodNs the percentiles of the last period are logged and the histograms start over. Render thread only.
+ */
+class LatencyTracker{
+public:
+    explicit LatencyTracker(uint64_t reportPeriodNs);
+
+    // an ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_* value
+    void setTimestampSource(uint32_t eyeIndex, uint8_t source);
+    // the frame being built; the older of the eyes counts, acquireNs is when the renderer got the image
+    void cameraFrame(uint32_t eyeIndex, int64_t sensorTimestampNs, uint64_t acquireNs);
+    void markUploaded(uint64_t nowNs);
+    void markPresented(uint64_t nowNs);
+    // after the present, with the times the backend filled for this frame
+    void endFrame(const FrameStageTimes &times);
+    void printStats();
+
+    static const char *stageName(LatencyStage stage);
+
+private:
+    struct FrameRecord{
+        uint64_t startNs;
+        uint64_t exposureNs;        // CLOCK_MONOTONIC, 0 when no timestamp could be trusted
+        uint64_t acquireNs;
+        uint64_t uploadedNs;
+        uint64_t presentedNs;
+        uint64_t gpuDoneNs;
+    };
+
+    bool toMonotonic(uint32_t eyeIndex, int64_t sensorTimestampNs, uint64_t nowNs, uint64_t *out_monotonicNs);
+    static int64_t bootTimeOffset();
+    FrameRecord *findFrame(uint64_t startNs);
+    void sample(LatencyStage stage, uint64_t fromNs, uint64_t toNs);
+
+    uint64_t mReportPeriodNs;
+    uint8_t mTimestampSources[LATENCY_TRACKER_MAX_EYES] = {};
+    bool bUnknownOnBootTime[LATENCY_TRACKER_MAX_EYES] = {};
+    int64_t mBootTimeOffsetNs = 0;
+
+    FrameRecord mCurrent = {};
+    FrameRecord mFrames[LATENCY_TRACKER_FRAMES] = {};
+    uint32_t mNextFrame = 0;
+
+    LatencyHistogram mHistograms[(int)LatencyStage::COUNT];
+    uint64_t mReportStartNs = 0;
+    uint32_t mDroppedTimestamps = 0;
+};
+
+#endif //CAMERA2VK_LATENCYTRACKER_H
@@ -0,0 +1,34 @@
+/*!
+ * @brief  Log macros, logcat on the device and stderr in the host tests
+ * @date 2023/8/23
+ */
+#ifndef CAMERA2VK_LOG_H
+#define CAMERA2VK_LOG_H
+
+#define LOG_TAG "Camera2Vk"
+
+#ifndef ALOG
+#ifdef __ANDROID__
+#include <android/log.h>
+#define ALOG(priority, tag, fmt...) \
+    __android_log_print(ANDROID_##priority, tag, fmt)
+#else
+#include <cstdio>
+#define ALOG(priority, tag, fmt...) \
+    (fprintf(stderr, "%s " #priority ": ", tag), fprintf(stderr, fmt), fputc('\n', stderr))
+#endif
+#endif
+
+#ifndef LOG_D
+#define LOG_D(...) ((void)ALOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__))
+#endif
+
+#ifndef LOG_W
+#define LOG_W(...) ((void)ALOG(LOG_WARN, LOG_TAG, __VA_ARGS__))
+#endif
+
+#ifndef LOG_E
+#define LOG_E(...) ((void)ALOG(LOG_ERROR, LOG_TAG, __VA_ARGS__))
+#endif
+
+#endif //CAMERA2VK_LOG_H
@@ -3,15 +3,14 @@
 #include "FpsCollector.h"
 #include "Camera/AndroidCameraPermission.h"
 #include "ProfileTrace.h"
+#include "RendererFactory.h"
+#include "RenderThread.h"
 
-#ifdef GRAPHIC_API_GLES
-#include "GL/GLRenderer.h"
+Renderer *renderer = nullptr;
+RenderThread *renderThread = nullptr;
 
-GLRenderer renderer{};
-#else
-#include "VK/VKRenderer.h"
-
-VKRenderer renderer{};
+#ifdef VK_PIPELINE_BENCHMARK
+#include "VK/VkBenchmark.h"
 #endif
 
 FpsCollector collector("FPS", 1e9 / 85);
@@ -52,31 +51,23 @@ void CmdHandler(struct android_app *app, int32_t cmd) {
             LOG_D("surfaceCreated()");
             LOG_D("    APP_CMD_INIT_WINDOW");
             initializeATrace();
-            renderer.Init(app);
+            if(renderThread){
+                renderThread->post(RenderCommandType::INIT_WINDOW, app, false);
+            }
             break;
         }
         case APP_CMD_TERM_WINDOW: {
             LOG_D("surfaceDestroyed()");
             LOG_D("    APP_CMD_TERM_WINDOW");
-            renderer.Destroy();
+            // the window goes away once this returns
+            if(renderThread){
+                renderThread->post(RenderCommandType::TERM_WINDOW, app, true);
+            }
             break;
         }
     }
 }
 
-static void setThreadBindCpu(pthread_t thread, uint8_t cpu0, uint8_t cpu1) {
-    cpu_set_t sets;
-    CPU_ZERO(&sets);
-    CPU_SET(cpu0, &sets);
-    CPU_SET(cpu1, &sets);
-    if (sched_setaffinity(0, sizeof(sets), &sets) != 0) {
-        ALOG(LOG_DEBUG, "THREAD_SET", "could not set CPU affinity to %d,%d: %s", cpu0, cpu1, strerror(errno));
-    } else {
-        ALOG(LOG_DEBUG, "THREAD_SET", "set CPU affinity to %d,%d", cpu0, cpu1);
-    }
-    pthread_join(thread, NULL);
-}
-
 /**
  * This is the main entry point of a native application that is using
  * android_native_app_glue.  It runs in its own thread, with its own
@@ -85,6 +76,10 @@ static void setThreadBindCpu(pthread_t thread, uint8_t cpu0, uint8_t cpu1) {
 void android_main( struct android_app *app){
     LOG_D( "----------------------------------------------------------------" );
     LOG_D( "    android_main()" );
+    // the startup report runs from here to the first frame
+    uint64_t launchNs = getTimeNano(CLOCK_MONOTONIC);
+    renderer = RendererFactory::create(RendererFactory::selectBackend(app));
+    renderer->SetLaunchTime(launchNs);
 
     app->onAppCmd = CmdHandler;
 
@@ -93,25 +88,32 @@ void android_main( struct android_app *app){
 
     int32_t result;
     android_poll_source* source;
-    uint64_t frameIndex = 0;
 
-    pthread_setname_np(pthread_self(), "Camera-Render");
-    setThreadBindCpu(pthread_self(), 6, 7);
+    pthread_setname_np(pthread_self(), "Camera-Main");
 
+#ifdef VK_PIPELINE_BENCHMARK
+    initializeATrace();
+    VkBenchmark::compareCameraSampling(app, 600);
+    VkBenchmark::compareCameraUpload(app, 600);
+    VkBenchmark::compareFramesInFlight(app, 600);
+    VkBenchmark::compareFp16Shading(app, 600);
+#endif
+
+    renderThread = new RenderThread(renderer, &collector);
+    renderThread->start();
+
+    // frames are rendered on the render thread, this one only sleeps until the next lifecycle event
     for (;;) {
-        while((result = ALooper_pollAll(renderer.IsRunning() ? 0 : -1, nullptr, nullptr, reinterpret_cast<void**>(&source))) >= 0){
+        while((result = ALooper_pollAll(-1, nullptr, nullptr, reinterpret_cast<void**>(&source))) >= 0){
             if(source != nullptr)
                 source->process(app, source);
 
             if(app->destroyRequested)
             {
+                SAFE_DELETE(renderThread);
+                SAFE_DELETE(renderer);
                 return;
             }
         }
-
-        if(renderer.IsRunning()){
-            renderer.ProcessFrame(frameIndex++);
-            collector.collect();
-        }
     }
 }
\ No newline at end of file
@@ -282,7 +282,7 @@ void initGraphics(){
 #else
     VkHelper::createDescriptorSetLayout(vk.deviceInfo.device, nullptr, &vk.descriptorSetLayout);
 #endif
-    VkHelper::createDescriptorPool(vk.deviceInfo.device, &vk.descriptorPool);
+    VkHelper::createDescriptorPool(vk.deviceInfo.device, 2, &vk.descriptorPool);
     vk.descriptorSets = static_cast<VkDescriptorSet *>(malloc(sizeof(VkDescriptorSet) * 2));
     VkHelper::allocateDescriptorSets(vk.deviceInfo.device, vk.descriptorPool, vk.descriptorSetLayout, vk.descriptorSets);
     VkHelper::createPipelineLayout(vk.deviceInfo.device, vk.descriptorSetLayout, &vk.pipelineLayout);
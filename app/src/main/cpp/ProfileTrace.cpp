@@ -1,7 +1,12 @@
 #include "ProfileTrace.h"
+#include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
 #include <dlfcn.h>
 #include "Common.h"
+#ifdef __ANDROID__
+#include <sys/system_properties.h>
+#endif
 
 #define MAX_BUFFER_SIZE 256
 
@@ -13,6 +18,7 @@ typedef void *(*fp_ATrace_endSection) (void);
 typedef void *(*fp_ATrace_isEnabled) (void);
 
 void initializeATrace() {
+#ifdef __ANDROID__
     void *lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
     if (lib != NULL) {
         txrTraceEnterInternal = reinterpret_cast<fp_ATrace_beginSection>(dlsym(lib, "ATrace_beginSection"));
@@ -24,6 +30,7 @@ void initializeATrace() {
             traceEnabled = atoi(pValue) ? true : false;
         }
     }
+#endif
 }
 
 void TRACE_BEGIN(const char* fmt, ...) {
@@ -0,0 +1,104 @@
+#include "RenderThread.h"
+#include <cerrno>
+#include <pthread.h>
+#include "Common.h"
+#include "ThreadManager.h"
+
+static const uint64_t gPlacementReportFrames = 900;  // frames between thread placement reports
+
+RenderThread::RenderThread(Renderer *renderer, FpsCollector *collector) : mRenderer(renderer), mCollector(collector) {
+    sem_init(&mCommandCount, 0, 0);
+}
+
+RenderThread::~RenderThread() {
+    stop();
+    sem_destroy(&mCommandCount);
+}
+
+void RenderThread::start() {
+    if(mThread.joinable()){
+        return;
+    }
+    mThread = std::thread(&RenderThread::threadLoop, this);
+}
+
+bool RenderThread::post(RenderCommandType type, android_app *app, bool bWait) {
+    sem_t done;
+    if(bWait){
+        sem_init(&done, 0, 0);
+    }
+    if(!mCommands.push({.type = type, .app = app, .done = bWait ? &done : nullptr})){
+        LOG_E("RenderThread: command queue is full, dropping command %d", (int)type);
+        if(bWait){
+            sem_destroy(&done);
+        }
+        return false;
+    }
+    sem_post(&mCommandCount);
+    if(bWait){
+        while(sem_wait(&done) != 0 && errno == EINTR);
+        sem_destroy(&done);
+    }
+    return true;
+}
+
+void RenderThread::stop() {
+    if(!mThread.joinable()){
+        return;
+    }
+    post(RenderCommandType::QUIT, nullptr, false);
+    mThread.join();
+}
+
+void RenderThread::threadLoop() {
+    pthread_setname_np(pthread_self(), "Camera-Render");
+    ThreadManager::get().place(ThreadRole::RENDER, "Camera-Render");
+
+    for (;;) {
+        // without a window there is nothing to render until the next command
+        bool bIdle = !mRenderer->IsRunning();
+        while((bIdle ? sem_wait(&mCommandCount) : sem_trywait(&mCommandCount)) == 0){
+            RenderCommand command;
+            if(!mCommands.pop(&command)){
+                continue;
+            }
+            bool bContinue = execute(command);
+            if(command.done){
+                sem_post(command.done);
+            }
+            if(!bContinue){
+                return;
+            }
+            bIdle = !mRenderer->IsRunning();
+        }
+
+        if(mRenderer->IsRunning()){
+            mRenderer->ProcessFrame(mFrameIndex++);
+            mCollector->collect();
+            if(mFrameIndex % gPlacementReportFrames == 0){
+                ThreadManager::get().reportPlacement();
+            }
+        }
+    }
+}
+
+bool RenderThread::execute(const RenderCommand &command) {
+    switch (command.type) {
+        case RenderCommandType::INIT_WINDOW:
+            if(!mRenderer->IsRunning()){
+                mRenderer->Init(command.app);
+            }
+            return true;
+        case RenderCommandType::TERM_WINDOW:
+            if(mRenderer->IsRunning()){
+                mRenderer->Destroy();
+            }
+            return true;
+        case RenderCommandType::QUIT:
+            if(mRenderer->IsRunning()){
+                mRenderer->Destroy();
+            }
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+/*!
+ * @brief  The thread frames are rendered on, driven by lifecycle commands from the app-glue thread
+ * @date 2023/8/20
+ */
+#ifndef CAMERA2VK_RENDERTHREAD_H
+#define CAMERA2VK_RENDERTHREAD_H
+
+#include <android_native_app_glue.h>
+#include <semaphore.h>
+#include <thread>
+#include "FpsCollector.h"
+#include "Renderer.h"
+#include "SpscQueue.h"
+
+enum class RenderCommandType{
+    INIT_WINDOW,
+    TERM_WINDOW,
+    QUIT
+};
+
+struct RenderCommand{
+    RenderCommandType type;
+    android_app *app;
+    sem_t *done;        // posted once the command ran, nullptr when nobody waits
+};
+
+/**
+ * The renderer lives on this thread only. The app-glue thread posts commands through a lock-free queue and a
+ * semaphore, the render thread picks them up between frames and blocks on the semaphore while there is no window.
+ * With a window every frame paces itself on the vsync grid (Renderer::WaitForFirstHalf), so the loop never spins.
+ * TERM_WINDOW is posted with wait, the window has to outlive Renderer::Destroy().
+ */
+class RenderThread{
+public:
+    RenderThread(Renderer *renderer, FpsCollector *collector);
+    ~RenderThread();
+
+    void start();
+    // app-glue thread only; false when the queue is full
+    bool post(RenderCommandType type, android_app *app, bool bWait);
+    // posts QUIT and joins, a renderer that still runs is destroyed on its thread first
+    void stop();
+
+private:
+    void threadLoop();
+    // false once QUIT came in
+    bool execute(const RenderCommand &command);
+
+    Renderer *mRenderer;
+    FpsCollector *mCollector;
+    std::thread mThread;
+    SpscQueue<RenderCommand, 16> mCommands;
+    sem_t mCommandCount;
+    uint64_t mFrameIndex = 0;
+};
+
+#endif //CAMERA2VK_RENDERTHREAD_H
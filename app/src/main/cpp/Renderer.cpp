@@ -0,0 +1,176 @@
+#include "Renderer.h"
+#include <stdexcept>
+#include "Common.h"
+#include "ProfileTrace.h"
+#ifdef __ANDROID__
+#include <android_native_app_glue.h>
+#include "Camera/AndroidCameraPermission.h"
+#include "Camera/CameraImageReader.h"
+#include "Camera/CameraManager.h"
+#include "ChoreographerVsyncSource.h"
+#endif
+
+const int64_t gFramePeriodNs = (int64_t)(1e9 / 90);  //90FPS, until the vsync timeline has measured the display
+const uint64_t gLatencyReportNs = 10000ULL * U_TIME_1MS_IN_NS;  // latency percentiles logged this often
+const float gTimeWarpWaitFramePercentage = 0.5f;
+const bool gTimeWarpDelayBetweenEyes = false;
+const int gWarpMeshType = 2; //0 = Columns (Left To Right); 1 = Columns (Right To Left); 2 = Rows (Top To Bottom); 3 = Rows (Bottom To Top)
+
+static VsyncSource *createVsyncSource() {
+#ifdef __ANDROID__
+    return new ChoreographerVsyncSource();
+#else
+    // a host has no display to pace against, the vsync grid stays on the nominal period
+    return nullptr;
+#endif
+}
+
+Renderer::Renderer() : mVsyncTimeline(gFramePeriodNs, createVsyncSource()), mLatency(gLatencyReportNs) {
+}
+
+std::string Renderer::DataDir(struct android_app *app) {
+#ifdef __ANDROID__
+    if(app != nullptr){
+        return app->activity->internalDataPath;
+    }
+#endif
+    return ".";
+}
+
+void Renderer::AttachApp(struct android_app *app) {
+    mApp = app;
+    mDataDir = DataDir(app);
+#ifdef __ANDROID__
+    if(app != nullptr){
+        mAssets.reset(new AndroidAssetSource(app->activity->assetManager));
+        return;
+    }
+#endif
+    // headless runs without an activity read the shaders from the working directory
+    mAssets.reset(new FileAssetSource("."));
+}
+
+void Renderer::OpenCameras(uint64_t usage) {
+#ifdef __ANDROID__
+    if(!AndroidCameraPermission::isCameraPermitted(mApp)){
+        AndroidCameraPermission::requestCameraPermission(mApp);
+    }
+    mImageReaderLeft = new CameraImageReader(1920, 1440, AIMAGE_FORMAT_YUV_420_888, 4, usage);
+    mCameraLeft = new CameraManager(mImageReaderLeft->getWindow(), 2);
+    mCameraLeft->startCapturing();
+
+    mImageReaderRight= new CameraImageReader(1920, 1440, AIMAGE_FORMAT_YUV_420_888, 4, usage);
+    mCameraRight = new CameraManager(mImageReaderRight->getWindow(), 3);
+    mCameraRight->startCapturing();
+
+    mLatency.setTimestampSource(0, mCameraLeft->getTimestampSource());
+    mLatency.setTimestampSource(1, mCameraRight->getTimestampSource());
+#else
+    throw std::runtime_error("The host build has no cameras, only headless runs.");
+#endif
+}
+
+void Renderer::CloseCameras() {
+#ifdef __ANDROID__
+    mCameraLeft->stopCapturing();
+    mCameraRight->stopCapturing();
+    SAFE_DELETE(mImageReaderLeft);
+    SAFE_DELETE(mImageReaderRight);
+    SAFE_DELETE(mCameraLeft);
+    SAFE_DELETE(mCameraRight);
+#endif
+}
+
+std::vector<char> Renderer::ReadFileFromAndroidRes(const std::string& filePath) {
+    return mAssets->read(filePath);
+}
+
+RenderMeshOrder Renderer::MeshOrder() {
+    RenderMeshOrder gMeshOrderEnum = MeshOrderLeftToRight;
+    if (gWarpMeshType == 0) {
+        gMeshOrderEnum = MeshOrderLeftToRight;
+    } else if (gWarpMeshType == 1) {
+        gMeshOrderEnum = MeshOrderRightToLeft;
+    } else if (gWarpMeshType == 2) {
+        gMeshOrderEnum = MeshOrderTopToBottom;
+    } else if (gWarpMeshType == 3) {
+        gMeshOrderEnum = MeshOrderBottomToTop;
+    }
+    return gMeshOrderEnum;
+}
+
+uint64_t Renderer::WaitForFirstHalf(uint64_t frameIndex) {
+    uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+    uint64_t periodNs = mVsyncTimeline.refreshPeriodNs();
+    uint64_t lastVsyncTimeNs = mVsyncTimeline.predictNextVsync(startTimeNs) - periodNs;
+    mVsyncCount++;
+    mVsyncDiffTimeNs = startTimeNs - lastVsyncTimeNs;
+    double fractFrame = ((double)mVsyncDiffTimeNs) / periodNs;
+
+    int64_t waitTimeNs = 0;
+    if (fractFrame < gTimeWarpWaitFramePercentage) {
+        //We are currently in the first half of the display so wait until we hit the halfway point
+        waitTimeNs = (int64_t)((gTimeWarpWaitFramePercentage - fractFrame) * periodNs);
+    } else {
+        //We are currently past the halfway point in the display so wait until halfway through the next vsync cycle
+        waitTimeNs = (int64_t)((0.9 + gTimeWarpWaitFramePercentage - fractFrame) * periodNs);
+        LOG_W("%lu: jank...", frameIndex);
+    }
+    LOG_D("%lu: Left EyeBuffer Wait : %.2f ms, Vsync diff : %.2f ms, Frame diff : %.2f ms, Period : %.3f ms, [%lu: %.2f]", frameIndex,
+          waitTimeNs * 1.f / U_TIME_1MS_IN_NS, mVsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS, (startTimeNs - mLastFrameTime) * 1.f / U_TIME_1MS_IN_NS,
+          periodNs * 1.f / U_TIME_1MS_IN_NS, mVsyncCount, fractFrame);
+    mLastFrameTime = startTimeNs;
+    TRACE_BEGIN("Left wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, mVsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
+    NanoSleep(waitTimeNs);
+    TRACE_END("Left wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, mVsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
+    return getTimeNano(CLOCK_MONOTONIC);
+}
+
+void Renderer::WaitForSecondHalf(uint64_t frameIndex, uint64_t firstHalfNs) {
+    if (!gTimeWarpDelayBetweenEyes) {
+        return;
+    }
+    uint64_t periodNs = mVsyncTimeline.refreshPeriodNs();
+    uint64_t rightTimestamp = getTimeNano(CLOCK_MONOTONIC);
+    //We started the left eye half way through vsync, figure out how long
+    //we have left in the half frame until the raster starts over so we can render the right eye
+    uint64_t delta = rightTimestamp - firstHalfNs;
+    uint64_t waitTimeNs = 0;
+    if (delta < periodNs / 2) {
+        waitTimeNs = periodNs / 2 - delta;
+        LOG_D("%lu: Right EyeBuffer Wait : %.2f ms, Left take : %.2f ms", frameIndex, waitTimeNs * 1.f / U_TIME_1MS_IN_NS, delta * 1.f / U_TIME_1MS_IN_NS);
+        TRACE_BEGIN("Right wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, mVsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
+        NanoSleep(waitTimeNs + periodNs / 8);
+        TRACE_END("Right wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, mVsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
+    } else {
+        //The left eye took longer than 1/2 the refresh so the raster has already wrapped around and is
+        //in the left half of the screen.  Skip the wait and get right on rendering the right eye.
+        LOG_D("Left Eye took too long!!! ( %.2f ms )", delta * 1.f / U_TIME_1MS_IN_NS);
+    }
+}
+
+void Renderer::BeginInit() {
+    mVsyncTimeline.start();
+    mStartupTimes.initStartNs = getTimeNano(CLOCK_MONOTONIC);
+    if(mStartupTimes.launchNs == 0){
+        mStartupTimes.launchNs = mStartupTimes.initStartNs;
+    }
+    mStartupTimes.firstFrameNs = 0;
+}
+
+void Renderer::EndInit() {
+    mStartupTimes.initEndNs = getTimeNano(CLOCK_MONOTONIC);
+}
+
+void Renderer::ReportFirstFrame() {
+    if(mStartupTimes.firstFrameNs != 0){
+        return;
+    }
+    mStartupTimes.firstFrameNs = getTimeNano(CLOCK_MONOTONIC);
+    uint64_t launchNs = mStartupTimes.launchNs;
+    LOG_D("startup: %s launch to first frame %.2f ms (launch to init %.2f ms, init %.2f ms, init to first frame %.2f ms)", GetName(),
+          (mStartupTimes.firstFrameNs - launchNs) * 1.f / U_TIME_1MS_IN_NS,
+          (mStartupTimes.initStartNs - launchNs) * 1.f / U_TIME_1MS_IN_NS,
+          (mStartupTimes.initEndNs - mStartupTimes.initStartNs) * 1.f / U_TIME_1MS_IN_NS,
+          (mStartupTimes.firstFrameNs - mStartupTimes.initEndNs) * 1.f / U_TIME_1MS_IN_NS);
+}
@@ -0,0 +1,96 @@
+/*!
+ * @brief  What every renderer backend shares: cameras, display pacing, frame and startup metrics
+ * @date 2023/8/18
+ */
+#ifndef CAMERA2VK_RENDERER_H
+#define CAMERA2VK_RENDERER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AssetSource.h"
+#include "FrameTiming.h"
+#include "LatencyTracker.h"
+#include "VsyncTimeline.h"
+
+enum RenderMeshOrder{
+    MeshOrderLeftToRight = 0,
+    MeshOrderRightToLeft,
+    MeshOrderTopToBottom,
+    MeshOrderBottomToTop
+};
+
+enum RenderMeshArea{
+    MeshLeft = 0,      // Columns Left to Right [-1, 0]
+    MeshRight,         // Columns Left to Right [0, 1]
+    MeshUpperLeft,     // Rows Top to Bottom [Upper Left]
+    MeshUpperRight,    // Rows Top to Bottom [Upper Right]
+    MeshLowerLeft,     // Rows Top to Bottom [Lower Left]
+    MeshLowerRight,    // Rows Top to Bottom [Lower Right]
+};
+
+class CameraImageReader;
+class CameraManager;
+
+/**
+ * A backend renders the two camera streams in two half frames, raced against the raster: the first half starts
+ * halfway through a vsync period (WaitForFirstHalf), the second optionally half a period later (WaitForSecondHalf).
+ * Both wait on the vsync grid mVsyncTimeline predicts, which BeginInit() starts and the backend stops in Destroy().
+ * The backend fills mFrameStageTimes on every frame and calls ReportFirstFrame() once the first one is submitted.
+ * It also feeds mLatency the camera timestamps and the upload and present times, and ends each frame with it.
+ */
+class Renderer{
+public:
+    Renderer();
+    virtual ~Renderer() = default;
+
+    virtual void Init(struct android_app *app) = 0;
+    virtual void Destroy() = 0;
+    virtual void ProcessFrame(uint64_t frameIndex) = 0;
+    virtual const char *GetName() const = 0;
+
+    bool IsRunning() const { return bRunning; };
+    const FrameStageTimes &GetFrameStageTimes() const { return mFrameStageTimes; };
+    // before Init, when the process started, so the startup report covers everything up to the first frame
+    void SetLaunchTime(uint64_t launchNs) { mStartupTimes.launchNs = launchNs; };
+    const StartupTimes &GetStartupTimes() const { return mStartupTimes; };
+    // the internal data directory of the activity, the working directory without one
+    static std::string DataDir(struct android_app *app);
+
+protected:
+    // mApp, mAssets and mDataDir, app is null in a headless run without an activity
+    void AttachApp(struct android_app *app);
+    // usage adds AHARDWAREBUFFER_USAGE_* bits for backends that import the camera buffers
+    void OpenCameras(uint64_t usage = 0);
+    void CloseCameras();
+    std::vector<char> ReadFileFromAndroidRes(const std::string& filePath);
+    static RenderMeshOrder MeshOrder();
+    // sleeps until halfway through the current vsync period, returns when the first half frame may start
+    uint64_t WaitForFirstHalf(uint64_t frameIndex);
+    // half a period after firstHalfNs when the eyes are delayed against each other, returns at once otherwise
+    void WaitForSecondHalf(uint64_t frameIndex, uint64_t firstHalfNs);
+    void BeginInit();
+    void EndInit();
+    void ReportFirstFrame();
+
+    struct android_app *mApp = nullptr;
+    std::unique_ptr<AssetSource> mAssets;              // the APK assets, files in the working directory without an activity
+    std::string mDataDir;
+    bool bRunning = false;
+    CameraImageReader *mImageReaderLeft = nullptr;     // camera image reader
+    CameraImageReader *mImageReaderRight = nullptr;    // camera image reader
+    CameraManager *mCameraLeft = nullptr;              // camera left
+    CameraManager *mCameraRight = nullptr;             // camera right
+    FrameStageTimes mFrameStageTimes;
+    StartupTimes mStartupTimes;
+    VsyncTimeline mVsyncTimeline;
+    LatencyTracker mLatency;
+
+private:
+    uint64_t mVsyncCount = 0;
+    uint64_t mLastFrameTime = 0;
+    int64_t mVsyncDiffTimeNs = 0;
+};
+
+#endif //CAMERA2VK_RENDERER_H
@@ -0,0 +1,118 @@
+#include "RendererFactory.h"
+#include <cstring>
+#include <strings.h>
+#include <sys/system_properties.h>
+#include "Common.h"
+#ifdef GRAPHIC_API_GLES
+#include "GL/GLRenderer.h"
+#endif
+#ifdef GRAPHIC_API_VK
+#include "VK/VKRenderer.h"
+#endif
+
+static const char *gBackendProperty = "debug.camera2vk.renderer";   // adb shell setprop, survives relaunches
+static const char *gBackendExtra = "renderer";                      // am start --es, for this launch only
+
+RendererBackend RendererFactory::selectBackend(android_app *app) {
+    RendererBackend backend;
+    char value[PROP_VALUE_MAX] = {0};
+    if(__system_property_get(gBackendProperty, value) > 0){
+        if(parseBackend(value, &backend)){
+            LOG_D("RendererFactory: %s from %s", backendName(backend), gBackendProperty);
+            return backend;
+        }
+        LOG_W("RendererFactory: unknown backend %s in %s", value, gBackendProperty);
+    }
+    if(app != nullptr && readLaunchExtra(app, gBackendExtra, value, sizeof(value))){
+        if(parseBackend(value, &backend)){
+            LOG_D("RendererFactory: %s from the launch intent", backendName(backend));
+            return backend;
+        }
+        LOG_W("RendererFactory: unknown backend %s in the launch intent", value);
+    }
+#ifdef GRAPHIC_API_GLES
+    backend = RendererBackend::GLES;
+#else
+    backend = RendererBackend::VULKAN;
+#endif
+    LOG_D("RendererFactory: %s by default", backendName(backend));
+    return backend;
+}
+
+Renderer *RendererFactory::create(RendererBackend backend) {
+#if defined(GRAPHIC_API_GLES) && defined(GRAPHIC_API_VK)
+    if(backend == RendererBackend::GLES){
+        return new GLRenderer();
+    }
+    return new VKRenderer();
+#elif defined(GRAPHIC_API_GLES)
+    if(backend != RendererBackend::GLES){
+        LOG_W("RendererFactory: %s is not built in, using GLES", backendName(backend));
+    }
+    return new GLRenderer();
+#else
+    if(backend != RendererBackend::VULKAN){
+        LOG_W("RendererFactory: %s is not built in, using Vulkan", backendName(backend));
+    }
+    return new VKRenderer();
+#endif
+}
+
+const char *RendererFactory::backendName(RendererBackend backend) {
+    switch (backend) {
+        case RendererBackend::VULKAN:
+            return "Vulkan";
+        case RendererBackend::GLES:
+            return "GLES";
+    }
+    return "unknown";
+}
+
+bool RendererFactory::parseBackend(const char *value, RendererBackend *out_backend) {
+    if(strcasecmp(value, "vulkan") == 0 || strcasecmp(value, "vk") == 0){
+        *out_backend = RendererBackend::VULKAN;
+        return true;
+    }
+    if(strcasecmp(value, "gles") == 0 || strcasecmp(value, "gl") == 0){
+        *out_backend = RendererBackend::GLES;
+        return true;
+    }
+    return false;
+}
+
+bool RendererFactory::readLaunchExtra(android_app *app, const char *name, char *out_value, size_t size) {
+    auto instance = app->activity->clazz;
+    auto env = app->activity->env;
+    auto vm = app->activity->vm;
+
+    if(vm->AttachCurrentThread(&env, nullptr) != JNI_OK){
+        LOG_W("RendererFactory: could not attach thread to running VM.");
+        return false;
+    }
+
+    jclass Activity = env->GetObjectClass(instance);
+    jmethodID Activity_getIntent = env->GetMethodID(Activity, "getIntent", "()Landroid/content/Intent;");
+    jobject intent = env->CallObjectMethod(instance, Activity_getIntent);
+    jstring extra = nullptr;
+    if(intent != nullptr){
+        jclass Intent = env->GetObjectClass(intent);
+        jmethodID Intent_getStringExtra = env->GetMethodID(Intent, "getStringExtra", "(Ljava/lang/String;)Ljava/lang/String;");
+        jstring extraName = env->NewStringUTF(name);
+        extra = static_cast<jstring>(env->CallObjectMethod(intent, Intent_getStringExtra, extraName));
+    }
+    if(env->ExceptionCheck()){
+        env->ExceptionClear();
+        extra = nullptr;
+    }
+    bool bFound = false;
+    if(extra != nullptr){
+        const char *chars = env->GetStringUTFChars(extra, nullptr);
+        strncpy(out_value, chars, size - 1);
+        out_value[size - 1] = '\0';
+        env->ReleaseStringUTFChars(extra, chars);
+        bFound = true;
+    }
+
+    vm->DetachCurrentThread();
+    return bFound;
+}
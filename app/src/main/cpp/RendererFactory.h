@@ -0,0 +1,34 @@
+/*!
+ * @brief  Picks the renderer backend at launch, so one build can run either on the same device
+ * @date 2023/8/18
+ */
+#ifndef CAMERA2VK_RENDERERFACTORY_H
+#define CAMERA2VK_RENDERERFACTORY_H
+
+#include <android_native_app_glue.h>
+#include "Renderer.h"
+
+enum class RendererBackend{
+    VULKAN = 0,
+    GLES
+};
+
+/**
+ * The backend comes from, in this order: the debug.camera2vk.renderer system property, the "renderer" string extra
+ * of the launch intent (both "vulkan"/"vk" or "gles"/"gl"), and the build default, GLES when GRAPHIC_API_GLES is
+ * defined. A backend the build left out falls back to the other one.
+ *     adb shell setprop debug.camera2vk.renderer vk
+ *     adb shell am start -n <package>/android.app.NativeActivity --es renderer gles
+ */
+class RendererFactory{
+public:
+    static RendererBackend selectBackend(android_app *app);
+    static Renderer *create(RendererBackend backend);
+    static const char *backendName(RendererBackend backend);
+
+private:
+    static bool parseBackend(const char *value, RendererBackend *out_backend);
+    static bool readLaunchExtra(android_app *app, const char *name, char *out_value, size_t size);
+};
+
+#endif //CAMERA2VK_RENDERERFACTORY_H
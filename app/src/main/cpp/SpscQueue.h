@@ -0,0 +1,49 @@
+/*!
+ * @brief  Bounded lock-free queue between exactly one producer thread and one consumer thread
+ * @date 2023/8/20
+ */
+#ifndef CAMERA2VK_SPSCQUEUE_H
+#define CAMERA2VK_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * A ring of Capacity slots, Capacity a power of two. Each side only writes its own index and reads the other one
+ * with acquire, so neither ever blocks or takes a lock; push() fails when full and pop() when empty. T is copied
+ * in and out, keep it small and trivially copyable.
+ */
+template <typename T, uint32_t Capacity>
+class SpscQueue{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    // producer only
+    bool push(const T &value) {
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        if(tail - mHead.load(std::memory_order_acquire) == Capacity){
+            return false;
+        }
+        mSlots[tail & (Capacity - 1)] = value;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool pop(T *out_value) {
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        if(head == mTail.load(std::memory_order_acquire)){
+            return false;
+        }
+        *out_value = mSlots[head & (Capacity - 1)];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T mSlots[Capacity];
+    // far apart, so the two sides do not bounce one cache line
+    alignas(64) std::atomic<uint32_t> mHead{0};
+    alignas(64) std::atomic<uint32_t> mTail{0};
+};
+
+#endif //CAMERA2VK_SPSCQUEUE_H
@@ -0,0 +1,307 @@
+#include "ThreadManager.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sched.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "Log.h"
+
+// render gets two cores so a stray task on one of them does not stall a frame
+static const ThreadPolicy gDefaultPolicies[(int)ThreadRole::COUNT] = {
+        {.cluster = CpuCluster::BIG, .minCpus = 2, .fifoPriority = 2, .nice = -10},       // RENDER
+        {.cluster = CpuCluster::MID, .minCpus = 1, .fifoPriority = 1, .nice = -8},        // CAMERA_ACQUIRE
+        {.cluster = CpuCluster::MID, .minCpus = 2, .fifoPriority = 0, .nice = -4},        // UPLOAD
+        {.cluster = CpuCluster::MID, .minCpus = 2, .fifoPriority = 0, .nice = -6},        // RECORDER
+        {.cluster = CpuCluster::LITTLE, .minCpus = 1, .fifoPriority = 0, .nice = 5},      // METRICS
+};
+
+static std::string formatCpuList(const std::vector<int> &cpus) {
+    std::string text;
+    for(int cpu : cpus){
+        text += (text.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return text.empty() ? "none" : text;
+}
+
+ThreadManager::ThreadManager(const std::string &sysfsRoot, const std::string &procTaskRoot, PriorityMode mode)
+        : mSysfsRoot(sysfsRoot), mProcTaskRoot(procTaskRoot), mMode(mode) {
+    std::copy(std::begin(gDefaultPolicies), std::end(gDefaultPolicies), mPolicies);
+    readTopology();
+}
+
+void ThreadManager::setPolicy(ThreadRole role, const ThreadPolicy &policy) {
+    mPolicies[(int)role] = policy;
+}
+
+std::vector<int> ThreadManager::parseCpuList(const std::string &text) {
+    // "0-3,6" from the cpu lists, "4 5 6" from related_cpus
+    std::vector<int> cpus;
+    std::string token;
+    std::stringstream stream(text);
+    while(stream >> token){
+        std::stringstream ranges(token);
+        std::string range;
+        while(std::getline(ranges, range, ',')){
+            int first = 0, last = 0;
+            int count = sscanf(range.c_str(), "%d-%d", &first, &last);
+            if(count < 1 || first < 0){
+                continue;
+            }
+            if(count == 1){
+                last = first;
+            }
+            for(int cpu = first; cpu <= last; cpu++){
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+bool ThreadManager::readFile(const std::string &path, std::string *out_text) const {
+    std::ifstream stream(path);
+    if(!stream.is_open()){
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    *out_text = buffer.str();
+    return true;
+}
+
+void ThreadManager::readTopology() {
+    std::string text;
+    std::vector<int> cpus;
+    if(readFile(mSysfsRoot + "/possible", &text)){
+        cpus = parseCpuList(text);
+    }
+    std::vector<int> online = cpus;
+    if(readFile(mSysfsRoot + "/online", &text)){
+        online = parseCpuList(text);
+    }
+
+    // keyed by the frequency domain, by capacity where cpufreq is missing
+    std::map<std::string, CpuDomain> domains;
+    for(int cpu : cpus){
+        if(!std::binary_search(online.begin(), online.end(), cpu)){
+            continue;
+        }
+        std::string cpuDir = mSysfsRoot + "/cpu" + std::to_string(cpu);
+        uint32_t capacity = 0;
+        if(readFile(cpuDir + "/cpu_capacity", &text) || readFile(cpuDir + "/cpufreq/cpuinfo_max_freq", &text)){
+            capacity = (uint32_t)strtoul(text.c_str(), nullptr, 10);
+        }
+        std::string key = "capacity " + std::to_string(capacity);
+        if(readFile(cpuDir + "/cpufreq/related_cpus", &text)){
+            key = formatCpuList(parseCpuList(text));
+        }
+        CpuDomain &domain = domains[key];
+        domain.cpus.push_back(cpu);
+        domain.capacity = std::max(domain.capacity, capacity);
+    }
+
+    mDomains.clear();
+    for(auto &entry : domains){
+        mDomains.push_back(entry.second);
+    }
+    std::sort(mDomains.begin(), mDomains.end(), [](const CpuDomain &a, const CpuDomain &b){
+        return a.capacity > b.capacity || (a.capacity == b.capacity && a.cpus.front() < b.cpus.front());
+    });
+    // by capacity, so two domains of the same cores land in the same cluster
+    for(CpuDomain &domain : mDomains){
+        if(domain.capacity == mDomains.front().capacity){
+            domain.cluster = CpuCluster::BIG;
+        } else if(domain.capacity == mDomains.back().capacity){
+            domain.cluster = CpuCluster::LITTLE;
+        } else {
+            domain.cluster = CpuCluster::MID;
+        }
+        LOG_D("ThreadManager: %s cpus %s, capacity %u", clusterName(domain.cluster), formatCpuList(domain.cpus).c_str(), domain.capacity);
+    }
+    if(mDomains.empty()){
+        LOG_W("ThreadManager: no CPU topology under %s, threads keep the default affinity", mSysfsRoot.c_str());
+    }
+}
+
+std::vector<int> ThreadManager::cpusFor(ThreadRole role) const {
+    std::vector<int> cpus;
+    if(mDomains.empty()){
+        return cpus;
+    }
+    const ThreadPolicy &rolePolicy = mPolicies[(int)role];
+    // a missing cluster falls to the next faster one, BIG always exists
+    CpuCluster cluster = rolePolicy.cluster;
+    auto hasCluster = [this](CpuCluster c){
+        return std::any_of(mDomains.begin(), mDomains.end(), [c](const CpuDomain &domain){ return domain.cluster == c; });
+    };
+    while(!hasCluster(cluster)){
+        cluster = (CpuCluster)((int)cluster - 1);
+    }
+
+    int first = -1, last = -1;
+    for(int i = 0; i < (int)mDomains.size(); i++){
+        if(mDomains[i].cluster == cluster){
+            first = first < 0 ? i : first;
+            last = i;
+        }
+    }
+    // too few CPUs: faster neighbours first, slower ones after
+    for(int i = first; i <= last; i++){
+        cpus.insert(cpus.end(), mDomains[i].cpus.begin(), mDomains[i].cpus.end());
+    }
+    for(int i = first - 1; i >= 0 && cpus.size() < rolePolicy.minCpus; i--){
+        cpus.insert(cpus.end(), mDomains[i].cpus.begin(), mDomains[i].cpus.end());
+    }
+    for(int i = last + 1; i < (int)mDomains.size() && cpus.size() < rolePolicy.minCpus; i++){
+        cpus.insert(cpus.end(), mDomains[i].cpus.begin(), mDomains[i].cpus.end());
+    }
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+bool ThreadManager::place(ThreadRole role, const char *name, pid_t tid) {
+    if(tid == 0){
+        tid = gettid();
+    }
+    std::vector<int> cpus = cpusFor(role);
+    bool bPlaced = false;
+    if(!cpus.empty()){
+        cpu_set_t sets;
+        CPU_ZERO(&sets);
+        for(int cpu : cpus){
+            CPU_SET(cpu, &sets);
+        }
+        bPlaced = sched_setaffinity(tid, sizeof(sets), &sets) == 0;
+        if(!bPlaced){
+            LOG_W("ThreadManager: could not set the affinity of %s to %s: %s", name, formatCpuList(cpus).c_str(), strerror(errno));
+        }
+    }
+    std::string priority = applyPriority(mPolicies[(int)role], tid);
+    LOG_D("ThreadManager: %s (%s) tid %d on cpus %s, %s", name, roleName(role), tid,
+          bPlaced ? formatCpuList(cpus).c_str() : "of the process", priority.c_str());
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mThreads.erase(std::remove_if(mThreads.begin(), mThreads.end(), [tid](const PlacedThread &thread){ return thread.tid == tid; }),
+                   mThreads.end());
+    mThreads.push_back({.tid = tid, .name = name, .role = role, .cpus = bPlaced ? cpus : std::vector<int>(),
+                        .priority = priority, .lastCpu = -1, .migrations = 0});
+    return bPlaced;
+}
+
+std::string ThreadManager::applyPriority(const ThreadPolicy &policy, pid_t tid) const {
+    if(mMode == PriorityMode::NONE){
+        return "default priority";
+    }
+    if(mMode == PriorityMode::REALTIME && policy.fifoPriority > 0){
+        sched_param param = {.sched_priority = policy.fifoPriority};
+        if(sched_setscheduler(tid, SCHED_FIFO, &param) == 0){
+            return "SCHED_FIFO " + std::to_string(policy.fifoPriority);
+        }
+        // apps usually lack CAP_SYS_NICE
+        LOG_W("ThreadManager: SCHED_FIFO %d refused for tid %d: %s, using nice %d", policy.fifoPriority, tid, strerror(errno), policy.nice);
+    }
+    if(setpriority(PRIO_PROCESS, tid, policy.nice) == 0){
+        return "nice " + std::to_string(policy.nice);
+    }
+    LOG_W("ThreadManager: nice %d refused for tid %d: %s", policy.nice, tid, strerror(errno));
+    return "default priority";
+}
+
+bool ThreadManager::readTaskCpu(pid_t tid, int *out_cpu) const {
+    std::string text;
+    if(!readFile(mProcTaskRoot + "/" + std::to_string(tid) + "/stat", &text)){
+        return false;
+    }
+    // the name may hold spaces and parentheses, the fields after it are fixed: processor is the 37th
+    size_t nameEnd = text.rfind(')');
+    if(nameEnd == std::string::npos){
+        return false;
+    }
+    std::stringstream stream(text.substr(nameEnd + 1));
+    std::string field;
+    for(int i = 0; i < 37 && (stream >> field); i++);
+    if(!stream){
+        return false;
+    }
+    *out_cpu = atoi(field.c_str());
+    return true;
+}
+
+bool ThreadManager::readTaskMigrations(pid_t tid, uint64_t *out_migrations) const {
+    // only with CONFIG_SCHED_DEBUG
+    std::ifstream stream(mProcTaskRoot + "/" + std::to_string(tid) + "/sched");
+    std::string line;
+    while(std::getline(stream, line)){
+        if(line.compare(0, strlen("se.nr_migrations"), "se.nr_migrations") == 0){
+            size_t colon = line.find(':');
+            if(colon == std::string::npos){
+                return false;
+            }
+            *out_migrations = strtoull(line.c_str() + colon + 1, nullptr, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadManager::reportPlacement() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto it = mThreads.begin(); it != mThreads.end();){
+        PlacedThread &thread = *it;
+        int cpu = -1;
+        if(!readTaskCpu(thread.tid, &cpu)){
+            LOG_D("ThreadManager: %s tid %d has exited", thread.name.c_str(), thread.tid);
+            it = mThreads.erase(it);
+            continue;
+        }
+        uint64_t migrations = 0;
+        if(readTaskMigrations(thread.tid, &migrations)){
+            thread.migrations = migrations;
+        } else if(thread.lastCpu >= 0 && cpu != thread.lastCpu){
+            thread.migrations++;
+        }
+        thread.lastCpu = cpu;
+        bool bInside = thread.cpus.empty() || std::binary_search(thread.cpus.begin(), thread.cpus.end(), cpu);
+        LOG_D("ThreadManager: %-16s %-14s tid %d last on cpu %d%s, cpus %s, %s, %lu migrations", thread.name.c_str(),
+              roleName(thread.role), thread.tid, cpu, bInside ? "" : " (outside its cpus)", formatCpuList(thread.cpus).c_str(),
+              thread.priority.c_str(), (unsigned long)thread.migrations);
+        ++it;
+    }
+}
+
+const char *ThreadManager::roleName(ThreadRole role) {
+    switch (role) {
+        case ThreadRole::RENDER:
+            return "render";
+        case ThreadRole::CAMERA_ACQUIRE:
+            return "camera-acquire";
+        case ThreadRole::UPLOAD:
+            return "upload";
+        case ThreadRole::RECORDER:
+            return "recorder";
+        case ThreadRole::METRICS:
+            return "metrics";
+        case ThreadRole::COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+const char *ThreadManager::clusterName(CpuCluster cluster) {
+    switch (cluster) {
+        case CpuCluster::BIG:
+            return "big";
+        case CpuCluster::MID:
+            return "mid";
+        case CpuCluster::LITTLE:
+            return "little";
+    }
+    return "unknown";
+}
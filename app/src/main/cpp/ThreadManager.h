@@ -0,0 +1,105 @@
+/*!
+ * @brief  Places threads by role on the big, mid or little CPU cluster read from sysfs, with optional real-time priority
+ * @date 2023/8/21
+ */
+#ifndef CAMERA2VK_THREADMANAGER_H
+#define CAMERA2VK_THREADMANAGER_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+enum class ThreadRole{
+    RENDER = 0,
+    CAMERA_ACQUIRE,
+    UPLOAD,
+    RECORDER,
+    METRICS,
+    COUNT
+};
+
+enum class CpuCluster{
+    BIG = 0,
+    MID,
+    LITTLE
+};
+
+enum class PriorityMode{
+    NONE = 0,       // affinity only
+    NICE,           // nice values
+    REALTIME        // SCHED_FIFO where the policy asks for it, nice where that is refused
+};
+
+struct CpuDomain{
+    std::vector<int> cpus;          // one frequency domain, they share a clock
+    uint32_t capacity = 0;          // cpu_capacity, or cpuinfo_max_freq in kHz when the kernel has no capacities
+    CpuCluster cluster = CpuCluster::BIG;
+};
+
+struct ThreadPolicy{
+    CpuCluster cluster;
+    uint32_t minCpus;               // clusters next to it are added until the thread has this many CPUs
+    int fifoPriority;               // 0 keeps SCHED_OTHER even in REALTIME mode
+    int nice;
+};
+
+/**
+ * The topology is read once from a sysfs root, /sys/devices/system/cpu on a device, any directory with the same
+ * layout otherwise: possible and online CPU lists, cpuN/cpu_capacity and cpuN/cpufreq/{related_cpus,cpuinfo_max_freq}.
+ * Frequency domains sorted by capacity become clusters: the fastest is BIG, the slowest LITTLE, the ones between MID.
+ * A SoC with two domains has no MID and one with a single domain only BIG; a role asking for a missing cluster gets
+ * the next faster one. cpusFor() is the whole policy and touches no thread, app/tests runs it against fake trees on Linux.
+ * place() applies it to a thread and remembers it for reportPlacement(), which logs where every placed thread ran
+ * last and how often the scheduler migrated it.
+ */
+class ThreadManager{
+public:
+    ThreadManager(const std::string &sysfsRoot, const std::string &procTaskRoot, PriorityMode mode);
+
+    // the device topology, the priority mode from the debug.camera2vk.thread_priority property (none, nice, fifo);
+    // in ThreadManagerDevice.cpp, the host tests construct their own
+    static ThreadManager &get();
+
+    const std::vector<CpuDomain> &domains() const { return mDomains; };
+    const ThreadPolicy &policy(ThreadRole role) const { return mPolicies[(int)role]; };
+    void setPolicy(ThreadRole role, const ThreadPolicy &policy);
+    std::vector<int> cpusFor(ThreadRole role) const;
+
+    // tid 0 is the calling thread; false when the affinity could not be set, a refused priority only logs
+    bool place(ThreadRole role, const char *name, pid_t tid = 0);
+    void reportPlacement();
+
+    static std::vector<int> parseCpuList(const std::string &text);
+    static const char *roleName(ThreadRole role);
+    static const char *clusterName(CpuCluster cluster);
+
+private:
+    struct PlacedThread{
+        pid_t tid;
+        std::string name;
+        ThreadRole role;
+        std::vector<int> cpus;
+        std::string priority;       // what was actually applied
+        int lastCpu;
+        uint64_t migrations;        // counted from last cpu changes when the kernel has no schedstats
+    };
+
+    void readTopology();
+    bool readFile(const std::string &path, std::string *out_text) const;
+    std::string applyPriority(const ThreadPolicy &policy, pid_t tid) const;
+    bool readTaskCpu(pid_t tid, int *out_cpu) const;
+    bool readTaskMigrations(pid_t tid, uint64_t *out_migrations) const;
+
+    std::string mSysfsRoot;
+    std::string mProcTaskRoot;
+    PriorityMode mMode;
+    std::vector<CpuDomain> mDomains;        // fastest first
+    ThreadPolicy mPolicies[(int)ThreadRole::COUNT];
+
+    std::mutex mMutex;
+    std::vector<PlacedThread> mThreads;
+};
+
+#endif //CAMERA2VK_THREADMANAGER_H
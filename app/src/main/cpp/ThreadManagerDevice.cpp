@@ -0,0 +1,29 @@
+#include "ThreadManager.h"
+#include <cstring>
+#ifdef __ANDROID__
+#include <sys/system_properties.h>
+#endif
+
+// the device side of ThreadManager, kept apart so ThreadManager.cpp builds in the host tests
+static PriorityMode readPriorityMode() {
+#ifdef __ANDROID__
+    char value[PROP_VALUE_MAX] = {0};
+    if(__system_property_get("debug.camera2vk.thread_priority", value) > 0){
+        if(strcmp(value, "none") == 0){
+            return PriorityMode::NONE;
+        }
+        if(strcmp(value, "fifo") == 0){
+            return PriorityMode::REALTIME;
+        }
+    }
+    return PriorityMode::NICE;
+#else
+    // the host benchmark leaves the scheduling of a desktop alone
+    return PriorityMode::NONE;
+#endif
+}
+
+ThreadManager &ThreadManager::get() {
+    static ThreadManager manager("/sys/devices/system/cpu", "/proc/self/task", readPriorityMode());
+    return manager;
+}
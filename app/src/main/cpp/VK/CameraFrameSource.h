@@ -0,0 +1,28 @@
+/*!
+ * @brief  Where VKRenderer takes the camera frames of both eyes from, the image readers or fixed frames
+ * @date 2023/8/24
+ */
+#ifndef CAMERA2VK_CAMERAFRAMESOURCE_H
+#define CAMERA2VK_CAMERAFRAMESOURCE_H
+
+#include <cstdint>
+#include "VkCameraImageV2.h"
+
+class CameraFrameSource{
+public:
+    virtual ~CameraFrameSource() = default;
+    // the latest frame of the eye, false while there is none. the planes stay valid until the next acquire of the eye
+    virtual bool acquire(uint32_t eyeIndex, CameraFrame *out_frame) = 0;
+};
+
+// the frames set last, a headless run sets new ones before every ProcessFrame
+class SyntheticFrameSource : public CameraFrameSource{
+public:
+    void set(const CameraFrame &left, const CameraFrame &right) { mFrames[0] = left; mFrames[1] = right; };
+    bool acquire(uint32_t eyeIndex, CameraFrame *out_frame) override { *out_frame = mFrames[eyeIndex]; return true; };
+
+private:
+    CameraFrame mFrames[2];
+};
+
+#endif //CAMERA2VK_CAMERAFRAMESOURCE_H
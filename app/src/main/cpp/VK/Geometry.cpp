@@ -16,25 +16,22 @@ uint32_t Geometry::geIndexCount() const {
     return indices.size();
 }
 
-void Geometry::destroy(VkDevice device) {
+void Geometry::destroy(VkDevice device, VkMemoryAllocator *allocator) {
     if(vertexBuffer != VK_NULL_HANDLE){
         vkDestroyBuffer(device, vertexBuffer, VK_ALLOC);
+        vertexBuffer = VK_NULL_HANDLE;
     }
-    if(vertexMemory != VK_NULL_HANDLE){
-        vkFreeMemory(device, vertexMemory, VK_ALLOC);
-    }
+    allocator->free(&vertexAllocation);
     if(indexBuffer != VK_NULL_HANDLE){
         vkDestroyBuffer(device, indexBuffer, VK_ALLOC);
+        indexBuffer = VK_NULL_HANDLE;
     }
-    if(indexMemory != VK_NULL_HANDLE){
-        vkFreeMemory(device, indexMemory, VK_ALLOC);
-    }
+    allocator->free(&indexAllocation);
     vertices.clear();
     indices.clear();
 
     for(int i = 0; i < uniformBuffers.size(); i++){
         vkDestroyBuffer(device, uniformBuffers[i], VK_ALLOC);
-        vkFreeMemory(device, uniformMemorys[i], VK_ALLOC);
+        allocator->free(&uniformAllocations[i]);
     }
 }
-
@@ -10,24 +10,25 @@
 #include <vector>
 #include "vulkan_wrapper.h"
 #include "VkShaderParam.h"
+#include "VkMemoryAllocator.h"
 
 class Geometry {
 public:
     bool bUseIndexDraw() const;
     uint32_t getVertexCount() const;
     uint32_t geIndexCount() const;
-    void destroy(VkDevice device);
+    void destroy(VkDevice device, VkMemoryAllocator *allocator);
 public:
     std::vector<Vertex>  vertices;
     std::vector<uint32_t> indices;
 
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexMemory;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkAllocation vertexAllocation;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkAllocation indexAllocation;
 
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformMemorys;
+    std::vector<VkAllocation> uniformAllocations;
     std::vector<void*> uniformBuffersMapped;
 };
 
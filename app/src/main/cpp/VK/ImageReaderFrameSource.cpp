@@ -0,0 +1,99 @@
+#include "ImageReaderFrameSource.h"
+#include <dlfcn.h>
+#include <mutex>
+#include "../Camera/CameraImageReader.h"
+
+// the ADataSpace bit fields, and the legacy values that predate them
+static const int32_t gDataSpaceStandardMask = 63 << 16;
+static const int32_t gDataSpaceStandardBt709 = 1 << 16;
+static const int32_t gDataSpaceStandardBt601First = 2 << 16;    // 625 and 525 lines, adjusted or not
+static const int32_t gDataSpaceStandardBt601Last = 5 << 16;
+static const int32_t gDataSpaceStandardBt2020First = 6 << 16;   // constant luminance too
+static const int32_t gDataSpaceStandardBt2020Last = 7 << 16;
+static const int32_t gDataSpaceRangeMask = 7 << 27;
+static const int32_t gDataSpaceRangeFull = 1 << 27;
+static const int32_t gDataSpaceRangeLimited = 2 << 27;
+static const int32_t gDataSpaceLegacyJfif = 0x101;
+static const int32_t gDataSpaceLegacyBt601First = 0x102;        // 625 and 525 lines
+static const int32_t gDataSpaceLegacyBt601Last = 0x103;
+static const int32_t gDataSpaceLegacyBt709 = 0x104;
+
+// API 34, newer than the NDK this builds with, looked up at runtime
+typedef media_status_t (*fp_AImage_getDataSpace)(const AImage *image, int32_t *dataSpace);
+static fp_AImage_getDataSpace gGetDataSpace = nullptr;
+
+static void loadImageSymbols() {
+    static std::once_flag once;
+    std::call_once(once, []{
+        void *lib = dlopen("libmediandk.so", RTLD_NOW | RTLD_LOCAL);
+        if(lib != nullptr){
+            gGetDataSpace = reinterpret_cast<fp_AImage_getDataSpace>(dlsym(lib, "AImage_getDataSpace"));
+        }
+    });
+}
+
+// false when the dataspace does not say, then the JFIF defaults stay
+static bool colorFromDataSpace(int32_t dataSpace, CameraColorFormat *out_format) {
+    if(dataSpace == gDataSpaceLegacyJfif){
+        out_format->colorModel = ColorModel::BT601;
+        out_format->colorRange = ColorRange::FULL;
+        return true;
+    }
+    if(dataSpace >= gDataSpaceLegacyBt601First && dataSpace <= gDataSpaceLegacyBt601Last){
+        out_format->colorModel = ColorModel::BT601;
+        out_format->colorRange = ColorRange::LIMITED;
+        return true;
+    }
+    if(dataSpace == gDataSpaceLegacyBt709){
+        out_format->colorModel = ColorModel::BT709;
+        out_format->colorRange = ColorRange::LIMITED;
+        return true;
+    }
+    int32_t standard = dataSpace & gDataSpaceStandardMask;
+    int32_t range = dataSpace & gDataSpaceRangeMask;
+    if(standard == gDataSpaceStandardBt709){
+        out_format->colorModel = ColorModel::BT709;
+    } else if(standard >= gDataSpaceStandardBt601First && standard <= gDataSpaceStandardBt601Last){
+        out_format->colorModel = ColorModel::BT601;
+    } else if(standard >= gDataSpaceStandardBt2020First && standard <= gDataSpaceStandardBt2020Last){
+        out_format->colorModel = ColorModel::BT2020;
+    } else {
+        return false;
+    }
+    // extended and unspecified ranges are taken as full, like JFIF
+    out_format->colorRange = range == gDataSpaceRangeLimited ? ColorRange::LIMITED : ColorRange::FULL;
+    return true;
+}
+
+bool ImageReaderFrameSource::acquire(uint32_t eyeIndex, CameraFrame *out_frame) {
+    return getFrame(mReaders[eyeIndex]->getLatestImage(), out_frame);
+}
+
+bool ImageReaderFrameSource::getFrame(const AImage *image, CameraFrame *out_frame) {
+    if(!image){
+        return false;
+    }
+    uint8_t *yData, *uData, *vData;
+    int32_t uDataLen, vDataLen;
+    AImage_getTimestamp(image, &out_frame->timestamp);
+    AImage_getPlaneData(image, 0, &yData, &out_frame->yDataLen);
+    AImage_getPlaneData(image, 1, &uData, &uDataLen);
+    AImage_getPlaneData(image, 2, &vData, &vDataLen);
+    out_frame->yData = yData;
+    // U and V point into the same interleaved plane, the one that starts first gives the chroma order
+    bool bVFirst = vData < uData;
+    out_frame->uvData = bVFirst ? vData : uData;
+    out_frame->uvDataLen = bVFirst ? vDataLen : uDataLen;
+    // camera2 documents YUV_420_888 as JFIF, that stays where the buffer carries no dataspace or an unknown one
+    out_frame->format = {
+            .chromaOrder = bVFirst ? ChromaOrder::NV21 : ChromaOrder::NV12,
+            .colorModel = ColorModel::BT601,
+            .colorRange = ColorRange::FULL
+    };
+    loadImageSymbols();
+    int32_t dataSpace = 0;
+    if(gGetDataSpace != nullptr && gGetDataSpace(image, &dataSpace) == AMEDIA_OK){
+        colorFromDataSpace(dataSpace, &out_frame->format);
+    }
+    return true;
+}
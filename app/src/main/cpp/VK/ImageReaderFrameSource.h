@@ -0,0 +1,25 @@
+/*!
+ * @brief  Camera frames from the latest AImage of each eye's image reader, the device CameraFrameSource
+ * @date 2023/8/24
+ */
+#ifndef CAMERA2VK_IMAGEREADERFRAMESOURCE_H
+#define CAMERA2VK_IMAGEREADERFRAMESOURCE_H
+
+#include <media/NdkImage.h>
+#include "CameraFrameSource.h"
+
+class CameraImageReader;
+
+class ImageReaderFrameSource : public CameraFrameSource{
+public:
+    // the readers are not owned
+    ImageReaderFrameSource(CameraImageReader *left, CameraImageReader *right) : mReaders{left, right} {};
+    bool acquire(uint32_t eyeIndex, CameraFrame *out_frame) override;
+    // the planes, the chroma order and, where the buffer carries one, the color model and range of its dataspace
+    static bool getFrame(const AImage *image, CameraFrame *out_frame);
+
+private:
+    CameraImageReader *mReaders[2];
+};
+
+#endif //CAMERA2VK_IMAGEREADERFRAMESOURCE_H
@@ -2,80 +2,151 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <sstream>
+#include <cstring>
 #include "VkHelper.h"
 
-bool Texture::load(AAssetManager *assetManager, VkDevice device, VkPhysicalDeviceMemoryProperties physicalMemoType, VkCommandPool cmdPool, VkQueue queue, const char *fileName) {
-    AAsset* file = AAssetManager_open(assetManager, fileName, AASSET_MODE_BUFFER);
-    if(!file){
-        std::stringstream ss;
-        ss << "can not load the texture, fileName=" << fileName;
-        throw std::runtime_error(ss.str());
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// KTX2 file layout up to the level index, little endian like every supported device
+struct Ktx2Header{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static void throwTextureError(const char *fileName, const char *reason){
+    std::stringstream ss;
+    ss << "can not load the texture, fileName=" << fileName << ", " << reason;
+    throw std::runtime_error(ss.str());
+}
+
+static void parseKtx2(const uint8_t *buffer, size_t length, const char *fileName, TextureData *out_data){
+    Ktx2Header header;
+    memcpy(&header, buffer, sizeof(header));
+    if(header.supercompressionScheme != 0 || header.vkFormat == VK_FORMAT_UNDEFINED){
+        throwTextureError(fileName, "supercompressed and Basis Universal payloads are not supported");
+    }
+    if(header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1){
+        throwTextureError(fileName, "only 2D textures are supported");
     }
-    auto fileData = std::vector<stbi_uc>(AAsset_getLength(file));
-    if(AAsset_read(file, fileData.data(), fileData.size()) != fileData.size())
-    {
-        AAsset_close(file);
-        throw std::runtime_error{"Unknown error. Couldn't read from texture file."};
+    // a level count of 0 asks the loader to generate mips, the base level is used alone
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    if(sizeof(header) + levelCount * sizeof(Ktx2LevelIndex) > length){
+        throwTextureError(fileName, "truncated level index");
     }
-    AAsset_close(file);
 
-    auto pixels = stbi_load_from_memory(fileData.data(), fileData.size(), &height, &width,
-                                          &channels, STBI_rgb_alpha);
-    if(nullptr == pixels){
-        std::stringstream ss;
-        ss << "can not load the texture, fileName=" << fileName;
-        throw std::runtime_error(ss.str());
+    out_data->format = static_cast<VkFormat>(header.vkFormat);
+    out_data->levels.resize(levelCount);
+    for(uint32_t i = 0; i < levelCount; i++){
+        Ktx2LevelIndex levelIndex;
+        memcpy(&levelIndex, buffer + sizeof(header) + i * sizeof(Ktx2LevelIndex), sizeof(levelIndex));
+        if(levelIndex.byteLength == 0 || levelIndex.byteOffset + levelIndex.byteLength > length){
+            throwTextureError(fileName, "level data out of range");
+        }
+        out_data->levels[i] = {
+                .width = std::max(header.pixelWidth >> i, 1u),
+                .height = std::max(header.pixelHeight >> i, 1u),
+                .data = buffer + levelIndex.byteOffset,
+                .size = levelIndex.byteLength
+        };
     }
+}
 
-    VkDeviceSize size = width * height * 4;//rgba
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    VkHelper::createBufferInternal(physicalMemoType, device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                   size, &stagingBuffer, &stagingMemory);
-    void* data;
-    vkMapMemory(device, stagingMemory, 0, size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(size));
-    vkUnmapMemory(device, stagingMemory);
-    stbi_image_free(pixels);
+void TextureData::release() {
+    levels.clear();
+    asset.reset();
+    if(pixels != nullptr){
+        stbi_image_free(pixels);
+        pixels = nullptr;
+    }
+}
 
-    VkHelper::createImage(physicalMemoType, device, width, height, 1, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                          &mImage, &mMemory);
+VkDeviceSize TextureData::byteSize() const {
+    VkDeviceSize size = 0;
+    for(const auto &level : levels){
+        size += level.size;
+    }
+    return size;
+}
 
-    VkCommandBuffer cmdBuffer;
-    VkHelper::allocateCommandBuffers(device, cmdPool, 1, &cmdBuffer);
-    VkHelper::beginCommandBuffer(cmdBuffer, true);
-    VkBufferImageCopy region = {
-            .bufferOffset = 0,
-            .bufferRowLength = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .mipLevel = 0,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1
-            },
-            .imageOffset = {0, 0, 0},
-            .imageExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1}
-    };
-    vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer, mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    VkHelper::endCommandBuffer(cmdBuffer, device, cmdPool, queue, true);
+void Texture::decode(const AssetSource *assets, const char *fileName, TextureData *out_data) {
+    out_data->release();
+    out_data->asset = assets->open(fileName);
+    if(!out_data->asset){
+        throwTextureError(fileName, "asset not found");
+    }
+    const uint8_t *buffer = out_data->asset->data();
+    size_t length = out_data->asset->size();
+    if(buffer == nullptr){
+        throwTextureError(fileName, "asset can not be mapped");
+    }
+
+    if(length >= sizeof(Ktx2Header) && memcmp(buffer, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0){
+        parseKtx2(buffer, length, fileName, out_data);
+        return;
+    }
+
+    int width, height, channels;
+    out_data->pixels = stbi_load_from_memory(buffer, (int) length, &width, &height, &channels, STBI_rgb_alpha);
+    // the pixels are a copy, the asset is not needed anymore
+    out_data->asset.reset();
+    if(nullptr == out_data->pixels){
+        throwTextureError(fileName, stbi_failure_reason());
+    }
+    out_data->format = VK_FORMAT_R8G8B8A8_SRGB;
+    out_data->levels.push_back({
+            .width = (uint32_t) width,
+            .height = (uint32_t) height,
+            .data = out_data->pixels,
+            .size = (VkDeviceSize) width * height * 4//rgba
+    });
+}
 
-    vkDestroyBuffer(device, stagingBuffer, VK_ALLOC);
-    vkFreeMemory(device, stagingMemory, VK_ALLOC);
+bool Texture::load(const AssetSource *assets, VkDevice device, VkMemoryAllocator *allocator, UploadBatch *batch, const char *fileName) {
+    TextureData data;
+    decode(assets, fileName, &data);
+    create(device, allocator, batch, data);
+    return true;
+}
+
+void Texture::create(VkDevice device, VkMemoryAllocator *allocator, UploadBatch *batch, const TextureData &data) {
+    width = data.levels[0].width;
+    height = data.levels[0].height;
+    mipLevels = data.levels.size();
+    VkHelper::createImage(allocator, device, width, height, 1, VK_IMAGE_TYPE_2D, data.format,
+                          VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                          &mImage, &mAllocation, 1, mipLevels);
+    batch->uploadImageLevels(mImage, data.levels.data(), mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     //image view
-    VkHelper::createImageView(device, mImage, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, &mImgView);
+    VkHelper::createImageView(device, mImage, VK_IMAGE_VIEW_TYPE_2D, data.format, VK_IMAGE_ASPECT_COLOR_BIT, &mImgView, 1, mipLevels);
     //sampler
-    VkHelper::createImageSampler(device, &mSampler);
-
-    return false;
+    VkHelper::createImageSampler(device, &mSampler, (float) mipLevels);
 }
 
-void Texture::destroy(VkDevice device) {
+void Texture::destroy(VkDevice device, VkMemoryAllocator *allocator) {
     vkDestroySampler(device, mSampler, VK_ALLOC);
+    mSampler = VK_NULL_HANDLE;
     vkDestroyImageView(device, mImgView, VK_ALLOC);
-    vkDestroyImage(device, mImage, VK_ALLOC);
-    vkFreeMemory(device, mMemory, VK_ALLOC);
+    mImgView = VK_NULL_HANDLE;
+    VkHelper::destroyImage(allocator, device, &mImage, &mAllocation);
 }
@@ -1,21 +1,47 @@
 #pragma once
 
-#include <android/asset_manager.h>
+#include <memory>
+#include <vector>
+#include "../AssetSource.h"
 #include "vulkan_wrapper.h"
+#include "VkMemoryAllocator.h"
+#include "UploadBatch.h"
+
+// CPU side of a texture, the levels point into the mapped asset (KTX2) or the decoded pixels (PNG/JPEG)
+struct TextureData {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::vector<ImageLevelData> levels;
+    std::unique_ptr<Asset> asset;
+    unsigned char *pixels = nullptr;
+
+    TextureData() = default;
+    TextureData(const TextureData&) = delete;
+    TextureData& operator=(const TextureData&) = delete;
+    ~TextureData() { release(); };
+    void release();
+    VkDeviceSize byteSize() const;
+};
 
 class Texture {
 public:
-    bool load(AAssetManager *assetManager, VkDevice device, VkPhysicalDeviceMemoryProperties physicalMemoType, VkCommandPool cmdPool, VkQueue queue, const char *fileName);
-    void destroy(VkDevice device);
+    bool load(const AssetSource *assets, VkDevice device, VkMemoryAllocator *allocator, UploadBatch *batch, const char *fileName);
+    // KTX2 payloads are used as stored, anything else is decoded to RGBA8 with stb_image. safe off the render thread
+    static void decode(const AssetSource *assets, const char *fileName, TextureData *out_data);
+    // records the upload of every level into an OPTIMAL image, data must stay alive until the call returns
+    void create(VkDevice device, VkMemoryAllocator *allocator, UploadBatch *batch, const TextureData &data);
+    void destroy(VkDevice device, VkMemoryAllocator *allocator);
     VkImage getImg() { return mImage; };
     VkImageView getImgView() { return mImgView; };
     VkSampler getSampler(){ return mSampler; };
+    uint32_t getWidth() const { return width; };
+    uint32_t getHeight() const { return height; };
+    uint32_t getMipLevels() const { return mipLevels; };
 private:
-    int width, height;
-    int channels;
-    VkImage mImage;
-    VkDeviceMemory mMemory;
+    uint32_t width = 0, height = 0;
+    uint32_t mipLevels = 0;
+    VkImage mImage = VK_NULL_HANDLE;
+    VkAllocation mAllocation;
 
-    VkImageView mImgView;
-    VkSampler mSampler;
-};
\ No newline at end of file
+    VkImageView mImgView = VK_NULL_HANDLE;
+    VkSampler mSampler = VK_NULL_HANDLE;
+};
@@ -0,0 +1,132 @@
+#include "TextureStreamer.h"
+#include <pthread.h>
+#include <sstream>
+#include "VkHelper.h"
+#include "../ProfileTrace.h"
+#include "../ThreadManager.h"
+
+TextureStreamer::TextureStreamer(VkBundle *vk, const AssetSource *assets, uint32_t workerCount,
+                                 VkDeviceSize stagingCapacity, VkDeviceSize uploadBytesPerUpdate)
+        : mVk(vk), mAssets(assets), mBatch(vk, stagingCapacity), mStagingCapacity(stagingCapacity),
+          mUploadBytesPerUpdate(uploadBytesPerUpdate) {
+    for(uint32_t i = 0; i < std::max(workerCount, 1u); i++){
+        mWorkers.emplace_back(&TextureStreamer::workerLoop, this, i);
+    }
+    LOG_D("TextureStreamer: %zu workers, %lu bytes staging", mWorkers.size(), (unsigned long) stagingCapacity);
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        bStop = true;
+    }
+    mCond.notify_all();
+    for(auto &worker : mWorkers){
+        worker.join();
+    }
+    mBatch.flush();
+    for(auto &handle : mTextures){
+        handle->texture.destroy(mVk->deviceInfo.device, mVk->allocator);
+    }
+}
+
+TextureHandle TextureStreamer::load(const char *fileName) {
+    auto handle = std::make_shared<StreamedTexture>();
+    handle->fileName = fileName;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDecodeQueue.push_back(handle);
+    }
+    mCond.notify_one();
+    return handle;
+}
+
+void TextureStreamer::update() {
+    uint64_t completedSerial = mBatch.getCompletedSerial();
+    while(!mUploading.empty() && mUploading.front()->uploadSerial <= completedSerial){
+        mUploading.front()->state.store(TextureState::READY, std::memory_order_release);
+        mUploading.pop_front();
+    }
+
+    // the budget bounds the memcpy into the staging ring, one texture may overshoot it
+    VkDeviceSize uploadedBytes = 0;
+    std::vector<TextureHandle> recorded;
+    while(uploadedBytes < mUploadBytesPerUpdate){
+        TextureHandle handle;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(mDecodedQueue.empty()){
+                break;
+            }
+            handle = mDecodedQueue.front();
+            mDecodedQueue.pop_front();
+        }
+        TRACE_BEGIN("UploadTexture");
+        uploadedBytes += handle->data.byteSize();
+        handle->texture.create(mVk->deviceInfo.device, mVk->allocator, &mBatch, handle->data);
+        handle->data.release();
+        handle->state.store(TextureState::UPLOADING, std::memory_order_release);
+        mTextures.push_back(handle);
+        recorded.push_back(handle);
+        TRACE_END("UploadTexture");
+    }
+    if(recorded.empty()){
+        return;
+    }
+    mBatch.submit();
+    for(auto &handle : recorded){
+        handle->uploadSerial = mBatch.getLastSubmitSerial();
+        mUploading.push_back(handle);
+    }
+}
+
+void TextureStreamer::workerLoop(uint32_t workerIndex) {
+    std::string threadName = "TexStream-" + std::to_string(workerIndex);
+    pthread_setname_np(pthread_self(), threadName.c_str());
+    ThreadManager::get().place(ThreadRole::UPLOAD, threadName.c_str());
+    while(true){
+        TextureHandle handle;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCond.wait(lock, [this]{ return bStop || !mDecodeQueue.empty(); });
+            if(bStop){
+                return;
+            }
+            handle = mDecodeQueue.front();
+            mDecodeQueue.pop_front();
+        }
+        decode(handle);
+    }
+}
+
+void TextureStreamer::decode(const TextureHandle &handle) {
+    TRACE_BEGIN("DecodeTexture");
+    uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+    try{
+        Texture::decode(mAssets, handle->fileName.c_str(), &handle->data);
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(mVk->deviceInfo.physicalDev, handle->data.format, &formatProperties);
+        if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)){
+            std::stringstream ss;
+            ss << "format " << handle->data.format << " can not be sampled on this device";
+            throw std::runtime_error(ss.str());
+        }
+        // checked here so update() never fails halfway through recording a texture
+        for(const auto &level : handle->data.levels){
+            if(level.size > mStagingCapacity){
+                throw std::runtime_error("a mip level exceeds the staging capacity");
+            }
+        }
+    } catch (const std::runtime_error &e) {
+        LOG_E("TextureStreamer: %s failed, %s", handle->fileName.c_str(), e.what());
+        handle->data.release();
+        handle->state.store(TextureState::FAILED, std::memory_order_release);
+        TRACE_END("DecodeTexture");
+        return;
+    }
+    LOG_D("TextureStreamer: %s decoded, %ux%u, %zu levels, %.3f ms", handle->fileName.c_str(), handle->data.levels[0].width,
+          handle->data.levels[0].height, handle->data.levels.size(), (getTimeNano(CLOCK_MONOTONIC) - startTimeNs) * 1.f / U_TIME_1MS_IN_NS);
+    TRACE_END("DecodeTexture");
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDecodedQueue.push_back(handle);
+}
@@ -0,0 +1,77 @@
+/*!
+ * @brief  Asynchronous texture loading, decode on worker threads and upload through a shared staging ring
+ * @date 2023/8/9
+ */
+#ifndef CAMERA2VK_TEXTURESTREAMER_H
+#define CAMERA2VK_TEXTURESTREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../AssetSource.h"
+#include "VkBundle.h"
+#include "Texture.h"
+#include "UploadBatch.h"
+
+enum class TextureState{
+    LOADING,
+    UPLOADING,
+    READY,
+    FAILED
+};
+
+struct StreamedTexture{
+    std::string fileName;
+    std::atomic<TextureState> state{TextureState::LOADING};
+    Texture texture;                // valid once state is READY
+    TextureData data;               // owned by the streamer until the upload is recorded
+    uint64_t uploadSerial = 0;
+
+    bool isReady() const { return state.load(std::memory_order_acquire) == TextureState::READY; };
+};
+
+typedef std::shared_ptr<StreamedTexture> TextureHandle;
+
+/**
+ * load() only queues the file, workers map the asset and parse KTX2 or decode PNG/JPEG, update() on the render
+ * thread records the uploads within a byte budget and flips the handles to READY once their submit has retired.
+ * Nothing here waits on the GPU. The streamer must outlive the handles it returned.
+ */
+class TextureStreamer{
+public:
+    TextureStreamer(VkBundle *vk, const AssetSource *assets, uint32_t workerCount,
+                    VkDeviceSize stagingCapacity = 32 * 1024 * 1024, VkDeviceSize uploadBytesPerUpdate = 8 * 1024 * 1024);
+    ~TextureStreamer();
+
+    TextureHandle load(const char *fileName);
+    // render thread only
+    void update();
+
+private:
+    void workerLoop(uint32_t workerIndex);
+    void decode(const TextureHandle &handle);
+
+    VkBundle *mVk;
+    const AssetSource *mAssets;
+    UploadBatch mBatch;
+    VkDeviceSize mStagingCapacity;
+    VkDeviceSize mUploadBytesPerUpdate;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    bool bStop = false;
+    std::deque<TextureHandle> mDecodeQueue;
+    std::deque<TextureHandle> mDecodedQueue;
+
+    // render thread only
+    std::deque<TextureHandle> mUploading;
+    std::vector<TextureHandle> mTextures;
+};
+
+#endif //CAMERA2VK_TEXTURESTREAMER_H
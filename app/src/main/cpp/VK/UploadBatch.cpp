@@ -0,0 +1,191 @@
+#include "UploadBatch.h"
+#include "VkHelper.h"
+#include "../ProfileTrace.h"
+
+static const VkDeviceSize STAGING_BUFFER_ALIGNMENT = 16;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+    return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+}
+
+UploadBatch::UploadBatch(VkBundle *vk, VkDeviceSize stagingCapacity) : mVk(vk), mCapacity(stagingCapacity) {
+    VkHelper::createBufferInternal(mVk->allocator, mVk->deviceInfo.device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   AllocationUsage::RESOURCE, mCapacity, &mStagingBuffer, &mStagingAllocation);
+}
+
+UploadBatch::~UploadBatch() {
+    wait();
+    if(mCmdBuffer != VK_NULL_HANDLE){
+        LOG_W("UploadBatch: %u recorded uploads were never submitted.", mRecordedCount);
+        vkEndCommandBuffer(mCmdBuffer);
+        vkFreeCommandBuffers(mVk->deviceInfo.device, mVk->cmdPool, 1, &mCmdBuffer);
+        mCmdBuffer = VK_NULL_HANDLE;
+    }
+    VkHelper::destroyBuffer(mVk->allocator, mVk->deviceInfo.device, &mStagingBuffer, &mStagingAllocation);
+}
+
+VkCommandBuffer UploadBatch::getCommandBuffer() {
+    if(mCmdBuffer == VK_NULL_HANDLE){
+        VkHelper::allocateCommandBuffers(mVk->deviceInfo.device, mVk->cmdPool, 1, &mCmdBuffer);
+        VkHelper::beginCommandBuffer(mCmdBuffer, true);
+    }
+    return mCmdBuffer;
+}
+
+void UploadBatch::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+    VkDeviceSize stagingOffset = allocateStaging(size, STAGING_BUFFER_ALIGNMENT);
+    memcpy(static_cast<uint8_t *>(mStagingAllocation.mapped) + stagingOffset, data, (size_t) size);
+
+    VkBufferCopy copyRegion = {
+            .srcOffset = stagingOffset,
+            .dstOffset = dstOffset,
+            .size = size
+    };
+    vkCmdCopyBuffer(getCommandBuffer(), mStagingBuffer, dstBuffer, 1, &copyRegion);
+    mRecordedCount++;
+}
+
+void UploadBatch::uploadImage(VkImage dstImage, uint32_t width, uint32_t height, const void *data, VkDeviceSize size,
+                              VkImageLayout oldLayout, VkImageLayout finalLayout) {
+    ImageLevelData level = {width, height, data, size};
+    uploadImageLevels(dstImage, &level, 1, oldLayout, finalLayout);
+}
+
+void UploadBatch::uploadImageLevels(VkImage dstImage, const ImageLevelData *levels, uint32_t levelCount,
+                                    VkImageLayout oldLayout, VkImageLayout finalLayout) {
+    // 16 covers the texel block size of the ETC2, ASTC and BC formats as well
+    VkDeviceSize alignment = std::max(mVk->deviceInfo.physicalDevLimits.optimalBufferCopyOffsetAlignment, STAGING_BUFFER_ALIGNMENT);
+    VkHelper::transition_image_layout(dstImage, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, getCommandBuffer(), 0, 1, levelCount);
+    for(uint32_t i = 0; i < levelCount; i++){
+        // a full ring submits the open batch, so fetch the command buffer after the staging space
+        VkDeviceSize stagingOffset = allocateStaging(levels[i].size, alignment);
+        memcpy(static_cast<uint8_t *>(mStagingAllocation.mapped) + stagingOffset, levels[i].data, (size_t) levels[i].size);
+        VkBufferImageCopy region = {
+                .bufferOffset = stagingOffset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .mipLevel = i,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1
+                },
+                .imageOffset = {0, 0, 0},
+                .imageExtent = {levels[i].width, levels[i].height, 1}
+        };
+        vkCmdCopyBufferToImage(getCommandBuffer(), mStagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+    VkHelper::transition_image_layout(dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout, getCommandBuffer(), 0, 1, levelCount);
+    mRecordedCount++;
+}
+
+VkFence UploadBatch::submit() {
+    if(mCmdBuffer == VK_NULL_HANDLE){
+        return VK_NULL_HANDLE;
+    }
+    TRACE_BEGIN("UploadBatch submit:%u", mRecordedCount);
+    // make the transfer writes visible to every consumer, buffers don't get per-resource barriers
+    VkMemoryBarrier memoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+    };
+    vkCmdPipelineBarrier(mCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    CALL_VK(vkEndCommandBuffer(mCmdBuffer));
+
+    VkFenceCreateInfo fenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0
+    };
+    VkFence fence;
+    CALL_VK(vkCreateFence(mVk->deviceInfo.device, &fenceCreateInfo, VK_ALLOC, &fence));
+    VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &mCmdBuffer
+    };
+    CALL_VK(vkQueueSubmit(mVk->queueInfo.queue, 1, &submitInfo, fence));
+    LOG_D("UploadBatch: submitted %u uploads, %lu staging bytes", mRecordedCount, (unsigned long) mBatchBytes);
+
+    mPending.push_back({mCmdBuffer, fence, mBatchBytes, ++mSubmitSerial});
+    mCmdBuffer = VK_NULL_HANDLE;
+    mRecordedCount = 0;
+    mBatchBytes = 0;
+    TRACE_END("UploadBatch submit");
+    return fence;
+}
+
+void UploadBatch::wait() {
+    if(mPending.empty()){
+        return;
+    }
+    TRACE_BEGIN("UploadBatch wait:%zu", mPending.size());
+    while(!mPending.empty()){
+        retire(true);
+    }
+    TRACE_END("UploadBatch wait");
+}
+
+void UploadBatch::flush() {
+    submit();
+    wait();
+}
+
+uint64_t UploadBatch::getCompletedSerial() {
+    retire(false);
+    return mCompletedSerial;
+}
+
+VkDeviceSize UploadBatch::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+    if(size > mCapacity){
+        std::stringstream ss;
+        ss << "UploadBatch: upload of " << size << " bytes exceeds the staging capacity " << mCapacity;
+        throw std::runtime_error(ss.str());
+    }
+    while(true){
+        retire(false);
+        VkDeviceSize offset = alignUp(mHead, alignment);
+        VkDeviceSize needed = offset + size - mHead;
+        if(offset + size > mCapacity){
+            // not enough room before the end, skip the tail and wrap around
+            offset = 0;
+            needed = mCapacity - mHead + size;
+        }
+        if(mUsedBytes + needed <= mCapacity){
+            mHead = offset + size;
+            mUsedBytes += needed;
+            mBatchBytes += needed;
+            return offset;
+        }
+        if(mPending.empty()){
+            // the open batch alone fills the ring, push it out and wait for it
+            submit();
+        }
+        retire(true);
+    }
+}
+
+void UploadBatch::retire(bool bWaitOldest) {
+    while(!mPending.empty()){
+        PendingSubmit &pending = mPending.front();
+        if(bWaitOldest){
+            CALL_VK(vkWaitForFences(mVk->deviceInfo.device, 1, &pending.fence, VK_TRUE, UINT64_MAX));
+            bWaitOldest = false;
+        } else if(vkGetFenceStatus(mVk->deviceInfo.device, pending.fence) != VK_SUCCESS){
+            break;
+        }
+        vkDestroyFence(mVk->deviceInfo.device, pending.fence, VK_ALLOC);
+        vkFreeCommandBuffers(mVk->deviceInfo.device, mVk->cmdPool, 1, &pending.cmdBuffer);
+        mUsedBytes -= pending.stagingBytes;
+        mCompletedSerial = pending.serial;
+        mPending.pop_front();
+    }
+    if(mUsedBytes == 0){
+        mHead = 0;
+    }
+}
@@ -0,0 +1,74 @@
+/*!
+ * @brief  Batches staging uploads into one command buffer and one fence
+ * @date 2023/8/3
+ */
+#ifndef CAMERA2VK_UPLOADBATCH_H
+#define CAMERA2VK_UPLOADBATCH_H
+
+#include <deque>
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+#include "VkMemoryAllocator.h"
+
+// one tightly packed mip level, compressed formats use the texel extent of the level
+struct ImageLevelData{
+    uint32_t width;
+    uint32_t height;
+    const void *data;
+    VkDeviceSize size;
+};
+
+/**
+ * Uploads are copied into a persistently mapped staging ring and recorded into a single command buffer.
+ * submit() hands the recorded work to the queue with a fence, the ring space is reclaimed once that fence
+ * signals, so many resources cost one GPU round trip instead of one each.
+ */
+class UploadBatch{
+public:
+    UploadBatch(VkBundle *vk, VkDeviceSize stagingCapacity = 16 * 1024 * 1024);
+    ~UploadBatch();
+
+    void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+    // whole mip 0 of a 2D color image, the image ends up in finalLayout
+    void uploadImage(VkImage dstImage, uint32_t width, uint32_t height, const void *data, VkDeviceSize size,
+                     VkImageLayout oldLayout, VkImageLayout finalLayout);
+    // mip levels 0 to levelCount - 1 of a 2D color image
+    void uploadImageLevels(VkImage dstImage, const ImageLevelData *levels, uint32_t levelCount,
+                           VkImageLayout oldLayout, VkImageLayout finalLayout);
+    // command buffer of the open batch, for layout transitions that should ride along with the uploads
+    VkCommandBuffer getCommandBuffer();
+
+    VkFence submit();
+    void wait();
+    void flush();
+    // every submit gets a serial, work up to getCompletedSerial() is done on the GPU. never blocks
+    uint64_t getLastSubmitSerial() const { return mSubmitSerial; };
+    uint64_t getCompletedSerial();
+
+private:
+    struct PendingSubmit{
+        VkCommandBuffer cmdBuffer;
+        VkFence fence;
+        VkDeviceSize stagingBytes;
+        uint64_t serial;
+    };
+
+    VkDeviceSize allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+    void retire(bool bWaitOldest);
+
+    VkBundle *mVk;
+    VkBuffer mStagingBuffer = VK_NULL_HANDLE;
+    VkAllocation mStagingAllocation;
+    VkDeviceSize mCapacity;
+    VkDeviceSize mHead = 0;             // next free byte of the ring
+    VkDeviceSize mUsedBytes = 0;        // bytes not yet reclaimed, including wrap padding
+    VkDeviceSize mBatchBytes = 0;       // bytes consumed by the open batch
+
+    VkCommandBuffer mCmdBuffer = VK_NULL_HANDLE;
+    uint32_t mRecordedCount = 0;
+    std::deque<PendingSubmit> mPending;
+    uint64_t mSubmitSerial = 0;
+    uint64_t mCompletedSerial = 0;
+};
+
+#endif //CAMERA2VK_UPLOADBATCH_H
@@ -1,321 +1,624 @@
 #include "VKRenderer.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <string>
-#include <android/choreographer.h>
 #include "../Common.h"
-#include "../Camera/AndroidCameraPermission.h"
+#include "../InitTaskGraph.h"
 #include "../ProfileTrace.h"
 #include "vulkan_wrapper.h"
 #include "VkHelper.h"
+#include "VkBenchmark.h"
+#ifdef __ANDROID__
+#include <android_native_app_glue.h>
+#include <sys/system_properties.h>
+#include "ImageReaderFrameSource.h"
+#endif
 
-const int64_t gFramePeriodNs = (int64_t)(1e9 / 90);  //90FPS
-const float gTimeWarpWaitFramePercentage = 0.5f;
-const bool gTimeWarpDelayBetweenEyes = false;
-const int gWarpMeshType = 2; //0 = Columns (Left To Right); 1 = Columns (Right To Left); 2 = Rows (Top To Bottom); 3 = Rows (Bottom To Top)
 const bool gRenderVst = true;
+const uint32_t gRecordWorkerCount = 2;   // secondary command buffer recording threads, 1 to 4
+const uint32_t gTextureStreamWorkerCount = 2;   // texture decode threads
+const bool gOverlayDemoLayer = false;   // a streamed texture quad over each eye, exercises the layer compositor
+const bool gUseMultiview = true;         // single pass stereo, headless or where the target is not single buffered
+const bool gYcbcrSampling = true;        // one NV12 image per eye sampled through a YCbCr conversion when supported
+const bool gHostCameraUpload = true;     // camera planes written from the CPU, no staging copy, when supported
+const bool gTransferQueueUpload = true;  // staged camera copies on a transfer queue family of their own when there is one
+const bool gFp16Shading = true;          // half precision camera shading when the device has shaderFloat16
+const bool gFoveatedRendering = false;   // multi resolution per eye path, takes precedence over multiview
+const uint32_t gInitWorkerCount = 3;     // startup task graph threads, the calling thread included
+const uint32_t gEyeTimerAreasPerPass = 2;   // sub areas a per eye pass draws at most
+const uint64_t gRecordFrameInterval = 30;   // frames between recorded camera frames, so they differ
+const uint64_t gCameraFormatWaitNs = 1000 * U_TIME_1MS_IN_NS;   // for the first camera frame, then JFIF is assumed
+const uint64_t gCameraFormatPollNs = 5 * U_TIME_1MS_IN_NS;
+const FoveationConfig gFoveationConfig = {
+        .fovealWidth = 0.5f,
+        .fovealHeight = 0.5f,
+        .peripheryScale = 0.5f
+};
 
-static uint64_t gLastVsyncTimeNs = 0;
-static void VsyncCallback(long frameTimeNanos, void* data) {
-    gLastVsyncTimeNs = frameTimeNanos;
-}
+void VKRenderer::Init(struct android_app *app) {
+    AttachApp(app);
+    bHeadless = false;
+#ifdef RENDER_USE_SINGLE_BUFFER
+    // one pass presents both eyes at once, the per eye passes race the raster a half frame each
+    bMultiview = false;
+#endif
+#ifdef __ANDROID__
+    char value[PROP_VALUE_MAX] = {0};
+    if(__system_property_get("debug.camera2vk.record_frames", value) > 0){
+        mRecordFrameCount = std::min<uint32_t>(strtoul(value, nullptr, 10), RECORDED_FRAME_MAX);
+    }
+#endif
 
-std::vector<char> VKRenderer::ReadFileFromAndroidRes(const std::string& filePath) {
-    AAsset* file = AAssetManager_open(mApp->activity->assetManager, filePath.c_str(), AASSET_MODE_BUFFER);
-    size_t fileLength = AAsset_getLength(file);
+    RunInitGraph();
+    bRunning = true;
+}
 
-    std::vector<char> buffer(fileLength);
+void VKRenderer::InitHeadless(struct android_app *app, uint32_t width, uint32_t height) {
+    AttachApp(app);
+    bHeadless = true;
+    mCameraFrames = &mSyntheticFrames;
+    mOffscreenExtent = {width, height};
 
-    AAsset_read(file, buffer.data(), fileLength);
-    AAsset_close(file);
+    RunInitGraph();
+    bRunning = true;
+}
 
-    return buffer;
+void VKRenderer::RunInitGraph() {
+    BeginInit();
+    InitTaskGraph graph(gInitWorkerCount);
+    // CreateDescriptors may still clear bYcbcrSampling and bFp16Shading while the shaders are read
+    bool bYcbcrRequested = bYcbcrSampling && gYcbcrSampling;
+    // the cameras only have to stream by the first frame, except for the immutable YCbCr conversion,
+    // which is built for the format of the first camera frame
+    InitTaskId cameraFormat = INVALID_INIT_TASK;
+    if(!bHeadless){
+        InitTaskId cameras = graph.add("OpenCameras", [this]{ OpenCameraSource(); });
+        if(bYcbcrRequested){
+            cameraFormat = graph.add("ReadCameraFormat", [this]{ ReadCameraFormat(); }, {cameras});
+        }
+    }
+    InitTaskId device = graph.add("CreateDevice", [this]{ CreateDevice(); });
+    bool bFp16Requested = bFp16Shading && gFp16Shading;
+    InitTaskId shaders = graph.add("ReadShaders", [this, bYcbcrRequested, bFp16Requested]{
+        ReadShaders(bYcbcrRequested, bFp16Requested);
+    });
+    InitTaskId meshes = graph.add("GenerateGeometry", [this]{ GenerateGeometry(); });
+    InitTaskId targets = graph.add("CreateTargets", [this]{ CreateTargets(); }, {device});
+    // the frame ring allocates from the shared command pool, nothing else does before InitResources
+    InitTaskId descriptors = graph.add("CreateDescriptors", [this]{ CreateDescriptors(); }, {device, cameraFormat});
+    InitTaskId streamer = graph.add("CreateTextureStreamer", [this]{ CreateTextureStreamer(); }, {device});
+    graph.add("CreatePipeline", [this]{ CreatePipeline(); }, {targets, descriptors, shaders});
+    InitTaskId passes = graph.add("CreatePasses", [this]{ CreatePasses(); }, {targets, descriptors, shaders});
+    graph.add("InitResources", [this]{ InitResources(); }, {passes, meshes, streamer});
+    graph.run();
+    mShaderCode.clear();
+    EndInit();
+    graph.printTimeline(mStartupTimes.launchNs);
 }
 
-void VKRenderer::Init(struct android_app *app) {
-    mApp = app;
+void VKRenderer::ReadCameraFormat() {
+    // no frame can render before the camera delivers one, so this barely moves the first frame
+    uint64_t deadlineNs = getTimeNano(CLOCK_MONOTONIC) + gCameraFormatWaitNs;
+    CameraFrame frame;
+    while(!mCameraFrames->acquire(0, &frame)){
+        if(getTimeNano(CLOCK_MONOTONIC) > deadlineNs){
+            LOG_W("no camera frame within %lu ms, the YCbCr conversion assumes JFIF NV21.",
+                  (unsigned long)(gCameraFormatWaitNs / U_TIME_1MS_IN_NS));
+            return;
+        }
+        NanoSleep(gCameraFormatPollNs);
+    }
+    mCameraFormat = frame.format;
+    LOG_D("camera format: %s, model %u, range %u", mCameraFormat.chromaOrder == ChromaOrder::NV21 ? "NV21" : "NV12",
+          (uint32_t)mCameraFormat.colorModel, (uint32_t)mCameraFormat.colorRange);
+}
 
+void VKRenderer::OpenCameraSource() {
     OpenCameras();
-    InitVKEnv();
-    mImageLeft = new VkCameraImageV2(&mVk);
-    mImageRight = new VkCameraImageV2(&mVk);
-    bRunning = true;
+#ifdef __ANDROID__
+    // a host build has no cameras, OpenCameras throws there
+    mCameraFrames = new ImageReaderFrameSource(mImageReaderLeft, mImageReaderRight);
+#endif
+}
+
+void VKRenderer::CloseCameraSource() {
+    SAFE_DELETE(mCameraFrames);
+    CloseCameras();
+}
+
+void VKRenderer::InitResources() {
+    {
+        // every init upload goes through one batch, so init costs a single GPU round trip
+        UploadBatch uploadBatch(&mVk);
+        UploadGeometry(&uploadBatch);
+        mCameraUploadMode = VkCameraImageV2::resolveUploadMode(&mVk, gHostCameraUpload ? mCameraUploadMode : CameraUploadMode::STAGING,
+                                                               mMultiviewPass != nullptr, bYcbcrSampling);
+        // the camera planes of a frame in flight are not touched until its context comes around again
+        uint32_t uploadSlots = mFrameRing->getDepth();
+        // the host modes have no copy to move off the graphics queue
+        if(gTransferQueueUpload && mCameraUploadMode == CameraUploadMode::STAGING && mVk.queueInfo.transferQueue != VK_NULL_HANDLE){
+            mTransferQueue = new VkTransferQueue(&mVk, uploadSlots);
+        }
+        LOG_D("camera upload: %s%s", VkCameraImageV2::uploadModeName(mCameraUploadMode), mTransferQueue != nullptr ? " on the transfer queue" : "");
+        if(mMultiviewPass != nullptr){
+            mImageLeft = new VkCameraImageV2(&mVk, &uploadBatch, true, mYcbcrConversion, mYcbcrSampler, mCameraUploadMode, uploadSlots);
+        } else {
+            mImageLeft = new VkCameraImageV2(&mVk, &uploadBatch, false, mYcbcrConversion, mYcbcrSampler, mCameraUploadMode, uploadSlots);
+            mImageRight = new VkCameraImageV2(&mVk, &uploadBatch, false, mYcbcrConversion, mYcbcrSampler, mCameraUploadMode, uploadSlots);
+        }
+        mCompositor = new VkLayerCompositor(&mVk, &uploadBatch, ShaderCode("shaders/overlay_layer.vert.spv"),
+                                            ShaderCode("shaders/overlay_layer.frag.spv"), mFrameRing->getSlotCount(),
+                                            bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        uploadBatch.flush();
+    }
+    mVk.allocator->printStats();
+    mGraphicsTimer = new VkQueueTimer(&mVk, mVk.queueInfo.workQueueIndex, mFrameRing->getDepth(), "Graphics");
+    if(mMultiviewPass == nullptr){
+        uint32_t eyeTimerSlots = mFrameRing->getDepth() * mVk.cmdBufferCount * gEyeTimerAreasPerPass;
+        mEyeTimer = new VkQueueTimer(&mVk, mVk.queueInfo.workQueueIndex, eyeTimerSlots, "Eye");
+        mEyeTimerEyes.assign(eyeTimerSlots, -1);
+    }
+
+    // from here on the frame graph owns the layouts of the camera planes and the targets
+    mImageLeft->registerResources(&mFrameGraph);
+    if(mImageRight != nullptr){
+        mImageRight->registerResources(&mFrameGraph);
+    }
+    for(uint32_t i = 0; i < mVk.swapchainImage.imageCount; i++){
+        mTargetResources.push_back(mFrameGraph.registerImage("Target", mVk.swapchainImage.images[i],
+                                                             { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, VK_IMAGE_LAYOUT_UNDEFINED));
+    }
+
+    if(gOverlayDemoLayer && mTextureStreamer != nullptr){
+        OverlayLayerDesc desc;
+        // a quarter of each eye, centered
+        desc.transforms[0] = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(-0.5f, 0.f, 0.f)), glm::vec3(0.125f, 0.25f, 1.f));
+        desc.transforms[1] = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.5f, 0.f, 0.f)), glm::vec3(0.125f, 0.25f, 1.f));
+        desc.color = glm::vec4(1.f, 1.f, 1.f, 0.8f);
+        desc.texture = mTextureStreamer->load("texture/awesomeface.png");
+        mCompositor->addLayer(desc);
+    }
 }
 
 void VKRenderer::Destroy() {
     bRunning = false;
+    mVsyncTimeline.stop();
+    // up to FRAME_RING_MAX_DEPTH frames may still read the camera images, staging buffers and transfer slots
+    vkDeviceWaitIdle(mVk.deviceInfo.device);
+    SAFE_DELETE(mTransferQueue);
     SAFE_DELETE(mImageLeft);
     SAFE_DELETE(mImageRight);
     DestroyVKEnv();
-    CloseCameras();
+    if(!bHeadless){
+        mLatency.printStats();
+        CloseCameraSource();
+    }
 }
 
-bool VKRenderer::IsRunning() {
-    return bRunning;
+void VKRenderer::SetSyntheticFrames(const CameraFrame &left, const CameraFrame &right) {
+    mSyntheticFrames.set(left, right);
+}
+
+bool VKRenderer::ReadTarget(std::vector<uint8_t> *out_pixels) {
+    if(!bHeadless){
+        LOG_E("ReadTarget: only offscreen targets can be read back.");
+        return false;
+    }
+    VkDevice device = mVk.deviceInfo.device;
+    CALL_VK(vkDeviceWaitIdle(device));
+    VkExtent2D extent = mVk.swapchainParam.extent;
+    VkDeviceSize size = extent.width * extent.height * 4;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkAllocation allocation;
+    VkHelper::createBufferInternal(mVk.allocator, device, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   AllocationUsage::DEDICATED, size, &buffer, &allocation);
+    VkCommandBuffer cmdBuffer;
+    VkHelper::allocateCommandBuffers(device, mVk.cmdPool, 1, &cmdBuffer);
+    VkHelper::beginCommandBuffer(cmdBuffer, true);
+    // every path leaves an offscreen target in TRANSFER_SRC_OPTIMAL at the end of the frame
+    VkBufferImageCopy region = {
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .imageOffset = { 0, 0, 0 },
+            .imageExtent = { extent.width, extent.height, 1 }
+    };
+    vkCmdCopyImageToBuffer(cmdBuffer, mVk.swapchainImage.images[mCurrentImageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           buffer, 1, &region);
+    VkHelper::endCommandBuffer(cmdBuffer, device, mVk.cmdPool, mVk.queueInfo.queue, true);
+    const uint8_t *pixels = static_cast<const uint8_t *>(allocation.mapped);
+    out_pixels->assign(pixels, pixels + size);
+    VkHelper::destroyBuffer(mVk.allocator, device, &buffer, &allocation);
+    return true;
 }
 
 void VKRenderer::ProcessFrame(uint64_t frameIndex) {
     TRACE_BEGIN("ProcessFrame:%lu", frameIndex);
-    AChoreographer *grapher = AChoreographer_getInstance();
-    AChoreographer_postFrameCallback(grapher, VsyncCallback, nullptr);
-    uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
-    mLastVsyncTimeNs = gLastVsyncTimeNs;
-    if (mLastVsyncTimeNs > startTimeNs) {
-        LOG_W("%lu: verify that the qvr timestamp is actually in the past...", startTimeNs);
-        mLastVsyncTimeNs = startTimeNs;
-    }
-    if ((startTimeNs - mLastVsyncTimeNs) > gFramePeriodNs) {
-        //We've managed to get here prior to the next vsync occuring so set it based on the previous (interrupt may have been delayed)
-        LOG_W("%lu:Adding frame period time (%0.2f) to vsync time, Last VSync was %0.4f ms ago!", frameIndex,
-              gFramePeriodNs * 1.f / U_TIME_1MS_IN_NS, (startTimeNs - mLastVsyncTimeNs) * 1.f / U_TIME_1MS_IN_NS);
-        mLastVsyncTimeNs = mLastVsyncTimeNs + gFramePeriodNs;
-    }
-    mVsyncCount++;
-    int64_t vsyncDiffTimeNs = startTimeNs - mLastVsyncTimeNs;
-    double framePct = (double)mVsyncCount + ((double)vsyncDiffTimeNs) / (gFramePeriodNs);
-    double fractFrame = framePct - ((long)framePct);
-
-    int64_t waitTimeNs = 0;
-    if (fractFrame < gTimeWarpWaitFramePercentage) {
-        //We are currently in the first half of the display so wait until we hit the halfway point
-        waitTimeNs = (int64_t)((gTimeWarpWaitFramePercentage - fractFrame) * gFramePeriodNs);
-    } else {
-        //We are currently past the halfway point in the display so wait until halfway through the next vsync cycle
-        waitTimeNs = (int64_t)((0.9 + gTimeWarpWaitFramePercentage - fractFrame) * gFramePeriodNs);
-        LOG_W("%lu: jank...", frameIndex);
-    }
-    LOG_D("%lu: Left EyeBuffer Wait : %.2f ms, Vsync diff : %.2f ms, Frame diff : %.2f ms, [%lu: %.2f, %.2f]", frameIndex, waitTimeNs * 1.f / U_TIME_1MS_IN_NS,
-          vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS, (startTimeNs - mLastFrameTime) * 1.f / U_TIME_1MS_IN_NS, mVsyncCount, framePct, fractFrame);
-    mLastFrameTime = startTimeNs;
-    TRACE_BEGIN("Left wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-    NanoSleep(waitTimeNs);
-    TRACE_END("Left wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-    uint64_t postLeftWaitTimeStamp = getTimeNano(CLOCK_MONOTONIC);
-
-    RenderMeshOrder gMeshOrderEnum = MeshOrderLeftToRight;
-    if (gWarpMeshType == 0) {
-        gMeshOrderEnum = MeshOrderLeftToRight;
-    } else if (gWarpMeshType == 1) {
-        gMeshOrderEnum = MeshOrderRightToLeft;
-    } else if (gWarpMeshType == 2) {
-        gMeshOrderEnum = MeshOrderTopToBottom;
-    } else if (gWarpMeshType == 3) {
-        gMeshOrderEnum = MeshOrderBottomToTop;
-    }
-
-    AImage *imageLeft = mImageReaderLeft->getLatestImage();
-    if(!imageLeft){
+    // offscreen frames are not paced against a display
+    uint64_t postLeftWaitTimeStamp = bHeadless ? getTimeNano(CLOCK_MONOTONIC) : WaitForFirstHalf(frameIndex);
+    RenderMeshOrder gMeshOrderEnum = MeshOrder();
+
+    CameraFrame frameLeft, frameRight;
+    if(!mCameraFrames->acquire(0, &frameLeft) || !mCameraFrames->acquire(1, &frameRight)){
+        TRACE_END("ProcessFrame:%lu", frameIndex);
         return;
     }
-    AImage *imageRight = mImageReaderRight->getLatestImage();
-    if(!imageRight){
-        return;
+    if(!bHeadless && mRecordedFrames < mRecordFrameCount && frameIndex % gRecordFrameInterval == 0){
+        // a debug aid, the write stalls this frame
+        VkBenchmark::recordFrame(mDataDir.c_str(), mRecordedFrames++, frameLeft);
+    }
+    if(!bHeadless){
+        // synthetic frames carry no sensor timestamps worth measuring against
+        uint64_t acquireNs = getTimeNano(CLOCK_MONOTONIC);
+        mLatency.cameraFrame(0, frameLeft.timestamp, acquireNs);
+        mLatency.cameraFrame(1, frameRight.timestamp, acquireNs);
     }
 
-    VkResult rt = vkAcquireNextImageKHR(mVk.deviceInfo.device, mVk.swapchain, std::numeric_limits<uint64_t>::max(), mVk.imageSemaphore, VK_NULL_HANDLE, &mCurrentImageIndex);
-    LOG_D("image index: %d", mCurrentImageIndex);
+    SelectCameraPipelines(frameLeft.format);
 
-    if(rt == VK_ERROR_OUT_OF_DATE_KHR){
-        LOG_E("swapchain was out of date.");
-        return;
+    mFrameStageTimes = FrameStageTimes{};
+    TRACE_BEGIN("Frame wait");
+    // the frame this context carried FramesInFlight frames ago has to be done, everything it owns is free again
+    FrameContext &frame = mFrameRing->begin();
+    mFrameStageTimes.frameWaitNs = mFrameRing->getLastWaitNs();
+    mFrameStageTimes.latencyNs = mFrameRing->getLastLatencyNs();
+    mFrameStageTimes.startNs = frame.startNs;
+    mFrameStageTimes.retiredStartNs = mFrameRing->getLastRetiredStartNs();
+    CollectQueueTimes();
+    TRACE_END("Frame wait");
+
+    uint64_t stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+    if(bHeadless){
+        mCurrentImageIndex = (mCurrentImageIndex + 1) % mVk.swapchainImage.imageCount;
+    } else {
+        VkResult rt = vkAcquireNextImageKHR(mVk.deviceInfo.device, mVk.swapchain, std::numeric_limits<uint64_t>::max(), frame.acquireSemaphore, VK_NULL_HANDLE, &mCurrentImageIndex);
+        LOG_D("image index: %d", mCurrentImageIndex);
+
+        if(rt == VK_ERROR_OUT_OF_DATE_KHR){
+            LOG_E("swapchain was out of date.");
+            // the frame is dropped, its camera times must not end up in the next one
+            mLatency.endFrame(FrameStageTimes{});
+            TRACE_END("ProcessFrame:%lu", frameIndex);
+            return;
+        }
+        frame.bAcquirePending = true;
     }
+    mFrameStageTimes.acquireNs = getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    // a freshly acquired image has no content worth keeping
+    mFrameGraph.resetImage(mTargetResources[mCurrentImageIndex], VK_IMAGE_LAYOUT_UNDEFINED);
 
     TRACE_BEGIN("UpdateDescriptorSets");
-    UpdateDescriptorSets(0, imageLeft);
-    UpdateDescriptorSets(1, imageRight);
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+    UploadCameraFrames(frameLeft, frameRight);
+    if(mTransferQueue != nullptr){
+        // the copies run while the GPU still renders the previous frame
+        SubmitTransferUploads();
+    }
+    UpdateDescriptorSets(0);
+    UpdateDescriptorSets(1);
+    if(mTextureStreamer != nullptr){
+        mTextureStreamer->update();
+    }
+    mCompositor->beginFrame();
+    mFrameStageTimes.uploadNs = getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    mLatency.markUploaded(stageStartNs + mFrameStageTimes.uploadNs);
     TRACE_END("UpdateDescriptorSets");
 
+    if(mMultiviewPass != nullptr){
+        // both eyes in one pass, there is no second half frame to race against the raster
+        TRACE_BEGIN("Stereo Render");
+        stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+        RenderMultiview();
+        mFrameStageTimes.renderNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+        stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+        if(!bHeadless){
+            PresentFrame(0);
+        }
+        mFrameStageTimes.presentNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+        mFrameStageTimes.totalNs = getTimeNano(CLOCK_MONOTONIC) - postLeftWaitTimeStamp;
+        if(!bHeadless){
+            mLatency.markPresented(getTimeNano(CLOCK_MONOTONIC));
+            mLatency.endFrame(mFrameStageTimes);
+        }
+        ReportFirstFrame();
+        TRACE_END("Stereo Render");
+        TRACE_END("ProcessFrame:%lu", frameIndex);
+        return;
+    }
+
     TRACE_BEGIN("First Render");
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
     switch (gMeshOrderEnum) {
         case MeshOrderLeftToRight:
-            RenderSubArea(imageLeft, MeshLeft);
+            RenderSubAreas(0, {MeshLeft});
             break;
 
         case MeshOrderRightToLeft:
-            RenderSubArea(imageRight, MeshRight);
+            RenderSubAreas(0, {MeshRight});
             break;
 
         case MeshOrderTopToBottom:
-            RenderSubArea(imageLeft, MeshUpperLeft);
-            RenderSubArea(imageRight, MeshUpperRight);
+            RenderSubAreas(0, {MeshUpperLeft, MeshUpperRight});
             break;
 
         case MeshOrderBottomToTop:
-            RenderSubArea(imageLeft, MeshLowerLeft);
-            RenderSubArea(imageRight, MeshLowerRight);
+            RenderSubAreas(0, {MeshLowerLeft, MeshLowerRight});
             break;
     }
+    mFrameStageTimes.renderNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
 #ifdef RENDER_USE_SINGLE_BUFFER
-    VkPresentInfoKHR presentInfo = {
-            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-            .pNext = nullptr,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &mVk.presentSemaphore,
-            .swapchainCount = 1,
-            .pSwapchains = &mVk.swapchain,
-            .pImageIndices = &mCurrentImageIndex,
-            .pResults = nullptr
-    };
-    CALL_VK(vkQueuePresentKHR(mVk.queueInfo.queue, &presentInfo));
+    if(!bHeadless){
+        stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+        PresentFrame(0);
+        mFrameStageTimes.presentNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    }
 #endif
     TRACE_END("First Render");
 
-    if (gTimeWarpDelayBetweenEyes) {
-        uint64_t rightTimestamp = getTimeNano(CLOCK_MONOTONIC);
-        //We started the left eye half way through vsync, figure out how long
-        //we have left in the half frame until the raster starts over so we can render the right eye
-        uint64_t delta = rightTimestamp - postLeftWaitTimeStamp;
-        uint64_t waitTimeNs = 0;
-        if (delta < ((uint64_t)(gFramePeriodNs / 2.0))) {
-            waitTimeNs = ((uint64_t)(gFramePeriodNs / 2.0)) - delta;
-            LOG_D("%lu: Right EyeBuffer Wait : %.2f ms, Left take : %.2f ms", frameIndex, waitTimeNs * 1.f / U_TIME_1MS_IN_NS, delta * 1.f / U_TIME_1MS_IN_NS);
-            TRACE_BEGIN("Right wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-            NanoSleep(waitTimeNs + gFramePeriodNs / 8);
-            TRACE_END("Right wait:%.1f:%.1f", waitTimeNs * 1.f / U_TIME_1MS_IN_NS, vsyncDiffTimeNs * 1.f / U_TIME_1MS_IN_NS);
-        } else {
-            //The left eye took longer than 1/2 the refresh so the raster has already wrapped around and is
-            //in the left half of the screen.  Skip the wait and get right on rendering the right eye.
-            LOG_D("Left Eye took too long!!! ( %.2f ms )", delta * 1.f / U_TIME_1MS_IN_NS);
-        }
+    if(!bHeadless){
+        WaitForSecondHalf(frameIndex, postLeftWaitTimeStamp);
     }
 
     TRACE_BEGIN("Second Render");
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
     switch (gMeshOrderEnum) {
         case MeshOrderLeftToRight:
-            RenderSubArea(imageRight, MeshRight);
+            RenderSubAreas(1, {MeshRight});
             break;
 
         case MeshOrderRightToLeft:
-            RenderSubArea(imageLeft, MeshLeft);
+            RenderSubAreas(1, {MeshLeft});
             break;
 
         case MeshOrderTopToBottom:
-            RenderSubArea(imageLeft, MeshLowerLeft);
-            RenderSubArea(imageRight, MeshLowerRight);
+            RenderSubAreas(1, {MeshLowerLeft, MeshLowerRight});
             break;
 
         case MeshOrderBottomToTop:
-            RenderSubArea(imageLeft, MeshUpperLeft);
-            RenderSubArea(imageRight, MeshUpperRight);
+            RenderSubAreas(1, {MeshUpperLeft, MeshUpperRight});
             break;
     }
-#ifdef RENDER_USE_SINGLE_BUFFER
-    CALL_VK(vkQueuePresentKHR(mVk.queueInfo.queue, &presentInfo));
-#else
-    VkPresentInfoKHR presentInfo = {
-            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-            .pNext = nullptr,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &mVk.presentSemaphore,
-            .swapchainCount = 1,
-            .pSwapchains = &mVk.swapchain,
-            .pImageIndices = &mCurrentImageIndex,
-            .pResults = nullptr
-    };
-    CALL_VK(vkQueuePresentKHR(mVk.queueInfo.queue, &presentInfo));
-    CALL_VK(vkQueueWaitIdle(mVk.queueInfo.queue));
-#endif
+    mFrameStageTimes.renderNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    stageStartNs = getTimeNano(CLOCK_MONOTONIC);
+    // nothing waits for the GPU here, the ring does once it comes back to this context
+    if(!bHeadless){
+        PresentFrame(1);
+    }
+    mFrameStageTimes.presentNs += getTimeNano(CLOCK_MONOTONIC) - stageStartNs;
+    mFrameStageTimes.totalNs = getTimeNano(CLOCK_MONOTONIC) - postLeftWaitTimeStamp;
+    if(!bHeadless){
+        mLatency.markPresented(getTimeNano(CLOCK_MONOTONIC));
+        mLatency.endFrame(mFrameStageTimes);
+    }
+    ReportFirstFrame();
     TRACE_END("Second Render");
     TRACE_END("ProcessFrame:%lu", frameIndex);
 }
 
-void VKRenderer::OpenCameras() {
-    if(!AndroidCameraPermission::isCameraPermitted(mApp)){
-        AndroidCameraPermission::requestCameraPermission(mApp);
-    }
-    mImageReaderLeft = new CameraImageReader(1920, 1440, AIMAGE_FORMAT_YUV_420_888, 4);
-    mCameraLeft = new CameraManager(mImageReaderLeft->getWindow(), 2);
-    mCameraLeft->startCapturing();
-
-    mImageReaderRight= new CameraImageReader(1920, 1440, AIMAGE_FORMAT_YUV_420_888, 4);
-    mCameraRight = new CameraManager(mImageReaderRight->getWindow(), 3);
-    mCameraRight->startCapturing();
-}
-
-void VKRenderer::CloseCameras() {
-    mCameraLeft->stopCapturing();
-    mCameraRight->stopCapturing();
-    SAFE_DELETE(mImageReaderLeft);
-    SAFE_DELETE(mImageReaderRight);
-    SAFE_DELETE(mCameraLeft);
-    SAFE_DELETE(mCameraRight);
-}
-
-int VKRenderer::InitVKEnv() {
+void VKRenderer::CreateDevice() {
     if(!InitVulkan()){
         throw std::runtime_error("Failed to init vulkan!");
     }
     VkHelper::createInstance(true, &mVk.instance, &mVk.debugReport);
-    CreateWindowSurface();
+    mVk.surface = VK_NULL_HANDLE;
+    if(!bHeadless){
+        CreateWindowSurface();
+    }
     VkHelper::pickPhyDevAndCreateDev(mVk.instance, mVk.surface, &mVk.deviceInfo, &mVk.queueInfo);
+    mVk.allocator = new VkMemoryAllocator(mVk.deviceInfo.device, mVk.deviceInfo.physicalDevMemoProps,
+                                          mVk.deviceInfo.physicalDevLimits.bufferImageGranularity);
     VkHelper::createCommandPool(mVk.deviceInfo.device, mVk.queueInfo.workQueueIndex, &mVk.cmdPool);
-    VkHelper::createSwapchain(mVk.deviceInfo.physicalDev, mVk.deviceInfo.device, mVk.surface, mVk.queueInfo.workQueueIndex, mVk.queueInfo.presentQueueIndex, &mVk.swapchainParam,&mVk.swapchain);
-    CALL_VK(vkGetSwapchainImagesKHR(mVk.deviceInfo.device, mVk.swapchain, &mVk.swapchainImage.imageCount, nullptr));
-    mVk.swapchainImage.images = static_cast<VkImage *>(malloc(sizeof(VkImage) * mVk.swapchainImage.imageCount));
-    CALL_VK(vkGetSwapchainImagesKHR(mVk.deviceInfo.device, mVk.swapchain, &mVk.swapchainImage.imageCount, mVk.swapchainImage.images));
-    mVk.swapchainImage.views = static_cast<VkImageView *>(malloc(sizeof(VkImageView) * mVk.swapchainImage.imageCount));
-    for(uint32_t i = 0; i < mVk.swapchainImage.imageCount; i++){
-        VkImageViewCreateInfo createInfo = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .pNext = nullptr,
-                .flags = 0,
-                .image = mVk.swapchainImage.images[i],
-                .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .format = mVk.swapchainParam.format.format,
-                .components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
-                .subresourceRange = {
-                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                        .baseMipLevel = 0,
-                        .levelCount = 1,
-                        .baseArrayLayer = 0,
-                        .layerCount = 1
-                }
-        };
-        CALL_VK(vkCreateImageView(mVk.deviceInfo.device, &createInfo, VK_ALLOC, &mVk.swapchainImage.views[i]));
+}
+
+void VKRenderer::CreateTargets() {
+    if(bHeadless){
+        CreateOffscreenTargets();
+    } else {
+        VkHelper::createSwapchain(mVk.deviceInfo.physicalDev, mVk.deviceInfo.device, mVk.surface, mVk.queueInfo.workQueueIndex, mVk.queueInfo.presentQueueIndex, &mVk.swapchainParam,&mVk.swapchain);
+        CALL_VK(vkGetSwapchainImagesKHR(mVk.deviceInfo.device, mVk.swapchain, &mVk.swapchainImage.imageCount, nullptr));
+        mVk.swapchainImage.images = static_cast<VkImage *>(malloc(sizeof(VkImage) * mVk.swapchainImage.imageCount));
+        CALL_VK(vkGetSwapchainImagesKHR(mVk.deviceInfo.device, mVk.swapchain, &mVk.swapchainImage.imageCount, mVk.swapchainImage.images));
+        mVk.swapchainImage.views = static_cast<VkImageView *>(malloc(sizeof(VkImageView) * mVk.swapchainImage.imageCount));
+        for(uint32_t i = 0; i < mVk.swapchainImage.imageCount; i++){
+            VkImageViewCreateInfo createInfo = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .image = mVk.swapchainImage.images[i],
+                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                    .format = mVk.swapchainParam.format.format,
+                    .components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
+                    .subresourceRange = {
+                            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                            .baseMipLevel = 0,
+                            .levelCount = 1,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1
+                    }
+            };
+            CALL_VK(vkCreateImageView(mVk.deviceInfo.device, &createInfo, VK_ALLOC, &mVk.swapchainImage.views[i]));
+        }
     }
-    VkHelper::createRenderPass(mVk.deviceInfo.device, mVk.swapchainParam, &mVk.renderPass);
+    VkHelper::createRenderPass(mVk.deviceInfo.device, mVk.swapchainParam, &mVk.renderPass,
+                               bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
     mVk.framebufferCount = mVk.swapchainImage.imageCount;
     mVk.framebuffers = static_cast<VkFramebuffer *>(malloc(sizeof(VkFramebuffer) * mVk.framebufferCount));
     VkHelper::createFramebuffer(mVk.deviceInfo.device, mVk.renderPass, mVk.swapchainParam.extent.width, mVk.swapchainParam.extent.height,
                                 mVk.framebufferCount, mVk.swapchainImage.views, mVk.framebuffers);
-    VkHelper::createDescriptorSetLayout(mVk.deviceInfo.device, nullptr, &mVk.descriptorSetLayout);
-    VkHelper::createDescriptorPool(mVk.deviceInfo.device, &mVk.descriptorPool);
-    mVk.descriptorSets = static_cast<VkDescriptorSet *>(malloc(sizeof(VkDescriptorSet) * 2));
-    VkHelper::allocateDescriptorSets(mVk.deviceInfo.device, mVk.descriptorPool, mVk.descriptorSetLayout, mVk.descriptorSets);
+}
+
+void VKRenderer::CreateDescriptors() {
+    // the conversion sampler is immutable, it has to exist before the set layout
+    bYcbcrSampling = bYcbcrSampling && gYcbcrSampling && VkCameraImageV2::isYcbcrSupported(&mVk, gUseMultiview && bMultiview);
+    if(bYcbcrSampling){
+        VkCameraImageV2::createYcbcrSampler(&mVk, mCameraFormat, &mYcbcrConversion, &mYcbcrSampler);
+    }
+    LOG_D("camera sampling: %s", bYcbcrSampling ? "YCbCr conversion" : "separate Y and UV planes");
+    // independent of the sampling, behind the conversion sampler only the output encoding runs in half precision
+    bFp16Shading = bFp16Shading && gFp16Shading && mVk.deviceInfo.features.shaderFloat16;
+    LOG_D("camera shading: %s", bFp16Shading ? "fp16" : "fp32");
+    VkHelper::createDescriptorSetLayout(mVk.deviceInfo.device, mYcbcrSampler, &mVk.descriptorSetLayout, bYcbcrSampling ? 1 : 2);
+    mFramesInFlight = std::min<uint32_t>(std::max<uint32_t>(mFramesInFlight, 1), FRAME_RING_MAX_DEPTH);
+    VkHelper::createDescriptorPool(mVk.deviceInfo.device, mFramesInFlight * 2, &mVk.descriptorPool);
     VkHelper::createPipelineLayout(mVk.deviceInfo.device, mVk.descriptorSetLayout, &mVk.pipelineLayout);
-    auto vertexShaderCode = ReadFileFromAndroidRes("shaders/demo001.vert.spv");
-    auto fragShaderCode = ReadFileFromAndroidRes("shaders/demo001.frag.spv");
-    mVk.vertexShaderModule = VkHelper::createShaderModule(mVk.deviceInfo.device, vertexShaderCode);
-    mVk.fragShaderModule = VkHelper::createShaderModule(mVk.deviceInfo.device, fragShaderCode);
-    VkHelper::createPipeline(mVk.deviceInfo.device, mVk.pipelineLayout, mVk.renderPass,
-                             mVk.vertexShaderModule, mVk.fragShaderModule, mVk.swapchainParam, &mVk.graphicPipeline);
+    // passes per frame, the command buffers, semaphores and descriptor sets live in the frame contexts
     mVk.cmdBufferCount = 2;
-    mVk.cmdBuffers = static_cast<VkCommandBuffer *>(malloc(sizeof(VkCommandBuffer) * mVk.cmdBufferCount));
-    VkHelper::allocateCommandBuffers(mVk.deviceInfo.device, mVk.cmdPool, mVk.cmdBufferCount, mVk.cmdBuffers);
+    mFrameRing = new VkFrameRing(&mVk, mFramesInFlight, mVk.cmdBufferCount);
+}
 
-    VkSemaphoreCreateInfo semaphoreCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0
+void VKRenderer::CreatePipeline() {
+    mVk.vertexShaderModule = VkHelper::createShaderModule(mVk.deviceInfo.device, ShaderCode("shaders/demo001.vert.spv"));
+    mVk.fragShaderModule = VkHelper::createShaderModule(mVk.deviceInfo.device, ShaderCode(CameraFragShader(false)));
+    mCameraPipelines = new VkPipelineVariants(&mVk, "Camera", [this](const VkSpecializationInfo *fragSpecialization, VkPipeline *out_pipeline){
+        VkHelper::createPipeline(mVk.deviceInfo.device, mVk.pipelineLayout, mVk.renderPass, mVk.vertexShaderModule, mVk.fragShaderModule,
+                                 mVk.swapchainParam, out_pipeline, false, fragSpecialization);
+    }, mCameraFormat);
+    mVk.graphicPipeline = mCameraPipelines->current();
+    if(!bYcbcrSampling){
+        // only the first frame tells the chroma order, the other one is ready by then
+        mCameraPipelines->prepare(OtherChromaOrder(mCameraFormat));
+    }
+}
+
+void VKRenderer::CreateTextureStreamer() {
+    mTextureStreamer = new TextureStreamer(&mVk, mAssets.get(), gTextureStreamWorkerCount);
+}
+
+void VKRenderer::CreatePasses() {
+    mRecorder = new VkCommandRecorder(&mVk, gRecordWorkerCount, mFrameRing->getSlotCount());
+    if(gFoveatedRendering && VkFoveatedPass::isSupported(&mVk, bHeadless)){
+        mFoveatedPass = new VkFoveatedPass(&mVk, gFoveationConfig, mFrameRing->getSlotCount(),
+                                           bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    } else if(gFoveatedRendering){
+        LOG_W("foveated rendering needs a transfer dst target, falling back to full resolution.");
+    }
+    if(mFoveatedPass == nullptr && gUseMultiview && bMultiview){
+        mMultiviewPass = new VkMultiviewPass(&mVk, ShaderCode("shaders/demo001_multiview.vert.spv"),
+                                             ShaderCode(CameraFragShader(true)), mCameraFormat);
+        if(!bYcbcrSampling){
+            mMultiviewPass->getPipelines()->prepare(OtherChromaOrder(mCameraFormat));
+        }
+    }
+    bMultiview = mMultiviewPass != nullptr;
+}
+
+CameraColorFormat VKRenderer::OtherChromaOrder(const CameraColorFormat &format) {
+    CameraColorFormat other = format;
+    other.chromaOrder = format.chromaOrder == ChromaOrder::NV21 ? ChromaOrder::NV12 : ChromaOrder::NV21;
+    return other;
+}
+
+void VKRenderer::SelectCameraPipelines(const CameraColorFormat &format) {
+    if(bYcbcrSampling){
+        // the conversion is baked into the immutable sampler of the set layout
+        if(format != mCameraFormat && !bCameraFormatWarned){
+            LOG_W("camera format differs from the one the YCbCr conversion was built for, colors will be off.");
+            bCameraFormatWarned = true;
+        }
+        return;
+    }
+    // a variant still compiling leaves the previous one in place for a few frames
+    mVk.graphicPipeline = mCameraPipelines->select(format);
+    if(mMultiviewPass != nullptr){
+        mMultiviewPass->selectFormat(format);
+    }
+}
+
+const char *VKRenderer::CameraFragShader(bool bMultiview) {
+    if(bYcbcrSampling && bFp16Shading){
+        return bMultiview ? "shaders/demo001_multiview_ycbcr_fp16.frag.spv" : "shaders/demo001_ycbcr_fp16.frag.spv";
+    }
+    if(bYcbcrSampling){
+        return bMultiview ? "shaders/demo001_multiview_ycbcr.frag.spv" : "shaders/demo001_ycbcr.frag.spv";
+    }
+    if(bFp16Shading){
+        return bMultiview ? "shaders/demo001_multiview_fp16.frag.spv" : "shaders/demo001_fp16.frag.spv";
+    }
+    return bMultiview ? "shaders/demo001_multiview.frag.spv" : "shaders/demo001.frag.spv";
+}
+
+void VKRenderer::ReadShaders(bool bYcbcrVariants, bool bFp16Variants) {
+    // every variant the device might pick, which one is only known once the device exists
+    std::vector<std::string> paths = {
+            "shaders/demo001.vert.spv",
+            "shaders/demo001.frag.spv",
+            "shaders/overlay_layer.vert.spv",
+            "shaders/overlay_layer.frag.spv",
     };
-    CALL_VK(vkCreateSemaphore(mVk.deviceInfo.device, &semaphoreCreateInfo, VK_ALLOC, &mVk.imageSemaphore));
-    CALL_VK(vkCreateSemaphore(mVk.deviceInfo.device, &semaphoreCreateInfo, VK_ALLOC, &mVk.presentSemaphore));
+    if(bYcbcrVariants){
+        paths.emplace_back("shaders/demo001_ycbcr.frag.spv");
+    }
+    if(bFp16Variants){
+        paths.emplace_back("shaders/demo001_fp16.frag.spv");
+    }
+    if(bYcbcrVariants && bFp16Variants){
+        paths.emplace_back("shaders/demo001_ycbcr_fp16.frag.spv");
+    }
+    if(gUseMultiview && bMultiview && !gFoveatedRendering){
+        paths.emplace_back("shaders/demo001_multiview.vert.spv");
+        paths.emplace_back("shaders/demo001_multiview.frag.spv");
+        if(bYcbcrVariants){
+            paths.emplace_back("shaders/demo001_multiview_ycbcr.frag.spv");
+        }
+        if(bFp16Variants){
+            paths.emplace_back("shaders/demo001_multiview_fp16.frag.spv");
+        }
+        if(bYcbcrVariants && bFp16Variants){
+            paths.emplace_back("shaders/demo001_multiview_ycbcr_fp16.frag.spv");
+        }
+    }
+    for(const auto &path : paths){
+        mShaderCode[path] = ReadFileFromAndroidRes(path);
+    }
+}
 
-    InitGeometry();
-    return 1;
+std::vector<char> &VKRenderer::ShaderCode(const std::string &path) {
+    auto it = mShaderCode.find(path);
+    if(it == mShaderCode.end()){
+        throw std::runtime_error("Shader " + path + " was not read by ReadShaders.");
+    }
+    return it->second;
 }
 
 void VKRenderer::DestroyVKEnv() {
     vkDeviceWaitIdle(mVk.deviceInfo.device);
-    mGeometryLeft.destroy(mVk.deviceInfo.device);
-    mGeometryRight.destroy(mVk.deviceInfo.device);
-    vkFreeDescriptorSets(mVk.deviceInfo.device, mVk.descriptorPool, 1, mVk.descriptorSets);
-    free(mVk.descriptorSets);
+    mFrameRing->printStats();
+    if(mGraphicsTimer != nullptr){
+        mGraphicsTimer->printStats();
+    }
+    if(mTransferBusyNs > 0){
+        LOG_D("camera upload: %.1f%% of the transfer queue time overlapped the rendering of the previous frame",
+              mTransferOverlapNs * 100.f / mTransferBusyNs);
+    }
+    SAFE_DELETE(mGraphicsTimer);
+    if(mEyeTimer != nullptr){
+        mEyeTimer->printStats();
+    }
+    SAFE_DELETE(mEyeTimer);
+    SAFE_DELETE(mRecorder);
+    SAFE_DELETE(mCompositor);
+    SAFE_DELETE(mTextureStreamer);
+    SAFE_DELETE(mMultiviewPass);
+    SAFE_DELETE(mFoveatedPass);
+    mGeometryLeft.destroy(mVk.deviceInfo.device, mVk.allocator);
+    mGeometryRight.destroy(mVk.deviceInfo.device, mVk.allocator);
+    mGeometryStereo.destroy(mVk.deviceInfo.device, mVk.allocator);
+    SAFE_DELETE(mFrameRing);
     vkDestroyDescriptorPool(mVk.deviceInfo.device, mVk.descriptorPool, VK_ALLOC);
     vkDestroyDescriptorSetLayout(mVk.deviceInfo.device, mVk.descriptorSetLayout, VK_ALLOC);
-    vkDestroySemaphore(mVk.deviceInfo.device, mVk.presentSemaphore, VK_ALLOC);
-    vkDestroySemaphore(mVk.deviceInfo.device, mVk.imageSemaphore, VK_ALLOC);
-    vkFreeCommandBuffers(mVk.deviceInfo.device, mVk.cmdPool, mVk.cmdBufferCount, mVk.cmdBuffers);
-    free(mVk.cmdBuffers);
-    vkDestroyPipeline(mVk.deviceInfo.device, mVk.graphicPipeline, VK_ALLOC);
+    if(mYcbcrSampler != VK_NULL_HANDLE){
+        vkDestroySampler(mVk.deviceInfo.device, mYcbcrSampler, VK_ALLOC);
+        vkDestroySamplerYcbcrConversion(mVk.deviceInfo.device, mYcbcrConversion, VK_ALLOC);
+        mYcbcrSampler = VK_NULL_HANDLE;
+        mYcbcrConversion = VK_NULL_HANDLE;
+    }
+    mFrameGraph.printStats();
+    // owns mVk.graphicPipeline
+    SAFE_DELETE(mCameraPipelines);
+    mVk.graphicPipeline = VK_NULL_HANDLE;
     vkDestroyShaderModule(mVk.deviceInfo.device, mVk.vertexShaderModule, VK_ALLOC);
     vkDestroyShaderModule(mVk.deviceInfo.device, mVk.fragShaderModule, VK_ALLOC);
     vkDestroyPipelineLayout(mVk.deviceInfo.device, mVk.pipelineLayout, VK_ALLOC);
@@ -325,37 +628,30 @@ void VKRenderer::DestroyVKEnv() {
     free(mVk.framebuffers);
     for(uint32_t i = 0; i < mVk.swapchainImage.imageCount; i++){
         vkDestroyImageView(mVk.deviceInfo.device, mVk.swapchainImage.views[i], VK_ALLOC);
+        if(bHeadless){
+            VkHelper::destroyImage(mVk.allocator, mVk.deviceInfo.device, &mVk.swapchainImage.images[i], &mOffscreenAllocations[i]);
+        }
     }
+    mOffscreenAllocations.clear();
     free(mVk.swapchainImage.views);
     free(mVk.swapchainImage.images);
     vkDestroyRenderPass(mVk.deviceInfo.device, mVk.renderPass, VK_ALLOC);
-    vkDestroySwapchainKHR(mVk.deviceInfo.device, mVk.swapchain, VK_ALLOC);
+    if(!bHeadless){
+        vkDestroySwapchainKHR(mVk.deviceInfo.device, mVk.swapchain, VK_ALLOC);
+    }
     vkDestroyCommandPool(mVk.deviceInfo.device, mVk.cmdPool, VK_ALLOC);
+    SAFE_DELETE(mVk.allocator);
     vkDestroyDevice(mVk.deviceInfo.device, VK_ALLOC);
-    vkDestroySurfaceKHR(mVk.instance, mVk.surface, VK_ALLOC);
+    if(mVk.surface != VK_NULL_HANDLE){
+        vkDestroySurfaceKHR(mVk.instance, mVk.surface, VK_ALLOC);
+    }
     vkDestroyInstance(mVk.instance, VK_ALLOC);
 }
 
-void VKRenderer::RenderSubArea(const AImage *image, RenderMeshArea area) {
-    int eyeIndex = 0;
-    if(area == MeshLeft | area == MeshUpperLeft | area == MeshLowerLeft){
-        eyeIndex = 0;
-    } else {
-        eyeIndex = 1;
-    }
-    VkCommandBuffer cmdBuffer = mVk.cmdBuffers[eyeIndex];
-    VkCommandBufferBeginInfo cmdBufferBeginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext = nullptr,
-            .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-            .pInheritanceInfo = nullptr
-    };
-    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
-
-    uint32_t surfaceWidth = mVk.swapchainParam.extent.width;
-    uint32_t surfaceHeight = mVk.swapchainParam.extent.height;
+static void GetSubAreaParams(RenderMeshArea area, uint32_t surfaceWidth, uint32_t surfaceHeight,
+                             VkRect2D *out_renderArea, VkRect2D *out_scissor, VkClearValue *out_clearValue){
     VkClearValue defaultClearValues = { 0.1f,  0.2f,  0.3f,  1.0f};
-    VkRect2D renderArea = { 0, 0, mVk.swapchainParam.extent };
+    VkRect2D renderArea = { 0, 0, surfaceWidth, surfaceHeight };
     VkRect2D scissor = { 0, 0, surfaceWidth, surfaceHeight };
     switch (area) {
         case MeshLeft:
@@ -389,45 +685,388 @@ void VKRenderer::RenderSubArea(const AImage *image, RenderMeshArea area) {
             scissor = { static_cast<int32_t>(surfaceWidth / 2), static_cast<int32_t>(surfaceHeight / 2), surfaceWidth / 2, surfaceHeight / 2 };
             break;
     }
-    VkRenderPassBeginInfo renderPassBeginInfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+    *out_renderArea = renderArea;
+    *out_scissor = scissor;
+    *out_clearValue = defaultClearValues;
+}
+
+void VKRenderer::RenderSubAreas(uint32_t passIndex, std::initializer_list<RenderMeshArea> areas) {
+    if(mFoveatedPass != nullptr){
+        RenderFoveatedSubAreas(passIndex, areas);
+        return;
+    }
+    const FrameContext &frame = mFrameRing->current();
+    uint32_t slot = mFrameRing->passSlot(passIndex);
+    VkCommandBuffer cmdBuffer = frame.cmdBuffers[passIndex];
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+            .pInheritanceInfo = nullptr
+    };
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+    if(passIndex == 0){
+        mGraphicsTimer->beginSlot(cmdBuffer, frame.index);
+    }
+    mCompositor->beginSlot(cmdBuffer, slot);
+
+    uint32_t surfaceWidth = mVk.swapchainParam.extent.width;
+    uint32_t surfaceHeight = mVk.swapchainParam.extent.height;
+    std::vector<RecordJob> jobs;
+    std::vector<VkRect2D> renderAreas;
+    std::vector<VkClearValue> clearValues;
+    std::vector<VkCommandBuffer> compositeCmdBuffers;
+    std::vector<uint32_t> eyeIndices;
+    for(RenderMeshArea area : areas){
+        int eyeIndex = (area == MeshLeft || area == MeshUpperLeft || area == MeshLowerLeft) ? 0 : 1;
+        VkRect2D renderArea, scissor;
+        VkClearValue clearValue;
+        GetSubAreaParams(area, surfaceWidth, surfaceHeight, &renderArea, &scissor, &clearValue);
+        eyeIndices.push_back(eyeIndex);
+        renderAreas.push_back(renderArea);
+        clearValues.push_back(clearValue);
+        compositeCmdBuffers.push_back(mCompositor->getCompositeCmdBuffer(slot, compositeCmdBuffers.size(), eyeIndex, scissor));
+        // each sub area is recorded into its own secondary buffer on the worker pool
+        VkDescriptorSet descriptorSet = frame.descriptorSets[eyeIndex];
+        jobs.emplace_back([this, eyeIndex, scissor, descriptorSet](VkCommandBuffer secondaryCmdBuffer){
+            vkCmdSetScissor(secondaryCmdBuffer, 0, 1, &scissor);
+            if(gRenderVst){
+                vkCmdBindPipeline(secondaryCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mVk.graphicPipeline);
+                vkCmdBindDescriptorSets(secondaryCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mVk.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+                VkHelper::geometryDraw(secondaryCmdBuffer, mVk.graphicPipeline, mVk.swapchainParam, eyeIndex == 0 ? mGeometryLeft : mGeometryRight);
+            }
+        });
+    }
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
             .pNext = nullptr,
             .renderPass = mVk.renderPass,
+            .subpass = 0,
             .framebuffer = mVk.framebuffers[mCurrentImageIndex],
-            .renderArea = renderArea,
-            .clearValueCount = 1,
-            .pClearValues = &defaultClearValues,
+            .occlusionQueryEnable = VK_FALSE,
+            .queryFlags = 0,
+            .pipelineStatistics = 0
     };
-    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    std::vector<VkCommandBuffer> secondaryCmdBuffers(jobs.size());
+    mRecorder->record(slot, inheritanceInfo, jobs, secondaryCmdBuffers.data());
 
-    if(gRenderVst){
-        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mVk.graphicPipeline);
-        if(mVk.descriptorSets != VK_NULL_HANDLE){
-            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mVk.pipelineLayout, 0, 1, &mVk.descriptorSets[eyeIndex], 0, nullptr);
+    if(passIndex == 0){
+        AddUploadPasses();
+    }
+    FrameResourceId targetResource = mTargetResources[mCurrentImageIndex];
+    std::vector<ResourceAccess> accesses = {
+            {targetResource, ResourceUsage::ATTACHMENT_WRITE, bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR}
+    };
+    for(RenderMeshArea area : areas){
+        uint32_t eyeIndex = (area == MeshLeft || area == MeshUpperLeft || area == MeshLowerLeft) ? 0 : 1;
+        if(gRenderVst){
+            AddCameraReads(eyeIndex, &accesses);
         }
-        VkHelper::geometryDraw(cmdBuffer, mVk.graphicPipeline, mVk.swapchainParam, eyeIndex == 0 ? mGeometryLeft : mGeometryRight);
     }
+    mFrameGraph.addPass("EyeRender", accesses, [&](VkCommandBuffer cmdBuffer){
+        for(size_t i = 0; i < secondaryCmdBuffers.size(); i++){
+            VkRenderPassBeginInfo renderPassBeginInfo = {
+                    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                    .pNext = nullptr,
+                    .renderPass = mVk.renderPass,
+                    .framebuffer = mVk.framebuffers[mCurrentImageIndex],
+                    .renderArea = renderAreas[i],
+                    .clearValueCount = 1,
+                    .pClearValues = &clearValues[i],
+            };
+            // the primary buffer may only execute secondaries inside the render pass, the timestamps go around it
+            uint32_t timerSlot = EyeTimerSlot(frame.index, passIndex, i);
+            BeginEyeTimer(cmdBuffer, timerSlot, eyeIndices[i]);
+            vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            // the overlay layers go on top of the camera in the same render pass
+            VkCommandBuffer executeCmdBuffers[] = {secondaryCmdBuffers[i], compositeCmdBuffers[i]};
+            vkCmdExecuteCommands(cmdBuffer, compositeCmdBuffers[i] != VK_NULL_HANDLE ? 2 : 1, executeCmdBuffers);
+            vkCmdEndRenderPass(cmdBuffer);
+            if(mEyeTimer != nullptr){
+                mEyeTimer->endSlot(cmdBuffer, timerSlot);
+            }
+        }
+    });
+    mFrameGraph.markOutput(targetResource);
+    mFrameGraph.execute(cmdBuffer);
+    if(passIndex == mVk.cmdBufferCount - 1){
+        mGraphicsTimer->endSlot(cmdBuffer, frame.index);
+    }
+    CALL_VK(vkEndCommandBuffer(cmdBuffer));
+    // the last pass of the frame releases the frame context
+    SubmitPass(cmdBuffer, passIndex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, passIndex == mVk.cmdBufferCount - 1);
+}
+
+void VKRenderer::RenderFoveatedSubAreas(uint32_t passIndex, std::initializer_list<RenderMeshArea> areas) {
+    const FrameContext &frame = mFrameRing->current();
+    uint32_t slot = mFrameRing->passSlot(passIndex);
+    VkCommandBuffer cmdBuffer = frame.cmdBuffers[passIndex];
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+            .pInheritanceInfo = nullptr
+    };
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+    if(passIndex == 0){
+        mGraphicsTimer->beginSlot(cmdBuffer, frame.index);
+    }
+    mFoveatedPass->beginSlot(cmdBuffer, slot);
+    mCompositor->beginSlot(cmdBuffer, slot);
 
-    vkCmdEndRenderPass(cmdBuffer);
+    // the first area of the frame may discard the old content, later ones build on it
+    FoveatedTarget target = {
+            .image = mVk.swapchainImage.images[mCurrentImageIndex],
+            .framebuffer = mVk.framebuffers[mCurrentImageIndex],
+            .oldLayout = passIndex == 0 ? VK_IMAGE_LAYOUT_UNDEFINED : mFoveatedPass->getTargetFinalLayout()
+    };
+    if(passIndex == 0){
+        AddUploadPasses();
+    }
+    FrameResourceId targetResource = mTargetResources[mCurrentImageIndex];
+    VkImageLayout finalLayout = mFoveatedPass->getTargetFinalLayout();
+    uint32_t areaIndex = 0;
+    for(RenderMeshArea area : areas){
+        uint32_t eyeIndex = (area == MeshLeft || area == MeshUpperLeft || area == MeshLowerLeft) ? 0 : 1;
+        VkRect2D renderArea, scissor;
+        VkClearValue clearValue;
+        GetSubAreaParams(area, mVk.swapchainParam.extent.width, mVk.swapchainParam.extent.height, &renderArea, &scissor, &clearValue);
+        FoveatedDraw draw = {
+                .pipeline = mVk.graphicPipeline,
+                .pipelineLayout = mVk.pipelineLayout,
+                .descriptorSet = frame.descriptorSets[eyeIndex],
+                .geometry = gRenderVst ? (eyeIndex == 0 ? &mGeometryLeft : &mGeometryRight) : nullptr
+        };
+        // the foveated pass transitions the target itself
+        std::vector<ResourceAccess> accesses = {{targetResource, ResourceUsage::EXTERNAL_WRITE, finalLayout}};
+        if(gRenderVst){
+            AddCameraReads(eyeIndex, &accesses);
+        }
+        uint32_t timerSlot = EyeTimerSlot(frame.index, passIndex, areaIndex);
+        mFrameGraph.addPass("FoveatedArea", accesses, [this, slot, eyeIndex, scissor, clearValue, draw, target, timerSlot](VkCommandBuffer cmdBuffer){
+            BeginEyeTimer(cmdBuffer, timerSlot, eyeIndex);
+            mFoveatedPass->recordArea(cmdBuffer, slot, eyeIndex, scissor, clearValue, draw, target);
+            if(mEyeTimer != nullptr){
+                mEyeTimer->endSlot(cmdBuffer, timerSlot);
+            }
+        });
+        if(mCompositor->hasVisibleLayers()){
+            // the area ends in the final layout, the layers need a load pass of their own
+            mFrameGraph.addPass("Overlay", {{targetResource, ResourceUsage::ATTACHMENT_READ_WRITE, finalLayout}},
+                                [this, slot, areaIndex, eyeIndex, scissor, target](VkCommandBuffer cmdBuffer){
+                mCompositor->recordOverlayPass(cmdBuffer, slot, areaIndex, eyeIndex, scissor, target.framebuffer);
+            });
+        }
+        areaIndex++;
+        target.oldLayout = finalLayout;
+    }
+    mFrameGraph.markOutput(targetResource);
+    mFrameGraph.execute(cmdBuffer);
+    if(passIndex == mVk.cmdBufferCount - 1){
+        mGraphicsTimer->endSlot(cmdBuffer, frame.index);
+    }
     CALL_VK(vkEndCommandBuffer(cmdBuffer));
+    // the upscale blit is the first write to the target
+    SubmitPass(cmdBuffer, passIndex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+               passIndex == mVk.cmdBufferCount - 1);
+}
+
+void VKRenderer::AddUploadPasses() {
+    for(uint32_t eyeIndex = 0; eyeIndex < 2; eyeIndex++){
+        if(mTransferQueue != nullptr){
+            // copied and released by the transfer queue, the first read acquires the planes after the semaphore wait
+            mFrameGraph.acquireImage(CameraResource(eyeIndex, PLANE_Y), mTransferQueue->getQueueFamily(), mVk.queueInfo.workQueueIndex,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            if(CameraResource(eyeIndex, PLANE_UV) != CameraResource(eyeIndex, PLANE_Y)){
+                mFrameGraph.acquireImage(CameraResource(eyeIndex, PLANE_UV), mTransferQueue->getQueueFamily(), mVk.queueInfo.workQueueIndex,
+                                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            }
+            continue;
+        }
+        CameraImage(eyeIndex)->addUploadPass(&mFrameGraph, eyeIndex);
+        // the eye may only be sampled by the second pass of the frame, without the camera the uploads are culled
+        if(gRenderVst && CameraResource(eyeIndex, PLANE_Y) != INVALID_FRAME_RESOURCE){
+            mFrameGraph.markOutput(CameraResource(eyeIndex, PLANE_Y));
+            mFrameGraph.markOutput(CameraResource(eyeIndex, PLANE_UV));
+        }
+    }
+}
+
+void VKRenderer::AddCameraReads(uint32_t eyeIndex, std::vector<ResourceAccess> *accesses) {
+    // host written planes are complete before the submission
+    if(CameraResource(eyeIndex, PLANE_Y) == INVALID_FRAME_RESOURCE){
+        return;
+    }
+    accesses->push_back({CameraResource(eyeIndex, PLANE_Y), ResourceUsage::SHADER_READ});
+    // a YCbCr image holds both planes
+    if(CameraResource(eyeIndex, PLANE_UV) != CameraResource(eyeIndex, PLANE_Y)){
+        accesses->push_back({CameraResource(eyeIndex, PLANE_UV), ResourceUsage::SHADER_READ});
+    }
+}
+
+FrameResourceId VKRenderer::CameraResource(uint32_t eyeIndex, YuvPlane plane) {
+    return CameraImage(eyeIndex)->getResource(eyeIndex, plane);
+}
+
+VkCameraImageV2 *VKRenderer::CameraImage(uint32_t eyeIndex) {
+    return (eyeIndex == 0 || mMultiviewPass != nullptr) ? mImageLeft : mImageRight;
+}
+
+void VKRenderer::UploadCameraFrames(const CameraFrame &frameLeft, const CameraFrame &frameRight) {
+    // the planes of the frame context, free since the ring waited for its last frame
+    mImageLeft->setSlot(mFrameRing->current().index);
+    if(mImageRight != nullptr){
+        mImageRight->setSlot(mFrameRing->current().index);
+    }
+    CameraImage(0)->updateImg(0, frameLeft);
+    CameraImage(1)->updateImg(1, frameRight);
+}
+
+void VKRenderer::SubmitTransferUploads() {
+    VkCommandBuffer cmdBuffer = mTransferQueue->begin(mFrameRing->current().index);
+    for(uint32_t eyeIndex = 0; eyeIndex < 2; eyeIndex++){
+        CameraImage(eyeIndex)->recordTransferUpload(cmdBuffer, eyeIndex, mTransferQueue->getQueueFamily(), mVk.queueInfo.workQueueIndex);
+    }
+    mUploadSemaphore = mTransferQueue->submit();
+}
+
+void VKRenderer::CollectQueueTimes() {
+    // the frame the ring just retired copied while the frame before it rendered, whose times were collected last time
+    uint32_t slot = mFrameRing->current().index;
+    QueueInterval transfer;
+    // uncalibrated queues only report their own busy time, their raw timestamps can not be compared
+    bool bComparable = mTransferQueue != nullptr && mTransferQueue->isCalibrated() && mGraphicsTimer->isCalibrated();
+    if(mTransferQueue != nullptr && mTransferQueue->collect(slot, &transfer) && bLastGraphicsValid && bComparable){
+        uint64_t overlapStart = std::max(transfer.startNs, mLastGraphicsInterval.startNs);
+        uint64_t overlapEnd = std::min(transfer.endNs, mLastGraphicsInterval.endNs);
+        mTransferBusyNs += transfer.endNs - transfer.startNs;
+        mTransferOverlapNs += overlapEnd > overlapStart ? overlapEnd - overlapStart : 0;
+    }
+    bLastGraphicsValid = mGraphicsTimer->collect(slot, &mLastGraphicsInterval);
+    mFrameStageTimes.gpuNs = bLastGraphicsValid ? mLastGraphicsInterval.endNs - mLastGraphicsInterval.startNs : 0;
+    if(mEyeTimer == nullptr){
+        return;
+    }
+    for(uint32_t i = EyeTimerSlot(slot, 0, 0); i < EyeTimerSlot(slot + 1, 0, 0); i++){
+        QueueInterval eye;
+        if(mEyeTimerEyes[i] >= 0 && mEyeTimer->collect(i, &eye)){
+            mFrameStageTimes.gpuEyeNs[mEyeTimerEyes[i]] += eye.endNs - eye.startNs;
+        }
+        mEyeTimerEyes[i] = -1;
+    }
+}
 
-    VkPipelineStageFlags stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+uint32_t VKRenderer::EyeTimerSlot(uint32_t frameIndex, uint32_t passIndex, uint32_t areaIndex) const {
+    return (frameIndex * mVk.cmdBufferCount + passIndex) * gEyeTimerAreasPerPass + areaIndex;
+}
+
+void VKRenderer::BeginEyeTimer(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t eyeIndex) {
+    if(mEyeTimer == nullptr){
+        return;
+    }
+    mEyeTimer->beginSlot(cmdBuffer, slot);
+    mEyeTimerEyes[slot] = static_cast<int8_t>(eyeIndex);
+}
+
+void VKRenderer::SubmitPass(VkCommandBuffer cmdBuffer, uint32_t passIndex, VkPipelineStageFlags waitStages, bool bLastPass) {
+    FrameContext &frame = mFrameRing->current();
+    // offscreen targets are never acquired or presented, so there is nothing to wait on or signal
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStageMasks[2];
+    uint32_t waitCount = 0;
+    // one acquire per frame, later passes are ordered behind the first through the barriers on the target
+    if(frame.bAcquirePending){
+        waitSemaphores[waitCount] = frame.acquireSemaphore;
+        waitStageMasks[waitCount++] = waitStages;
+        frame.bAcquirePending = false;
+    }
+    // the first submission of the frame waits for the camera copies, the planes are first read by the fragment shader
+    if(mUploadSemaphore != VK_NULL_HANDLE){
+        waitSemaphores[waitCount] = mUploadSemaphore;
+        waitStageMasks[waitCount++] = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        mUploadSemaphore = VK_NULL_HANDLE;
+    }
     VkSubmitInfo submitInfo = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .pNext = nullptr,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &mVk.imageSemaphore,
-            .pWaitDstStageMask = stages,
+            .waitSemaphoreCount = waitCount,
+            .pWaitSemaphores = waitSemaphores,
+            .pWaitDstStageMask = waitStageMasks,
             .commandBufferCount = 1,
             .pCommandBuffers = &cmdBuffer,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &mVk.presentSemaphore,
+            .signalSemaphoreCount = bHeadless ? 0u : 1u,
+            .pSignalSemaphores = &frame.renderSemaphores[passIndex],
     };
-    CALL_VK(vkQueueSubmit(mVk.queueInfo.queue, 1, &submitInfo, VK_NULL_HANDLE));
+    VkFence fence = VK_NULL_HANDLE;
+    if(bLastPass){
+        fence = frame.fence;
+        CALL_VK(vkResetFences(mVk.deviceInfo.device, 1, &fence));
+    }
+    CALL_VK(vkQueueSubmit(mVk.queueInfo.queue, 1, &submitInfo, fence));
+    frame.bInFlight = frame.bInFlight || bLastPass;
+}
+
+void VKRenderer::RenderMultiview() {
+    const FrameContext &frame = mFrameRing->current();
+    uint32_t slot = mFrameRing->passSlot(0);
+    VkCommandBuffer cmdBuffer = frame.cmdBuffers[0];
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+            .pInheritanceInfo = nullptr
+    };
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+    mGraphicsTimer->beginSlot(cmdBuffer, frame.index);
+    mCompositor->beginSlot(cmdBuffer, slot);
+
+    AddUploadPasses();
+    FrameResourceId targetResource = mTargetResources[mCurrentImageIndex];
+    VkImageLayout finalLayout = bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    std::vector<ResourceAccess> accesses = {{targetResource, ResourceUsage::ATTACHMENT_WRITE, finalLayout}};
+    if(gRenderVst){
+        for(uint32_t eyeIndex = 0; eyeIndex < 2; eyeIndex++){
+            AddCameraReads(eyeIndex, &accesses);
+        }
+    }
+    VkDescriptorSet descriptorSet = frame.descriptorSets[0];
+    mFrameGraph.addPass("StereoRender", accesses, [this, descriptorSet](VkCommandBuffer cmdBuffer){
+        // a single draw is too little work to split across the recorder threads, record it inline
+        mMultiviewPass->record(cmdBuffer, mVk.framebuffers[mCurrentImageIndex], descriptorSet, gRenderVst ? &mGeometryStereo : nullptr);
+    });
+    // the overlay layers go over the camera, a pass per eye
+    VkExtent2D extent = mVk.swapchainParam.extent;
+    for(uint32_t eyeIndex = 0; eyeIndex < 2 && mCompositor->hasVisibleLayers(); eyeIndex++){
+        VkRect2D eyeArea = {{static_cast<int32_t>(eyeIndex * extent.width / 2), 0}, {extent.width / 2, extent.height}};
+        mFrameGraph.addPass("Overlay", {{targetResource, ResourceUsage::ATTACHMENT_READ_WRITE, finalLayout}},
+                            [this, slot, eyeIndex, eyeArea](VkCommandBuffer cmdBuffer){
+            mCompositor->recordOverlayPass(cmdBuffer, slot, eyeIndex, eyeIndex, eyeArea, mVk.framebuffers[mCurrentImageIndex]);
+        });
+    }
+    mFrameGraph.markOutput(targetResource);
+    mFrameGraph.execute(cmdBuffer);
+    mGraphicsTimer->endSlot(cmdBuffer, frame.index);
+    CALL_VK(vkEndCommandBuffer(cmdBuffer));
+    SubmitPass(cmdBuffer, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, true);
+}
+
+void VKRenderer::PresentFrame(uint32_t passIndex) {
+    VkPresentInfoKHR presentInfo = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .pNext = nullptr,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &mFrameRing->current().renderSemaphores[passIndex],
+            .swapchainCount = 1,
+            .pSwapchains = &mVk.swapchain,
+            .pImageIndices = &mCurrentImageIndex,
+            .pResults = nullptr
+    };
+    CALL_VK(vkQueuePresentKHR(mVk.queueInfo.queue, &presentInfo));
 }
 
 void VKRenderer::CreateWindowSurface(){
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
     VkAndroidSurfaceCreateInfoKHR surfaceCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
             .pNext = nullptr,
@@ -436,9 +1075,39 @@ void VKRenderer::CreateWindowSurface(){
     };
     vkCreateAndroidSurfaceKHR(mVk.instance, &surfaceCreateInfo, VK_ALLOC, &mVk.surface);
     LOG_D("surface: %p", mVk.surface);
+#else
+    throw std::runtime_error("No window surface on this platform, only headless runs.");
+#endif
 }
 
-void VKRenderer::InitGeometry(){
+void VKRenderer::CreateOffscreenTargets(){
+    mVk.swapchain = VK_NULL_HANDLE;
+    mVk.swapchainParam.format = {VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    mVk.swapchainParam.extent = mOffscreenExtent;
+    mVk.swapchainImage.imageCount = 2;
+    mVk.swapchainImage.images = static_cast<VkImage *>(malloc(sizeof(VkImage) * mVk.swapchainImage.imageCount));
+    mVk.swapchainImage.views = static_cast<VkImageView *>(malloc(sizeof(VkImageView) * mVk.swapchainImage.imageCount));
+    mOffscreenAllocations.resize(mVk.swapchainImage.imageCount);
+    for(uint32_t i = 0; i < mVk.swapchainImage.imageCount; i++){
+        VkHelper::createImage(mVk.allocator, mVk.deviceInfo.device, mOffscreenExtent.width, mOffscreenExtent.height, 1,
+                              VK_IMAGE_TYPE_2D, mVk.swapchainParam.format.format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+                              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                              &mVk.swapchainImage.images[i], &mOffscreenAllocations[i]);
+        VkHelper::createImageView(mVk.deviceInfo.device, mVk.swapchainImage.images[i], VK_IMAGE_VIEW_TYPE_2D,
+                                  mVk.swapchainParam.format.format, VK_IMAGE_ASPECT_COLOR_BIT, &mVk.swapchainImage.views[i]);
+    }
+    LOG_D("offscreen targets: %u x %ux%u", mVk.swapchainImage.imageCount, mOffscreenExtent.width, mOffscreenExtent.height);
+}
+
+void VKRenderer::GenerateGeometry(){
+    // one eye quad, the multiview shader maps it into each half of the target
+    mGeometryStereo.vertices = {
+            {{-0.9f, 0.95f},/*vertex*/ {0.0f, 0.0f},/*texcoord*/  },
+            {{-0.9f, -0.95f},/*vertex*/ {0.0f, 1.0f},/*texcoord*/ },
+            {{0.9f, 0.95f},/*vertex*/ {1.0f, 0.0f},/*texcoord*/  },
+            {{0.9f, -0.95f},/*vertex*/ {1.0f, 1.0f},/*texcoord*/ },
+    };
+
     //left
     mGeometryLeft.vertices = {
             {{-0.95f, 0.95f},/*vertex*/ {0.0f, 0.0f},/*texcoord*/  },
@@ -446,7 +1115,6 @@ void VKRenderer::InitGeometry(){
             {{-0.05f, 0.95f},/*vertex*/ {1.0f, 0.0f},/*texcoord*/  },
             {{-0.05f, -0.95f},/*vertex*/ {1.0f, 1.0f},/*texcoord*/ },
     };
-    VkHelper::initGeometryBuffers(mVk.deviceInfo.physicalDevMemoProps, mVk.deviceInfo.device, mVk.cmdPool, mVk.queueInfo.queue, mGeometryLeft);
 
     //right
     mGeometryRight.vertices = {
@@ -455,34 +1123,38 @@ void VKRenderer::InitGeometry(){
             {{0.95f, 0.95f},/*vertex*/ {1.0f, 0.0f},/*texcoord*/ },
             {{0.95f, -0.95f},/*vertex*/ {1.0f, 1.0f},/*texcoord*/  },
     };
-    VkHelper::initGeometryBuffers(mVk.deviceInfo.physicalDevMemoProps, mVk.deviceInfo.device, mVk.cmdPool, mVk.queueInfo.queue, mGeometryRight);
 }
 
-void VKRenderer::UpdateDescriptorSets(uint8_t eyeIndex, const AImage *image){
-    VkCameraImageV2 *cameraImage = nullptr;
-    if(eyeIndex == 0){
-        cameraImage = mImageLeft;
-    } else {
-        cameraImage = mImageRight;
+void VKRenderer::UploadGeometry(UploadBatch *uploadBatch){
+    if(mMultiviewPass != nullptr){
+        VkHelper::initGeometryBuffers(mVk.allocator, mVk.deviceInfo.device, uploadBatch, mGeometryStereo);
+        return;
     }
-    cameraImage->updateImg(eyeIndex, image);
+    VkHelper::initGeometryBuffers(mVk.allocator, mVk.deviceInfo.device, uploadBatch, mGeometryLeft);
+    VkHelper::initGeometryBuffers(mVk.allocator, mVk.deviceInfo.device, uploadBatch, mGeometryRight);
+}
+
+void VKRenderer::UpdateDescriptorSets(uint8_t eyeIndex){
+    VkCameraImageV2 *cameraImage = CameraImage(eyeIndex);
+    // the layered image of the multiview path is bound once, through set 0
+    VkDescriptorSet descriptorSet = mFrameRing->current().descriptorSets[mMultiviewPass != nullptr ? 0 : eyeIndex];
 
     VkDescriptorImageInfo imageInfoY = {
             .sampler = cameraImage->getSampler(eyeIndex, PLANE_Y),
             .imageView = cameraImage->getImgView(eyeIndex, PLANE_Y),
-            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            .imageLayout = cameraImage->getSampledLayout()
     };
     VkDescriptorImageInfo imageInfoUV = {
             .sampler = cameraImage->getSampler(eyeIndex, PLANE_UV),
             .imageView = cameraImage->getImgView(eyeIndex, PLANE_UV),
-            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            .imageLayout = cameraImage->getSampledLayout()
     };
 
     VkWriteDescriptorSet writeDescSets[] = {
             {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .pNext = nullptr,
-                    .dstSet = mVk.descriptorSets[eyeIndex],
+                    .dstSet = descriptorSet,
                     .dstBinding = 0,
                     .dstArrayElement = 0,
                     .descriptorCount = 1,
@@ -492,7 +1164,7 @@ void VKRenderer::UpdateDescriptorSets(uint8_t eyeIndex, const AImage *image){
             {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .pNext = nullptr,
-                    .dstSet = mVk.descriptorSets[eyeIndex],
+                    .dstSet = descriptorSet,
                     .dstBinding = 1,
                     .dstArrayElement = 0,
                     .descriptorCount = 1,
@@ -500,5 +1172,6 @@ void VKRenderer::UpdateDescriptorSets(uint8_t eyeIndex, const AImage *image){
                     .pImageInfo = &imageInfoUV
             }
     };
-    vkUpdateDescriptorSets(mVk.deviceInfo.device, ARRAY_SIZE(writeDescSets), writeDescSets, 0, nullptr);
+    // the combined YCbCr image only has binding 0
+    vkUpdateDescriptorSets(mVk.deviceInfo.device, bYcbcrSampling ? 1 : ARRAY_SIZE(writeDescSets), writeDescSets, 0, nullptr);
 }
\ No newline at end of file
@@ -1,61 +1,132 @@
 #pragma once
 
 #include <cstdint>
-#include "../Camera/CameraImageReader.h"
-#include "../Camera/CameraManager.h"
+#include <initializer_list>
+#include <map>
+#include <string>
+#include "../Renderer.h"
 #include "VkBundle.h"
 #include "Geometry.h"
+#include "CameraFrameSource.h"
 #include "VkCameraImageV2.h"
+#include "VkCommandRecorder.h"
+#include "VkMultiviewPass.h"
+#include "VkFoveatedPass.h"
+#include "TextureStreamer.h"
+#include "VkLayerCompositor.h"
+#include "VkFrameGraph.h"
+#include "VkTransferQueue.h"
+#include "VkQueueTimer.h"
+#include "VkFrameRing.h"
+#include "VkPipelineVariants.h"
 
-enum RenderMeshOrder{
-    MeshOrderLeftToRight = 0,
-    MeshOrderRightToLeft,
-    MeshOrderTopToBottom,
-    MeshOrderBottomToTop
-};
-
-enum RenderMeshArea{
-    MeshLeft = 0,      // Columns Left to Right [-1, 0]
-    MeshRight,         // Columns Left to Right [0, 1]
-    MeshUpperLeft,     // Rows Top to Bottom [Upper Left]
-    MeshUpperRight,    // Rows Top to Bottom [Upper Right]
-    MeshLowerLeft,     // Rows Top to Bottom [Lower Left]
-    MeshLowerRight,    // Rows Top to Bottom [Lower Right]
-};
-
-class VKRenderer{
+class VKRenderer : public Renderer{
 public:
-    void Init(struct android_app *app);
-    void Destroy();
-    bool IsRunning();
-    void ProcessFrame(uint64_t frameIndex);
+    void Init(struct android_app *app) override;
+    // renders into offscreen images owned by the renderer, no camera, surface or swapchain involved
+    void InitHeadless(struct android_app *app, uint32_t width, uint32_t height);
+    void Destroy() override;
+    void ProcessFrame(uint64_t frameIndex) override;
+    const char *GetName() const override { return "Vulkan"; };
+    void SetSyntheticFrames(const CameraFrame &left, const CameraFrame &right);
+    // headless only, waits for the GPU and copies the target of the last frame out as tightly packed RGBA8
+    bool ReadTarget(std::vector<uint8_t> *out_pixels);
+    // before Init, false keeps the separate Y and UV images even where the YCbCr conversion is supported
+    void SetYcbcrSampling(bool bEnabled) { bYcbcrSampling = bEnabled; };
+    // before Init, the FP16 shaders where the device has shaderFloat16, with the YCbCr sampler and without
+    void SetFp16Shading(bool bEnabled) { bFp16Shading = bEnabled; };
+    // whether the FP16 shaders are in use after Init
+    bool GetFp16Shading() const { return bFp16Shading; };
+    // before Init, unsupported host modes fall back towards STAGING
+    void SetCameraUploadMode(CameraUploadMode mode) { mCameraUploadMode = mode; };
+    // the mode actually in use after Init
+    CameraUploadMode GetCameraUploadMode() const { return mCameraUploadMode; };
+    // before Init, each frame in flight adds throughput headroom and a frame of latency, 1 to FRAME_RING_MAX_DEPTH
+    void SetFramesInFlight(uint32_t depth) { mFramesInFlight = depth; };
+    uint32_t GetFramesInFlight() const { return mFramesInFlight; };
+    // before Init, false keeps the per eye passes, the only ones with a GPU time per eye
+    void SetMultiview(bool bEnabled) { bMultiview = bEnabled; };
 private:
-    void OpenCameras();
-    void CloseCameras();
-    int InitVKEnv();
+    // the steps below run as tasks of an InitTaskGraph, see RunInitGraph for what depends on what
+    void RunInitGraph();
+    void OpenCameraSource();
+    void CloseCameraSource();
+    void CreateDevice();
+    void ReadCameraFormat();
+    void CreateTargets();
+    void CreateDescriptors();
+    void CreatePipeline();
+    void CreateTextureStreamer();
+    void CreatePasses();
+    void ReadShaders(bool bYcbcrVariants, bool bFp16Variants);
+    const char *CameraFragShader(bool bMultiview);
+    std::vector<char> &ShaderCode(const std::string &path);
+    void InitResources();
     void DestroyVKEnv();
-    std::vector<char> ReadFileFromAndroidRes(const std::string& filePath);
-    void RenderSubArea(const AImage *image, RenderMeshArea area);
+    void RenderSubAreas(uint32_t passIndex, std::initializer_list<RenderMeshArea> areas);
+    void RenderFoveatedSubAreas(uint32_t passIndex, std::initializer_list<RenderMeshArea> areas);
+    void RenderMultiview();
+    void AddUploadPasses();
+    FrameResourceId CameraResource(uint32_t eyeIndex, YuvPlane plane);
+    void AddCameraReads(uint32_t eyeIndex, std::vector<ResourceAccess> *accesses);
+    VkCameraImageV2 *CameraImage(uint32_t eyeIndex);
+    void UploadCameraFrames(const CameraFrame &frameLeft, const CameraFrame &frameRight);
+    void SubmitTransferUploads();
+    void CollectQueueTimes();
+    uint32_t EyeTimerSlot(uint32_t frameIndex, uint32_t passIndex, uint32_t areaIndex) const;
+    void BeginEyeTimer(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t eyeIndex);
+    void SubmitPass(VkCommandBuffer cmdBuffer, uint32_t passIndex, VkPipelineStageFlags waitStages, bool bLastPass);
+    void PresentFrame(uint32_t passIndex);
+    static CameraColorFormat OtherChromaOrder(const CameraColorFormat &format);
+    void SelectCameraPipelines(const CameraColorFormat &format);
 
     void CreateWindowSurface();
-    void InitGeometry();
-    void UpdateDescriptorSets(uint8_t eyeIndex, const AImage *image);
-
-    struct android_app *mApp;
-    bool bRunning = false;
-    CameraImageReader *mImageReaderLeft;     // camera image reader
-    CameraImageReader *mImageReaderRight;    // camera image reader
-    CameraManager *mCameraLeft;              // camera left
-    CameraManager *mCameraRight;             // camera right
-
-    uint64_t mLastVsyncTimeNs = 0;
-    uint64_t mVsyncCount = 0;
-    uint64_t mLastFrameTime = 0;
+    void CreateOffscreenTargets();
+    void GenerateGeometry();
+    void UploadGeometry(UploadBatch *uploadBatch);
+    void UpdateDescriptorSets(uint8_t eyeIndex);
 
     uint32_t mCurrentImageIndex = 0;
     VkBundle mVk;                            // vulkan bundle
     Geometry mGeometryLeft;
     Geometry mGeometryRight;
-    VkCameraImageV2 *mImageLeft;
-    VkCameraImageV2 *mImageRight;
+    Geometry mGeometryStereo;                // one eye quad, placed per view by the multiview shader
+    VkCameraImageV2 *mImageLeft = nullptr;   // holds both eyes in layered mode
+    VkCameraImageV2 *mImageRight = nullptr;  // unused in multiview mode
+    bool bYcbcrSampling = true;              // cleared in CreateDescriptors when the device can not do it
+    bool bFp16Shading = true;                // likewise
+    bool bMultiview = true;                  // cleared by Init on a single buffered target
+    VkSamplerYcbcrConversion mYcbcrConversion = VK_NULL_HANDLE;
+    VkSampler mYcbcrSampler = VK_NULL_HANDLE;
+    CameraColorFormat mCameraFormat;         // of the first camera frame where YCbCr is requested, the conversion stays on it
+    bool bCameraFormatWarned = false;
+    VkPipelineVariants *mCameraPipelines = nullptr;  // mVk.graphicPipeline is the selected variant
+    CameraUploadMode mCameraUploadMode = CameraUploadMode::HOST_IMAGE_COPY;   // resolved in InitResources
+    VkCommandRecorder *mRecorder = nullptr;
+    VkMultiviewPass *mMultiviewPass = nullptr;
+    VkFoveatedPass *mFoveatedPass = nullptr;
+    TextureStreamer *mTextureStreamer = nullptr;
+    VkLayerCompositor *mCompositor = nullptr;
+    VkFrameGraph mFrameGraph;
+    std::vector<FrameResourceId> mTargetResources;  // per swapchain image
+    VkFrameRing *mFrameRing = nullptr;       // command buffers, semaphores, fence and descriptor sets per frame in flight
+    uint32_t mFramesInFlight = 2;
+    VkTransferQueue *mTransferQueue = nullptr;  // camera uploads next to the rendering, STAGING mode with a dedicated family only
+    VkSemaphore mUploadSemaphore = VK_NULL_HANDLE;  // waited on by the next submission
+    VkQueueTimer *mGraphicsTimer = nullptr;
+    QueueInterval mLastGraphicsInterval;
+    VkQueueTimer *mEyeTimer = nullptr;       // a pair per sub area draw, per eye path only
+    std::vector<int8_t> mEyeTimerEyes;       // eye each slot timed, -1 once collected
+    bool bLastGraphicsValid = false;
+    uint64_t mTransferBusyNs = 0;
+    uint64_t mTransferOverlapNs = 0;         // transfer time spent while the previous frame rendered
+
+    bool bHeadless = false;
+    VkExtent2D mOffscreenExtent = {0, 0};
+    std::vector<VkAllocation> mOffscreenAllocations;
+    SyntheticFrameSource mSyntheticFrames;
+    CameraFrameSource *mCameraFrames = nullptr;   // an owned ImageReaderFrameSource, &mSyntheticFrames when headless
+    uint32_t mRecordFrameCount = 0;          // camera frames to keep for VkBenchmark, debug.camera2vk.record_frames
+    uint32_t mRecordedFrames = 0;
+    std::map<std::string, std::vector<char>> mShaderCode;  // read ahead of the device, dropped after init
 };
\ No newline at end of file
@@ -0,0 +1,345 @@
+#include "VkBenchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define SYNTHETIC_FRAME_COUNT 4
+#define RECORDED_FRAME_MAGIC 0x46563243   // "C2VF"
+
+struct RecordedFrameHeader{
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t chromaOrder;
+    uint32_t colorModel;
+    uint32_t colorRange;
+};
+
+struct YuvFrame{
+    std::vector<uint8_t> yPlane;
+    std::vector<uint8_t> uvPlane;
+    CameraColorFormat format;
+};
+
+static std::string recordedFramePath(const char *dir, uint32_t index){
+    return std::string(dir) + "/camera_frame_" + std::to_string(index) + ".yuv";
+}
+
+static void fillSyntheticFrame(uint32_t seed, std::vector<uint8_t> *yPlane, std::vector<uint8_t> *uvPlane){
+    // moving gradients, so consecutive frames never carry identical content
+    yPlane->resize(IMAGE_WIDTH * IMAGE_HEIGHT);
+    uvPlane->resize(IMAGE_WIDTH * IMAGE_HEIGHT / 2);
+    for(uint32_t y = 0; y < IMAGE_HEIGHT; y++){
+        uint8_t *row = yPlane->data() + y * IMAGE_WIDTH;
+        for(uint32_t x = 0; x < IMAGE_WIDTH; x++){
+            row[x] = static_cast<uint8_t>(x + y + seed * 32);
+        }
+    }
+    for(uint32_t y = 0; y < IMAGE_HEIGHT / 2; y++){
+        uint8_t *row = uvPlane->data() + y * IMAGE_WIDTH;
+        for(uint32_t x = 0; x < IMAGE_WIDTH; x += 2){
+            row[x] = static_cast<uint8_t>(128 + y - seed * 16);
+            row[x + 1] = static_cast<uint8_t>(128 + x / 2 + seed * 16);
+        }
+    }
+}
+
+// planes as the upload sees them, IMAGE_WIDTH x IMAGE_HEIGHT luma followed by the interleaved chroma
+bool VkBenchmark::recordFrame(const char *dir, uint32_t index, const CameraFrame &frame) {
+    if(dir == nullptr || frame.yData == nullptr || frame.uvData == nullptr ||
+       frame.yDataLen < IMAGE_WIDTH * IMAGE_HEIGHT || frame.uvDataLen < IMAGE_WIDTH * IMAGE_HEIGHT / 2 - 1){
+        return false;
+    }
+    std::string path = recordedFramePath(dir, index);
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr){
+        LOG_W("VkBenchmark: can not record a camera frame to %s", path.c_str());
+        return false;
+    }
+    RecordedFrameHeader header = {
+            .magic = RECORDED_FRAME_MAGIC,
+            .width = IMAGE_WIDTH,
+            .height = IMAGE_HEIGHT,
+            .chromaOrder = static_cast<uint32_t>(frame.format.chromaOrder),
+            .colorModel = static_cast<uint32_t>(frame.format.colorModel),
+            .colorRange = static_cast<uint32_t>(frame.format.colorRange)
+    };
+    // the interleaved chroma plane of camera2 ends one byte short, the last one is padded
+    std::vector<uint8_t> uvPlane(frame.uvData, frame.uvData + std::min(frame.uvDataLen, IMAGE_WIDTH * IMAGE_HEIGHT / 2));
+    uvPlane.resize(IMAGE_WIDTH * IMAGE_HEIGHT / 2, 128);
+    bool bWritten = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                    fwrite(frame.yData, IMAGE_WIDTH * IMAGE_HEIGHT, 1, file) == 1 &&
+                    fwrite(uvPlane.data(), uvPlane.size(), 1, file) == 1;
+    fclose(file);
+    LOG_D("VkBenchmark: recorded camera frame %u to %s%s", index, path.c_str(), bWritten ? "" : " failed");
+    return bWritten;
+}
+
+static void loadRecordedFrames(struct android_app *app, std::vector<YuvFrame> *out_frames){
+    std::string dir = Renderer::DataDir(app);
+    for(uint32_t i = 0; i < RECORDED_FRAME_MAX; i++){
+        FILE *file = fopen(recordedFramePath(dir.c_str(), i).c_str(), "rb");
+        if(file == nullptr){
+            break;
+        }
+        RecordedFrameHeader header;
+        YuvFrame frame;
+        frame.yPlane.resize(IMAGE_WIDTH * IMAGE_HEIGHT);
+        frame.uvPlane.resize(IMAGE_WIDTH * IMAGE_HEIGHT / 2);
+        bool bRead = fread(&header, sizeof(header), 1, file) == 1 && header.magic == RECORDED_FRAME_MAGIC &&
+                     header.width == IMAGE_WIDTH && header.height == IMAGE_HEIGHT &&
+                     fread(frame.yPlane.data(), frame.yPlane.size(), 1, file) == 1 &&
+                     fread(frame.uvPlane.data(), frame.uvPlane.size(), 1, file) == 1;
+        fclose(file);
+        if(!bRead){
+            LOG_W("VkBenchmark: recorded camera frame %u is not in the current format, skipped", i);
+            continue;
+        }
+        frame.format = {
+                .chromaOrder = static_cast<ChromaOrder>(header.chromaOrder),
+                .colorModel = static_cast<ColorModel>(header.colorModel),
+                .colorRange = static_cast<ColorRange>(header.colorRange)
+        };
+        out_frames->push_back(std::move(frame));
+    }
+}
+
+static void accumulate(const FrameStageTimes &times, FrameStageTimes *sum, FrameStageTimes *max){
+    sum->frameWaitNs += times.frameWaitNs;
+    sum->acquireNs += times.acquireNs;
+    sum->uploadNs += times.uploadNs;
+    sum->renderNs += times.renderNs;
+    sum->presentNs += times.presentNs;
+    sum->totalNs += times.totalNs;
+    sum->latencyNs += times.latencyNs;
+    sum->gpuNs += times.gpuNs;
+    for(int eye = 0; eye < 2; eye++){
+        sum->gpuEyeNs[eye] += times.gpuEyeNs[eye];
+        max->gpuEyeNs[eye] = std::max(max->gpuEyeNs[eye], times.gpuEyeNs[eye]);
+    }
+    max->frameWaitNs = std::max(max->frameWaitNs, times.frameWaitNs);
+    max->acquireNs = std::max(max->acquireNs, times.acquireNs);
+    max->uploadNs = std::max(max->uploadNs, times.uploadNs);
+    max->renderNs = std::max(max->renderNs, times.renderNs);
+    max->presentNs = std::max(max->presentNs, times.presentNs);
+    max->totalNs = std::max(max->totalNs, times.totalNs);
+    max->latencyNs = std::max(max->latencyNs, times.latencyNs);
+    max->gpuNs = std::max(max->gpuNs, times.gpuNs);
+}
+
+// renders every frame once, both eyes fed the same one, and reads the target back after each
+static bool captureFrames(struct android_app *app, uint32_t width, uint32_t height, bool bYcbcrSampling, bool bFp16Shading,
+                          const std::vector<YuvFrame> &frames, std::vector<uint8_t> *out_targets){
+    VKRenderer renderer{};
+    renderer.SetYcbcrSampling(bYcbcrSampling);
+    renderer.SetFramesInFlight(1);
+    renderer.SetFp16Shading(bFp16Shading);
+    renderer.InitHeadless(app, width, height);
+    bool bFp16Used = renderer.GetFp16Shading();
+    for(uint32_t i = 0; i < frames.size(); i++){
+        CameraFrame frame = {frames[i].yPlane.data(), static_cast<int32_t>(frames[i].yPlane.size()),
+                             frames[i].uvPlane.data(), static_cast<int32_t>(frames[i].uvPlane.size()),
+                             static_cast<int64_t>(getTimeNano(CLOCK_MONOTONIC)), frames[i].format};
+        renderer.SetSyntheticFrames(frame, frame);
+        renderer.ProcessFrame(i);
+        renderer.ReadTarget(&out_targets[i]);
+    }
+    renderer.Destroy();
+    return bFp16Used == bFp16Shading;
+}
+
+// over the color channels of two RGBA8 images, infinite when they are identical
+static double computePsnr(const std::vector<uint8_t> &reference, const std::vector<uint8_t> &test){
+    if(reference.size() != test.size() || reference.empty()){
+        return 0;
+    }
+    double squaredError = 0;
+    for(size_t i = 0; i < reference.size(); i++){
+        if(i % 4 == 3){
+            continue;
+        }
+        double diff = static_cast<double>(reference[i]) - test[i];
+        squaredError += diff * diff;
+    }
+    double mse = squaredError / (reference.size() / 4 * 3);
+    return mse == 0 ? INFINITY : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+BenchmarkResult VkBenchmark::run(struct android_app *app, uint32_t frameCount, uint32_t width, uint32_t height, uint32_t warmupFrames,
+                                 bool bYcbcrSampling, CameraUploadMode uploadMode, uint32_t framesInFlight, bool bFp16Shading,
+                                 bool bMultiview) {
+    std::vector<uint8_t> yPlanes[SYNTHETIC_FRAME_COUNT];
+    std::vector<uint8_t> uvPlanes[SYNTHETIC_FRAME_COUNT];
+    for(uint32_t i = 0; i < SYNTHETIC_FRAME_COUNT; i++){
+        fillSyntheticFrame(i, &yPlanes[i], &uvPlanes[i]);
+    }
+
+    VKRenderer renderer{};
+    renderer.SetYcbcrSampling(bYcbcrSampling);
+    renderer.SetCameraUploadMode(uploadMode);
+    renderer.SetFramesInFlight(framesInFlight);
+    renderer.SetFp16Shading(bFp16Shading);
+    renderer.SetMultiview(bMultiview);
+    renderer.InitHeadless(app, width, height);
+
+    BenchmarkResult result;
+    result.uploadMode = renderer.GetCameraUploadMode();
+    result.framesInFlight = renderer.GetFramesInFlight();
+    result.bFp16Shading = renderer.GetFp16Shading();
+    FrameStageTimes sumStageTimes;
+    uint64_t startTimeNs = 0, startCpuNs = 0;
+    for(uint32_t frameIndex = 0; frameIndex < warmupFrames + frameCount; frameIndex++){
+        if(frameIndex == warmupFrames){
+            startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+            startCpuNs = getTimeNano(CLOCK_PROCESS_CPUTIME_ID);
+        }
+        uint32_t left = frameIndex % SYNTHETIC_FRAME_COUNT;
+        uint32_t right = (frameIndex + 1) % SYNTHETIC_FRAME_COUNT;
+        int64_t timestamp = getTimeNano(CLOCK_MONOTONIC);
+        CameraFrame frameLeft = {yPlanes[left].data(), static_cast<int32_t>(yPlanes[left].size()),
+                                 uvPlanes[left].data(), static_cast<int32_t>(uvPlanes[left].size()), timestamp};
+        CameraFrame frameRight = {yPlanes[right].data(), static_cast<int32_t>(yPlanes[right].size()),
+                                  uvPlanes[right].data(), static_cast<int32_t>(uvPlanes[right].size()), timestamp};
+        renderer.SetSyntheticFrames(frameLeft, frameRight);
+        renderer.ProcessFrame(frameIndex);
+        if(frameIndex >= warmupFrames){
+            accumulate(renderer.GetFrameStageTimes(), &sumStageTimes, &result.maxStageTimes);
+        }
+    }
+    uint64_t elapsedNs = getTimeNano(CLOCK_MONOTONIC) - startTimeNs;
+    uint64_t cpuNs = getTimeNano(CLOCK_PROCESS_CPUTIME_ID) - startCpuNs;
+    renderer.Destroy();
+
+    result.frameCount = frameCount;
+    if(frameCount > 0){
+        result.fps = frameCount * 1e9 / elapsedNs;
+        result.cpuMsPerFrame = cpuNs * 1.0 / frameCount / U_TIME_1MS_IN_NS;
+        result.avgStageTimes = {.frameWaitNs = sumStageTimes.frameWaitNs / frameCount, .acquireNs = sumStageTimes.acquireNs / frameCount,
+                                .uploadNs = sumStageTimes.uploadNs / frameCount, .renderNs = sumStageTimes.renderNs / frameCount,
+                                .presentNs = sumStageTimes.presentNs / frameCount, .totalNs = sumStageTimes.totalNs / frameCount,
+                                .latencyNs = sumStageTimes.latencyNs / frameCount, .gpuNs = sumStageTimes.gpuNs / frameCount,
+                                .gpuEyeNs = {sumStageTimes.gpuEyeNs[0] / frameCount, sumStageTimes.gpuEyeNs[1] / frameCount}};
+    }
+
+    LOG_D("---------------------------------");
+    LOG_D("VkBenchmark: %u frames at %ux%u, %s upload, %u in flight, %s shading, %.2f fps, cpu %.3f ms/frame", frameCount, width, height,
+          VkCameraImageV2::uploadModeName(result.uploadMode), result.framesInFlight, result.bFp16Shading ? "fp16" : "fp32",
+          result.fps, result.cpuMsPerFrame);
+    LOG_D("    stage      avg(ms)   max(ms)");
+    LOG_D("    gpu wait   %7.3f   %7.3f", result.avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    acquire    %7.3f   %7.3f", result.avgStageTimes.acquireNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.acquireNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    upload     %7.3f   %7.3f", result.avgStageTimes.uploadNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.uploadNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    render     %7.3f   %7.3f", result.avgStageTimes.renderNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.renderNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    total      %7.3f   %7.3f", result.avgStageTimes.totalNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.totalNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    latency    %7.3f   %7.3f", result.avgStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    gpu        %7.3f   %7.3f", result.avgStageTimes.gpuNs * 1.f / U_TIME_1MS_IN_NS, result.maxStageTimes.gpuNs * 1.f / U_TIME_1MS_IN_NS);
+    return result;
+}
+
+void VkBenchmark::compareCameraSampling(struct android_app *app, uint32_t frameCount, uint32_t width, uint32_t height) {
+    // one frame in flight, so the gpu wait of every frame is the whole execution of the one before
+    BenchmarkResult manual = run(app, frameCount, width, height, 30, false, CameraUploadMode::HOST_IMAGE_COPY, 1);
+    BenchmarkResult ycbcr = run(app, frameCount, width, height, 30, true, CameraUploadMode::HOST_IMAGE_COPY, 1);
+    LOG_D("---------------------------------");
+    LOG_D("VkBenchmark camera sampling      manual    ycbcr");
+    LOG_D("    fps                        %7.2f  %7.2f", manual.fps, ycbcr.fps);
+    LOG_D("    render (ms)                %7.3f  %7.3f", manual.avgStageTimes.renderNs * 1.f / U_TIME_1MS_IN_NS,
+          ycbcr.avgStageTimes.renderNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    gpu wait (ms)              %7.3f  %7.3f", manual.avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS,
+          ycbcr.avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS);
+}
+
+void VkBenchmark::compareCameraUpload(struct android_app *app, uint32_t frameCount, uint32_t width, uint32_t height) {
+    CameraUploadMode modes[] = {CameraUploadMode::STAGING, CameraUploadMode::HOST_IMAGE_COPY, CameraUploadMode::HOST_LINEAR};
+    BenchmarkResult results[ARRAY_SIZE(modes)];
+    for(uint32_t i = 0; i < ARRAY_SIZE(modes); i++){
+        results[i] = run(app, frameCount, width, height, 30, true, modes[i], 1);
+    }
+    LOG_D("---------------------------------");
+    LOG_D("VkBenchmark camera upload        staging  hostcopy   linear");
+    // a fallen back mode shows up as the mode it ran with
+    LOG_D("    ran as                     %7s  %7s  %7s", VkCameraImageV2::uploadModeName(results[0].uploadMode),
+          VkCameraImageV2::uploadModeName(results[1].uploadMode), VkCameraImageV2::uploadModeName(results[2].uploadMode));
+    LOG_D("    fps                        %7.2f  %7.2f  %7.2f", results[0].fps, results[1].fps, results[2].fps);
+    LOG_D("    upload (ms)                %7.3f  %7.3f  %7.3f", results[0].avgStageTimes.uploadNs * 1.f / U_TIME_1MS_IN_NS,
+          results[1].avgStageTimes.uploadNs * 1.f / U_TIME_1MS_IN_NS, results[2].avgStageTimes.uploadNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    gpu wait (ms)              %7.3f  %7.3f  %7.3f", results[0].avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS,
+          results[1].avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS, results[2].avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    total (ms)                 %7.3f  %7.3f  %7.3f", results[0].avgStageTimes.totalNs * 1.f / U_TIME_1MS_IN_NS,
+          results[1].avgStageTimes.totalNs * 1.f / U_TIME_1MS_IN_NS, results[2].avgStageTimes.totalNs * 1.f / U_TIME_1MS_IN_NS);
+}
+
+void VkBenchmark::compareFramesInFlight(struct android_app *app, uint32_t frameCount, uint32_t width, uint32_t height) {
+    BenchmarkResult results[FRAME_RING_MAX_DEPTH];
+    for(uint32_t i = 0; i < FRAME_RING_MAX_DEPTH; i++){
+        results[i] = run(app, frameCount, width, height, 30, true, CameraUploadMode::HOST_IMAGE_COPY, i + 1);
+    }
+    LOG_D("---------------------------------");
+    LOG_D("VkBenchmark frames in flight          1        2        3");
+    LOG_D("    fps                        %7.2f  %7.2f  %7.2f", results[0].fps, results[1].fps, results[2].fps);
+    LOG_D("    gpu wait (ms)              %7.3f  %7.3f  %7.3f", results[0].avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS,
+          results[1].avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS, results[2].avgStageTimes.frameWaitNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    latency (ms)               %7.3f  %7.3f  %7.3f", results[0].avgStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS,
+          results[1].avgStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS, results[2].avgStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS);
+    LOG_D("    max latency (ms)           %7.3f  %7.3f  %7.3f", results[0].maxStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS,
+          results[1].maxStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS, results[2].maxStageTimes.latencyNs * 1.f / U_TIME_1MS_IN_NS);
+}
+
+bool VkBenchmark::compareFp16Shading(struct android_app *app, uint32_t frameCount, uint32_t width, uint32_t height) {
+    // FP32 and FP16 on the manual conversion and behind the YCbCr sampler, per eye passes, so every eye has timestamps
+    // of its own
+    BenchmarkResult results[4];
+    for(uint32_t i = 0; i < ARRAY_SIZE(results); i++){
+        results[i] = run(app, frameCount, width, height, 30, i >= 2, CameraUploadMode::HOST_IMAGE_COPY, 1, i % 2 == 1, false);
+    }
+    if(!results[1].bFp16Shading){
+        LOG_W("VkBenchmark: the device has no shaderFloat16, nothing to compare.");
+        return true;
+    }
+
+    std::vector<YuvFrame> frames;
+    loadRecordedFrames(app, &frames);
+    bool bRecorded = !frames.empty();
+    if(!bRecorded){
+        LOG_W("VkBenchmark: no recorded camera frames, set debug.camera2vk.record_frames and run the camera first. "
+              "The PSNR below is on synthetic gradients.");
+        frames.resize(SYNTHETIC_FRAME_COUNT);
+        for(uint32_t i = 0; i < SYNTHETIC_FRAME_COUNT; i++){
+            fillSyntheticFrame(i, &frames[i].yPlane, &frames[i].uvPlane);
+        }
+    }
+    double minPsnr[2] = {INFINITY, INFINITY}, sumPsnr[2] = {0, 0};
+    for(uint32_t sampling = 0; sampling < 2; sampling++){
+        bool bYcbcrSampling = sampling == 1;
+        std::vector<std::vector<uint8_t>> reference(frames.size()), half(frames.size());
+        if(!captureFrames(app, width, height, bYcbcrSampling, false, frames, reference.data()) ||
+           !captureFrames(app, width, height, bYcbcrSampling, true, frames, half.data())){
+            LOG_E("VkBenchmark: the captures did not run with the requested shading.");
+            return false;
+        }
+        for(size_t i = 0; i < frames.size(); i++){
+            double psnr = computePsnr(reference[i], half[i]);
+            minPsnr[sampling] = std::min(minPsnr[sampling], psnr);
+            sumPsnr[sampling] += psnr;
+        }
+    }
+
+    LOG_D("---------------------------------");
+    LOG_D("VkBenchmark camera shading        fp32     fp16  ycbcr32  ycbcr16");
+    LOG_D("    fps                        %7.2f  %7.2f  %7.2f  %7.2f", results[0].fps, results[1].fps, results[2].fps, results[3].fps);
+    for(uint32_t eye = 0; eye < 2; eye++){
+        LOG_D("    gpu %s eye (ms)          %7.3f  %7.3f  %7.3f  %7.3f", eye == 0 ? "left " : "right",
+              results[0].avgStageTimes.gpuEyeNs[eye] * 1.f / U_TIME_1MS_IN_NS, results[1].avgStageTimes.gpuEyeNs[eye] * 1.f / U_TIME_1MS_IN_NS,
+              results[2].avgStageTimes.gpuEyeNs[eye] * 1.f / U_TIME_1MS_IN_NS, results[3].avgStageTimes.gpuEyeNs[eye] * 1.f / U_TIME_1MS_IN_NS);
+    }
+    LOG_D("    psnr min/avg (dB)          manual %.2f / %.2f, ycbcr %.2f / %.2f over %zu %s frames", minPsnr[0],
+          sumPsnr[0] / frames.size(), minPsnr[1], sumPsnr[1] / frames.size(), frames.size(), bRecorded ? "recorded camera" : "synthetic");
+    double worstPsnr = std::min(minPsnr[0], minPsnr[1]);
+    if(worstPsnr < FP16_MIN_PSNR_DB){
+        LOG_E("VkBenchmark: fp16 shading reaches only %.2f dB against fp32, below %.0f dB.", worstPsnr, FP16_MIN_PSNR_DB);
+        return false;
+    }
+    return true;
+}
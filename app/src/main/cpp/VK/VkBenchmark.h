@@ -0,0 +1,54 @@
+/*!
+ * @brief  Headless end-to-end benchmark of the Vulkan pipeline fed with synthetic camera frames
+ * @date 2023/8/5
+ */
+#ifndef CAMERA2VK_VKBENCHMARK_H
+#define CAMERA2VK_VKBENCHMARK_H
+
+#include <cstdint>
+#include "VKRenderer.h"
+
+#define RECORDED_FRAME_MAX 8                // camera frames kept for compareFp16Shading
+#define FP16_MIN_PSNR_DB 40.0               // below this the FP16 shaders are visibly off
+
+struct BenchmarkResult{
+    uint32_t frameCount = 0;
+    double fps = 0;
+    double cpuMsPerFrame = 0;               // process CPU time, recording workers included
+    CameraUploadMode uploadMode = CameraUploadMode::STAGING;   // after the fallbacks of the renderer
+    uint32_t framesInFlight = 0;
+    bool bFp16Shading = false;              // after the fallbacks of the renderer
+    FrameStageTimes avgStageTimes;
+    FrameStageTimes maxStageTimes;
+};
+
+class VkBenchmark{
+public:
+    /**
+     * Runs the whole ProcessFrame sequence (GPU wait, upload, record, submit) against offscreen targets, on the device
+     * inside the app, started from Main when VK_PIPELINE_BENCHMARK is defined, and on a host in tests/VkBenchmarkTest
+     * against the system loader. app is null there, the shaders are read from the working directory.
+     */
+    static BenchmarkResult run(struct android_app *app, uint32_t frameCount,
+                               uint32_t width = 2560, uint32_t height = 1280, uint32_t warmupFrames = 30,
+                               bool bYcbcrSampling = true, CameraUploadMode uploadMode = CameraUploadMode::HOST_IMAGE_COPY,
+                               uint32_t framesInFlight = 2, bool bFp16Shading = true, bool bMultiview = true);
+    // the same run with the manual Y/UV conversion and with the YCbCr sampler, the GPU wait carries the fragment cost
+    static void compareCameraSampling(struct android_app *app, uint32_t frameCount, uint32_t width = 2560, uint32_t height = 1280);
+    // staging against the host upload modes, the copy moves from the gpu wait into the upload stage
+    static void compareCameraUpload(struct android_app *app, uint32_t frameCount, uint32_t width = 2560, uint32_t height = 1280);
+    // every ring depth, throughput against the latency from the start of a frame until its fence is seen signaled
+    static void compareFramesInFlight(struct android_app *app, uint32_t frameCount, uint32_t width = 2560, uint32_t height = 1280);
+    /**
+     * FP32 against FP16 shaders, on the manual conversion and behind the YCbCr sampler, the GPU time of each eye's pass
+     * and the PSNR of the FP16 output against the FP32 one. The PSNR is taken on the camera frames recordFrame kept in
+     * the app's internal data directory, on synthetic gradients only when there are none. False when either sampling
+     * falls below FP16_MIN_PSNR_DB, true as well on a device without shaderFloat16, which renders FP32 only.
+     * tests/VkFp16ShadingTest runs it on a host.
+     */
+    static bool compareFp16Shading(struct android_app *app, uint32_t frameCount, uint32_t width = 2560, uint32_t height = 1280);
+    // writes the planes of a camera frame as the index-th recorded frame, debug.camera2vk.record_frames=N keeps N of them
+    static bool recordFrame(const char *dir, uint32_t index, const CameraFrame &frame);
+};
+
+#endif //CAMERA2VK_VKBENCHMARK_H
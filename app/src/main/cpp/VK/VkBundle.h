@@ -2,10 +2,22 @@
 
 #include "vulkan_wrapper.h"
 
+class VkMemoryAllocator;
+
+// optional features, only set when the device reports them and they got enabled on the device
+struct DeviceFeatures {
+    VkBool32 multiview;
+    VkBool32 hostImageCopy;                 // VK_EXT_host_image_copy
+    VkBool32 hostQueryReset;                // Vulkan 1.2, queries of transfer-only queues are reset from the host
+    VkBool32 shaderFloat16;                 // Vulkan 1.2 / VK_KHR_shader_float16_int8, FP16 arithmetic in shaders
+    VkBool32 calibratedTimestamps;          // VK_EXT_calibrated_timestamps with the device and CLOCK_MONOTONIC domains
+};
+
 struct DeviceInfo {
     VkPhysicalDevice physicalDev;
     VkPhysicalDeviceLimits physicalDevLimits;
     VkPhysicalDeviceMemoryProperties physicalDevMemoProps;
+    DeviceFeatures features;
     VkDevice device;
 };
 
@@ -13,6 +25,8 @@ struct QueueInfo {
     uint16_t workQueueIndex;
     uint16_t presentQueueIndex;
     VkQueue queue;
+    uint16_t transferQueueIndex;            // family without graphics, equals workQueueIndex when there is none
+    VkQueue transferQueue;                  // VK_NULL_HANDLE when there is no such family
 };
 
 struct SwapchainImage{
@@ -37,6 +51,7 @@ struct VkBundle {
     struct DeviceInfo deviceInfo;
     struct QueueInfo queueInfo;
     VkCommandPool cmdPool;
+    VkMemoryAllocator *allocator;
 
     SwapchainParam swapchainParam;
     VkSwapchainKHR swapchain;
@@ -197,18 +197,15 @@ void VkCameraImage::update(VkBundle *vk, VkImageUsageFlags usage, VkSharingMode
     CALL_VK(vkBindImageMemory(vk->deviceInfo.device, mImage, mMemory, 0));
 
     VkBuffer stageBuffer;
-    VkDeviceMemory stageMemory;
-    VkHelper::createBufferInternal(vk->deviceInfo.physicalDevMemoProps, vk->deviceInfo.device,
+    VkAllocation stageAllocation;
+    VkHelper::createBufferInternal(vk->allocator, vk->deviceInfo.device,
                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                  mDataSize, &stageBuffer, &stageMemory);
+                  AllocationUsage::TRANSIENT, mDataSize, &stageBuffer, &stageAllocation);
 
     void* hbData;
-    void *data_ptr;
-    vkMapMemory(vk->deviceInfo.device, stageMemory, 0, mDataSize, 0, &data_ptr);
     AHardwareBuffer_lock(hb, AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, -1, nullptr, &hbData);
-    memcpy(data_ptr, hbData, mDataSize);
+    memcpy(stageAllocation.mapped, hbData, mDataSize);
     AHardwareBuffer_unlock(hb, nullptr);
-    vkUnmapMemory(vk->deviceInfo.device, stageMemory);
 
     VkCommandBuffer cmdBuffer;
     VkHelper::allocateCommandBuffers(vk->deviceInfo.device, vk->cmdPool, 1, &cmdBuffer);
@@ -228,8 +225,7 @@ void VkCameraImage::update(VkBundle *vk, VkImageUsageFlags usage, VkSharingMode
     };
     vkCmdCopyBufferToImage(cmdBuffer, stageBuffer, mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
     VkHelper::endCommandBuffer(cmdBuffer, vk->deviceInfo.device, vk->cmdPool, vk->queueInfo.queue, true);
-    vkDestroyBuffer(vk->deviceInfo.device, stageBuffer, VK_ALLOC);
-    vkFreeMemory(vk->deviceInfo.device, stageMemory, VK_ALLOC);
+    VkHelper::destroyBuffer(vk->allocator, vk->deviceInfo.device, &stageBuffer, &stageAllocation);
 #endif
     //check memory requirements
     VkImageMemoryRequirementsInfo2 memReqsInfo = {
@@ -1,44 +1,148 @@
 #include "VkCameraImageV2.h"
 #include "VkHelper.h"
 
-#define IMAGE_WIDTH 1920
-#define IMAGE_HEIGHT 1440
+#define YCBCR_FORMAT VK_FORMAT_G8_B8R8_2PLANE_420_UNORM
 
-VkCameraImageV2::VkCameraImageV2(VkBundle *vk){
+#ifdef VK_EXT_host_image_copy
+// SHADER_READ_ONLY_OPTIMAL when the driver copies into it, otherwise GENERAL which every driver has to accept
+static VkImageLayout getHostCopyLayout(const VkBundle *vk) {
+    auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+            vkGetInstanceProcAddr(vk->instance, "vkGetPhysicalDeviceProperties2"));
+    if(getProperties2 == nullptr){
+        return VK_IMAGE_LAYOUT_GENERAL;
+    }
+    VkPhysicalDeviceHostImageCopyPropertiesEXT hostCopyProps = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT,
+            .pNext = nullptr,
+    };
+    VkPhysicalDeviceProperties2 props2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &hostCopyProps,
+    };
+    getProperties2(vk->deviceInfo.physicalDev, &props2);
+    std::vector<VkImageLayout> copyDstLayouts(hostCopyProps.copyDstLayoutCount);
+    hostCopyProps.pCopySrcLayouts = nullptr;
+    hostCopyProps.copySrcLayoutCount = 0;
+    hostCopyProps.pCopyDstLayouts = copyDstLayouts.data();
+    getProperties2(vk->deviceInfo.physicalDev, &props2);
+    for(VkImageLayout layout : copyDstLayouts){
+        if(layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
+            return layout;
+        }
+    }
+    return VK_IMAGE_LAYOUT_GENERAL;
+}
+
+static bool isHostCopySupported(const VkBundle *vk, VkFormat format, uint32_t layerCount) {
+    if(vkGetPhysicalDeviceImageFormatProperties2 == nullptr){
+        return false;
+    }
+    VkPhysicalDeviceImageFormatInfo2 formatInfo = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+            .pNext = nullptr,
+            .format = format,
+            .type = VK_IMAGE_TYPE_2D,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT,
+            .flags = 0
+    };
+    VkImageFormatProperties2 formatProps = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+            .pNext = nullptr,
+    };
+    VkResult rt = vkGetPhysicalDeviceImageFormatProperties2(vk->deviceInfo.physicalDev, &formatInfo, &formatProps);
+    return rt == VK_SUCCESS && formatProps.imageFormatProperties.maxArrayLayers >= layerCount;
+}
+#endif
+
+VkCameraImageV2::VkCameraImageV2(VkBundle *vk, UploadBatch *uploadBatch, bool layered,
+                                 VkSamplerYcbcrConversion ycbcrConversion, VkSampler ycbcrSampler, CameraUploadMode uploadMode,
+                                 uint32_t slotCount){
     mVkBundle = vk;
-    init();
+    mSlotCount = std::min<uint32_t>(std::max<uint32_t>(slotCount, 1), CAMERA_MAX_UPLOAD_SLOTS);
+    bLayered = layered;
+    mYcbcrConversion = ycbcrConversion;
+    mYcbcrSampler = ycbcrSampler;
+    mUploadMode = uploadMode;
+#ifdef VK_EXT_host_image_copy
+    if(mUploadMode == CameraUploadMode::HOST_IMAGE_COPY){
+        mCopyMemoryToImage = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(
+                vkGetDeviceProcAddr(mVkBundle->deviceInfo.device, "vkCopyMemoryToImageEXT"));
+        LOG_D("vkCopyMemoryToImageEXT==%p", mCopyMemoryToImage);
+        if(mCopyMemoryToImage == nullptr){
+            throw std::runtime_error("vkCopyMemoryToImageEXT is missing.");
+        }
+        mSampledLayout = getHostCopyLayout(mVkBundle);
+    }
+#endif
+    // host access to a linear image is only defined in GENERAL or PREINITIALIZED
+    if(mUploadMode == CameraUploadMode::HOST_LINEAR){
+        mSampledLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+    init(uploadBatch);
 }
 
 VkCameraImageV2::~VkCameraImageV2() {
     destroyImgs();
 }
 
-void VkCameraImageV2::init() {
-    VkHelper::createBuffer(mVkBundle->deviceInfo.physicalDevMemoProps, mVkBundle->deviceInfo.device, mVkBundle->cmdPool, mVkBundle->queueInfo.queue,
-                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, IMAGE_WIDTH * IMAGE_HEIGHT, nullptr, &mBufferY, &mBufferMemoryY);
-    VkHelper::createBuffer(mVkBundle->deviceInfo.physicalDevMemoProps, mVkBundle->deviceInfo.device, mVkBundle->cmdPool, mVkBundle->queueInfo.queue,
-                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, IMAGE_WIDTH * IMAGE_HEIGHT, nullptr, &mBufferUV, &mBufferMemoryUV);
-    VkCommandBuffer cmdBuffer;
-    VkHelper::allocateCommandBuffers(mVkBundle->deviceInfo.device, mVkBundle->cmdPool, 1, &cmdBuffer);
-    VkHelper::beginCommandBuffer(cmdBuffer, true);
-    for(auto & cameraImage : mCameraImages) {
+void VkCameraImageV2::init(UploadBatch *uploadBatch) {
+    for(uint32_t slotIndex = 0; slotIndex < mSlotCount; slotIndex++){
+        UploadSlot &slot = mSlots[slotIndex];
+        // staging buffers stay persistently mapped for the lifetime of the camera images
+        for(uint32_t i = 0; i < 2 && mUploadMode == CameraUploadMode::STAGING; i++){
+            VkHelper::createBufferInternal(mVkBundle->allocator, mVkBundle->deviceInfo.device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                           AllocationUsage::RESOURCE, IMAGE_WIDTH * IMAGE_HEIGHT, &slot.mBufferY[i], &slot.mBufferAllocY[i]);
+            VkHelper::createBufferInternal(mVkBundle->allocator, mVkBundle->deviceInfo.device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                           AllocationUsage::RESOURCE, IMAGE_WIDTH * IMAGE_HEIGHT, &slot.mBufferUV[i], &slot.mBufferAllocUV[i]);
+        }
+    }
+    // the initial layout transitions ride along with the other init uploads
+    VkCommandBuffer cmdBuffer = uploadBatch->getCommandBuffer();
+    uint32_t imageCount = bLayered ? 1 : 2;
+    uint32_t layerCount = bLayered ? 2 : 1;
+    for(uint32_t i = 0; i < imageCount * mSlotCount; i++) {
+        VkCameraImage &cameraImage = mSlots[i / imageCount].mCameraImages[i % imageCount];
+        if(mYcbcrConversion != VK_NULL_HANDLE){
+            initYcbcrImg(layerCount, cmdBuffer, &cameraImage.yImg.mImg, &cameraImage.yImg.mAllocation, &cameraImage.yImg.mImgView);
+            continue;
+        }
         // y plane
-        initImgs(VK_FORMAT_R8_UNORM, IMAGE_WIDTH, IMAGE_HEIGHT, cmdBuffer,
-                 &cameraImage.yImg.mImg, &cameraImage.yImg.mMemory,
-                 &cameraImage.yImg.mImgView, &cameraImage.yImg.mSampler);
+        initImgs(VK_FORMAT_R8_UNORM, IMAGE_WIDTH, IMAGE_HEIGHT, layerCount, cmdBuffer,
+                 &cameraImage.yImg.mImg, &cameraImage.yImg.mAllocation,
+                 &cameraImage.yImg.mImgView, &cameraImage.yImg.mSampler, &cameraImage.yImg.mHostLayout);
 
         // uv plane
-        initImgs(VK_FORMAT_R8G8_UNORM, IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2, cmdBuffer,
-                 &cameraImage.uvImg.mImg, &cameraImage.uvImg.mMemory,
-                 &cameraImage.uvImg.mImgView, &cameraImage.uvImg.mSampler);
+        initImgs(VK_FORMAT_R8G8_UNORM, IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2, layerCount, cmdBuffer,
+                 &cameraImage.uvImg.mImg, &cameraImage.uvImg.mAllocation,
+                 &cameraImage.uvImg.mImgView, &cameraImage.uvImg.mSampler, &cameraImage.uvImg.mHostLayout);
+    }
+}
+
+VkImageUsageFlags VkCameraImageV2::planeUsage() const {
+    switch(mUploadMode){
+#ifdef VK_EXT_host_image_copy
+        case CameraUploadMode::HOST_IMAGE_COPY:
+            return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+#endif
+        case CameraUploadMode::HOST_LINEAR:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        case CameraUploadMode::STAGING:
+        default:
+            return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
-    VkHelper::endCommandBuffer(cmdBuffer, mVkBundle->deviceInfo.device, mVkBundle->cmdPool, mVkBundle->queueInfo.queue, true);
 }
 
-void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height, VkCommandBuffer cmdBuffer,
-                           VkImage *outImg, VkDeviceMemory *outMemory, VkImageView *outImgView, VkSampler *outSampler) {
+void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount, VkCommandBuffer cmdBuffer,
+                               VkImage *outImg, VkAllocation *outAllocation, VkImageView *outImgView, VkSampler *outSampler,
+                               VkSubresourceLayout *outHostLayout) {
+    // staging keeps its linear single layer images, host image copy wants optimal tiling
+    VkImageTiling tiling = layerCount > 1 ? VK_IMAGE_TILING_OPTIMAL : VK_IMAGE_TILING_LINEAR;
+    if(mUploadMode == CameraUploadMode::HOST_IMAGE_COPY){
+        tiling = VK_IMAGE_TILING_OPTIMAL;
+    }
     //image
     VkImageCreateInfo imageInfo = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -48,10 +152,11 @@ void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height,
             .format = format,
             .extent = VkExtent3D{ width, height, 1 },
             .mipLevels = 1,
-            .arrayLayers = 1,
+            .arrayLayers = layerCount,
             .samples = VK_SAMPLE_COUNT_1_BIT,
-            .tiling = VK_IMAGE_TILING_LINEAR,
-            .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            // linear images are only guaranteed with a single layer
+            .tiling = tiling,
+            .usage = planeUsage(),
             .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
             .queueFamilyIndexCount = 0,
             .pQueueFamilyIndices = nullptr,
@@ -59,19 +164,17 @@ void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height,
     };
     CALL_VK(vkCreateImage(mVkBundle->deviceInfo.device, &imageInfo, VK_ALLOC, outImg));
 
-    VkMemoryRequirements memReqs{};
-    vkGetImageMemoryRequirements(mVkBundle->deviceInfo.device, *outImg, &memReqs);
-
-    VkMemoryAllocateInfo memoryAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .pNext = nullptr,
-            .allocationSize = memReqs.size,
-            .memoryTypeIndex = VkHelper::findMemoryType(mVkBundle->deviceInfo.physicalDevMemoProps, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    CALL_VK(vkAllocateMemory(mVkBundle->deviceInfo.device, &memoryAllocateInfo, VK_ALLOC, outMemory));
-    vkBindImageMemory(mVkBundle->deviceInfo.device, *outImg, *outMemory, 0);
+    if(mUploadMode == CameraUploadMode::HOST_LINEAR){
+        // stays mapped through the allocator block, rows are written at the pitch the driver picked
+        mVkBundle->allocator->allocateAndBindImage(*outImg, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                   AllocationUsage::RESOURCE, outAllocation);
+        VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+        vkGetImageSubresourceLayout(mVkBundle->deviceInfo.device, *outImg, &subresource, outHostLayout);
+    } else {
+        mVkBundle->allocator->allocateAndBindImage(*outImg, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationUsage::RESOURCE, outAllocation);
+    }
 
-    VkHelper::transition_image_layout(*outImg, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer);
+    VkHelper::transition_image_layout(*outImg, VK_IMAGE_LAYOUT_UNDEFINED, mSampledLayout, cmdBuffer, 0, layerCount);
 
     // view
     VkImageViewCreateInfo imgViewInfo = {
@@ -79,7 +182,7 @@ void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height,
             .pNext = nullptr,
             .flags = 0,
             .image = *outImg,
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
             .format = format,
             .components = {
                     .r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -92,7 +195,7 @@ void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height,
                     .baseMipLevel = 0,
                     .levelCount = 1,
                     .baseArrayLayer = 0,
-                    .layerCount = 1
+                    .layerCount = layerCount
             }
     };
     CALL_VK(vkCreateImageView(mVkBundle->deviceInfo.device, &imgViewInfo, VK_ALLOC, outImgView));
@@ -121,40 +224,349 @@ void VkCameraImageV2::initImgs(VkFormat format, uint32_t width, uint32_t height,
     CALL_VK(vkCreateSampler(mVkBundle->deviceInfo.device, &samplerCreateInfo, VK_ALLOC, outSampler));
 }
 
-void VkCameraImageV2::updateImg(uint32_t eyeIndex, const AImage *image) {
-    if(!image){
+void VkCameraImageV2::initYcbcrImg(uint32_t layerCount, VkCommandBuffer cmdBuffer, VkImage *outImg, VkAllocation *outAllocation,
+                                   VkImageView *outImgView) {
+    VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = YCBCR_FORMAT,
+            .extent = VkExtent3D{ IMAGE_WIDTH, IMAGE_HEIGHT, 1 },
+            .mipLevels = 1,
+            .arrayLayers = layerCount,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = planeUsage(),
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    CALL_VK(vkCreateImage(mVkBundle->deviceInfo.device, &imageInfo, VK_ALLOC, outImg));
+    // not disjoint, both planes share one allocation and the color aspect covers them in barriers
+    mVkBundle->allocator->allocateAndBindImage(*outImg, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationUsage::RESOURCE, outAllocation);
+
+    VkHelper::transition_image_layout(*outImg, VK_IMAGE_LAYOUT_UNDEFINED, mSampledLayout, cmdBuffer, 0, layerCount);
+
+    VkSamplerYcbcrConversionInfo conversionInfo = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO,
+            .pNext = nullptr,
+            .conversion = mYcbcrConversion
+    };
+    VkImageViewCreateInfo imgViewInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = &conversionInfo,
+            .flags = 0,
+            .image = *outImg,
+            .viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
+            .format = YCBCR_FORMAT,
+            .components = {
+                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY
+            },
+            .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = layerCount
+            }
+    };
+    CALL_VK(vkCreateImageView(mVkBundle->deviceInfo.device, &imgViewInfo, VK_ALLOC, outImgView));
+}
+
+bool VkCameraImageV2::isYcbcrSupported(const VkBundle *vk, bool layered) {
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(vk->deviceInfo.physicalDev, YCBCR_FORMAT, &formatProps);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    VkFormatFeatureFlags chroma = VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT | VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT;
+    if((formatProps.optimalTilingFeatures & required) != required || (formatProps.optimalTilingFeatures & chroma) == 0){
+        LOG_W("G8_B8R8_2PLANE_420 can not be sampled or copied to.");
+        return false;
+    }
+    if(layered){
+        // multi-planar formats only guarantee a single layer
+        VkImageFormatProperties imageFormatProps;
+        VkResult rt = vkGetPhysicalDeviceImageFormatProperties(vk->deviceInfo.physicalDev, YCBCR_FORMAT, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
+                                                               VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 0, &imageFormatProps);
+        if(rt != VK_SUCCESS || imageFormatProps.maxArrayLayers < 2){
+            LOG_W("G8_B8R8_2PLANE_420 array images are not supported.");
+            return false;
+        }
+    }
+    return true;
+}
+
+void VkCameraImageV2::createYcbcrSampler(const VkBundle *vk, const CameraColorFormat &format,
+                                         VkSamplerYcbcrConversion *out_conversion, VkSampler *out_sampler) {
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(vk->deviceInfo.physicalDev, YCBCR_FORMAT, &formatProps);
+    VkChromaLocation chromaLocation = (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT) != 0 ?
+                                      VK_CHROMA_LOCATION_COSITED_EVEN : VK_CHROMA_LOCATION_MIDPOINT;
+    VkSamplerYcbcrModelConversion model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_601;
+    if(format.colorModel == ColorModel::BT709){
+        model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709;
+    } else if(format.colorModel == ColorModel::BT2020){
+        model = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_2020;
+    }
+    // the conversion reads Cb from B and Cr from R, with V stored before U those two swap
+    bool bSwapChroma = format.chromaOrder == ChromaOrder::NV21;
+    VkSamplerYcbcrConversionCreateInfo convInfo = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+            .pNext = nullptr,
+            .format = YCBCR_FORMAT,
+            .ycbcrModel = model,
+            .ycbcrRange = format.colorRange == ColorRange::LIMITED ? VK_SAMPLER_YCBCR_RANGE_ITU_NARROW : VK_SAMPLER_YCBCR_RANGE_ITU_FULL,
+            .components = {
+                    .r = bSwapChroma ? VK_COMPONENT_SWIZZLE_B : VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = bSwapChroma ? VK_COMPONENT_SWIZZLE_R : VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY
+            },
+            .xChromaOffset = chromaLocation,
+            .yChromaOffset = chromaLocation,
+            .chromaFilter = VK_FILTER_NEAREST,
+            .forceExplicitReconstruction = VK_FALSE
+    };
+    CALL_VK(vkCreateSamplerYcbcrConversion(vk->deviceInfo.device, &convInfo, VK_ALLOC, out_conversion));
+
+    VkSamplerYcbcrConversionInfo conversionInfo = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO,
+            .pNext = nullptr,
+            .conversion = *out_conversion
+    };
+    // a conversion sampler has to clamp, filter like the chroma and skip anisotropy
+    VkSamplerCreateInfo samplerCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext = &conversionInfo,
+            .flags = 0,
+            .magFilter = VK_FILTER_NEAREST,
+            .minFilter = VK_FILTER_NEAREST,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .mipLodBias = 0.0f,
+            .anisotropyEnable = VK_FALSE,
+            .maxAnisotropy = 1.0f,
+            .compareEnable = VK_FALSE,
+            .compareOp = VK_COMPARE_OP_NEVER,
+            .minLod = 0.0f,
+            .maxLod = 0.0f,
+            .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+            .unnormalizedCoordinates = VK_FALSE
+    };
+    CALL_VK(vkCreateSampler(vk->deviceInfo.device, &samplerCreateInfo, VK_ALLOC, out_sampler));
+}
+
+CameraUploadMode VkCameraImageV2::resolveUploadMode(const VkBundle *vk, CameraUploadMode requested, bool layered, bool ycbcr) {
+    if(requested == CameraUploadMode::HOST_IMAGE_COPY){
+#ifdef VK_EXT_host_image_copy
+        uint32_t layerCount = layered ? 2 : 1;
+        bool bFormats = ycbcr ? isHostCopySupported(vk, YCBCR_FORMAT, layerCount) :
+                        isHostCopySupported(vk, VK_FORMAT_R8_UNORM, layerCount) && isHostCopySupported(vk, VK_FORMAT_R8G8_UNORM, layerCount);
+        if(vk->deviceInfo.features.hostImageCopy && bFormats){
+            return CameraUploadMode::HOST_IMAGE_COPY;
+        }
+#endif
+        LOG_W("host image copy is not supported, trying a host visible linear image.");
+        requested = CameraUploadMode::HOST_LINEAR;
+    }
+    if(requested == CameraUploadMode::HOST_LINEAR){
+        VkFormatProperties yProps, uvProps;
+        vkGetPhysicalDeviceFormatProperties(vk->deviceInfo.physicalDev, VK_FORMAT_R8_UNORM, &yProps);
+        vkGetPhysicalDeviceFormatProperties(vk->deviceInfo.physicalDev, VK_FORMAT_R8G8_UNORM, &uvProps);
+        bool bSampled = (yProps.linearTilingFeatures & uvProps.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+        // linear images have a single layer and no multi-planar format
+        if(!layered && !ycbcr && bSampled){
+            return CameraUploadMode::HOST_LINEAR;
+        }
+        LOG_W("host visible linear images do not fit, falling back to staging.");
+    }
+    return CameraUploadMode::STAGING;
+}
+
+const char *VkCameraImageV2::uploadModeName(CameraUploadMode mode) {
+    switch(mode){
+        case CameraUploadMode::HOST_IMAGE_COPY:
+            return "host image copy";
+        case CameraUploadMode::HOST_LINEAR:
+            return "host linear";
+        case CameraUploadMode::STAGING:
+        default:
+            return "staging";
+    }
+}
+
+void VkCameraImageV2::updateImg(uint32_t eyeIndex, const CameraFrame &frame) {
+    UploadSlot &slot = mSlots[mSlot];
+    const VkCameraImage &cameraImage = slot.mCameraImages[bLayered ? 0 : eyeIndex];
+    bool bYcbcr = mYcbcrConversion != VK_NULL_HANDLE;
+    switch(mUploadMode){
+        case CameraUploadMode::STAGING:
+            memcpy(slot.mBufferAllocY[eyeIndex].mapped, frame.yData, std::min<size_t>(frame.yDataLen, IMAGE_WIDTH * IMAGE_HEIGHT));
+            memcpy(slot.mBufferAllocUV[eyeIndex].mapped, frame.uvData, std::min<size_t>(frame.uvDataLen, IMAGE_WIDTH * IMAGE_HEIGHT));
+            break;
+        case CameraUploadMode::HOST_IMAGE_COPY:
+            // the previous frame is done with the image, the next submission sees the host write without a barrier
+            hostCopyPlane(cameraImage.yImg.mImg, bYcbcr ? VK_IMAGE_ASPECT_PLANE_0_BIT : VK_IMAGE_ASPECT_COLOR_BIT, bLayered ? eyeIndex : 0,
+                          frame.yData, frame.yDataLen, IMAGE_WIDTH, IMAGE_HEIGHT, 1);
+            hostCopyPlane(bYcbcr ? cameraImage.yImg.mImg : cameraImage.uvImg.mImg, bYcbcr ? VK_IMAGE_ASPECT_PLANE_1_BIT : VK_IMAGE_ASPECT_COLOR_BIT,
+                          bLayered ? eyeIndex : 0, frame.uvData, frame.uvDataLen, IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2, 2);
+            break;
+        case CameraUploadMode::HOST_LINEAR:
+            linearCopyPlane(cameraImage.yImg.mAllocation, cameraImage.yImg.mHostLayout, frame.yData, frame.yDataLen, IMAGE_WIDTH, IMAGE_HEIGHT);
+            linearCopyPlane(cameraImage.uvImg.mAllocation, cameraImage.uvImg.mHostLayout, frame.uvData, frame.uvDataLen, IMAGE_WIDTH, IMAGE_HEIGHT / 2);
+            break;
+    }
+}
+
+void VkCameraImageV2::hostCopyPlane(VkImage image, VkImageAspectFlags aspect, uint32_t layer, const uint8_t *data, size_t dataLen,
+                                    uint32_t width, uint32_t height, uint32_t texelSize) {
+#ifdef VK_EXT_host_image_copy
+    size_t rowSize = width * texelSize;
+    uint32_t fullRows = std::min<size_t>(dataLen / rowSize, height);
+    VkMemoryToImageCopyEXT regions[2];
+    uint32_t regionCount = 0;
+    if(fullRows > 0){
+        regions[regionCount++] = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT,
+                .pNext = nullptr,
+                .pHostPointer = data,
+                .memoryRowLength = 0,
+                .memoryImageHeight = 0,
+                .imageSubresource = { aspect, 0, layer, 1 },
+                .imageOffset = {0, 0, 0},
+                .imageExtent = { width, fullRows, 1 }
+        };
+    }
+    // an interleaved chroma plane of YUV_420_888 ends one byte before its last texel, that row goes through a copy
+    if(fullRows < height && dataLen > fullRows * rowSize){
+        mTailRow.assign(rowSize, 0);
+        memcpy(mTailRow.data(), data + fullRows * rowSize, dataLen - fullRows * rowSize);
+        regions[regionCount++] = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT,
+                .pNext = nullptr,
+                .pHostPointer = mTailRow.data(),
+                .memoryRowLength = 0,
+                .memoryImageHeight = 0,
+                .imageSubresource = { aspect, 0, layer, 1 },
+                .imageOffset = {0, static_cast<int32_t>(fullRows), 0},
+                .imageExtent = { width, 1, 1 }
+        };
+    }
+    if(regionCount == 0){
+        return;
+    }
+    VkCopyMemoryToImageInfoEXT copyInfo = {
+            .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT,
+            .pNext = nullptr,
+            .flags = 0,
+            .dstImage = image,
+            .dstImageLayout = mSampledLayout,
+            .regionCount = regionCount,
+            .pRegions = regions
+    };
+    CALL_VK(mCopyMemoryToImage(mVkBundle->deviceInfo.device, &copyInfo));
+#endif
+}
+
+void VkCameraImageV2::linearCopyPlane(const VkAllocation &allocation, const VkSubresourceLayout &layout, const uint8_t *data, size_t dataLen,
+                                      uint32_t rowSize, uint32_t height) {
+    uint8_t *dst = static_cast<uint8_t *>(allocation.mapped) + layout.offset;
+    size_t srcOffset = 0;
+    for(uint32_t row = 0; row < height && srcOffset < dataLen; row++, srcOffset += rowSize){
+        memcpy(dst + row * layout.rowPitch, data + srcOffset, std::min<size_t>(rowSize, dataLen - srcOffset));
+    }
+}
+
+void VkCameraImageV2::registerResources(VkFrameGraph *frameGraph) {
+    const char *names[2][2] = {{"CameraLeftY", "CameraLeftUV"}, {"CameraRightY", "CameraRightUV"}};
+    // host writes are done before anything of the frame is submitted, the passes have nothing to wait for
+    for(uint32_t slotIndex = 0; slotIndex < mSlotCount; slotIndex++){
+        UploadSlot &slot = mSlots[slotIndex];
+        for(uint32_t eyeIndex = 0; eyeIndex < 2; eyeIndex++){
+            if(mUploadMode != CameraUploadMode::STAGING){
+                slot.mResources[eyeIndex][PLANE_Y] = INVALID_FRAME_RESOURCE;
+                slot.mResources[eyeIndex][PLANE_UV] = INVALID_FRAME_RESOURCE;
+                continue;
+            }
+            const VkCameraImage &cameraImage = slot.mCameraImages[bLayered ? 0 : eyeIndex];
+            VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, bLayered ? eyeIndex : 0, 1 };
+            // init left the planes ready for sampling
+            slot.mResources[eyeIndex][PLANE_Y] = frameGraph->registerImage(names[eyeIndex][PLANE_Y], cameraImage.yImg.mImg, range,
+                                                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            if(mYcbcrConversion != VK_NULL_HANDLE){
+                slot.mResources[eyeIndex][PLANE_UV] = slot.mResources[eyeIndex][PLANE_Y];
+                continue;
+            }
+            slot.mResources[eyeIndex][PLANE_UV] = frameGraph->registerImage(names[eyeIndex][PLANE_UV], cameraImage.uvImg.mImg, range,
+                                                                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+    }
+}
+
+FrameResourceId VkCameraImageV2::getResource(uint32_t eyeIndex, YuvPlane plane) const {
+    return mSlots[mSlot].mResources[eyeIndex][plane];
+}
+
+void VkCameraImageV2::addUploadPass(VkFrameGraph *frameGraph, uint32_t eyeIndex) {
+    if(mUploadMode != CameraUploadMode::STAGING){
         return;
     }
+    const UploadSlot &slot = mSlots[mSlot];
+    std::vector<ResourceAccess> accesses = {{slot.mResources[eyeIndex][PLANE_Y], ResourceUsage::TRANSFER_WRITE}};
+    if(slot.mResources[eyeIndex][PLANE_UV] != slot.mResources[eyeIndex][PLANE_Y]){
+        accesses.push_back({slot.mResources[eyeIndex][PLANE_UV], ResourceUsage::TRANSFER_WRITE});
+    }
+    frameGraph->addPass(eyeIndex == 0 ? "UploadLeft" : "UploadRight", accesses, [this, eyeIndex](VkCommandBuffer cmdBuffer){
+        recordCopies(cmdBuffer, eyeIndex);
+    });
+}
+
+void VkCameraImageV2::recordTransferUpload(VkCommandBuffer cmdBuffer, uint32_t eyeIndex, uint32_t srcQueueFamily, uint32_t dstQueueFamily) {
+    const VkCameraImage &cameraImage = mSlots[mSlot].mCameraImages[bLayered ? 0 : eyeIndex];
+    bool bYcbcr = mYcbcrConversion != VK_NULL_HANDLE;
+    VkImage images[] = {cameraImage.yImg.mImg, cameraImage.uvImg.mImg};
+    uint32_t imageCount = bYcbcr ? 1 : 2;
+    VkImageMemoryBarrier barriers[2];
+    // the whole plane is overwritten, so the last content and its owner do not matter
+    for(uint32_t i = 0; i < imageCount; i++){
+        barriers[i] = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = images[i],
+                .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, bLayered ? eyeIndex : 0, 1 }
+        };
+    }
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                         imageCount, barriers);
+    recordCopies(cmdBuffer, eyeIndex);
+    // release, the graphics queue repeats the same transition in its acquire
+    for(uint32_t i = 0; i < imageCount; i++){
+        barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[i].dstAccessMask = 0;
+        barriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[i].srcQueueFamilyIndex = srcQueueFamily;
+        barriers[i].dstQueueFamilyIndex = dstQueueFamily;
+    }
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                         imageCount, barriers);
+}
 
-    int64_t timeStamp = 0;
-    AImage_getTimestamp(image, &timeStamp);
-    int64_t diffNs = getTimeNano(CLOCK_MONOTONIC) - timeStamp;
-    LOG_D("%s Update:%.2f, %lu", eyeIndex == 0 ? "Left" : "Right", (diffNs * 1.f) / U_TIME_1MS_IN_NS, timeStamp);
-    int width, height;
-    int numPlanes = 0;
-    uint8_t *yData, *uvData;
-    int32_t yDataLen = 0, uvDataLen = 0;
-    AImage_getWidth(image, &width);
-    AImage_getHeight(image, &height);
-    AImage_getNumberOfPlanes(image, &numPlanes);
-    AImage_getPlaneData(image, 0, &yData, &yDataLen);
-    AImage_getPlaneData(image, 1, &uvData, &uvDataLen);
-
-    void *mapped;
-    vkMapMemory(mVkBundle->deviceInfo.device, mBufferMemoryY, 0, yDataLen, 0, &mapped);
-    memcpy(mapped, yData, yDataLen);
-    vkUnmapMemory(mVkBundle->deviceInfo.device, mBufferMemoryY);
-
-    vkMapMemory(mVkBundle->deviceInfo.device, mBufferMemoryUV, 0, uvDataLen, 0, &mapped);
-    memcpy(mapped, uvData, uvDataLen);
-    vkUnmapMemory(mVkBundle->deviceInfo.device, mBufferMemoryUV);
-
-    VkCameraImage cameraImage = mCameraImages[eyeIndex];
-    VkCommandBuffer cmdBuffer;
-    VkHelper::allocateCommandBuffers(mVkBundle->deviceInfo.device, mVkBundle->cmdPool, 1, &cmdBuffer);
-    VkHelper::beginCommandBuffer(cmdBuffer, true);
-    VkHelper::transition_image_layout(cameraImage.yImg.mImg, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer);
-    VkHelper::transition_image_layout(cameraImage.uvImg.mImg, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer);
+void VkCameraImageV2::recordCopies(VkCommandBuffer cmdBuffer, uint32_t eyeIndex) {
+    const UploadSlot &slot = mSlots[mSlot];
+    const VkCameraImage &cameraImage = slot.mCameraImages[bLayered ? 0 : eyeIndex];
     VkBufferImageCopy bufferCopyRegions ={
             .bufferOffset = 0,
             .bufferRowLength = 0,
@@ -162,20 +574,24 @@ void VkCameraImageV2::updateImg(uint32_t eyeIndex, const AImage *image) {
             .imageSubresource = {
                     .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
                     .mipLevel = 0,
-                    .baseArrayLayer = 0,
+                    .baseArrayLayer = bLayered ? eyeIndex : 0,
                     .layerCount = 1,
             },
             .imageOffset = {0, 0, 0},
             .imageExtent = { IMAGE_WIDTH, IMAGE_HEIGHT, 1},
     };
-    vkCmdCopyBufferToImage(cmdBuffer, mBufferY, cameraImage.yImg.mImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegions);
-    bufferCopyRegions.bufferOffset = 0;
+    bool bYcbcr = mYcbcrConversion != VK_NULL_HANDLE;
+    VkImage uvImg = bYcbcr ? cameraImage.yImg.mImg : cameraImage.uvImg.mImg;
+    if(bYcbcr){
+        bufferCopyRegions.imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+    }
+    vkCmdCopyBufferToImage(cmdBuffer, slot.mBufferY[eyeIndex], cameraImage.yImg.mImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegions);
+    // the chroma plane of the 4:2:0 image has half the extent in both directions
+    if(bYcbcr){
+        bufferCopyRegions.imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
+    }
     bufferCopyRegions.imageExtent = { IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2, 1 };
-    vkCmdCopyBufferToImage(cmdBuffer, mBufferUV, cameraImage.uvImg.mImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegions);
-
-    VkHelper::transition_image_layout(cameraImage.yImg.mImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer);
-    VkHelper::transition_image_layout(cameraImage.uvImg.mImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer);
-    VkHelper::endCommandBuffer(cmdBuffer, mVkBundle->deviceInfo.device, mVkBundle->cmdPool, mVkBundle->queueInfo.queue, true);
+    vkCmdCopyBufferToImage(cmdBuffer, slot.mBufferUV[eyeIndex], uvImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegions);
 }
 
 VkImageView VkCameraImageV2::getImgView(uint16_t eyeIndex, YuvPlane plane) {
@@ -183,10 +599,11 @@ VkImageView VkCameraImageV2::getImgView(uint16_t eyeIndex, YuvPlane plane) {
         LOG_E("eye index must in (0, 1).");
         return VK_NULL_HANDLE;
     }
-    if(plane == PLANE_Y){
-        return mCameraImages[eyeIndex].yImg.mImgView;
+    const VkCameraImage &cameraImage = mSlots[mSlot].mCameraImages[bLayered ? 0 : eyeIndex];
+    if(plane == PLANE_Y || mYcbcrConversion != VK_NULL_HANDLE){
+        return cameraImage.yImg.mImgView;
     } else {
-        return mCameraImages[eyeIndex].uvImg.mImgView;
+        return cameraImage.uvImg.mImgView;
     }
 }
 
@@ -195,28 +612,26 @@ VkSampler VkCameraImageV2::getSampler(uint16_t eyeIndex, YuvPlane plane) {
         LOG_E("eye index must in (0, 1).");
         return VK_NULL_HANDLE;
     }
+    if(mYcbcrConversion != VK_NULL_HANDLE){
+        return mYcbcrSampler;
+    }
+    const VkCameraImage &cameraImage = mSlots[mSlot].mCameraImages[bLayered ? 0 : eyeIndex];
     if(plane == PLANE_Y){
-        return mCameraImages[eyeIndex].yImg.mSampler;
+        return cameraImage.yImg.mSampler;
     } else {
-        return mCameraImages[eyeIndex].uvImg.mSampler;
+        return cameraImage.uvImg.mSampler;
     }
 }
 
 void VkCameraImageV2::destroyImgs() {
-    for(auto &cameraImg : mCameraImages){
+    for(uint32_t i = 0; i < ARRAY_SIZE(mSlots) * 2; i++){
+        VkCameraImage &cameraImg = mSlots[i / 2].mCameraImages[i % 2];
         // y plane
         if(cameraImg.yImg.mImgView != VK_NULL_HANDLE){
             vkDestroyImageView(mVkBundle->deviceInfo.device, cameraImg.yImg.mImgView, VK_ALLOC);
             cameraImg.yImg.mImgView = VK_NULL_HANDLE;
         }
-        if(cameraImg.yImg.mMemory != VK_NULL_HANDLE){
-            vkFreeMemory(mVkBundle->deviceInfo.device, cameraImg.yImg.mMemory, VK_ALLOC);
-            cameraImg.yImg.mMemory = VK_NULL_HANDLE;
-        }
-        if(cameraImg.yImg.mImg != VK_NULL_HANDLE){
-            vkDestroyImage(mVkBundle->deviceInfo.device, cameraImg.yImg.mImg, VK_ALLOC);
-            cameraImg.yImg.mImg = VK_NULL_HANDLE;
-        }
+        VkHelper::destroyImage(mVkBundle->allocator, mVkBundle->deviceInfo.device, &cameraImg.yImg.mImg, &cameraImg.yImg.mAllocation);
         if(cameraImg.yImg.mSampler != VK_NULL_HANDLE){
             vkDestroySampler(mVkBundle->deviceInfo.device, cameraImg.yImg.mSampler, VK_ALLOC);
             cameraImg.yImg.mSampler = VK_NULL_HANDLE;
@@ -227,22 +642,17 @@ void VkCameraImageV2::destroyImgs() {
             vkDestroyImageView(mVkBundle->deviceInfo.device, cameraImg.uvImg.mImgView, VK_ALLOC);
             cameraImg.uvImg.mImgView = VK_NULL_HANDLE;
         }
-        if(cameraImg.uvImg.mMemory != VK_NULL_HANDLE){
-            vkFreeMemory(mVkBundle->deviceInfo.device, cameraImg.uvImg.mMemory, VK_ALLOC);
-            cameraImg.uvImg.mMemory = VK_NULL_HANDLE;
-        }
-        if(cameraImg.uvImg.mImg != VK_NULL_HANDLE){
-            vkDestroyImage(mVkBundle->deviceInfo.device, cameraImg.uvImg.mImg, VK_ALLOC);
-            cameraImg.uvImg.mImg = VK_NULL_HANDLE;
-        }
+        VkHelper::destroyImage(mVkBundle->allocator, mVkBundle->deviceInfo.device, &cameraImg.uvImg.mImg, &cameraImg.uvImg.mAllocation);
         if(cameraImg.uvImg.mSampler != VK_NULL_HANDLE){
             vkDestroySampler(mVkBundle->deviceInfo.device, cameraImg.uvImg.mSampler, VK_ALLOC);
             cameraImg.uvImg.mSampler = VK_NULL_HANDLE;
         }
     }
-    vkDestroyBuffer(mVkBundle->deviceInfo.device, mBufferY, VK_ALLOC);
-    vkFreeMemory(mVkBundle->deviceInfo.device, mBufferMemoryY, VK_ALLOC);
-    vkDestroyBuffer(mVkBundle->deviceInfo.device, mBufferUV, VK_ALLOC);
-    vkFreeMemory(mVkBundle->deviceInfo.device, mBufferMemoryUV, VK_ALLOC);
+    for(auto &slot : mSlots){
+        for(uint32_t i = 0; i < 2; i++){
+            VkHelper::destroyBuffer(mVkBundle->allocator, mVkBundle->deviceInfo.device, &slot.mBufferY[i], &slot.mBufferAllocY[i]);
+            VkHelper::destroyBuffer(mVkBundle->allocator, mVkBundle->deviceInfo.device, &slot.mBufferUV[i], &slot.mBufferAllocUV[i]);
+        }
+    }
 }
 
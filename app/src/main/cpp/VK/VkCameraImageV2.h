@@ -1,48 +1,157 @@
 #pragma once
 
-#include <media/NdkImage.h>
 #include "VulkanCommon.h"
 #include "VkBundle.h"
+#include "VkMemoryAllocator.h"
+#include "UploadBatch.h"
+#include "VkFrameGraph.h"
+
+#define IMAGE_WIDTH 1920
+#define IMAGE_HEIGHT 1440
+#define CAMERA_MAX_UPLOAD_SLOTS 3         // one per frame in flight, see FRAME_RING_MAX_DEPTH
+
+enum class ChromaOrder : uint32_t{
+    NV12 = 0,           // U before V in the interleaved chroma plane
+    NV21 = 1            // V before U, what Android cameras usually deliver
+};
+
+enum class ColorModel : uint32_t{
+    BT601 = 0,
+    BT709 = 1,
+    BT2020 = 2
+};
+
+enum class ColorRange : uint32_t{
+    FULL = 0,
+    LIMITED = 1         // Y in 16..235, chroma in 16..240
+};
+
+// how the YUV of a frame turns into RGB, the separate plane shaders are specialized on it
+struct CameraColorFormat{
+    ChromaOrder chromaOrder = ChromaOrder::NV21;
+    ColorModel colorModel = ColorModel::BT601;      // JFIF, full range BT.601, unless the dataspace of the buffer says otherwise
+    ColorRange colorRange = ColorRange::FULL;
+
+    bool operator==(const CameraColorFormat &other) const {
+        return chromaOrder == other.chromaOrder && colorModel == other.colorModel && colorRange == other.colorRange;
+    };
+    bool operator!=(const CameraColorFormat &other) const { return !(*this == other); };
+};
+
+// one YUV_420_888 camera frame, uvData points at whichever chroma sample comes first in the interleaved plane
+struct CameraFrame{
+    const uint8_t *yData = nullptr;
+    int32_t yDataLen = 0;
+    const uint8_t *uvData = nullptr;
+    int32_t uvDataLen = 0;
+    int64_t timestamp = 0;
+    CameraColorFormat format;
+};
 
 enum YuvPlane{
     PLANE_Y,
     PLANE_UV
 };
 
+enum class CameraUploadMode{
+    STAGING,            // memcpy into a staging buffer, copied by the upload passes of the frame graph
+    HOST_IMAGE_COPY,    // VK_EXT_host_image_copy straight from the plane pointers into the optimal image
+    HOST_LINEAR         // memcpy into a persistently mapped LINEAR image, single layer and separate planes only
+};
+
 struct VkCameraImage{
     struct{
         VkImage mImg = VK_NULL_HANDLE;
-        VkDeviceMemory mMemory = VK_NULL_HANDLE;
+        VkAllocation mAllocation;
         VkImageView mImgView = VK_NULL_HANDLE;
         VkSampler mSampler = VK_NULL_HANDLE;
+        VkSubresourceLayout mHostLayout = {};   // HOST_LINEAR only
     } yImg;
 
     struct{
         VkImage mImg = VK_NULL_HANDLE;
-        VkDeviceMemory mMemory = VK_NULL_HANDLE;
+        VkAllocation mAllocation;
         VkImageView mImgView = VK_NULL_HANDLE;
         VkSampler mSampler = VK_NULL_HANDLE;
+        VkSubresourceLayout mHostLayout = {};   // HOST_LINEAR only
     } uvImg;
 };
 
+/**
+ * Camera planes of both eyes. In layered mode one 2-layer array image per plane holds both eyes,
+ * layer index == eye index, so the multiview pass can sample them with gl_ViewIndex.
+ * With a YCbCr conversion both planes live in one G8_B8R8_2PLANE_420 image per eye, sampled through the
+ * immutable conversion sampler, and plane Y and UV share the image view, the sampler and the frame graph image.
+ * In STAGING mode updateImg only fills the staging buffers, the copies run in the upload passes of the frame graph.
+ * The host modes write the planes from the CPU in updateImg, which has to run after the fence of the last frame that
+ * used the slot, and the planes are not frame graph images at all.
+ * With more than one slot every slot has its own images and staging buffers, setSlot() picks the one of the frame
+ * context being recorded and everything else works on it. That lets one frame fill its slot while earlier ones sample theirs.
+ */
 class VkCameraImageV2{
 public:
-    VkCameraImageV2(VkBundle *vk);
+    VkCameraImageV2(VkBundle *vk, UploadBatch *uploadBatch, bool layered = false,
+                    VkSamplerYcbcrConversion ycbcrConversion = VK_NULL_HANDLE, VkSampler ycbcrSampler = VK_NULL_HANDLE,
+                    CameraUploadMode uploadMode = CameraUploadMode::STAGING, uint32_t slotCount = 1);
     ~VkCameraImageV2();
-    void init();
-    void updateImg(uint32_t eyeIndex, const AImage *image);
+    void init(UploadBatch *uploadBatch);
+    void updateImg(uint32_t eyeIndex, const CameraFrame &frame);
+    static bool isYcbcrSupported(const VkBundle *vk, bool layered);
+    // the sampler has to be immutable in the descriptor set layout, so the renderer owns both and format is fixed at init
+    static void createYcbcrSampler(const VkBundle *vk, const CameraColorFormat &format,
+                                   VkSamplerYcbcrConversion *out_conversion, VkSampler *out_sampler);
+    // the requested mode or the next one down the chain HOST_IMAGE_COPY -> HOST_LINEAR -> STAGING the device can do
+    static CameraUploadMode resolveUploadMode(const VkBundle *vk, CameraUploadMode requested, bool layered, bool ycbcr);
+    static const char *uploadModeName(CameraUploadMode mode);
+    CameraUploadMode getUploadMode() const { return mUploadMode; };
+    // layout the planes are sampled in
+    VkImageLayout getSampledLayout() const { return mSampledLayout; };
+    // every plane of every eye becomes a frame graph image, in its layer range when layered, INVALID_FRAME_RESOURCE in the host modes
+    void registerResources(VkFrameGraph *frameGraph);
+    FrameResourceId getResource(uint32_t eyeIndex, YuvPlane plane) const;
+    // copies the staged frame of the eye into its planes, nothing to do in the host modes
+    void addUploadPass(VkFrameGraph *frameGraph, uint32_t eyeIndex);
+    void setSlot(uint32_t slot) { mSlot = slot % mSlotCount; };
+    // STAGING on a queue of srcQueueFamily outside the frame graph, the planes end up released to dstQueueFamily
+    // in SHADER_READ_ONLY_OPTIMAL, see VkFrameGraph::acquireImage
+    void recordTransferUpload(VkCommandBuffer cmdBuffer, uint32_t eyeIndex, uint32_t srcQueueFamily, uint32_t dstQueueFamily);
     VkImageView getImgView(uint16_t eyeIndex, YuvPlane plane);
     VkSampler getSampler(uint16_t eyeIndex, YuvPlane plane);
 private:
-    void initImgs(VkFormat format, uint32_t width, uint32_t height, VkCommandBuffer cmdBuffer,
-                  VkImage *outImg, VkDeviceMemory *outMemory, VkImageView *outImgView, VkSampler *outSampler);
+    void initImgs(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount, VkCommandBuffer cmdBuffer,
+                  VkImage *outImg, VkAllocation *outAllocation, VkImageView *outImgView, VkSampler *outSampler,
+                  VkSubresourceLayout *outHostLayout);
+    void initYcbcrImg(uint32_t layerCount, VkCommandBuffer cmdBuffer, VkImage *outImg, VkAllocation *outAllocation, VkImageView *outImgView);
     void destroyImgs();
+    VkImageUsageFlags planeUsage() const;
+    void recordCopies(VkCommandBuffer cmdBuffer, uint32_t eyeIndex);
+    void hostCopyPlane(VkImage image, VkImageAspectFlags aspect, uint32_t layer, const uint8_t *data, size_t dataLen,
+                       uint32_t width, uint32_t height, uint32_t texelSize);
+    static void linearCopyPlane(const VkAllocation &allocation, const VkSubresourceLayout &layout, const uint8_t *data, size_t dataLen,
+                                uint32_t rowSize, uint32_t height);
 
     VkBundle *mVkBundle;
-    VkCameraImage mCameraImages[2];
+    bool bLayered;
+    VkSamplerYcbcrConversion mYcbcrConversion;     // VK_NULL_HANDLE for separate Y and UV images
+    VkSampler mYcbcrSampler;                        // not owned
+    CameraUploadMode mUploadMode;
+    VkImageLayout mSampledLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+#ifdef VK_EXT_host_image_copy
+    PFN_vkCopyMemoryToImageEXT mCopyMemoryToImage = nullptr;
+#endif
+    std::vector<uint8_t> mTailRow;                  // the last row of a plane whose buffer is cut short, HOST_IMAGE_COPY only
+
+    struct UploadSlot{
+        VkCameraImage mCameraImages[2];         // only [0] is used in layered mode
 
-    VkBuffer mBufferY;
-    VkDeviceMemory mBufferMemoryY;
-    VkBuffer mBufferUV;
-    VkDeviceMemory mBufferMemoryUV;
+        // per eye, both eyes are staged before the copies are recorded, STAGING only
+        VkBuffer mBufferY[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+        VkAllocation mBufferAllocY[2];
+        VkBuffer mBufferUV[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+        VkAllocation mBufferAllocUV[2];
+        FrameResourceId mResources[2][2] = {};  // [eye][plane]
+    };
+    UploadSlot mSlots[CAMERA_MAX_UPLOAD_SLOTS];
+    uint32_t mSlotCount;
+    uint32_t mSlot = 0;
 };
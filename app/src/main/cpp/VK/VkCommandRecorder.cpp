@@ -0,0 +1,157 @@
+#include "VkCommandRecorder.h"
+#include <pthread.h>
+#include <string>
+#include "VkHelper.h"
+#include "../ProfileTrace.h"
+#include "../ThreadManager.h"
+
+#define RECORDER_STATS_INTERVAL 300
+
+VkCommandRecorder::VkCommandRecorder(VkBundle *vk, uint32_t workerCount, uint32_t slotCount) : mVk(vk), mWorkers(std::max(workerCount, 1u)) {
+    // command pools are externally synchronized, every worker records from its own
+    VkCommandPoolCreateInfo cmdPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = mVk->queueInfo.workQueueIndex
+    };
+    for(auto &worker : mWorkers){
+        CALL_VK(vkCreateCommandPool(mVk->deviceInfo.device, &cmdPoolCreateInfo, VK_ALLOC, &worker.cmdPool));
+        worker.slotCmdBuffers.resize(slotCount);
+    }
+    for(uint32_t i = 0; i < mWorkers.size(); i++){
+        mWorkers[i].thread = std::thread(&VkCommandRecorder::workerLoop, this, i);
+    }
+    LOG_D("VkCommandRecorder: %zu workers, %u slots", mWorkers.size(), slotCount);
+}
+
+VkCommandRecorder::~VkCommandRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        bStop = true;
+    }
+    mStartCond.notify_all();
+    for(auto &worker : mWorkers){
+        if(worker.thread.joinable()){
+            worker.thread.join();
+        }
+        // destroying the pool frees every buffer allocated from it
+        vkDestroyCommandPool(mVk->deviceInfo.device, worker.cmdPool, VK_ALLOC);
+    }
+}
+
+void VkCommandRecorder::record(uint32_t slot, const VkCommandBufferInheritanceInfo &inheritanceInfo,
+                               const std::vector<RecordJob> &jobs, VkCommandBuffer *out_secondaryCmdBuffers) {
+    if(jobs.empty()){
+        return;
+    }
+    uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+    TRACE_BEGIN("RecordSecondary:%zu", jobs.size());
+    std::unique_lock<std::mutex> lock(mMutex);
+    mSlot = slot;
+    mInheritanceInfo = &inheritanceInfo;
+    mJobs = &jobs;
+    mOutCmdBuffers = out_secondaryCmdBuffers;
+    mNextJob = 0;
+    mFinishedWorkers = 0;
+    mWorkerError = nullptr;
+    mGeneration++;
+    mStartCond.notify_all();
+    mDoneCond.wait(lock, [this]{ return mFinishedWorkers == mWorkers.size(); });
+    mJobs = nullptr;
+    mInheritanceInfo = nullptr;
+    mOutCmdBuffers = nullptr;
+    std::exception_ptr error = mWorkerError;
+    lock.unlock();
+    TRACE_END("RecordSecondary:%zu", jobs.size());
+    if(error){
+        std::rethrow_exception(error);
+    }
+
+    mRecordWallTimeNs += getTimeNano(CLOCK_MONOTONIC) - startTimeNs;
+    if(++mRecordCount % RECORDER_STATS_INTERVAL == 0){
+        printStats();
+    }
+}
+
+void VkCommandRecorder::printStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mRecordCount == 0){
+        return;
+    }
+    LOG_D("VkCommandRecorder: %zu workers, record wall time %.3f ms avg over %lu batches", mWorkers.size(),
+          mRecordWallTimeNs * 1.f / mRecordCount / U_TIME_1MS_IN_NS, mRecordCount);
+    for(uint32_t i = 0; i < mWorkers.size(); i++){
+        const Worker &worker = mWorkers[i];
+        LOG_D("    worker %u: %u jobs, %.3f ms recording, %.3f ms per batch", i, worker.jobCount,
+              worker.recordTimeNs * 1.f / U_TIME_1MS_IN_NS, worker.recordTimeNs * 1.f / mRecordCount / U_TIME_1MS_IN_NS);
+    }
+}
+
+void VkCommandRecorder::workerLoop(uint32_t workerIndex) {
+    std::string threadName = "VkRecord-" + std::to_string(workerIndex);
+    pthread_setname_np(pthread_self(), threadName.c_str());
+    ThreadManager::get().place(ThreadRole::RECORDER, threadName.c_str());
+    Worker &worker = mWorkers[workerIndex];
+    uint64_t seenGeneration = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStartCond.wait(lock, [&]{ return bStop || mGeneration != seenGeneration; });
+            if(bStop){
+                return;
+            }
+            seenGeneration = mGeneration;
+        }
+
+        uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+        uint32_t localIndex = 0;
+        std::exception_ptr error;
+        try{
+            uint32_t jobIndex;
+            while((jobIndex = mNextJob.fetch_add(1)) < mJobs->size()){
+                VkCommandBuffer cmdBuffer = acquireCmdBuffer(worker, mSlot, localIndex++);
+                VkCommandBufferBeginInfo beginInfo = {
+                        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                        .pNext = nullptr,
+                        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                        .pInheritanceInfo = mInheritanceInfo
+                };
+                CALL_VK(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
+                (*mJobs)[jobIndex](cmdBuffer);
+                CALL_VK(vkEndCommandBuffer(cmdBuffer));
+                mOutCmdBuffers[jobIndex] = cmdBuffer;
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        worker.recordTimeNs += getTimeNano(CLOCK_MONOTONIC) - startTimeNs;
+        worker.jobCount += localIndex;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(error && !mWorkerError){
+                mWorkerError = error;
+            }
+            mFinishedWorkers++;
+        }
+        mDoneCond.notify_one();
+    }
+}
+
+VkCommandBuffer VkCommandRecorder::acquireCmdBuffer(Worker &worker, uint32_t slot, uint32_t localIndex) {
+    std::vector<VkCommandBuffer> &cmdBuffers = worker.slotCmdBuffers[slot];
+    if(localIndex >= cmdBuffers.size()){
+        VkCommandBufferAllocateInfo allocateInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .commandPool = worker.cmdPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = 1
+        };
+        VkCommandBuffer cmdBuffer;
+        CALL_VK(vkAllocateCommandBuffers(mVk->deviceInfo.device, &allocateInfo, &cmdBuffer));
+        cmdBuffers.push_back(cmdBuffer);
+    }
+    return cmdBuffers[localIndex];
+}
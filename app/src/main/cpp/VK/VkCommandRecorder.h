@@ -0,0 +1,69 @@
+/*!
+ * @brief  Parallel secondary command buffer recording, one command pool per worker thread
+ * @date 2023/8/4
+ */
+#ifndef CAMERA2VK_VKCOMMANDRECORDER_H
+#define CAMERA2VK_VKCOMMANDRECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+
+typedef std::function<void(VkCommandBuffer secondaryCmdBuffer)> RecordJob;
+
+class VkCommandRecorder{
+public:
+    VkCommandRecorder(VkBundle *vk, uint32_t workerCount, uint32_t slotCount);
+    ~VkCommandRecorder();
+
+    /**
+     * Records every job into its own secondary command buffer on the worker pool and blocks until all are done.
+     * Buffers of a slot are reused on the next record() of the same slot, so the caller must make sure
+     * the GPU is done with them, just like with the primary buffer they get executed from.
+     */
+    void record(uint32_t slot, const VkCommandBufferInheritanceInfo &inheritanceInfo,
+                const std::vector<RecordJob> &jobs, VkCommandBuffer *out_secondaryCmdBuffers);
+    uint32_t getWorkerCount() const { return mWorkers.size(); };
+    void printStats();
+
+private:
+    struct Worker{
+        std::thread thread;
+        VkCommandPool cmdPool = VK_NULL_HANDLE;
+        std::vector<std::vector<VkCommandBuffer>> slotCmdBuffers;
+        uint64_t recordTimeNs = 0;
+        uint32_t jobCount = 0;
+    };
+
+    void workerLoop(uint32_t workerIndex);
+    VkCommandBuffer acquireCmdBuffer(Worker &worker, uint32_t slot, uint32_t localIndex);
+
+    VkBundle *mVk;
+    std::vector<Worker> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mStartCond;
+    std::condition_variable mDoneCond;
+    uint64_t mGeneration = 0;
+    uint32_t mFinishedWorkers = 0;
+    bool bStop = false;
+    std::exception_ptr mWorkerError;
+
+    // the batch being recorded, only touched by workers between start and done
+    uint32_t mSlot = 0;
+    const VkCommandBufferInheritanceInfo *mInheritanceInfo = nullptr;
+    const std::vector<RecordJob> *mJobs = nullptr;
+    VkCommandBuffer *mOutCmdBuffers = nullptr;
+    std::atomic<uint32_t> mNextJob{0};
+
+    uint64_t mRecordCount = 0;
+    uint64_t mRecordWallTimeNs = 0;
+};
+
+#endif //CAMERA2VK_VKCOMMANDRECORDER_H
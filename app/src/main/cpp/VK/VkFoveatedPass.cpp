@@ -0,0 +1,281 @@
+#include "VkFoveatedPass.h"
+#include <algorithm>
+#include <cmath>
+#include "VkHelper.h"
+
+#define FOVEATION_STATS_INTERVAL 300
+
+static void drawGeometry(VkCommandBuffer cmdBuffer, const FoveatedDraw &draw, const VkViewport &viewport, const VkRect2D &scissor){
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    if(draw.geometry == nullptr){
+        return;
+    }
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipelineLayout, 0, 1, &draw.descriptorSet, 0, nullptr);
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &draw.geometry->vertexBuffer, offsets);
+    if(draw.geometry->bUseIndexDraw()){
+        vkCmdBindIndexBuffer(cmdBuffer, draw.geometry->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(cmdBuffer, draw.geometry->geIndexCount(), 1, 0, 0, 0);
+    } else {
+        vkCmdDraw(cmdBuffer, draw.geometry->getVertexCount(), 1, 0, 0);
+    }
+}
+
+static VkRect2D intersectRect(const VkRect2D &a, const VkRect2D &b){
+    int32_t x0 = std::max(a.offset.x, b.offset.x);
+    int32_t y0 = std::max(a.offset.y, b.offset.y);
+    int32_t x1 = std::min(a.offset.x + (int32_t) a.extent.width, b.offset.x + (int32_t) b.extent.width);
+    int32_t y1 = std::min(a.offset.y + (int32_t) a.extent.height, b.offset.y + (int32_t) b.extent.height);
+    if(x1 <= x0 || y1 <= y0){
+        return {{x0, y0}, {0, 0}};
+    }
+    return {{x0, y0}, {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}};
+}
+
+VkFoveatedPass::VkFoveatedPass(VkBundle *vk, const FoveationConfig &config, uint32_t slotCount, VkImageLayout targetFinalLayout)
+        : mVk(vk), mConfig(config), mTargetFinalLayout(targetFinalLayout), mSlotAreaCount(slotCount, 0) {
+    VkDevice device = mVk->deviceInfo.device;
+    mConfig.peripheryScale = std::min(std::max(mConfig.peripheryScale, 0.05f), 1.f);
+    mConfig.fovealWidth = std::min(std::max(mConfig.fovealWidth, 0.f), 1.f);
+    mConfig.fovealHeight = std::min(std::max(mConfig.fovealHeight, 0.f), 1.f);
+    mEyeExtent = {mVk->swapchainParam.extent.width / 2, mVk->swapchainParam.extent.height};
+    mPeripheryExtent = {std::max(1u, static_cast<uint32_t>(mEyeExtent.width * mConfig.peripheryScale)),
+                        std::max(1u, static_cast<uint32_t>(mEyeExtent.height * mConfig.peripheryScale))};
+
+    // the upscale is a blit, linear filtering needs format support
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(mVk->deviceInfo.physicalDev, mVk->swapchainParam.format.format, &formatProps);
+    mBlitFilter = (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    SwapchainParam peripheryParam = mVk->swapchainParam;
+    peripheryParam.extent = mPeripheryExtent;
+    VkHelper::createRenderPass(device, peripheryParam, &mPeripheryRenderPass, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    VkHelper::createRenderPass(device, mVk->swapchainParam, &mCompositeRenderPass, mTargetFinalLayout, 0, VK_ATTACHMENT_LOAD_OP_LOAD);
+    for(auto &eyeTarget : mEyeTargets){
+        VkHelper::createImage(mVk->allocator, device, mPeripheryExtent.width, mPeripheryExtent.height, 1, VK_IMAGE_TYPE_2D,
+                              peripheryParam.format.format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+                              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                              &eyeTarget.image, &eyeTarget.allocation);
+        VkHelper::createImageView(device, eyeTarget.image, VK_IMAGE_VIEW_TYPE_2D, peripheryParam.format.format,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, &eyeTarget.view);
+        VkHelper::createFramebuffer(device, mPeripheryRenderPass, mPeripheryExtent.width, mPeripheryExtent.height,
+                                    1, &eyeTarget.view, &eyeTarget.framebuffer);
+    }
+
+    if(mVk->deviceInfo.physicalDevLimits.timestampComputeAndGraphics){
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = slotCount * MAX_AREAS_PER_SLOT * QUERIES_PER_AREA,
+                .pipelineStatistics = 0
+        };
+        CALL_VK(vkCreateQueryPool(device, &queryPoolCreateInfo, VK_ALLOC, &mQueryPool));
+    } else {
+        LOG_W("VkFoveatedPass: no timestamp support, GPU times will not be reported.");
+    }
+    LOG_D("VkFoveatedPass: eye %ux%u, fovea %.2f x %.2f, periphery %ux%u", mEyeExtent.width, mEyeExtent.height,
+          mConfig.fovealWidth, mConfig.fovealHeight, mPeripheryExtent.width, mPeripheryExtent.height);
+}
+
+VkFoveatedPass::~VkFoveatedPass() {
+    VkDevice device = mVk->deviceInfo.device;
+    printStats();
+    if(mQueryPool != VK_NULL_HANDLE){
+        vkDestroyQueryPool(device, mQueryPool, VK_ALLOC);
+    }
+    for(auto &eyeTarget : mEyeTargets){
+        vkDestroyFramebuffer(device, eyeTarget.framebuffer, VK_ALLOC);
+        vkDestroyImageView(device, eyeTarget.view, VK_ALLOC);
+        VkHelper::destroyImage(mVk->allocator, device, &eyeTarget.image, &eyeTarget.allocation);
+    }
+    vkDestroyRenderPass(device, mCompositeRenderPass, VK_ALLOC);
+    vkDestroyRenderPass(device, mPeripheryRenderPass, VK_ALLOC);
+}
+
+bool VkFoveatedPass::isSupported(const VkBundle *vk, bool bOffscreenTarget) {
+    // the upscale blits into the target
+    return bOffscreenTarget || (vk->swapchainParam.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+}
+
+VkRect2D VkFoveatedPass::getFovealRect(uint32_t eyeIndex) const {
+    uint32_t width = static_cast<uint32_t>(mEyeExtent.width * mConfig.fovealWidth);
+    uint32_t height = static_cast<uint32_t>(mEyeExtent.height * mConfig.fovealHeight);
+    int32_t x = static_cast<int32_t>(eyeIndex * mEyeExtent.width + (mEyeExtent.width - width) / 2);
+    int32_t y = static_cast<int32_t>((mEyeExtent.height - height) / 2);
+    return {{x, y}, {width, height}};
+}
+
+void VkFoveatedPass::beginSlot(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    if(mQueryPool != VK_NULL_HANDLE){
+        readTimestamps(slot);
+        vkCmdResetQueryPool(cmdBuffer, mQueryPool, slot * MAX_AREAS_PER_SLOT * QUERIES_PER_AREA, MAX_AREAS_PER_SLOT * QUERIES_PER_AREA);
+    }
+    if(++mSlotCount % FOVEATION_STATS_INTERVAL == 0){
+        printStats();
+    }
+}
+
+void VkFoveatedPass::readTimestamps(uint32_t slot) {
+    uint32_t areaCount = mSlotAreaCount[slot];
+    mSlotAreaCount[slot] = 0;
+    if(areaCount == 0){
+        return;
+    }
+    uint64_t timestamps[MAX_AREAS_PER_SLOT * QUERIES_PER_AREA];
+    VkResult result = vkGetQueryPoolResults(mVk->deviceInfo.device, mQueryPool, slot * MAX_AREAS_PER_SLOT * QUERIES_PER_AREA,
+                                            areaCount * QUERIES_PER_AREA, sizeof(timestamps), timestamps,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if(result != VK_SUCCESS){
+        // still in flight, drop this sample rather than stall the render thread
+        return;
+    }
+    double period = mVk->deviceInfo.physicalDevLimits.timestampPeriod;
+    for(uint32_t i = 0; i < areaCount; i++){
+        const uint64_t *t = &timestamps[i * QUERIES_PER_AREA];
+        mPeripheryTimeNs += static_cast<uint64_t>((t[1] - t[0]) * period);
+        mCompositeTimeNs += static_cast<uint64_t>((t[2] - t[1]) * period);
+        mFovealTimeNs += static_cast<uint64_t>((t[3] - t[2]) * period);
+    }
+    mTimedAreaCount += areaCount;
+}
+
+void VkFoveatedPass::recordArea(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t eyeIndex, const VkRect2D &area,
+                                const VkClearValue &clearValue, const FoveatedDraw &draw, const FoveatedTarget &target) {
+    const EyeTarget &eyeTarget = mEyeTargets[eyeIndex];
+    uint32_t areaIndex = mSlotAreaCount[slot];
+    bool bTimed = mQueryPool != VK_NULL_HANDLE && areaIndex < MAX_AREAS_PER_SLOT;
+    uint32_t firstQuery = (slot * MAX_AREAS_PER_SLOT + areaIndex) * QUERIES_PER_AREA;
+    if(bTimed){
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, firstQuery);
+        mSlotAreaCount[slot]++;
+    }
+
+    // 1. periphery, the area in eye local coordinates scaled down
+    float scale = mConfig.peripheryScale;
+    int32_t eyeOffsetX = static_cast<int32_t>(eyeIndex * mEyeExtent.width);
+    VkRect2D peripheryArea = {
+            {static_cast<int32_t>((area.offset.x - eyeOffsetX) * scale), static_cast<int32_t>(area.offset.y * scale)},
+            {static_cast<uint32_t>(std::ceil(area.extent.width * scale)), static_cast<uint32_t>(std::ceil(area.extent.height * scale))}
+    };
+    peripheryArea = intersectRect(peripheryArea, {{0, 0}, mPeripheryExtent});
+    if(peripheryArea.extent.width == 0 || peripheryArea.extent.height == 0){
+        peripheryArea = {{0, 0}, mPeripheryExtent};
+    }
+    VkRenderPassBeginInfo renderPassBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = nullptr,
+            .renderPass = mPeripheryRenderPass,
+            .framebuffer = eyeTarget.framebuffer,
+            .renderArea = peripheryArea,
+            .clearValueCount = 1,
+            .pClearValues = &clearValue,
+    };
+    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // the geometry is laid out for the whole surface, shift the viewport so this eye lands in the target
+    VkViewport peripheryViewport = {
+            .x = -eyeOffsetX * scale,
+            .y = 0,
+            .width = mVk->swapchainParam.extent.width * scale,
+            .height = mVk->swapchainParam.extent.height * scale,
+            .minDepth = 0,
+            .maxDepth = 1
+    };
+    drawGeometry(cmdBuffer, draw, peripheryViewport, peripheryArea);
+    vkCmdEndRenderPass(cmdBuffer);
+    if(bTimed){
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, firstQuery + 1);
+    }
+
+    // 2. upscale into the target, after whatever earlier areas wrote into it
+    bool bFirstTouch = target.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = bFirstTouch ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = target.oldLayout,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = target.image,
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    VkImageBlit blitRegion = {
+            .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .srcOffsets = {
+                    {peripheryArea.offset.x, peripheryArea.offset.y, 0},
+                    {peripheryArea.offset.x + (int32_t) peripheryArea.extent.width, peripheryArea.offset.y + (int32_t) peripheryArea.extent.height, 1}
+            },
+            .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .dstOffsets = {
+                    {area.offset.x, area.offset.y, 0},
+                    {area.offset.x + (int32_t) area.extent.width, area.offset.y + (int32_t) area.extent.height, 1}
+            }
+    };
+    vkCmdBlitImage(cmdBuffer, eyeTarget.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, mBlitFilter);
+    if(bTimed){
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, mQueryPool, firstQuery + 2);
+    }
+
+    // 3. fovea at full resolution on top
+    VkRect2D fovealArea = intersectRect(area, getFovealRect(eyeIndex));
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    if(fovealArea.extent.width == 0 || fovealArea.extent.height == 0){
+        // the area lies completely in the periphery
+        bool bReadBack = mTargetFinalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.dstAccessMask = bReadBack ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+        barrier.newLayout = mTargetFinalLayout;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             bReadBack ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    } else {
+        barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        renderPassBeginInfo.renderPass = mCompositeRenderPass;
+        renderPassBeginInfo.framebuffer = target.framebuffer;
+        renderPassBeginInfo.renderArea = fovealArea;
+        renderPassBeginInfo.clearValueCount = 0;
+        renderPassBeginInfo.pClearValues = nullptr;
+        vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        VkViewport viewport = {
+                .x = 0,
+                .y = 0,
+                .width = static_cast<float>(mVk->swapchainParam.extent.width),
+                .height = static_cast<float>(mVk->swapchainParam.extent.height),
+                .minDepth = 0,
+                .maxDepth = 1
+        };
+        drawGeometry(cmdBuffer, draw, viewport, fovealArea);
+        vkCmdEndRenderPass(cmdBuffer);
+    }
+    if(bTimed){
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, firstQuery + 3);
+    }
+
+    mFullResPixels += (uint64_t) area.extent.width * area.extent.height;
+    mShadedPixels += (uint64_t) peripheryArea.extent.width * peripheryArea.extent.height +
+                     (uint64_t) fovealArea.extent.width * fovealArea.extent.height;
+}
+
+void VkFoveatedPass::printStats() {
+    if(mFullResPixels == 0){
+        return;
+    }
+    LOG_D("VkFoveatedPass: shaded %.1f%% of the full resolution pixels (fovea %.2f x %.2f, periphery scale %.2f)",
+          mShadedPixels * 100.f / mFullResPixels, mConfig.fovealWidth, mConfig.fovealHeight, mConfig.peripheryScale);
+    if(mTimedAreaCount > 0){
+        LOG_D("    GPU per area: periphery %.3f ms, upscale %.3f ms, fovea %.3f ms over %u areas",
+              mPeripheryTimeNs * 1.f / mTimedAreaCount / U_TIME_1MS_IN_NS, mCompositeTimeNs * 1.f / mTimedAreaCount / U_TIME_1MS_IN_NS,
+              mFovealTimeNs * 1.f / mTimedAreaCount / U_TIME_1MS_IN_NS, mTimedAreaCount);
+    }
+}
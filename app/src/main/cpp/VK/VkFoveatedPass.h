@@ -0,0 +1,85 @@
+/*!
+ * @brief  Multi resolution passthrough, full resolution fovea over an upscaled low resolution periphery
+ * @date 2023/8/8
+ */
+#ifndef CAMERA2VK_VKFOVEATEDPASS_H
+#define CAMERA2VK_VKFOVEATEDPASS_H
+
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+#include "Geometry.h"
+#include "VkMemoryAllocator.h"
+
+struct FoveationConfig{
+    float fovealWidth = 0.5f;       // part of the eye width rendered at full resolution, centered
+    float fovealHeight = 0.5f;      // part of the eye height rendered at full resolution, centered
+    float peripheryScale = 0.5f;    // resolution scale of the periphery targets, (0, 1]
+};
+
+struct FoveatedDraw{
+    VkPipeline pipeline;
+    VkPipelineLayout pipelineLayout;
+    VkDescriptorSet descriptorSet;
+    const Geometry *geometry;       // nullptr only clears
+};
+
+struct FoveatedTarget{
+    VkImage image;
+    VkFramebuffer framebuffer;      // compatible with the renderer's render pass
+    VkImageLayout oldLayout;        // UNDEFINED when nothing of the frame is in the image yet
+};
+
+/**
+ * Every sub area is drawn in three steps: the eye quad at peripheryScale into a per eye target,
+ * a linear blit of that area up into the final target, then the foveal part of the area at full
+ * resolution on top of it. GPU timestamps around the steps are read back one frame later.
+ */
+class VkFoveatedPass{
+public:
+    VkFoveatedPass(VkBundle *vk, const FoveationConfig &config, uint32_t slotCount, VkImageLayout targetFinalLayout);
+    ~VkFoveatedPass();
+
+    static bool isSupported(const VkBundle *vk, bool bOffscreenTarget);
+    // reads the timestamps of the previous use of the slot and resets its queries, call before recordArea
+    void beginSlot(VkCommandBuffer cmdBuffer, uint32_t slot);
+    void recordArea(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t eyeIndex, const VkRect2D &area, const VkClearValue &clearValue,
+                    const FoveatedDraw &draw, const FoveatedTarget &target);
+    VkImageLayout getTargetFinalLayout() const { return mTargetFinalLayout; };
+    void printStats();
+
+private:
+    static const uint32_t MAX_AREAS_PER_SLOT = 2;
+    static const uint32_t QUERIES_PER_AREA = 4;
+
+    struct EyeTarget{
+        VkImage image = VK_NULL_HANDLE;
+        VkAllocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    };
+
+    VkRect2D getFovealRect(uint32_t eyeIndex) const;
+    void readTimestamps(uint32_t slot);
+
+    VkBundle *mVk;
+    FoveationConfig mConfig;
+    VkImageLayout mTargetFinalLayout;
+    VkExtent2D mEyeExtent;
+    VkExtent2D mPeripheryExtent;
+    VkFilter mBlitFilter;
+    VkRenderPass mPeripheryRenderPass = VK_NULL_HANDLE;
+    VkRenderPass mCompositeRenderPass = VK_NULL_HANDLE;
+    EyeTarget mEyeTargets[2];
+
+    VkQueryPool mQueryPool = VK_NULL_HANDLE;
+    std::vector<uint32_t> mSlotAreaCount;
+    uint64_t mPeripheryTimeNs = 0;
+    uint64_t mCompositeTimeNs = 0;
+    uint64_t mFovealTimeNs = 0;
+    uint32_t mTimedAreaCount = 0;
+    uint64_t mFullResPixels = 0;
+    uint64_t mShadedPixels = 0;
+    uint64_t mSlotCount = 0;
+};
+
+#endif //CAMERA2VK_VKFOVEATEDPASS_H
@@ -0,0 +1,248 @@
+#include "VkFrameGraph.h"
+#include "../ProfileTrace.h"
+
+#define FRAME_GRAPH_STATS_INTERVAL 300
+
+struct UsageInfo{
+    VkImageLayout layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkAccessFlags writeAccess;
+};
+
+static UsageInfo getUsageInfo(ResourceUsage usage){
+    switch(usage){
+        case ResourceUsage::TRANSFER_READ:
+            return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0};
+        case ResourceUsage::TRANSFER_WRITE:
+            return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+        case ResourceUsage::SHADER_READ:
+            return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0};
+        case ResourceUsage::ATTACHMENT_WRITE:
+            // the layout is left to the render pass, UNDEFINED stands for "whatever it is now"
+            return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+        case ResourceUsage::ATTACHMENT_READ_WRITE:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+        case ResourceUsage::EXTERNAL_WRITE:
+        default:
+            return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_WRITE_BIT};
+    }
+}
+
+static bool isRead(ResourceUsage usage){
+    return usage == ResourceUsage::TRANSFER_READ || usage == ResourceUsage::SHADER_READ || usage == ResourceUsage::ATTACHMENT_READ_WRITE;
+}
+
+static bool isWrite(ResourceUsage usage){
+    return usage != ResourceUsage::TRANSFER_READ && usage != ResourceUsage::SHADER_READ;
+}
+
+FrameResourceId VkFrameGraph::registerImage(const char *name, VkImage image, const VkImageSubresourceRange &range, VkImageLayout currentLayout) {
+    mImages.push_back({name, image, range, currentLayout, 0, 0, 0, 0, false, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED});
+    return static_cast<FrameResourceId>(mImages.size() - 1);
+}
+
+void VkFrameGraph::resetImage(FrameResourceId id, VkImageLayout currentLayout) {
+    ImageState &state = mImages[id];
+    state.layout = currentLayout;
+    state.writeStages = 0;
+    state.writeAccess = 0;
+    state.readStages = 0;
+    state.visibleStages = 0;
+    state.srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    state.dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+}
+
+void VkFrameGraph::acquireImage(FrameResourceId id, uint32_t srcQueueFamily, uint32_t dstQueueFamily, VkImageLayout currentLayout,
+                                VkPipelineStageFlags waitStage) {
+    resetImage(id, currentLayout);
+    // an acquire has no source access, the semaphore already made the writes of the other queue available
+    ImageState &state = mImages[id];
+    state.writeStages = waitStage;
+    state.srcQueueFamily = srcQueueFamily;
+    state.dstQueueFamily = dstQueueFamily;
+}
+
+void VkFrameGraph::addPass(const char *name, std::initializer_list<ResourceAccess> accesses, FramePassFn record) {
+    mPasses.push_back({name, accesses, std::move(record), false});
+}
+
+void VkFrameGraph::addPass(const char *name, const std::vector<ResourceAccess> &accesses, FramePassFn record) {
+    mPasses.push_back({name, accesses, std::move(record), false});
+}
+
+void VkFrameGraph::markOutput(FrameResourceId id) {
+    mImages[id].bOutput = true;
+}
+
+void VkFrameGraph::execute(VkCommandBuffer cmdBuffer) {
+    TRACE_BEGIN("FrameGraph:%zu", mPasses.size());
+    cull();
+
+    // the barriers of a pass join an earlier batch when the passes in between leave its images alone and
+    // the batch already waits on the same stages, so merging never adds a wait the passes did not have
+    std::vector<BarrierBatch> batches(mPasses.size());
+    int32_t previousKept = -1;
+    for(size_t i = 0; i < mPasses.size(); i++){
+        if(mPasses[i].bCulled){
+            continue;
+        }
+        BarrierBatch batch;
+        for(const auto &access : mPasses[i].accesses){
+            addBarrier(access, &batch);
+        }
+        if(batch.srcStages != 0 || batch.dstStages != 0){
+            mUnbatchedCallCount++;
+            size_t target = i;
+            for(int32_t j = previousKept; j >= 0; j--){
+                if(mPasses[j].bCulled){
+                    continue;
+                }
+                bool bTouched = false;
+                for(FrameResourceId id : batch.resources){
+                    bTouched |= touches(mPasses[j], id);
+                }
+                const BarrierBatch &candidate = batches[j];
+                bool bSameWaits = (candidate.srcStages | batch.srcStages) == candidate.srcStages &&
+                                  (candidate.dstStages | batch.dstStages) == candidate.dstStages;
+                if(bTouched || !bSameWaits){
+                    break;
+                }
+                target = j;
+            }
+            BarrierBatch &dst = batches[target];
+            dst.srcStages |= batch.srcStages;
+            dst.dstStages |= batch.dstStages;
+            dst.imageBarriers.insert(dst.imageBarriers.end(), batch.imageBarriers.begin(), batch.imageBarriers.end());
+            dst.resources.insert(dst.resources.end(), batch.resources.begin(), batch.resources.end());
+        }
+        previousKept = static_cast<int32_t>(i);
+    }
+
+    for(size_t i = 0; i < mPasses.size(); i++){
+        const Pass &pass = mPasses[i];
+        if(pass.bCulled){
+            continue;
+        }
+        const BarrierBatch &batch = batches[i];
+        if(batch.srcStages != 0 || batch.dstStages != 0){
+            vkCmdPipelineBarrier(cmdBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr, 0, nullptr,
+                                 batch.imageBarriers.size(), batch.imageBarriers.data());
+            mBarrierCallCount++;
+            mImageBarrierCount += batch.imageBarriers.size();
+        }
+        pass.record(cmdBuffer);
+    }
+
+    mPassCount += mPasses.size();
+    mPasses.clear();
+    for(auto &image : mImages){
+        image.bOutput = false;
+    }
+    TRACE_END("FrameGraph");
+    if(++mExecuteCount % FRAME_GRAPH_STATS_INTERVAL == 0){
+        printStats();
+    }
+}
+
+void VkFrameGraph::cull() {
+    // walk backwards from the outputs, a pass lives when something later reads what it writes
+    std::vector<bool> bNeeded(mImages.size());
+    for(size_t i = 0; i < mImages.size(); i++){
+        bNeeded[i] = mImages[i].bOutput;
+    }
+    for(auto pass = mPasses.rbegin(); pass != mPasses.rend(); pass++){
+        bool bLive = false;
+        for(const auto &access : pass->accesses){
+            bLive |= isWrite(access.usage) && bNeeded[access.resource];
+        }
+        pass->bCulled = !bLive;
+        if(pass->bCulled){
+            mCulledCount++;
+            continue;
+        }
+        for(const auto &access : pass->accesses){
+            if(isRead(access.usage)){
+                bNeeded[access.resource] = true;
+            }
+        }
+    }
+}
+
+void VkFrameGraph::addBarrier(const ResourceAccess &access, BarrierBatch *batch) {
+    ImageState &state = mImages[access.resource];
+    UsageInfo usage = getUsageInfo(access.usage);
+    bool bWrite = usage.writeAccess != 0;
+    if(access.usage == ResourceUsage::EXTERNAL_WRITE){
+        state.layout = access.layoutAfter != VK_IMAGE_LAYOUT_UNDEFINED ? access.layoutAfter : state.layout;
+        state.writeStages = usage.stage;
+        state.writeAccess = usage.writeAccess;
+        state.readStages = 0;
+        state.visibleStages = 0;
+        return;
+    }
+
+    VkImageLayout layout = usage.layout == VK_IMAGE_LAYOUT_UNDEFINED ? state.layout : usage.layout;
+    bool bTransition = layout != state.layout;
+    bool bAcquire = state.srcQueueFamily != state.dstQueueFamily;
+    // write after read only needs the reads to finish, read after read needs nothing
+    bool bHazard = bWrite ? (state.writeStages != 0 || state.readStages != 0)
+                          : (state.writeStages != 0 && (state.visibleStages & usage.stage) != usage.stage);
+    if(bTransition || bHazard || bAcquire){
+        VkPipelineStageFlags srcStages = state.writeStages;
+        if(bWrite || bTransition){
+            srcStages |= state.readStages;
+        }
+        batch->srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        batch->dstStages |= usage.stage;
+        batch->resources.push_back(access.resource);
+        if(bTransition || bAcquire || state.writeAccess != 0){
+            batch->imageBarriers.push_back({
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = state.writeAccess,
+                    .dstAccessMask = usage.access,
+                    .oldLayout = state.layout,
+                    .newLayout = layout,
+                    .srcQueueFamilyIndex = state.srcQueueFamily,
+                    .dstQueueFamilyIndex = state.dstQueueFamily,
+                    .image = state.image,
+                    .subresourceRange = state.range
+            });
+            mAcquireCount += bAcquire ? 1 : 0;
+        }
+        state.srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+        state.dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    }
+
+    if(bWrite){
+        state.writeStages = usage.stage;
+        state.writeAccess = usage.writeAccess;
+        state.readStages = 0;
+        state.visibleStages = 0;
+    } else {
+        state.readStages |= usage.stage;
+        state.visibleStages |= usage.stage;
+    }
+    state.layout = access.layoutAfter != VK_IMAGE_LAYOUT_UNDEFINED ? access.layoutAfter : layout;
+}
+
+bool VkFrameGraph::touches(const Pass &pass, FrameResourceId id) {
+    for(const auto &access : pass.accesses){
+        if(access.resource == id){
+            return true;
+        }
+    }
+    return false;
+}
+
+void VkFrameGraph::printStats() {
+    if(mExecuteCount == 0){
+        return;
+    }
+    LOG_D("VkFrameGraph: %.2f passes, %.2f culled, %.2f barrier calls (%.2f before batching), %.2f image barriers (%.2f acquires) per execute",
+          mPassCount * 1.f / mExecuteCount, mCulledCount * 1.f / mExecuteCount, mBarrierCallCount * 1.f / mExecuteCount,
+          mUnbatchedCallCount * 1.f / mExecuteCount, mImageBarrierCount * 1.f / mExecuteCount, mAcquireCount * 1.f / mExecuteCount);
+}
@@ -0,0 +1,100 @@
+/*!
+ * @brief  Frame graph, passes declare their resource usage and the graph places batched barriers between them
+ * @date 2023/8/11
+ */
+#ifndef CAMERA2VK_VKFRAMEGRAPH_H
+#define CAMERA2VK_VKFRAMEGRAPH_H
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "VulkanCommon.h"
+
+typedef uint32_t FrameResourceId;
+const FrameResourceId INVALID_FRAME_RESOURCE = UINT32_MAX;     // not tracked, e.g. written by the host
+typedef std::function<void(VkCommandBuffer cmdBuffer)> FramePassFn;
+
+enum class ResourceUsage{
+    TRANSFER_READ,              // TRANSFER_SRC_OPTIMAL
+    TRANSFER_WRITE,             // TRANSFER_DST_OPTIMAL
+    SHADER_READ,                // SHADER_READ_ONLY_OPTIMAL, fragment shader
+    ATTACHMENT_WRITE,           // render pass that clears or discards, its initial layout is UNDEFINED
+    ATTACHMENT_READ_WRITE,      // render pass that loads, COLOR_ATTACHMENT_OPTIMAL on entry
+    EXTERNAL_WRITE              // the pass synchronizes the image itself, the graph only records the write
+};
+
+struct ResourceAccess{
+    FrameResourceId resource;
+    ResourceUsage usage;
+    VkImageLayout layoutAfter = VK_IMAGE_LAYOUT_UNDEFINED;      // final layout of a render pass, UNDEFINED keeps the usage layout
+};
+
+/**
+ * Images are registered once and their layout and pending accesses are tracked across frames. Passes are added
+ * in submission order, execute() culls the passes whose writes nobody consumes, computes the barriers with the
+ * stage and access masks of the actual producer and consumer, hoists them as early as the passes in between
+ * allow, and records everything into one command buffer. Render thread only.
+ */
+class VkFrameGraph{
+public:
+    FrameResourceId registerImage(const char *name, VkImage image, const VkImageSubresourceRange &range, VkImageLayout currentLayout);
+    // forgets the content, e.g. a swapchain image right after it was acquired
+    void resetImage(FrameResourceId id, VkImageLayout currentLayout);
+    // released by another queue family in currentLayout, the next access acquires it, chained to the semaphore wait
+    // at waitStage. The release has to transition to the layout of that access
+    void acquireImage(FrameResourceId id, uint32_t srcQueueFamily, uint32_t dstQueueFamily, VkImageLayout currentLayout,
+                      VkPipelineStageFlags waitStage);
+    void addPass(const char *name, std::initializer_list<ResourceAccess> accesses, FramePassFn record);
+    void addPass(const char *name, const std::vector<ResourceAccess> &accesses, FramePassFn record);
+    // consumed outside of the passes of this execute, keeps their writers alive
+    void markOutput(FrameResourceId id);
+    void execute(VkCommandBuffer cmdBuffer);
+    void printStats();
+
+private:
+    struct ImageState{
+        std::string name;
+        VkImage image;
+        VkImageSubresourceRange range;
+        VkImageLayout layout;
+        VkPipelineStageFlags writeStages;       // last write, 0 once nothing is pending
+        VkAccessFlags writeAccess;
+        VkPipelineStageFlags readStages;        // reads since the last write
+        VkPipelineStageFlags visibleStages;     // stages the last write was made visible to
+        bool bOutput;
+        uint32_t srcQueueFamily;                // pending acquire, VK_QUEUE_FAMILY_IGNORED when there is none
+        uint32_t dstQueueFamily;
+    };
+
+    struct Pass{
+        const char *name;
+        std::vector<ResourceAccess> accesses;
+        FramePassFn record;
+        bool bCulled;
+    };
+
+    struct BarrierBatch{
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        std::vector<FrameResourceId> resources;
+    };
+
+    void cull();
+    void addBarrier(const ResourceAccess &access, BarrierBatch *batch);
+    static bool touches(const Pass &pass, FrameResourceId id);
+
+    std::vector<ImageState> mImages;
+    std::vector<Pass> mPasses;
+
+    uint64_t mExecuteCount = 0;
+    uint64_t mPassCount = 0;
+    uint64_t mCulledCount = 0;
+    uint64_t mBarrierCallCount = 0;
+    uint64_t mUnbatchedCallCount = 0;
+    uint64_t mImageBarrierCount = 0;
+    uint64_t mAcquireCount = 0;
+};
+
+#endif //CAMERA2VK_VKFRAMEGRAPH_H
@@ -0,0 +1,100 @@
+#include "VkFrameRing.h"
+#include <algorithm>
+#include <limits>
+#include "VkHelper.h"
+
+VkFrameRing::VkFrameRing(VkBundle *vk, uint32_t depth, uint32_t passCount) {
+    mVk = vk;
+    mPassCount = passCount;
+    mContexts.resize(std::min<uint32_t>(std::max<uint32_t>(depth, 1), FRAME_RING_MAX_DEPTH));
+    VkDevice device = mVk->deviceInfo.device;
+    // fences start signaled, a context that never carried a frame is free
+    VkFenceCreateInfo fenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+    };
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0
+    };
+    for(uint32_t i = 0; i < mContexts.size(); i++){
+        FrameContext &context = mContexts[i];
+        context.index = i;
+        context.cmdBuffers.resize(passCount);
+        VkHelper::allocateCommandBuffers(device, mVk->cmdPool, passCount, context.cmdBuffers.data());
+        CALL_VK(vkCreateSemaphore(device, &semaphoreCreateInfo, VK_ALLOC, &context.acquireSemaphore));
+        context.renderSemaphores.resize(passCount);
+        for(auto &semaphore : context.renderSemaphores){
+            CALL_VK(vkCreateSemaphore(device, &semaphoreCreateInfo, VK_ALLOC, &semaphore));
+        }
+        CALL_VK(vkCreateFence(device, &fenceCreateInfo, VK_ALLOC, &context.fence));
+        VkHelper::allocateDescriptorSets(device, mVk->descriptorPool, mVk->descriptorSetLayout, context.descriptorSets);
+    }
+    mCurrent = mContexts.size() - 1;
+    LOG_D("VkFrameRing: %zu frames in flight, %u passes per frame", mContexts.size(), passCount);
+}
+
+VkFrameRing::~VkFrameRing() {
+    VkDevice device = mVk->deviceInfo.device;
+    for(auto &context : mContexts){
+        if(context.bInFlight){
+            CALL_VK(vkWaitForFences(device, 1, &context.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+        }
+        vkFreeDescriptorSets(device, mVk->descriptorPool, ARRAY_SIZE(context.descriptorSets), context.descriptorSets);
+        vkDestroyFence(device, context.fence, VK_ALLOC);
+        for(auto semaphore : context.renderSemaphores){
+            vkDestroySemaphore(device, semaphore, VK_ALLOC);
+        }
+        vkDestroySemaphore(device, context.acquireSemaphore, VK_ALLOC);
+        vkFreeCommandBuffers(device, mVk->cmdPool, context.cmdBuffers.size(), context.cmdBuffers.data());
+    }
+}
+
+FrameContext &VkFrameRing::begin() {
+    VkDevice device = mVk->deviceInfo.device;
+    mCurrent = (mCurrent + 1) % mContexts.size();
+    FrameContext &context = mContexts[mCurrent];
+    uint64_t startNs = getTimeNano(CLOCK_MONOTONIC);
+    // whatever finished since the last begin retires without a wait
+    for(auto &other : mContexts){
+        if(other.bInFlight && &other != &context && vkGetFenceStatus(device, other.fence) == VK_SUCCESS){
+            retire(other, startNs);
+        }
+    }
+    mLastWaitNs = 0;
+    mLastLatencyNs = context.latencyNs;
+    if(context.bInFlight){
+        CALL_VK(vkWaitForFences(device, 1, &context.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+        uint64_t endNs = getTimeNano(CLOCK_MONOTONIC);
+        retire(context, endNs);
+        mLastWaitNs = endNs - startNs;
+        mLastLatencyNs = context.latencyNs;
+        mWaitNs += mLastWaitNs;
+        mMaxWaitNs = std::max(mMaxWaitNs, mLastWaitNs);
+    }
+    mLastRetiredStartNs = mLastLatencyNs != 0 ? context.startNs : 0;
+    context.latencyNs = 0;
+    context.bAcquirePending = false;
+    context.startNs = startNs + mLastWaitNs;
+    mFrameCount++;
+    return context;
+}
+
+void VkFrameRing::retire(FrameContext &context, uint64_t nowNs) {
+    context.bInFlight = false;
+    context.latencyNs = nowNs - context.startNs;
+    mLatencyNs += context.latencyNs;
+    mMaxLatencyNs = std::max(mMaxLatencyNs, context.latencyNs);
+    mRetiredCount++;
+}
+
+void VkFrameRing::printStats() {
+    if(mFrameCount == 0 || mRetiredCount == 0){
+        return;
+    }
+    LOG_D("VkFrameRing: %zu frames in flight, fence wait %.3f ms avg %.3f ms max, latency %.3f ms avg %.3f ms max over %u frames",
+          mContexts.size(), mWaitNs * 1.f / mFrameCount / U_TIME_1MS_IN_NS, mMaxWaitNs * 1.f / U_TIME_1MS_IN_NS,
+          mLatencyNs * 1.f / mRetiredCount / U_TIME_1MS_IN_NS, mMaxLatencyNs * 1.f / U_TIME_1MS_IN_NS, mFrameCount);
+}
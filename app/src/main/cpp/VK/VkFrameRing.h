@@ -0,0 +1,72 @@
+/*!
+ * @brief  Frame contexts in flight, each with its own command buffers, semaphores, fence and descriptor sets
+ * @date 2023/8/13
+ */
+#ifndef CAMERA2VK_VKFRAMERING_H
+#define CAMERA2VK_VKFRAMERING_H
+
+#include <vector>
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+
+#define FRAME_RING_MAX_DEPTH 3
+
+struct FrameContext{
+    uint32_t index = 0;
+    std::vector<VkCommandBuffer> cmdBuffers;    // one per pass
+    VkSemaphore acquireSemaphore = VK_NULL_HANDLE;
+    std::vector<VkSemaphore> renderSemaphores;  // one per pass, waited on by the present of that pass
+    VkFence fence = VK_NULL_HANDLE;             // signaled by the last submission of the frame
+    VkDescriptorSet descriptorSets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    bool bAcquirePending = false;               // the first submission of the frame still has to wait on the acquire
+    bool bInFlight = false;
+    uint64_t startNs = 0;
+    uint64_t latencyNs = 0;                     // of the last frame retired
+};
+
+/**
+ * The CPU records frame N+1 into the next context while the GPU executes frame N, and only blocks when it comes
+ * back to a context whose last frame is still running. A deeper ring hides more GPU jitter but every extra context
+ * is one more frame of latency between the camera and the display, both are measured: the time blocked on fences
+ * and the latency from begin() until the fence of the frame was seen signaled. The fence is only looked at on
+ * begin(), so the latency is an upper bound by up to one frame start. Per pass helpers (recorder, compositor,
+ * foveated pass) keep one slot per pass of every context, see passSlot(). Render thread only.
+ */
+class VkFrameRing{
+public:
+    VkFrameRing(VkBundle *vk, uint32_t depth, uint32_t passCount);
+    ~VkFrameRing();
+
+    // moves on to the next context and waits for the frame it last carried, that is the only wait on the GPU
+    FrameContext &begin();
+    FrameContext &current() { return mContexts[mCurrent]; };
+    uint32_t getDepth() const { return mContexts.size(); };
+    uint32_t getSlotCount() const { return mContexts.size() * mPassCount; };
+    uint32_t passSlot(uint32_t passIndex) const { return mCurrent * mPassCount + passIndex; };
+    // time begin() spent blocked, latency of the frame retired by begin(), 0 when it retired none
+    uint64_t getLastWaitNs() const { return mLastWaitNs; };
+    uint64_t getLastLatencyNs() const { return mLastLatencyNs; };
+    // start of the frame that latency belongs to
+    uint64_t getLastRetiredStartNs() const { return mLastRetiredStartNs; };
+    void printStats();
+
+private:
+    void retire(FrameContext &context, uint64_t nowNs);
+
+    VkBundle *mVk;
+    uint32_t mPassCount;
+    std::vector<FrameContext> mContexts;
+    uint32_t mCurrent = 0;
+
+    uint64_t mLastWaitNs = 0;
+    uint64_t mLastLatencyNs = 0;
+    uint64_t mLastRetiredStartNs = 0;
+    uint64_t mWaitNs = 0;
+    uint64_t mMaxWaitNs = 0;
+    uint64_t mLatencyNs = 0;
+    uint64_t mMaxLatencyNs = 0;
+    uint32_t mFrameCount = 0;
+    uint32_t mRetiredCount = 0;
+};
+
+#endif //CAMERA2VK_VKFRAMERING_H
@@ -9,7 +9,9 @@ const DriverFeature validationInstanceLayers[] = {
 
 const DriverFeature validationInstanceExtensions[] = {
         {VK_KHR_SURFACE_EXTENSION_NAME,          false,     true},
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
         {VK_KHR_ANDROID_SURFACE_EXTENSION_NAME,    false,     true},
+#endif
 #ifdef RENDER_USE_SINGLE_BUFFER
         {VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, false, true},
 #endif
@@ -32,7 +34,15 @@ const DriverFeature validationDeviceExtensions[] = {
         {VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME, false, true},
         {VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME, false, true},
         {VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, false, true},
-        {VK_ANDROID_EXTERNAL_MEMORY_ANDROID_HARDWARE_BUFFER_EXTENSION_NAME, false, true}
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
+        {VK_ANDROID_EXTERNAL_MEMORY_ANDROID_HARDWARE_BUFFER_EXTENSION_NAME, false, true},
+#endif
+        {VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, false, false},
+#ifdef VK_EXT_host_image_copy
+        {VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME, false, false},
+        {VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME, false, false},
+        {VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME, false, false},
+#endif
 };
 
 VkBool32 debugReportCallback(VkDebugReportFlagsEXT msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObject,
@@ -140,9 +150,12 @@ void VkHelper::pickPhyDevAndCreateDev(VkInstance instance, VkSurfaceKHR surface,
         vkGetPhysicalDeviceQueueFamilyProperties(physicalDevs[i], &queueFamilyPropCount, queueFamilyProps);
         //表面查询支持
         for(int j = 0; j < queueFamilyPropCount; j++){
-            VkBool32 surfaceSupport;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevs[i], i, surface, &surfaceSupport);
-            LOG_D("Surface Support: %d", surfaceSupport);
+            // without a surface (offscreen target) any graphics queue will do
+            VkBool32 surfaceSupport = VK_TRUE;
+            if(surface != VK_NULL_HANDLE){
+                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevs[i], j, surface, &surfaceSupport);
+                LOG_D("Surface Support: %d", surfaceSupport);
+            }
 
             if(surfaceSupport && queueFamilyProps[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 selectedPhysicalDev = physicalDevs[i];
@@ -173,20 +186,128 @@ void VkHelper::pickPhyDevAndCreateDev(VkInstance instance, VkSurfaceKHR surface,
     checkFeatures("Device Extensions", true, true, validationDeviceExtensions, ARRAY_SIZE(validationDeviceExtensions),
                   availableDeviceExtensions, availableDeviceExtensionCount, enableDeviceExtensions, &enableDeviceExtensionCount);
 
+    // a transfer-only family lets the camera uploads run next to the rendering, an async compute family is second best
+    uint32_t queueFamilyPropCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(selectedPhysicalDev, &queueFamilyPropCount, nullptr);
+    VkQueueFamilyProperties queueFamilyProps[queueFamilyPropCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(selectedPhysicalDev, &queueFamilyPropCount, queueFamilyProps);
+    int32_t transferOnlyIndex = -1, computeIndex = -1;
+    for(uint32_t j = 0; j < queueFamilyPropCount; j++){
+        VkQueueFlags flags = queueFamilyProps[j].queueFlags;
+        if(queueFamilyProps[j].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT) != 0){
+            continue;
+        }
+        if((flags & VK_QUEUE_COMPUTE_BIT) != 0){
+            computeIndex = computeIndex < 0 ? j : computeIndex;
+        } else if((flags & VK_QUEUE_TRANSFER_BIT) != 0){
+            transferOnlyIndex = transferOnlyIndex < 0 ? j : transferOnlyIndex;
+        }
+    }
+    int32_t transferIndex = transferOnlyIndex >= 0 ? transferOnlyIndex : computeIndex;
+    LOG_D("Transfer Queue Family: %d (%s)", transferIndex, transferIndex < 0 ? "none" : (transferOnlyIndex >= 0 ? "transfer only" : "async compute"));
+
     float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .queueFamilyIndex = out_queueInfo->workQueueIndex,
-            .queueCount = 1,
-            .pQueuePriorities = &queuePriority, //队列优先级
+    VkDeviceQueueCreateInfo queueCreateInfos[] = {
+            {
+                    .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .queueFamilyIndex = out_queueInfo->workQueueIndex,
+                    .queueCount = 1,
+                    .pQueuePriorities = &queuePriority, //队列优先级
+            },
+            {
+                    .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .queueFamilyIndex = static_cast<uint32_t>(transferIndex),
+                    .queueCount = 1,
+                    .pQueuePriorities = &queuePriority,
+            }
     };
 
     //features
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,
+            .pNext = nullptr,
+    };
+    out_deviceInfo->features.hostImageCopy = VK_FALSE;
+    VkPhysicalDeviceHostQueryResetFeatures hostQueryResetFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES,
+            .pNext = multiviewFeatures.pNext,
+            .hostQueryReset = VK_FALSE
+    };
+    VkPhysicalDeviceShaderFloat16Int8Features float16Int8Features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES,
+            .pNext = &hostQueryResetFeatures,
+            .shaderFloat16 = VK_FALSE,
+            .shaderInt8 = VK_FALSE
+    };
+    // core in 1.2 only
+    if(devProps.apiVersion >= VK_API_VERSION_1_2){
+        multiviewFeatures.pNext = &float16Int8Features;
+    }
+#ifdef VK_EXT_host_image_copy
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT,
+            .pNext = multiviewFeatures.pNext,
+            .hostImageCopy = VK_FALSE
+    };
+    // the feature struct may only be chained when the extension gets enabled
+    for(uint32_t i = 0; i < enableDeviceExtensionCount; i++){
+        if(strcmp(enableDeviceExtensions[i], VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) == 0){
+            multiviewFeatures.pNext = &hostImageCopyFeatures;
+        }
+    }
+#endif
+    if(devProps.apiVersion >= VK_API_VERSION_1_1 && vkGetPhysicalDeviceFeatures2 != nullptr){
+        VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &multiviewFeatures,
+        };
+        vkGetPhysicalDeviceFeatures2(selectedPhysicalDev, &supportedFeatures2);
+    }
+    // only the plain multiview feature is needed, no geometry or tessellation shaders
+    multiviewFeatures.multiviewGeometryShader = VK_FALSE;
+    multiviewFeatures.multiviewTessellationShader = VK_FALSE;
+    out_deviceInfo->features.multiview = multiviewFeatures.multiview;
+    LOG_D("Multiview Support: %d", multiviewFeatures.multiview);
+#ifdef VK_EXT_host_image_copy
+    out_deviceInfo->features.hostImageCopy = hostImageCopyFeatures.hostImageCopy;
+#endif
+    LOG_D("Host Image Copy Support: %d", out_deviceInfo->features.hostImageCopy);
+    out_deviceInfo->features.hostQueryReset = devProps.apiVersion >= VK_API_VERSION_1_2 ? hostQueryResetFeatures.hostQueryReset : VK_FALSE;
+    LOG_D("Host Query Reset Support: %d", out_deviceInfo->features.hostQueryReset);
+    // only FP16 arithmetic is used, 8 bit integers stay off
+    float16Int8Features.shaderInt8 = VK_FALSE;
+    out_deviceInfo->features.shaderFloat16 = devProps.apiVersion >= VK_API_VERSION_1_2 ? float16Int8Features.shaderFloat16 : VK_FALSE;
+    LOG_D("Shader Float16 Support: %d", out_deviceInfo->features.shaderFloat16);
+    // timestamps of different queues only share a time domain once both are correlated to the same host clock
+    out_deviceInfo->features.calibratedTimestamps = VK_FALSE;
+    for(uint32_t i = 0; i < enableDeviceExtensionCount; i++){
+        if(strcmp(enableDeviceExtensions[i], VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) != 0){
+            continue;
+        }
+        auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+                vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+        uint32_t timeDomainCount = 0;
+        if(getTimeDomains == nullptr || getTimeDomains(selectedPhysicalDev, &timeDomainCount, nullptr) != VK_SUCCESS){
+            break;
+        }
+        VkTimeDomainEXT timeDomains[timeDomainCount];
+        getTimeDomains(selectedPhysicalDev, &timeDomainCount, timeDomains);
+        bool bDevice = false, bMonotonic = false;
+        for(uint32_t j = 0; j < timeDomainCount; j++){
+            bDevice |= timeDomains[j] == VK_TIME_DOMAIN_DEVICE_EXT;
+            bMonotonic |= timeDomains[j] == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+        }
+        out_deviceInfo->features.calibratedTimestamps = bDevice && bMonotonic;
+    }
+    LOG_D("Calibrated Timestamps Support: %d", out_deviceInfo->features.calibratedTimestamps);
+
     VkPhysicalDeviceSamplerYcbcrConversionFeatures ycbcrFeatures = {
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES,
-            .pNext = nullptr,
+            .pNext = &multiviewFeatures,
             .samplerYcbcrConversion = VK_TRUE
     };
     VkPhysicalDeviceFeatures2 phyDevFeatures2 = {
@@ -199,8 +320,8 @@ void VkHelper::pickPhyDevAndCreateDev(VkInstance instance, VkSurfaceKHR surface,
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
             .pNext = &phyDevFeatures2,
             .flags = 0,
-            .queueCreateInfoCount = 1,
-            .pQueueCreateInfos = &queueCreateInfo,
+            .queueCreateInfoCount = transferIndex >= 0 ? 2u : 1u,
+            .pQueueCreateInfos = queueCreateInfos,
             .enabledLayerCount = 0,
             .ppEnabledLayerNames = nullptr,
             .enabledExtensionCount = enableDeviceExtensionCount,
@@ -209,6 +330,11 @@ void VkHelper::pickPhyDevAndCreateDev(VkInstance instance, VkSurfaceKHR surface,
     CALL_VK(vkCreateDevice(out_deviceInfo->physicalDev, &deviceCreateInfo, VK_ALLOC, &out_deviceInfo->device));
 
     vkGetDeviceQueue(out_deviceInfo->device, out_queueInfo->workQueueIndex, 0, &out_queueInfo->queue);
+    out_queueInfo->transferQueueIndex = transferIndex >= 0 ? transferIndex : out_queueInfo->workQueueIndex;
+    out_queueInfo->transferQueue = VK_NULL_HANDLE;
+    if(transferIndex >= 0){
+        vkGetDeviceQueue(out_deviceInfo->device, out_queueInfo->transferQueueIndex, 0, &out_queueInfo->transferQueue);
+    }
 
 #ifdef RENDER_USE_SINGLE_BUFFER
     vkGetSwapchainStatusKHR = reinterpret_cast<PFN_vkGetSwapchainStatusKHR>(
@@ -346,7 +472,9 @@ void VkHelper::createSwapchain(VkPhysicalDevice physicalDev, VkDevice device, Vk
             .imageColorSpace = out_swapchainParam->format.colorSpace,
             .imageExtent = out_swapchainParam->extent,
             .imageArrayLayers = 1,
-            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            // transfer dst lets the foveated path blit its upscaled eyes into the presentable image
+            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                          (out_swapchainParam->capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT),
             .imageSharingMode = workQueueIndex == presentQueueIndex ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT,
             .queueFamilyIndexCount = static_cast<uint32_t>(workQueueIndex == presentQueueIndex ? 1 : 2),
             .pQueueFamilyIndices = workQueueIndex == presentQueueIndex ? nullptr : queueFamilysArr,
@@ -360,7 +488,8 @@ void VkHelper::createSwapchain(VkPhysicalDevice physicalDev, VkDevice device, Vk
     CALL_VK(vkCreateSwapchainKHR(device, &swapchainCreateInfo, VK_ALLOC, out_swapchain));
 }
 
-void VkHelper::createRenderPass(VkDevice device, SwapchainParam swapchainParam, VkRenderPass *out_renderPass) {
+void VkHelper::createRenderPass(VkDevice device, SwapchainParam swapchainParam, VkRenderPass *out_renderPass,
+                                VkImageLayout finalLayout, uint32_t viewMask, VkAttachmentLoadOp loadOp) {
     VkAttachmentDescription attachDesc[] = {
             {
                     .flags = 0,
@@ -369,14 +498,15 @@ void VkHelper::createRenderPass(VkDevice device, SwapchainParam swapchainParam,
                     //VK_ATTACHMENT_LOAD_OP_LOAD：保持附着的现有内容
                     //VK_ATTACHMENT_LOAD_OP_CLEAR：使用一个常量值来清除附着的内容
                     //VK_ATTACHMENT_LOAD_OP_DONT_CARE：不关心附着现存的内容
-                    .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                    .loadOp = loadOp,
                     .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
                     //K_ATTACHMENT_STORE_OP_STORE：渲染的内容会被存储起来，以便之后读取
                     //VK_ATTACHMENT_STORE_OP_DONT_CARE：渲染后，不会读取帧缓冲的内容
                     .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                     .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                    .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+                    // loaded content has to be in the attachment layout already
+                    .initialLayout = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                    .finalLayout = finalLayout
             }
     };
     VkAttachmentReference colorAttachRef = {
@@ -395,6 +525,9 @@ void VkHelper::createRenderPass(VkDevice device, SwapchainParam swapchainParam,
             .pPreserveAttachments = nullptr,
     };
 
+    // a render target that gets copied out or sampled afterwards has to be written before it is read
+    bool bTransferSrc = finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    bool bSampled = finalLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     VkSubpassDependency dependencys[] = {
             {
                     .srcSubpass = VK_SUBPASS_EXTERNAL,
@@ -409,16 +542,30 @@ void VkHelper::createRenderPass(VkDevice device, SwapchainParam swapchainParam,
                     .srcSubpass = 0,
                     .dstSubpass = VK_SUBPASS_EXTERNAL,
                     .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-                    .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    .dstStageMask = bTransferSrc ? VK_PIPELINE_STAGE_TRANSFER_BIT :
+                                    bSampled ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
                     .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                    .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+                    .dstAccessMask = bTransferSrc ? VK_ACCESS_TRANSFER_READ_BIT :
+                                     bSampled ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_MEMORY_READ_BIT,
                     .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
             }
     };
 
+    // every view in viewMask renders into the framebuffer layer of the same index
+    VkRenderPassMultiviewCreateInfo multiviewCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+            .pNext = nullptr,
+            .subpassCount = 1,
+            .pViewMasks = &viewMask,
+            .dependencyCount = 0,
+            .pViewOffsets = nullptr,
+            .correlationMaskCount = 1,
+            .pCorrelationMasks = &viewMask
+    };
+
     VkRenderPassCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .pNext = nullptr,
+            .pNext = viewMask == 0 ? nullptr : &multiviewCreateInfo,
             .flags = 0,
             .attachmentCount = ARRAY_SIZE(attachDesc),
             .pAttachments = attachDesc,
@@ -453,15 +600,16 @@ void VkHelper::createFramebuffer(VkDevice device, VkRenderPass renderPass,
     }
 }
 
-void VkHelper::createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout *out_pipelineLayout) {
+void VkHelper::createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout *out_pipelineLayout,
+                                    const VkPushConstantRange *pushConstantRange) {
     VkPipelineLayoutCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
             .setLayoutCount = 1,
             .pSetLayouts = &descriptorSetLayout,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr
+            .pushConstantRangeCount = pushConstantRange == nullptr ? 0u : 1u,
+            .pPushConstantRanges = pushConstantRange
     };
     CALL_VK(vkCreatePipelineLayout(device, &createInfo, VK_ALLOC, out_pipelineLayout));
 }
@@ -483,7 +631,7 @@ VkShaderModule VkHelper::createShaderModule(VkDevice device, std::vector<char> &
 
 void VkHelper::createPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass,
                               VkShaderModule vertShaderModule, VkShaderModule fragShaderModule, SwapchainParam swapchainParam,
-                              VkPipeline *out_pipeline) {
+                              VkPipeline *out_pipeline, bool bAlphaBlend, const VkSpecializationInfo *fragSpecialization) {
     VkPipelineShaderStageCreateInfo stages[] = {
             {
                     .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -501,7 +649,7 @@ void VkHelper::createPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
                     .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                     .module = fragShaderModule,
                     .pName = "main",
-                    .pSpecializationInfo = nullptr
+                    .pSpecializationInfo = fragSpecialization
             }
     };
 
@@ -580,13 +728,14 @@ void VkHelper::createPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
             .alphaToOneEnable = VK_FALSE
     };
 
+    // blending draws straight alpha content over what is already in the target
     VkPipelineColorBlendAttachmentState attachmentState = {
-            .blendEnable = VK_FALSE,
-            .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
-            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .blendEnable = bAlphaBlend ? VK_TRUE : VK_FALSE,
+            .srcColorBlendFactor = bAlphaBlend ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE,
+            .dstColorBlendFactor = bAlphaBlend ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
             .colorBlendOp = VK_BLEND_OP_ADD,
             .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .dstAlphaBlendFactor = bAlphaBlend ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
             .alphaBlendOp = VK_BLEND_OP_ADD,
             .colorWriteMask = VK_COLOR_COMPONENT_R_BIT
                     | VK_COLOR_COMPONENT_G_BIT
@@ -758,69 +907,55 @@ void VkHelper::copyBuffer(VkDevice device, VkCommandPool cmdPool, VkQueue queue,
     endCommandBuffer(cmdBuffer, device, cmdPool, queue, true);
 }
 
-void VkHelper::createBufferInternal(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device,
-                                    VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps, VkDeviceSize size,
-                                    VkBuffer *outBuffer, VkDeviceMemory *outMemory) {
+void VkHelper::createBufferInternal(VkMemoryAllocator *allocator, VkDevice device,
+                                    VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps, AllocationUsage allocUsage,
+                                    VkDeviceSize size, VkBuffer *outBuffer, VkAllocation *outAllocation) {
     createBuffer(device, size, usage, outBuffer);
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, *outBuffer, &memRequirements);
-    VkMemoryAllocateInfo memAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .allocationSize = memRequirements.size,
-            .memoryTypeIndex = findMemoryType(physicalMemoType, memRequirements.memoryTypeBits, memProps)
-    };
-    CALL_VK(vkAllocateMemory(device, &memAllocateInfo, VK_ALLOC, outMemory));
-    CALL_VK(vkBindBufferMemory(device, *outBuffer, *outMemory, 0));
+    allocator->allocateAndBindBuffer(*outBuffer, memProps, allocUsage, outAllocation);
 }
 
-void VkHelper::createBuffer(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device, VkCommandPool cmdPool,
-                            VkQueue queue, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps,
+void VkHelper::createBuffer(VkMemoryAllocator *allocator, VkDevice device, UploadBatch *batch,
+                            VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps,
                             uint32_t dataSize, const void *data, VkBuffer *outBuffer,
-                            VkDeviceMemory *outMemory) {
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemo;
-    createBufferInternal(physicalMemoType, device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         dataSize, &stagingBuffer, &stagingMemo);
+                            VkAllocation *outAllocation) {
+    createBufferInternal(allocator, device, usage, memProps, AllocationUsage::RESOURCE, dataSize, outBuffer, outAllocation);
     if(data){
-        void *data_ptr;
-        CALL_VK(vkMapMemory(device, stagingMemo, 0, dataSize, 0, &data_ptr));
-        memcpy(data_ptr, data, (size_t) dataSize);
+        batch->uploadBuffer(*outBuffer, 0, data, dataSize);
     }
+}
 
-    createBufferInternal(physicalMemoType, device, usage, memProps, dataSize, outBuffer, outMemory);
-    copyBuffer(device, cmdPool, queue, stagingBuffer, *outBuffer, dataSize);
-
-    vkDestroyBuffer(device, stagingBuffer, VK_ALLOC);
-    vkFreeMemory(device, stagingMemo, VK_ALLOC);
+void VkHelper::destroyBuffer(VkMemoryAllocator *allocator, VkDevice device, VkBuffer *buffer, VkAllocation *allocation) {
+    if(*buffer != VK_NULL_HANDLE){
+        vkDestroyBuffer(device, *buffer, VK_ALLOC);
+        *buffer = VK_NULL_HANDLE;
+    }
+    allocator->free(allocation);
 }
 
-void VkHelper::initGeometryBuffers(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device,
-                                   VkCommandPool cmdPool, VkQueue queue, Geometry &geometry){
+void VkHelper::initGeometryBuffers(VkMemoryAllocator *allocator, VkDevice device,
+                                   UploadBatch *batch, Geometry &geometry){
     if(geometry.vertices.empty()){
         LOG_E("The geometry's vertices is empty.");
         return;
     }
-    createBuffer(physicalMemoType, device, cmdPool, queue,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    createBuffer(allocator, device, batch, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sizeof(Vertex) * geometry.vertices.size(), geometry.vertices.data(),
-                 &geometry.vertexBuffer, &geometry.vertexMemory);
+                 &geometry.vertexBuffer, &geometry.vertexAllocation);
 
     if(!geometry.indices.empty()){
-        createBuffer(physicalMemoType, device, cmdPool, queue,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        createBuffer(allocator, device, batch, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sizeof(uint32_t) * geometry.indices.size(), geometry.indices.data(),
-                     &geometry.indexBuffer, &geometry.indexMemory);
+                     &geometry.indexBuffer, &geometry.indexAllocation);
     }
 
     //uniform buffers
     geometry.uniformBuffers.resize(1);
-    geometry.uniformMemorys.resize(1);
+    geometry.uniformAllocations.resize(1);
     geometry.uniformBuffersMapped.resize(1);
 }
 
 void VkHelper::geometryDraw(VkCommandBuffer cmdBuffer, VkPipeline graphicPipeline,
-                            SwapchainParam swapchainParam, const Geometry& geometry) {
+                            SwapchainParam swapchainParam, const Geometry& geometry, uint32_t instanceCount) {
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicPipeline);
     if(geometry.vertexBuffer != VK_NULL_HANDLE) {
         VkDeviceSize offsets[] = {0};
@@ -848,20 +983,21 @@ void VkHelper::geometryDraw(VkCommandBuffer cmdBuffer, VkPipeline graphicPipelin
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
     if(geometry.bUseIndexDraw()){
-        vkCmdDrawIndexed(cmdBuffer, geometry.geIndexCount(), 1, 0, 0, 0);
+        vkCmdDrawIndexed(cmdBuffer, geometry.geIndexCount(), instanceCount, 0, 0, 0);
     } else {
         /*
          * commandBuffer 命令缓冲
          * vertexCount 顶点数量
-         * instanceCount 实例数量，我们目前只绘制一个实例。当绘制大批量对象时会用到。
+         * instanceCount 实例数量，单遍立体每只眼一个实例
          * firstVertex 起始顶点，用于偏移
          * firstInstance 起始实例，用于偏移
          */
-        vkCmdDraw(cmdBuffer, geometry.getVertexCount(), 1, 0, 0);
+        vkCmdDraw(cmdBuffer, geometry.getVertexCount(), instanceCount, 0, 0);
     }
 }
 
-void VkHelper::createDescriptorSetLayout(VkDevice device, VkSampler immutableSampler, VkDescriptorSetLayout *out_descriptorSetLayout) {
+void VkHelper::createDescriptorSetLayout(VkDevice device, VkSampler immutableSampler, VkDescriptorSetLayout *out_descriptorSetLayout,
+                                         uint32_t bindingCount) {
     VkDescriptorSetLayoutBinding layoutBindings[] = {
             {
                     .binding = 0,
@@ -882,28 +1018,28 @@ void VkHelper::createDescriptorSetLayout(VkDevice device, VkSampler immutableSam
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
-            .bindingCount = ARRAY_SIZE(layoutBindings),
+            .bindingCount = std::min<uint32_t>(bindingCount, ARRAY_SIZE(layoutBindings)),
             .pBindings = layoutBindings
     };
     CALL_VK(vkCreateDescriptorSetLayout(device, &createInfo, VK_ALLOC, out_descriptorSetLayout));
 }
 
-void VkHelper::createDescriptorPool(VkDevice device, VkDescriptorPool *out_descriptorPool) {
+void VkHelper::createDescriptorPool(VkDevice device, uint32_t maxSets, VkDescriptorPool *out_descriptorPool) {
     VkDescriptorPoolSize poolSizeInfo[] = {
             {
                     .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    .descriptorCount = 2
+                    .descriptorCount = maxSets
             },
             {
                     .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    .descriptorCount = 2
+                    .descriptorCount = maxSets
             }
     };
     VkDescriptorPoolCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
             .pNext = nullptr,
             .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-            .maxSets = 2,
+            .maxSets = maxSets,
             .poolSizeCount = ARRAY_SIZE(poolSizeInfo),
             .pPoolSizes = poolSizeInfo,
     };
@@ -924,10 +1060,10 @@ void VkHelper::allocateDescriptorSets(VkDevice device, VkDescriptorPool pool,
     CALL_VK(vkAllocateDescriptorSets(device, &allocateInfo, out_descriptorSets));
 }
 
-void VkHelper::createImage(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device, int width, int height,
+void VkHelper::createImage(VkMemoryAllocator *allocator, VkDevice device, int width, int height,
                            int depth, VkImageType imageType, VkFormat format, VkSampleCountFlagBits sampleCount,
                            VkImageTiling tiling, VkImageUsageFlags usage,
-                           VkImage *out_image, VkDeviceMemory *out_imageMemory) {
+                           VkImage *out_image, VkAllocation *out_imageAllocation, uint32_t arrayLayers, uint32_t mipLevels) {
     VkImageCreateInfo imageCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
             .pNext = nullptr,
@@ -939,8 +1075,8 @@ void VkHelper::createImage(VkPhysicalDeviceMemoryProperties physicalMemoType, Vk
                     .height = static_cast<uint32_t>(height),
                     .depth = static_cast<uint32_t>(depth)
             },
-            .mipLevels = 1,
-            .arrayLayers = 1,
+            .mipLevels = mipLevels,
+            .arrayLayers = arrayLayers,
             .samples = sampleCount,
             .tiling = tiling,
             .usage = usage,
@@ -949,22 +1085,19 @@ void VkHelper::createImage(VkPhysicalDeviceMemoryProperties physicalMemoType, Vk
     };
     CALL_VK(vkCreateImage(device, &imageCreateInfo, VK_ALLOC, out_image));
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, *out_image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = VkHelper::findMemoryType(physicalMemoType, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    allocator->allocateAndBindImage(*out_image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationUsage::RESOURCE, out_imageAllocation);
+}
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, out_imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
+void VkHelper::destroyImage(VkMemoryAllocator *allocator, VkDevice device, VkImage *image, VkAllocation *allocation) {
+    if(*image != VK_NULL_HANDLE){
+        vkDestroyImage(device, *image, VK_ALLOC);
+        *image = VK_NULL_HANDLE;
     }
-
-    vkBindImageMemory(device, *out_image, *out_imageMemory, 0);
+    allocator->free(allocation);
 }
 
-void VkHelper::createImageView(VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format, VkImageAspectFlags aspectMask, VkImageView *out_imageView) {
+void VkHelper::createImageView(VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format, VkImageAspectFlags aspectMask,
+                               VkImageView *out_imageView, uint32_t layerCount, uint32_t levelCount) {
     VkImageViewCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .pNext = nullptr,
@@ -976,15 +1109,15 @@ void VkHelper::createImageView(VkDevice device, VkImage image, VkImageViewType v
             .subresourceRange = {
                     .aspectMask = aspectMask,
                     .baseMipLevel = 0,
-                    .levelCount = 1,
+                    .levelCount = levelCount,
                     .baseArrayLayer = 0,
-                    .layerCount = 1
+                    .layerCount = layerCount
             }
     };
     CALL_VK(vkCreateImageView(device, &createInfo, VK_ALLOC, out_imageView));
 }
 
-void VkHelper::createImageSampler(VkDevice device, VkSampler *out_sampler) {
+void VkHelper::createImageSampler(VkDevice device, VkSampler *out_sampler, float maxLod) {
     VkSamplerCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
             .pNext = nullptr,
@@ -1001,7 +1134,7 @@ void VkHelper::createImageSampler(VkDevice device, VkSampler *out_sampler) {
             .compareEnable = VK_FALSE,
             .compareOp = VK_COMPARE_OP_ALWAYS,
             .minLod = 0.0f,
-            .maxLod = 0.0f,
+            .maxLod = maxLod,
             .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
             .unnormalizedCoordinates = VK_FALSE
     };
@@ -1009,7 +1142,8 @@ void VkHelper::createImageSampler(VkDevice device, VkSampler *out_sampler) {
 }
 
 
-void VkHelper::transition_image_layout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkCommandBuffer command_buffer){
+void VkHelper::transition_image_layout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkCommandBuffer command_buffer,
+                                       uint32_t base_array_layer, uint32_t layer_count, uint32_t level_count){
     VkImageMemoryBarrier barrier;
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.pNext = NULL;
@@ -1020,9 +1154,9 @@ void VkHelper::transition_image_layout(VkImage image, VkImageLayout old_layout,
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.levelCount = level_count;
+    barrier.subresourceRange.baseArrayLayer = base_array_layer;
+    barrier.subresourceRange.layerCount = layer_count;
 
     VkPipelineStageFlags sourceStage;
     VkPipelineStageFlags destinationStage;
@@ -1061,6 +1195,13 @@ void VkHelper::transition_image_layout(VkImage image, VkImageLayout old_layout,
         barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
+        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else if(old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+        // host written images that are sampled as they are
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
         sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
         destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     } else if(old_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
@@ -4,6 +4,8 @@
 #include "VulkanCommon.h"
 #include "VkBundle.h"
 #include "Geometry.h"
+#include "VkMemoryAllocator.h"
+#include "UploadBatch.h"
 
 enum class MemoryLocation
 {
@@ -19,14 +21,20 @@ public:
     static void createCommandPool(VkDevice device, uint32_t workQueueIndex, VkCommandPool *out_cmdPool);
     static void createSwapchain(VkPhysicalDevice physicalDev, VkDevice device, VkSurfaceKHR surface, uint16_t workQueueIndex, uint16_t presentQueueIndex,
                                 SwapchainParam *out_swapchainParam, VkSwapchainKHR *out_swapchain);
-    static void createRenderPass(VkDevice device, SwapchainParam swapchainParam, VkRenderPass *out_renderPass);
+    // a non zero viewMask makes a multiview render pass, one framebuffer layer per view.
+    // with LOAD_OP_LOAD the attachment is expected in COLOR_ATTACHMENT_OPTIMAL when the pass begins
+    static void createRenderPass(VkDevice device, SwapchainParam swapchainParam, VkRenderPass *out_renderPass,
+                                    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, uint32_t viewMask = 0,
+                                    VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR);
     static void createFramebuffer(VkDevice device, VkRenderPass renderPass, uint32_t width, uint32_t height,
                                      uint32_t framebufferCount, VkImageView *imageViews, VkFramebuffer *out_framebuffers);
-    static void createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout *out_pipelineLayout);
+    static void createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout *out_pipelineLayout,
+                                        const VkPushConstantRange *pushConstantRange = nullptr);
     static VkShaderModule createShaderModule(VkDevice device, std::vector<char> &code);
     static void createPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass,
                                   VkShaderModule vertShaderModule, VkShaderModule fragShaderModule, SwapchainParam swapchainParam,
-                                  VkPipeline *out_pipeline);
+                                  VkPipeline *out_pipeline, bool bAlphaBlend = false,
+                                  const VkSpecializationInfo *fragSpecialization = nullptr);
     static void allocateCommandBuffers(VkDevice device, VkCommandPool cmdPool, uint32_t cmdBufferCount, VkCommandBuffer *cmdBuffers);
     static void printPhysicalDevLog(const VkPhysicalDeviceProperties &devProps);
     static void beginCommandBuffer(VkCommandBuffer cmdBuffer, bool oneTime);
@@ -35,27 +43,35 @@ public:
     static uint32_t findMemoryType(VkPhysicalDeviceMemoryProperties phyProperties, uint32_t typeFilter, VkMemoryPropertyFlags properties);
     static uint32_t getMemoryIndex(VkPhysicalDeviceMemoryProperties phyProperties, uint32_t memoryTypeBits, MemoryLocation location);
     static void copyBuffer(VkDevice device, VkCommandPool cmdPool, VkQueue queue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    static void createBufferInternal(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device,
-                                        VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps, VkDeviceSize size,
-                                        VkBuffer *outBuffer, VkDeviceMemory *outMemory);
-    static void createBuffer(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device, VkCommandPool cmdPool,
-                                VkQueue queue, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps,
+    static void createBufferInternal(VkMemoryAllocator *allocator, VkDevice device,
+                                        VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps, AllocationUsage allocUsage,
+                                        VkDeviceSize size, VkBuffer *outBuffer, VkAllocation *outAllocation);
+    static void createBuffer(VkMemoryAllocator *allocator, VkDevice device, UploadBatch *batch,
+                                VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps,
                                 uint32_t dataSize, const void *data, VkBuffer *outBuffer,
-                                VkDeviceMemory *outMemory);
-    static void initGeometryBuffers(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device,
-                                       VkCommandPool cmdPool, VkQueue queue, Geometry &geometry);
-    static void geometryDraw(VkCommandBuffer cmdBuffer, VkPipeline graphicPipeline, SwapchainParam swapchainParam, const Geometry& geometry);
-    static void createDescriptorSetLayout(VkDevice device, VkSampler immutableSampler, VkDescriptorSetLayout *out_descriptorSetLayout);
-    static void createDescriptorPool(VkDevice device, VkDescriptorPool *out_descriptorPool);
+                                VkAllocation *outAllocation);
+    static void destroyBuffer(VkMemoryAllocator *allocator, VkDevice device, VkBuffer *buffer, VkAllocation *allocation);
+    static void initGeometryBuffers(VkMemoryAllocator *allocator, VkDevice device,
+                                       UploadBatch *batch, Geometry &geometry);
+    static void geometryDraw(VkCommandBuffer cmdBuffer, VkPipeline graphicPipeline, SwapchainParam swapchainParam, const Geometry& geometry,
+                             uint32_t instanceCount = 1);
+    // bindingCount 1 keeps binding 0 only, for a single combined YCbCr image
+    static void createDescriptorSetLayout(VkDevice device, VkSampler immutableSampler, VkDescriptorSetLayout *out_descriptorSetLayout,
+                                          uint32_t bindingCount = 2);
+    // room for maxSets sets of the camera layout, two image samplers each
+    static void createDescriptorPool(VkDevice device, uint32_t maxSets, VkDescriptorPool *out_descriptorPool);
     static void allocateDescriptorSets(VkDevice device, VkDescriptorPool pool,
                                           VkDescriptorSetLayout layout, VkDescriptorSet *out_descriptorSets);
-    static void createImage(VkPhysicalDeviceMemoryProperties physicalMemoType, VkDevice device, int width, int height,
+    static void createImage(VkMemoryAllocator *allocator, VkDevice device, int width, int height,
                                int depth, VkImageType imageType, VkFormat format, VkSampleCountFlagBits sampleCount,
                                VkImageTiling tiling, VkImageUsageFlags usage,
-                               VkImage *out_image, VkDeviceMemory *out_imageMemory);
-    static void createImageView(VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format, VkImageAspectFlags aspectMask, VkImageView *out_imageView);
-    static void createImageSampler(VkDevice device, VkSampler *out_sampler);
-    static void transition_image_layout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkCommandBuffer command_buffer);
+                               VkImage *out_image, VkAllocation *out_imageAllocation, uint32_t arrayLayers = 1, uint32_t mipLevels = 1);
+    static void destroyImage(VkMemoryAllocator *allocator, VkDevice device, VkImage *image, VkAllocation *allocation);
+    static void createImageView(VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format, VkImageAspectFlags aspectMask,
+                                   VkImageView *out_imageView, uint32_t layerCount = 1, uint32_t levelCount = 1);
+    static void createImageSampler(VkDevice device, VkSampler *out_sampler, float maxLod = 0.0f);
+    static void transition_image_layout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkCommandBuffer command_buffer,
+                                        uint32_t base_array_layer = 0, uint32_t layer_count = 1, uint32_t level_count = 1);
 };
 
 #endif //LEARN_VULKAN_VKHELPER_H
@@ -0,0 +1,564 @@
+#include "VkLayerCompositor.h"
+#include <algorithm>
+#include <cstring>
+#include "VkHelper.h"
+#include "../ProfileTrace.h"
+
+#define COMPOSITOR_STATS_INTERVAL 300
+
+VkLayerCompositor::VkLayerCompositor(VkBundle *vk, UploadBatch *batch, std::vector<char> &vertCode, std::vector<char> &fragCode,
+                                     uint32_t slotCount, VkImageLayout targetFinalLayout, uint32_t maxLayers)
+        : mVk(vk), mTargetFinalLayout(targetFinalLayout), mMaxLayers(maxLayers), mLayers(maxLayers),
+          mLayerSets(maxLayers), mParams(maxLayers), mSlots(slotCount) {
+    VkDevice device = mVk->deviceInfo.device;
+
+    // one strip of columns from left to right, bent in the vertex shader for cylinders
+    for(uint32_t i = 0; i <= GRID_COLUMNS; i++){
+        float u = i * 1.f / GRID_COLUMNS;
+        mGrid.vertices.push_back({{u * 2.f - 1.f, 1.f}, {u, 0.f}});
+        mGrid.vertices.push_back({{u * 2.f - 1.f, -1.f}, {u, 1.f}});
+    }
+    VkHelper::initGeometryBuffers(mVk->allocator, device, batch, mGrid);
+
+    VkDescriptorSetLayoutBinding layerBinding = {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = nullptr
+    };
+    VkDescriptorSetLayoutBinding paramsBinding = {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = nullptr
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = 1,
+            .pBindings = &layerBinding
+    };
+    CALL_VK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, VK_ALLOC, &mLayerSetLayout));
+    setLayoutCreateInfo.pBindings = &paramsBinding;
+    CALL_VK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, VK_ALLOC, &mParamsSetLayout));
+
+    // every set is allocated up front, adding a layer only rewrites its set
+    VkDescriptorPoolSize poolSizes[] = {
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxLayers},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slotCount}
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .maxSets = maxLayers + slotCount,
+            .poolSizeCount = ARRAY_SIZE(poolSizes),
+            .pPoolSizes = poolSizes
+    };
+    CALL_VK(vkCreateDescriptorPool(device, &poolCreateInfo, VK_ALLOC, &mDescriptorPool));
+    std::vector<VkDescriptorSetLayout> layerSetLayouts(maxLayers, mLayerSetLayout);
+    VkDescriptorSetAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = mDescriptorPool,
+            .descriptorSetCount = maxLayers,
+            .pSetLayouts = layerSetLayouts.data()
+    };
+    CALL_VK(vkAllocateDescriptorSets(device, &allocateInfo, mLayerSets.data()));
+
+    VkDeviceSize paramsSize = sizeof(OverlayLayerParams) * maxLayers;
+    for(auto &slot : mSlots){
+        VkHelper::createBufferInternal(mVk->allocator, device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       AllocationUsage::RESOURCE, paramsSize, &slot.paramsBuffer, &slot.paramsAllocation);
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &mParamsSetLayout;
+        CALL_VK(vkAllocateDescriptorSets(device, &allocateInfo, &slot.paramsSet));
+        VkDescriptorBufferInfo bufferInfo = {
+                .buffer = slot.paramsBuffer,
+                .offset = 0,
+                .range = paramsSize
+        };
+        VkWriteDescriptorSet write = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = nullptr,
+                .dstSet = slot.paramsSet,
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = nullptr,
+                .pBufferInfo = &bufferInfo,
+                .pTexelBufferView = nullptr
+        };
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    VkDescriptorSetLayout setLayouts[] = {mLayerSetLayout, mParamsSetLayout};
+    VkPushConstantRange pushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(OverlayDrawParams)
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = ARRAY_SIZE(setLayouts),
+            .pSetLayouts = setLayouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange
+    };
+    CALL_VK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VK_ALLOC, &mPipelineLayout));
+    mVertShaderModule = VkHelper::createShaderModule(device, vertCode);
+    mFragShaderModule = VkHelper::createShaderModule(device, fragCode);
+    // the renderer's render pass, the overlay pass only differs in the load op and stays compatible
+    VkHelper::createPipeline(device, mPipelineLayout, mVk->renderPass, mVertShaderModule, mFragShaderModule,
+                             mVk->swapchainParam, &mPipeline, true);
+    VkHelper::createRenderPass(device, mVk->swapchainParam, &mOverlayRenderPass, mTargetFinalLayout, 0, VK_ATTACHMENT_LOAD_OP_LOAD);
+
+    SwapchainParam contentParam = mVk->swapchainParam;
+    contentParam.format = {VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    VkHelper::createRenderPass(device, contentParam, &mContentRenderPass, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkHelper::createImageSampler(device, &mContentSampler);
+
+    if(mVk->deviceInfo.physicalDevLimits.timestampComputeAndGraphics){
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = slotCount * queriesPerSlot(),
+                .pipelineStatistics = 0
+        };
+        CALL_VK(vkCreateQueryPool(device, &queryPoolCreateInfo, VK_ALLOC, &mQueryPool));
+        // a value and an availability word per query
+        mQueryResults.resize(queriesPerSlot() * 2);
+    } else {
+        LOG_W("VkLayerCompositor: no timestamp support, per layer GPU times will not be reported.");
+    }
+    LOG_D("VkLayerCompositor: %u layers max, %u slots", maxLayers, slotCount);
+}
+
+VkLayerCompositor::~VkLayerCompositor() {
+    VkDevice device = mVk->deviceInfo.device;
+    printStats();
+    for(auto &slot : mSlots){
+        for(auto &composite : slot.composites){
+            if(composite.cmdBuffer != VK_NULL_HANDLE){
+                vkFreeCommandBuffers(device, mVk->cmdPool, 1, &composite.cmdBuffer);
+            }
+        }
+        VkHelper::destroyBuffer(mVk->allocator, device, &slot.paramsBuffer, &slot.paramsAllocation);
+    }
+    for(auto &layer : mLayers){
+        destroyContent(layer);
+    }
+    if(mQueryPool != VK_NULL_HANDLE){
+        vkDestroyQueryPool(device, mQueryPool, VK_ALLOC);
+    }
+    vkDestroySampler(device, mContentSampler, VK_ALLOC);
+    vkDestroyRenderPass(device, mContentRenderPass, VK_ALLOC);
+    vkDestroyRenderPass(device, mOverlayRenderPass, VK_ALLOC);
+    vkDestroyPipeline(device, mPipeline, VK_ALLOC);
+    vkDestroyShaderModule(device, mVertShaderModule, VK_ALLOC);
+    vkDestroyShaderModule(device, mFragShaderModule, VK_ALLOC);
+    vkDestroyPipelineLayout(device, mPipelineLayout, VK_ALLOC);
+    // destroying the pool frees every set allocated from it
+    vkDestroyDescriptorPool(device, mDescriptorPool, VK_ALLOC);
+    vkDestroyDescriptorSetLayout(device, mParamsSetLayout, VK_ALLOC);
+    vkDestroyDescriptorSetLayout(device, mLayerSetLayout, VK_ALLOC);
+    mGrid.destroy(device, mVk->allocator);
+}
+
+LayerId VkLayerCompositor::addLayer(const OverlayLayerDesc &desc) {
+    auto it = std::find_if(mLayers.begin(), mLayers.end(), [](const Layer &layer){ return !layer.bUsed; });
+    if(it == mLayers.end()){
+        LOG_W("VkLayerCompositor: all %u layers are in use.", mMaxLayers);
+        return INVALID_LAYER_ID;
+    }
+    LayerId id = static_cast<LayerId>(it - mLayers.begin());
+    Layer &layer = *it;
+    layer = Layer{};
+    layer.bUsed = true;
+    layer.addSerial = mAddSerial++;
+    layer.desc = desc;
+    mParams[id] = {
+            .transforms = {desc.transforms[0], desc.transforms[1]},
+            .shape = glm::vec4(desc.shape == LayerShape::CYLINDER ? desc.cylinderAngle : 0.f, 0.f, 0.f, 0.f),
+            .color = desc.color
+    };
+    mParamsVersion++;
+
+    if(desc.drawContent){
+        VkDevice device = mVk->deviceInfo.device;
+        VkHelper::createImage(mVk->allocator, device, desc.contentExtent.width, desc.contentExtent.height, 1, VK_IMAGE_TYPE_2D,
+                              VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+                              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &layer.image, &layer.allocation);
+        VkHelper::createImageView(device, layer.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, &layer.view);
+        VkHelper::createFramebuffer(device, mContentRenderPass, desc.contentExtent.width, desc.contentExtent.height,
+                                    1, &layer.view, &layer.framebuffer);
+        bindContent(id, layer.view, mContentSampler);
+        // shown once the first draw of the content is recorded
+        markDirty(id);
+    } else if(desc.texture){
+        mWaitingTextures.push_back(id);
+    } else {
+        bindContent(id, desc.imageView, desc.sampler);
+        setVisible(id, true);
+    }
+    return id;
+}
+
+void VkLayerCompositor::removeLayer(LayerId id) {
+    if(id >= mMaxLayers || !mLayers[id].bUsed){
+        return;
+    }
+    Layer &layer = mLayers[id];
+    setVisible(id, false);
+    if(layer.bScheduled){
+        mSchedule.erase(layer.scheduleEntry);
+    }
+    mWaitingTextures.erase(std::remove(mWaitingTextures.begin(), mWaitingTextures.end(), id), mWaitingTextures.end());
+    if(layer.image != VK_NULL_HANDLE){
+        // removing is rare, wait rather than track when the GPU is done with the content
+        CALL_VK(vkQueueWaitIdle(mVk->queueInfo.queue));
+        destroyContent(layer);
+    }
+    layer = Layer{};
+}
+
+void VkLayerCompositor::setTransforms(LayerId id, const glm::mat4 &left, const glm::mat4 &right) {
+    mParams[id].transforms[0] = left;
+    mParams[id].transforms[1] = right;
+    mParamsVersion++;
+}
+
+void VkLayerCompositor::setColor(LayerId id, const glm::vec4 &color) {
+    mParams[id].color = color;
+    mParamsVersion++;
+}
+
+void VkLayerCompositor::markDirty(LayerId id) {
+    Layer &layer = mLayers[id];
+    if(layer.bUsed && layer.desc.drawContent && !layer.bDirty){
+        layer.bDirty = true;
+        mDueContent.push_back(id);
+    }
+}
+
+void VkLayerCompositor::beginFrame() {
+    mFrameCount++;
+    for(size_t i = 0; i < mWaitingTextures.size();){
+        LayerId id = mWaitingTextures[i];
+        const TextureHandle &texture = mLayers[id].desc.texture;
+        TextureState state = texture->state.load(std::memory_order_acquire);
+        if(state == TextureState::READY){
+            bindContent(id, texture->texture.getImgView(), texture->texture.getSampler());
+            setVisible(id, true);
+        } else if(state == TextureState::FAILED){
+            LOG_W("VkLayerCompositor: layer %u stays hidden, %s did not load.", id, texture->fileName.c_str());
+        } else {
+            i++;
+            continue;
+        }
+        mWaitingTextures.erase(mWaitingTextures.begin() + i);
+    }
+    while(!mSchedule.empty() && mSchedule.begin()->first <= mFrameCount){
+        LayerId id = mSchedule.begin()->second;
+        mSchedule.erase(mSchedule.begin());
+        mLayers[id].bScheduled = false;
+        markDirty(id);
+    }
+    if(mFrameCount % COMPOSITOR_STATS_INTERVAL == 0){
+        printStats();
+    }
+}
+
+void VkLayerCompositor::beginSlot(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+    Slot &slotData = mSlots[slot];
+    if(mQueryPool != VK_NULL_HANDLE){
+        if(slotData.bQueriesReset){
+            readTimestamps(slot);
+        }
+        vkCmdResetQueryPool(cmdBuffer, mQueryPool, slot * queriesPerSlot(), queriesPerSlot());
+        slotData.bQueriesReset = true;
+    }
+    for(LayerId id : mDueContent){
+        drawContent(cmdBuffer, slot, id);
+    }
+    mDueContent.clear();
+    // reused under the same rules as the slot's command buffer
+    if(slotData.paramsVersion != mParamsVersion){
+        memcpy(slotData.paramsAllocation.mapped, mParams.data(), sizeof(OverlayLayerParams) * mMaxLayers);
+        slotData.paramsVersion = mParamsVersion;
+    }
+    mCpuTimeNs += getTimeNano(CLOCK_MONOTONIC) - startTimeNs;
+}
+
+VkCommandBuffer VkLayerCompositor::getCompositeCmdBuffer(uint32_t slot, uint32_t areaIndex, uint32_t eyeIndex, const VkRect2D &scissor) {
+    if(mDrawOrder.empty()){
+        return VK_NULL_HANDLE;
+    }
+    CachedComposite &composite = mSlots[slot].composites[areaIndex];
+    if(composite.cmdBuffer == VK_NULL_HANDLE || composite.version != mLayerVersion || composite.eyeIndex != eyeIndex ||
+       memcmp(&composite.scissor, &scissor, sizeof(VkRect2D)) != 0){
+        uint64_t startTimeNs = getTimeNano(CLOCK_MONOTONIC);
+        composite.eyeIndex = eyeIndex;
+        composite.scissor = scissor;
+        recordComposite(composite, slot, areaIndex);
+        mCpuTimeNs += getTimeNano(CLOCK_MONOTONIC) - startTimeNs;
+    }
+    return composite.cmdBuffer;
+}
+
+void VkLayerCompositor::recordOverlayPass(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t areaIndex, uint32_t eyeIndex,
+                                          const VkRect2D &scissor, VkFramebuffer targetFramebuffer) {
+    VkCommandBuffer compositeCmdBuffer = getCompositeCmdBuffer(slot, areaIndex, eyeIndex, scissor);
+    if(compositeCmdBuffer == VK_NULL_HANDLE){
+        return;
+    }
+    VkRenderPassBeginInfo renderPassBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = nullptr,
+            .renderPass = mOverlayRenderPass,
+            .framebuffer = targetFramebuffer,
+            .renderArea = scissor,
+            .clearValueCount = 0,
+            .pClearValues = nullptr,
+    };
+    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(cmdBuffer, 1, &compositeCmdBuffer);
+    vkCmdEndRenderPass(cmdBuffer);
+}
+
+void VkLayerCompositor::setVisible(LayerId id, bool bVisible) {
+    Layer &layer = mLayers[id];
+    if(layer.bVisible == bVisible){
+        return;
+    }
+    layer.bVisible = bVisible;
+    if(bVisible){
+        auto it = std::upper_bound(mDrawOrder.begin(), mDrawOrder.end(), id, [this](LayerId a, LayerId b){
+            return mLayers[a].addSerial < mLayers[b].addSerial;
+        });
+        mDrawOrder.insert(it, id);
+    } else {
+        mDrawOrder.erase(std::remove(mDrawOrder.begin(), mDrawOrder.end(), id), mDrawOrder.end());
+    }
+    mLayerVersion++;
+}
+
+void VkLayerCompositor::bindContent(LayerId id, VkImageView imageView, VkSampler sampler) {
+    VkDescriptorImageInfo imageInfo = {
+            .sampler = sampler,
+            .imageView = imageView,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = mLayerSets[id],
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &imageInfo,
+            .pBufferInfo = nullptr,
+            .pTexelBufferView = nullptr
+    };
+    vkUpdateDescriptorSets(mVk->deviceInfo.device, 1, &write, 0, nullptr);
+}
+
+void VkLayerCompositor::drawContent(VkCommandBuffer cmdBuffer, uint32_t slot, LayerId id) {
+    Layer &layer = mLayers[id];
+    if(!layer.bUsed || !layer.bDirty){
+        // removed, or already drawn through an earlier entry
+        return;
+    }
+    TRACE_BEGIN("LayerContent:%u", id);
+    if(mQueryPool != VK_NULL_HANDLE){
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, contentQuery(slot, id));
+    }
+    // the composite of the previous frame may still sample the old content
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, nullptr, 0, nullptr, 0, nullptr);
+    VkExtent2D extent = layer.desc.contentExtent;
+    VkClearValue clearValue = {.color = {.float32 = {0.0f, 0.0f, 0.0f, 0.0f}}};
+    VkRenderPassBeginInfo renderPassBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = nullptr,
+            .renderPass = mContentRenderPass,
+            .framebuffer = layer.framebuffer,
+            .renderArea = {{0, 0}, extent},
+            .clearValueCount = 1,
+            .pClearValues = &clearValue,
+    };
+    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkViewport viewport = {
+            .x = 0,
+            .y = 0,
+            .width = static_cast<float>(extent.width),
+            .height = static_cast<float>(extent.height),
+            .minDepth = 0,
+            .maxDepth = 1
+    };
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {{0, 0}, extent};
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    layer.desc.drawContent(cmdBuffer, extent);
+    vkCmdEndRenderPass(cmdBuffer);
+    if(mQueryPool != VK_NULL_HANDLE){
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, contentQuery(slot, id) + 1);
+    }
+    TRACE_END("LayerContent:%u", id);
+
+    layer.bDirty = false;
+    mContentDrawCount++;
+    setVisible(id, true);
+    if(layer.desc.updateInterval > 0){
+        layer.scheduleEntry = mSchedule.emplace(mFrameCount + layer.desc.updateInterval, id);
+        layer.bScheduled = true;
+    }
+}
+
+void VkLayerCompositor::destroyContent(Layer &layer) {
+    VkDevice device = mVk->deviceInfo.device;
+    if(layer.framebuffer != VK_NULL_HANDLE){
+        vkDestroyFramebuffer(device, layer.framebuffer, VK_ALLOC);
+        layer.framebuffer = VK_NULL_HANDLE;
+    }
+    if(layer.view != VK_NULL_HANDLE){
+        vkDestroyImageView(device, layer.view, VK_ALLOC);
+        layer.view = VK_NULL_HANDLE;
+    }
+    VkHelper::destroyImage(mVk->allocator, device, &layer.image, &layer.allocation);
+}
+
+void VkLayerCompositor::recordComposite(CachedComposite &composite, uint32_t slot, uint32_t areaIndex) {
+    if(composite.cmdBuffer == VK_NULL_HANDLE){
+        VkCommandBufferAllocateInfo allocateInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .commandPool = mVk->cmdPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = 1
+        };
+        CALL_VK(vkAllocateCommandBuffers(mVk->deviceInfo.device, &allocateInfo, &composite.cmdBuffer));
+    }
+    // no framebuffer, the same buffer serves every swapchain image
+    VkCommandBufferInheritanceInfo inheritanceInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .pNext = nullptr,
+            .renderPass = mVk->renderPass,
+            .subpass = 0,
+            .framebuffer = VK_NULL_HANDLE,
+            .occlusionQueryEnable = VK_FALSE,
+            .queryFlags = 0,
+            .pipelineStatistics = 0
+    };
+    VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+            .pInheritanceInfo = &inheritanceInfo
+    };
+    VkCommandBuffer cmdBuffer = composite.cmdBuffer;
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
+    VkViewport viewport = {
+            .x = 0,
+            .y = 0,
+            .width = static_cast<float>(mVk->swapchainParam.extent.width),
+            .height = static_cast<float>(mVk->swapchainParam.extent.height),
+            .minDepth = 0,
+            .maxDepth = 1
+    };
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &composite.scissor);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 1, 1, &mSlots[slot].paramsSet, 0, nullptr);
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &mGrid.vertexBuffer, offsets);
+    for(LayerId id : mDrawOrder){
+        if(mQueryPool != VK_NULL_HANDLE){
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, compositeQuery(slot, areaIndex, id));
+        }
+        OverlayDrawParams drawParams = {id, composite.eyeIndex};
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mLayerSets[id], 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(drawParams), &drawParams);
+        vkCmdDraw(cmdBuffer, mGrid.getVertexCount(), 1, 0, 0);
+        if(mQueryPool != VK_NULL_HANDLE){
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, compositeQuery(slot, areaIndex, id) + 1);
+        }
+    }
+    CALL_VK(vkEndCommandBuffer(cmdBuffer));
+    composite.version = mLayerVersion;
+    mRecordCount++;
+}
+
+uint32_t VkLayerCompositor::compositeQuery(uint32_t slot, uint32_t areaIndex, LayerId id) const {
+    return slot * queriesPerSlot() + (areaIndex * mMaxLayers + id) * 2;
+}
+
+uint32_t VkLayerCompositor::contentQuery(uint32_t slot, LayerId id) const {
+    return slot * queriesPerSlot() + (MAX_AREAS_PER_SLOT * mMaxLayers + id) * 2;
+}
+
+void VkLayerCompositor::readTimestamps(uint32_t slot) {
+    // queries that were not written or are still in flight report no availability, only those are skipped
+    VkResult result = vkGetQueryPoolResults(mVk->deviceInfo.device, mQueryPool, slot * queriesPerSlot(), queriesPerSlot(),
+                                            mQueryResults.size() * sizeof(uint64_t), mQueryResults.data(), 2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if(result != VK_SUCCESS && result != VK_NOT_READY){
+        return;
+    }
+    uint32_t slotFirstQuery = slot * queriesPerSlot();
+    double period = mVk->deviceInfo.physicalDevLimits.timestampPeriod;
+    auto elapsedNs = [&](uint32_t query, uint64_t *out_ns){
+        const uint64_t *r = &mQueryResults[(query - slotFirstQuery) * 2];
+        if(r[1] == 0 || r[3] == 0){
+            return false;
+        }
+        *out_ns = static_cast<uint64_t>((r[2] - r[0]) * period);
+        return true;
+    };
+    for(LayerId id = 0; id < mMaxLayers; id++){
+        Layer &layer = mLayers[id];
+        if(!layer.bUsed){
+            continue;
+        }
+        uint64_t ns;
+        for(uint32_t area = 0; area < MAX_AREAS_PER_SLOT; area++){
+            if(elapsedNs(compositeQuery(slot, area, id), &ns)){
+                layer.compositeTimeNs += ns;
+                layer.compositeSamples++;
+            }
+        }
+        if(elapsedNs(contentQuery(slot, id), &ns)){
+            layer.contentTimeNs += ns;
+            layer.contentSamples++;
+        }
+    }
+}
+
+void VkLayerCompositor::printStats() {
+    if(mFrameCount == 0){
+        return;
+    }
+    LOG_D("VkLayerCompositor: %zu visible layers, CPU %.3f ms per frame, %u composite records, %u content draws over %lu frames",
+          mDrawOrder.size(), mCpuTimeNs * 1.f / mFrameCount / U_TIME_1MS_IN_NS, mRecordCount, mContentDrawCount, mFrameCount);
+    for(LayerId id = 0; id < mMaxLayers; id++){
+        const Layer &layer = mLayers[id];
+        if(!layer.bUsed || (layer.compositeSamples == 0 && layer.contentSamples == 0)){
+            continue;
+        }
+        LOG_D("    layer %u: composite %.3f ms per area, content %.3f ms per draw", id,
+              layer.compositeSamples ? layer.compositeTimeNs * 1.f / layer.compositeSamples / U_TIME_1MS_IN_NS : 0.f,
+              layer.contentSamples ? layer.contentTimeNs * 1.f / layer.contentSamples / U_TIME_1MS_IN_NS : 0.f);
+    }
+}
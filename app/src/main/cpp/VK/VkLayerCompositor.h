@@ -0,0 +1,161 @@
+/*!
+ * @brief  Overlay layers composited over the passthrough, quads or cylinders with their own update rates
+ * @date 2023/8/10
+ */
+#ifndef CAMERA2VK_VKLAYERCOMPOSITOR_H
+#define CAMERA2VK_VKLAYERCOMPOSITOR_H
+
+#include <functional>
+#include <map>
+#include <vector>
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+#include "Geometry.h"
+#include "UploadBatch.h"
+#include "TextureStreamer.h"
+
+enum class LayerShape{
+    QUAD,
+    CYLINDER
+};
+
+// records the content of a layer inside the content render pass, viewport and scissor already cover the extent
+typedef std::function<void(VkCommandBuffer cmdBuffer, VkExtent2D extent)> LayerContentFn;
+
+struct OverlayLayerDesc{
+    LayerShape shape = LayerShape::QUAD;
+    float cylinderAngle = 1.0f;                 // central angle in radians, CYLINDER only
+    glm::mat4 transforms[2] = {glm::mat4(1.f), glm::mat4(1.f)};    // layer space, x and y in [-1, 1], to target clip space per eye
+    glm::vec4 color = glm::vec4(1.f);           // multiplies the content, alpha is the opacity
+    // the content is the first one set of: drawContent into an image of the layer, a streamed texture, an image view
+    LayerContentFn drawContent;
+    VkExtent2D contentExtent = {0, 0};
+    uint32_t updateInterval = 0;                // frames between drawContent calls, 0 redraws after markDirty only
+    TextureHandle texture;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+};
+
+typedef uint32_t LayerId;
+const LayerId INVALID_LAYER_ID = UINT32_MAX;
+
+/**
+ * Layers are blended in the order they were added over whatever the pass left in the target. The composite of an
+ * area is a cached secondary command buffer, re-recorded only when the set of visible layers changes. Transforms and
+ * colors live in a per slot storage buffer and drawn content follows its own schedule, so an unchanged frame costs
+ * the same CPU time for any number of layers. Render thread only.
+ */
+class VkLayerCompositor{
+public:
+    VkLayerCompositor(VkBundle *vk, UploadBatch *batch, std::vector<char> &vertCode, std::vector<char> &fragCode,
+                      uint32_t slotCount, VkImageLayout targetFinalLayout, uint32_t maxLayers = 16);
+    ~VkLayerCompositor();
+
+    LayerId addLayer(const OverlayLayerDesc &desc);
+    void removeLayer(LayerId id);
+    void setTransforms(LayerId id, const glm::mat4 &left, const glm::mat4 &right);
+    void setColor(LayerId id, const glm::vec4 &color);
+    // redraws drawContent on the next frame
+    void markDirty(LayerId id);
+    bool hasVisibleLayers() const { return !mDrawOrder.empty(); };
+    // pipelines used in drawContent have to be compatible with it
+    VkRenderPass getContentRenderPass() const { return mContentRenderPass; };
+
+    // once per frame, picks up streamed textures and the layers due for a redraw
+    void beginFrame();
+    // outside a render pass and before the composites of the slot, draws the due content and resets the slot's queries
+    void beginSlot(VkCommandBuffer cmdBuffer, uint32_t slot);
+    // secondary command buffer for the renderer's render pass, VK_NULL_HANDLE when no layer is visible
+    VkCommandBuffer getCompositeCmdBuffer(uint32_t slot, uint32_t areaIndex, uint32_t eyeIndex, const VkRect2D &scissor);
+    // loads the area back and composites it in a pass of its own, the target has to be in COLOR_ATTACHMENT_OPTIMAL
+    // already and is left in the final layout
+    void recordOverlayPass(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t areaIndex, uint32_t eyeIndex, const VkRect2D &scissor,
+                           VkFramebuffer targetFramebuffer);
+    void printStats();
+
+private:
+    static const uint32_t MAX_AREAS_PER_SLOT = 2;
+    static const uint32_t GRID_COLUMNS = 32;    // cylinder tessellation, quads use the same grid
+
+    struct Layer{
+        bool bUsed = false;
+        bool bVisible = false;
+        bool bDirty = false;
+        bool bScheduled = false;
+        uint64_t addSerial = 0;
+        OverlayLayerDesc desc;
+        std::multimap<uint64_t, LayerId>::iterator scheduleEntry;
+        // target of drawContent
+        VkImage image = VK_NULL_HANDLE;
+        VkAllocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        // GPU time
+        uint64_t compositeTimeNs = 0;
+        uint32_t compositeSamples = 0;
+        uint64_t contentTimeNs = 0;
+        uint32_t contentSamples = 0;
+    };
+
+    struct CachedComposite{
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        uint64_t version = 0;
+        uint32_t eyeIndex = 0;
+        VkRect2D scissor = {};
+    };
+
+    struct Slot{
+        VkBuffer paramsBuffer = VK_NULL_HANDLE;
+        VkAllocation paramsAllocation;
+        VkDescriptorSet paramsSet = VK_NULL_HANDLE;
+        uint64_t paramsVersion = 0;
+        bool bQueriesReset = false;
+        CachedComposite composites[MAX_AREAS_PER_SLOT];
+    };
+
+    void setVisible(LayerId id, bool bVisible);
+    void bindContent(LayerId id, VkImageView imageView, VkSampler sampler);
+    void drawContent(VkCommandBuffer cmdBuffer, uint32_t slot, LayerId id);
+    void destroyContent(Layer &layer);
+    void recordComposite(CachedComposite &composite, uint32_t slot, uint32_t areaIndex);
+    void readTimestamps(uint32_t slot);
+    uint32_t queriesPerSlot() const { return mMaxLayers * 2 * (MAX_AREAS_PER_SLOT + 1); };
+    uint32_t compositeQuery(uint32_t slot, uint32_t areaIndex, LayerId id) const;
+    uint32_t contentQuery(uint32_t slot, LayerId id) const;
+
+    VkBundle *mVk;
+    VkImageLayout mTargetFinalLayout;
+    uint32_t mMaxLayers;
+    Geometry mGrid;
+    VkShaderModule mVertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule mFragShaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mLayerSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mParamsSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+    VkRenderPass mContentRenderPass = VK_NULL_HANDLE;
+    VkRenderPass mOverlayRenderPass = VK_NULL_HANDLE;
+    VkSampler mContentSampler = VK_NULL_HANDLE;
+    VkQueryPool mQueryPool = VK_NULL_HANDLE;
+
+    std::vector<Layer> mLayers;
+    std::vector<VkDescriptorSet> mLayerSets;
+    std::vector<OverlayLayerParams> mParams;
+    std::vector<Slot> mSlots;
+    std::vector<LayerId> mDrawOrder;
+    std::vector<LayerId> mWaitingTextures;
+    std::vector<LayerId> mDueContent;
+    std::multimap<uint64_t, LayerId> mSchedule;
+    std::vector<uint64_t> mQueryResults;
+    uint64_t mLayerVersion = 1;
+    uint64_t mParamsVersion = 1;
+    uint64_t mAddSerial = 0;
+    uint64_t mFrameCount = 0;
+
+    uint64_t mCpuTimeNs = 0;
+    uint32_t mRecordCount = 0;
+    uint32_t mContentDrawCount = 0;
+};
+
+#endif //CAMERA2VK_VKLAYERCOMPOSITOR_H
@@ -0,0 +1,384 @@
+#include "VkMemoryAllocator.h"
+#include "VkHelper.h"
+
+static const VkDeviceSize ALLOCATOR_BLOCK_SIZE = 64 * 1024 * 1024;
+static const VkDeviceSize ALLOCATOR_MIN_ALLOCATION = 256;
+
+static VkDeviceSize orderSize(uint32_t order){
+    return static_cast<VkDeviceSize>(1) << order;
+}
+
+static uint32_t ceilLog2(VkDeviceSize value){
+    uint32_t order = 0;
+    while(orderSize(order) < value){
+        order++;
+    }
+    return order;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+    return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+}
+
+static const char *usageName(AllocationUsage usage){
+    switch(usage){
+        case AllocationUsage::RESOURCE:
+            return "resource";
+        case AllocationUsage::TRANSIENT:
+            return "transient";
+        case AllocationUsage::DEDICATED:
+            return "dedicated";
+    }
+    return "unknown";
+}
+
+VkMemoryAllocator::VkMemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memProps, VkDeviceSize bufferImageGranularity)
+        : mDevice(device), mMemProps(memProps), mBlockSize(ALLOCATOR_BLOCK_SIZE){
+    // buddy blocks never straddle a linear/optimal page, so they're safe to mix buffers and images
+    mMinOrder = ceilLog2(std::max(ALLOCATOR_MIN_ALLOCATION, bufferImageGranularity));
+    mMaxOrder = ceilLog2(mBlockSize);
+    mPools.resize(mMemProps.memoryTypeCount);
+}
+
+VkMemoryAllocator::~VkMemoryAllocator() {
+    for(auto &pool : mPools){
+        for(auto &block : pool.buddyBlocks){
+            if(block.memory != VK_NULL_HANDLE){
+                vkFreeMemory(mDevice, block.memory, VK_ALLOC);
+            }
+        }
+        for(auto &block : pool.linearBlocks){
+            if(block.memory != VK_NULL_HANDLE){
+                vkFreeMemory(mDevice, block.memory, VK_ALLOC);
+            }
+        }
+        if(pool.dedicatedCount != 0){
+            LOG_W("VkMemoryAllocator: %u dedicated allocations leaked.", pool.dedicatedCount);
+        }
+    }
+}
+
+uint32_t VkMemoryAllocator::chooseMemoryType(uint32_t typeBits, VkMemoryPropertyFlags memProps) {
+    uint32_t index = VkHelper::findMemoryType(mMemProps, typeBits, memProps);
+    if(index == UINT32_MAX && (memProps & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)){
+        // cached is only a preference, fall back to uncached host memory
+        index = VkHelper::findMemoryType(mMemProps, typeBits, memProps & ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    }
+    if(index == UINT32_MAX){
+        throw std::runtime_error("VkMemoryAllocator: no suitable memory type.");
+    }
+    return index;
+}
+
+VkDeviceMemory VkMemoryAllocator::allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void **out_mapped,
+                                                       VkImage dedicatedImage, VkBuffer dedicatedBuffer) {
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .image = dedicatedImage,
+            .buffer = dedicatedBuffer
+    };
+    VkMemoryAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = (dedicatedImage != VK_NULL_HANDLE || dedicatedBuffer != VK_NULL_HANDLE) ? &dedicatedInfo : nullptr,
+            .allocationSize = size,
+            .memoryTypeIndex = memoryTypeIndex
+    };
+    VkDeviceMemory memory;
+    CALL_VK(vkAllocateMemory(mDevice, &allocateInfo, VK_ALLOC, &memory));
+
+    *out_mapped = nullptr;
+    if(mMemProps.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+        // host visible blocks stay mapped for their whole lifetime
+        CALL_VK(vkMapMemory(mDevice, memory, 0, VK_WHOLE_SIZE, 0, out_mapped));
+    }
+    return memory;
+}
+
+void VkMemoryAllocator::allocate(const VkMemoryRequirements &memReqs, VkMemoryPropertyFlags memProps, AllocationUsage usage,
+                                 VkAllocation *out_allocation, VkImage dedicatedImage, VkBuffer dedicatedBuffer) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t memoryTypeIndex = chooseMemoryType(memReqs.memoryTypeBits, memProps);
+    MemoryPool &pool = mPools[memoryTypeIndex];
+
+    // anything larger than half a block would waste most of it
+    if(memReqs.size > mBlockSize / 2){
+        usage = AllocationUsage::DEDICATED;
+    }
+
+    *out_allocation = VkAllocation{};
+    out_allocation->memoryTypeIndex = memoryTypeIndex;
+    out_allocation->usage = usage;
+    switch(usage){
+        case AllocationUsage::RESOURCE:
+            allocateBuddy(pool, memoryTypeIndex, memReqs.size, memReqs.alignment, out_allocation);
+            break;
+        case AllocationUsage::TRANSIENT:
+            allocateLinear(pool, memoryTypeIndex, memReqs.size, memReqs.alignment, out_allocation);
+            break;
+        case AllocationUsage::DEDICATED:
+            out_allocation->memory = allocateDeviceMemory(memoryTypeIndex, memReqs.size, &out_allocation->mapped,
+                                                          dedicatedImage, dedicatedBuffer);
+            out_allocation->size = memReqs.size;
+            pool.dedicatedCount++;
+            pool.dedicatedBytes += memReqs.size;
+            break;
+    }
+}
+
+void VkMemoryAllocator::allocateAndBindBuffer(VkBuffer buffer, VkMemoryPropertyFlags memProps, AllocationUsage usage,
+                                              VkAllocation *out_allocation) {
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(mDevice, buffer, &memReqs);
+    allocate(memReqs, memProps, usage, out_allocation, VK_NULL_HANDLE, usage == AllocationUsage::DEDICATED ? buffer : VK_NULL_HANDLE);
+    CALL_VK(vkBindBufferMemory(mDevice, buffer, out_allocation->memory, out_allocation->offset));
+}
+
+void VkMemoryAllocator::allocateAndBindImage(VkImage image, VkMemoryPropertyFlags memProps, AllocationUsage usage,
+                                             VkAllocation *out_allocation) {
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(mDevice, image, &memReqs);
+    if(vkGetImageMemoryRequirements2 != nullptr){
+        VkImageMemoryRequirementsInfo2 memReqsInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+                .pNext = nullptr,
+                .image = image
+        };
+        VkMemoryDedicatedRequirements dedicatedReqs = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+                .pNext = nullptr
+        };
+        VkMemoryRequirements2 memReqs2 = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+                .pNext = &dedicatedReqs
+        };
+        vkGetImageMemoryRequirements2(mDevice, &memReqsInfo, &memReqs2);
+        if(dedicatedReqs.requiresDedicatedAllocation){
+            usage = AllocationUsage::DEDICATED;
+        }
+    }
+    allocate(memReqs, memProps, usage, out_allocation, usage == AllocationUsage::DEDICATED ? image : VK_NULL_HANDLE, VK_NULL_HANDLE);
+    CALL_VK(vkBindImageMemory(mDevice, image, out_allocation->memory, out_allocation->offset));
+}
+
+void VkMemoryAllocator::free(VkAllocation *allocation) {
+    if(allocation == nullptr || allocation->memory == VK_NULL_HANDLE){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    MemoryPool &pool = mPools[allocation->memoryTypeIndex];
+    switch(allocation->usage){
+        case AllocationUsage::RESOURCE:
+            freeBuddy(pool, *allocation);
+            break;
+        case AllocationUsage::TRANSIENT:
+            freeLinear(pool, *allocation);
+            break;
+        case AllocationUsage::DEDICATED:
+            vkFreeMemory(mDevice, allocation->memory, VK_ALLOC);
+            pool.dedicatedCount--;
+            pool.dedicatedBytes -= allocation->size;
+            break;
+    }
+    *allocation = VkAllocation{};
+}
+
+void VkMemoryAllocator::allocateBuddy(MemoryPool &pool, uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment,
+                                      VkAllocation *out_allocation) {
+    // a buddy of order k is always aligned to 2^k inside its block
+    uint32_t order = std::max(ceilLog2(std::max(size, alignment)), mMinOrder);
+
+    uint32_t blockIndex = 0;
+    uint32_t freeOrder = mMaxOrder + 1;
+    for(; blockIndex < pool.buddyBlocks.size(); blockIndex++){
+        BuddyBlock &block = pool.buddyBlocks[blockIndex];
+        if(block.memory == VK_NULL_HANDLE){
+            continue;
+        }
+        for(freeOrder = order; freeOrder <= mMaxOrder && block.freeLists[freeOrder - mMinOrder].empty(); freeOrder++);
+        if(freeOrder <= mMaxOrder){
+            break;
+        }
+    }
+
+    if(blockIndex == pool.buddyBlocks.size()){
+        // reuse the slot of a released block before growing the pool
+        for(blockIndex = 0; blockIndex < pool.buddyBlocks.size() && pool.buddyBlocks[blockIndex].memory != VK_NULL_HANDLE; blockIndex++);
+        if(blockIndex == pool.buddyBlocks.size()){
+            pool.buddyBlocks.emplace_back();
+        }
+        BuddyBlock &block = pool.buddyBlocks[blockIndex];
+        block.memory = allocateDeviceMemory(memoryTypeIndex, mBlockSize, &block.mapped, VK_NULL_HANDLE, VK_NULL_HANDLE);
+        block.freeLists.assign(mMaxOrder - mMinOrder + 1, std::set<VkDeviceSize>());
+        block.freeLists[mMaxOrder - mMinOrder].insert(0);
+        freeOrder = mMaxOrder;
+        LOG_D("VkMemoryAllocator: new %s block %u for memory type %u", usageName(AllocationUsage::RESOURCE), blockIndex, memoryTypeIndex);
+    }
+
+    BuddyBlock &block = pool.buddyBlocks[blockIndex];
+    auto &freeList = block.freeLists[freeOrder - mMinOrder];
+    VkDeviceSize offset = *freeList.begin();
+    freeList.erase(freeList.begin());
+    // split down, handing the upper halves back to the free lists
+    while(freeOrder > order){
+        freeOrder--;
+        block.freeLists[freeOrder - mMinOrder].insert(offset + orderSize(freeOrder));
+    }
+
+    block.allocationCount++;
+    block.usedBytes += orderSize(order);
+    out_allocation->memory = block.memory;
+    out_allocation->offset = offset;
+    out_allocation->size = size;
+    out_allocation->mapped = block.mapped ? static_cast<uint8_t *>(block.mapped) + offset : nullptr;
+    out_allocation->blockIndex = blockIndex;
+    out_allocation->order = order;
+}
+
+void VkMemoryAllocator::freeBuddy(MemoryPool &pool, const VkAllocation &allocation) {
+    BuddyBlock &block = pool.buddyBlocks[allocation.blockIndex];
+    VkDeviceSize offset = allocation.offset;
+    uint32_t order = allocation.order;
+    block.allocationCount--;
+    block.usedBytes -= orderSize(order);
+
+    // merge with the free buddy as far up as possible
+    while(order < mMaxOrder){
+        auto &freeList = block.freeLists[order - mMinOrder];
+        auto buddy = freeList.find(offset ^ orderSize(order));
+        if(buddy == freeList.end()){
+            break;
+        }
+        freeList.erase(buddy);
+        offset &= ~orderSize(order);
+        order++;
+    }
+    block.freeLists[order - mMinOrder].insert(offset);
+
+    if(block.allocationCount == 0){
+        // keep a single empty block around as a spare, give the rest back
+        for(const auto &other : pool.buddyBlocks){
+            if(&other != &block && other.memory != VK_NULL_HANDLE && other.allocationCount == 0){
+                vkFreeMemory(mDevice, block.memory, VK_ALLOC);
+                block = BuddyBlock{};
+                break;
+            }
+        }
+    }
+}
+
+void VkMemoryAllocator::allocateLinear(MemoryPool &pool, uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment,
+                                       VkAllocation *out_allocation) {
+    // linear blocks may hold both buffers and images
+    alignment = std::max(alignment, orderSize(mMinOrder));
+
+    uint32_t blockIndex = 0;
+    for(; blockIndex < pool.linearBlocks.size(); blockIndex++){
+        const LinearBlock &block = pool.linearBlocks[blockIndex];
+        if(block.memory != VK_NULL_HANDLE && alignUp(block.head, alignment) + size <= mBlockSize){
+            break;
+        }
+    }
+
+    if(blockIndex == pool.linearBlocks.size()){
+        for(blockIndex = 0; blockIndex < pool.linearBlocks.size() && pool.linearBlocks[blockIndex].memory != VK_NULL_HANDLE; blockIndex++);
+        if(blockIndex == pool.linearBlocks.size()){
+            pool.linearBlocks.emplace_back();
+        }
+        LinearBlock &block = pool.linearBlocks[blockIndex];
+        block.memory = allocateDeviceMemory(memoryTypeIndex, mBlockSize, &block.mapped, VK_NULL_HANDLE, VK_NULL_HANDLE);
+        LOG_D("VkMemoryAllocator: new %s block %u for memory type %u", usageName(AllocationUsage::TRANSIENT), blockIndex, memoryTypeIndex);
+    }
+
+    LinearBlock &block = pool.linearBlocks[blockIndex];
+    VkDeviceSize offset = alignUp(block.head, alignment);
+    block.head = offset + size;
+    block.allocationCount++;
+    out_allocation->memory = block.memory;
+    out_allocation->offset = offset;
+    out_allocation->size = size;
+    out_allocation->mapped = block.mapped ? static_cast<uint8_t *>(block.mapped) + offset : nullptr;
+    out_allocation->blockIndex = blockIndex;
+}
+
+void VkMemoryAllocator::freeLinear(MemoryPool &pool, const VkAllocation &allocation) {
+    LinearBlock &block = pool.linearBlocks[allocation.blockIndex];
+    block.allocationCount--;
+    if(block.allocationCount != 0){
+        return;
+    }
+    // the block rewinds once everything carved out of it has been released
+    block.head = 0;
+    for(const auto &other : pool.linearBlocks){
+        if(&other != &block && other.memory != VK_NULL_HANDLE && other.allocationCount == 0){
+            vkFreeMemory(mDevice, block.memory, VK_ALLOC);
+            block = LinearBlock{};
+            break;
+        }
+    }
+}
+
+std::vector<MemoryPoolStats> VkMemoryAllocator::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<MemoryPoolStats> stats;
+    for(uint32_t i = 0; i < mPools.size(); i++){
+        const MemoryPool &pool = mPools[i];
+        if(!pool.buddyBlocks.empty()){
+            MemoryPoolStats stat{i, AllocationUsage::RESOURCE};
+            for(const auto &block : pool.buddyBlocks){
+                if(block.memory == VK_NULL_HANDLE){
+                    continue;
+                }
+                stat.blockCount++;
+                stat.allocationCount += block.allocationCount;
+                stat.reservedBytes += mBlockSize;
+                stat.usedBytes += block.usedBytes;
+                for(uint32_t order = mMaxOrder; order >= mMinOrder; order--){
+                    if(!block.freeLists[order - mMinOrder].empty()){
+                        stat.largestFreeRange = std::max(stat.largestFreeRange, orderSize(order));
+                        break;
+                    }
+                }
+            }
+            VkDeviceSize freeBytes = stat.reservedBytes - stat.usedBytes;
+            stat.fragmentation = freeBytes == 0 ? 0.f : 1.f - (float)stat.largestFreeRange / freeBytes;
+            stats.push_back(stat);
+        }
+        if(!pool.linearBlocks.empty()){
+            MemoryPoolStats stat{i, AllocationUsage::TRANSIENT};
+            for(const auto &block : pool.linearBlocks){
+                if(block.memory == VK_NULL_HANDLE){
+                    continue;
+                }
+                stat.blockCount++;
+                stat.allocationCount += block.allocationCount;
+                stat.reservedBytes += mBlockSize;
+                stat.usedBytes += block.head;
+                stat.largestFreeRange = std::max(stat.largestFreeRange, mBlockSize - block.head);
+            }
+            VkDeviceSize freeBytes = stat.reservedBytes - stat.usedBytes;
+            stat.fragmentation = freeBytes == 0 ? 0.f : 1.f - (float)stat.largestFreeRange / freeBytes;
+            stats.push_back(stat);
+        }
+        if(pool.dedicatedCount != 0){
+            MemoryPoolStats stat{i, AllocationUsage::DEDICATED};
+            stat.blockCount = pool.dedicatedCount;
+            stat.allocationCount = pool.dedicatedCount;
+            stat.reservedBytes = pool.dedicatedBytes;
+            stat.usedBytes = pool.dedicatedBytes;
+            stats.push_back(stat);
+        }
+    }
+    return stats;
+}
+
+void VkMemoryAllocator::printStats() {
+    LOG_D("---------------------------------");
+    LOG_D("Memory Pools:");
+    for(const auto &stat : getStats()){
+        LOG_D("type %2u %-9s: blocks %u, allocations %u, used %.2f / %.2f MB, largest free %.2f MB, fragmentation %.2f",
+              stat.memoryTypeIndex, usageName(stat.usage), stat.blockCount, stat.allocationCount,
+              stat.usedBytes / (1024.f * 1024.f), stat.reservedBytes / (1024.f * 1024.f),
+              stat.largestFreeRange / (1024.f * 1024.f), stat.fragmentation);
+    }
+}
@@ -0,0 +1,94 @@
+/*!
+ * @brief  Block based device memory sub-allocator
+ * @date 2023/8/2
+ */
+#ifndef CAMERA2VK_VKMEMORYALLOCATOR_H
+#define CAMERA2VK_VKMEMORYALLOCATOR_H
+
+#include <mutex>
+#include <set>
+#include <vector>
+#include "VulkanCommon.h"
+
+enum class AllocationUsage{
+    RESOURCE,   // long-lived resources, buddy sub-allocation
+    TRANSIENT,  // per-frame and staging data, linear sub-allocation
+    DEDICATED   // one VkDeviceMemory per resource
+};
+
+struct VkAllocation{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;                     // valid for host visible memory only
+    uint32_t memoryTypeIndex = UINT32_MAX;
+    AllocationUsage usage = AllocationUsage::RESOURCE;
+    uint32_t blockIndex = 0;
+    uint32_t order = 0;                         // buddy order, RESOURCE only
+};
+
+struct MemoryPoolStats{
+    uint32_t memoryTypeIndex;
+    AllocationUsage usage;
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    VkDeviceSize reservedBytes;                 // bytes taken from the driver
+    VkDeviceSize usedBytes;                     // bytes handed out, including alignment padding
+    VkDeviceSize largestFreeRange;              // over all blocks, the biggest request served without a new block
+    float fragmentation;                        // 1 - largestFreeRange / freeBytes, 0 when all free bytes are one range
+};
+
+class VkMemoryAllocator{
+public:
+    VkMemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memProps, VkDeviceSize bufferImageGranularity);
+    ~VkMemoryAllocator();
+
+    void allocate(const VkMemoryRequirements &memReqs, VkMemoryPropertyFlags memProps, AllocationUsage usage,
+                  VkAllocation *out_allocation, VkImage dedicatedImage = VK_NULL_HANDLE, VkBuffer dedicatedBuffer = VK_NULL_HANDLE);
+    void allocateAndBindBuffer(VkBuffer buffer, VkMemoryPropertyFlags memProps, AllocationUsage usage, VkAllocation *out_allocation);
+    void allocateAndBindImage(VkImage image, VkMemoryPropertyFlags memProps, AllocationUsage usage, VkAllocation *out_allocation);
+    void free(VkAllocation *allocation);
+
+    std::vector<MemoryPoolStats> getStats();
+    void printStats();
+
+private:
+    // released blocks keep their slot with a null memory handle, so block indices stay stable
+    struct BuddyBlock{
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        std::vector<std::set<VkDeviceSize>> freeLists; // indexed by order - mMinOrder
+        uint32_t allocationCount = 0;
+        VkDeviceSize usedBytes = 0;
+    };
+    struct LinearBlock{
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        VkDeviceSize head = 0;
+        uint32_t allocationCount = 0;
+    };
+    struct MemoryPool{
+        std::vector<BuddyBlock> buddyBlocks;
+        std::vector<LinearBlock> linearBlocks;
+        uint32_t dedicatedCount = 0;
+        VkDeviceSize dedicatedBytes = 0;
+    };
+
+    uint32_t chooseMemoryType(uint32_t typeBits, VkMemoryPropertyFlags memProps);
+    VkDeviceMemory allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void **out_mapped,
+                                        VkImage dedicatedImage, VkBuffer dedicatedBuffer);
+    void allocateBuddy(MemoryPool &pool, uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, VkAllocation *out_allocation);
+    void freeBuddy(MemoryPool &pool, const VkAllocation &allocation);
+    void allocateLinear(MemoryPool &pool, uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, VkAllocation *out_allocation);
+    void freeLinear(MemoryPool &pool, const VkAllocation &allocation);
+
+    VkDevice mDevice;
+    VkPhysicalDeviceMemoryProperties mMemProps;
+    VkDeviceSize mBlockSize;
+    uint32_t mMinOrder;
+    uint32_t mMaxOrder;
+    std::vector<MemoryPool> mPools;           // indexed by memory type
+    std::mutex mMutex;
+};
+
+#endif //CAMERA2VK_VKMEMORYALLOCATOR_H
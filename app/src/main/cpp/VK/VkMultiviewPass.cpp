@@ -0,0 +1,63 @@
+#include "VkMultiviewPass.h"
+#include "VkHelper.h"
+
+VkMultiviewPass::VkMultiviewPass(VkBundle *vk, std::vector<char> &vertShaderCode, std::vector<char> &fragShaderCode,
+                                 const CameraColorFormat &format) : mVk(vk) {
+    VkDevice device = mVk->deviceInfo.device;
+    for(uint32_t i = 0; i < VIEW_COUNT; i++){
+        setViewTransform(i, 0.f, 0.f, 1.f, 1.f);
+    }
+
+    VkPushConstantRange pushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(MultiviewParams)
+    };
+    VkHelper::createPipelineLayout(device, mVk->descriptorSetLayout, &mPipelineLayout, &pushConstantRange);
+    mVertShaderModule = VkHelper::createShaderModule(device, vertShaderCode);
+    mFragShaderModule = VkHelper::createShaderModule(device, fragShaderCode);
+    mPipelines = new VkPipelineVariants(mVk, "Multiview", [this](const VkSpecializationInfo *fragSpecialization, VkPipeline *out_pipeline){
+        VkHelper::createPipeline(mVk->deviceInfo.device, mPipelineLayout, mVk->renderPass, mVertShaderModule, mFragShaderModule,
+                                 mVk->swapchainParam, out_pipeline, false, fragSpecialization);
+    }, format);
+    LOG_D("VkMultiviewPass: %u views side by side in %ux%u", VIEW_COUNT, mVk->swapchainParam.extent.width, mVk->swapchainParam.extent.height);
+}
+
+VkMultiviewPass::~VkMultiviewPass() {
+    VkDevice device = mVk->deviceInfo.device;
+    SAFE_DELETE(mPipelines);
+    vkDestroyShaderModule(device, mVertShaderModule, VK_ALLOC);
+    vkDestroyShaderModule(device, mFragShaderModule, VK_ALLOC);
+    vkDestroyPipelineLayout(device, mPipelineLayout, VK_ALLOC);
+}
+
+void VkMultiviewPass::setViewTransform(uint32_t viewIndex, float offsetX, float offsetY, float scaleX, float scaleY) {
+    if(viewIndex >= VIEW_COUNT){
+        LOG_E("view index must in (0, 1).");
+        return;
+    }
+    mViewParams.viewTransforms[viewIndex] = glm::vec4(offsetX, offsetY, scaleX, scaleY);
+}
+
+void VkMultiviewPass::record(VkCommandBuffer cmdBuffer, VkFramebuffer framebuffer, VkDescriptorSet descriptorSet,
+                             const Geometry *geometry) {
+    VkClearValue clearValue = { 0.1f,  0.2f,  0.3f,  1.0f};
+    VkRenderPassBeginInfo renderPassBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = nullptr,
+            .renderPass = mVk->renderPass,
+            .framebuffer = framebuffer,
+            .renderArea = { 0, 0, mVk->swapchainParam.extent.width, mVk->swapchainParam.extent.height },
+            .clearValueCount = 1,
+            .pClearValues = &clearValue,
+    };
+    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if(geometry != nullptr){
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelines->current());
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MultiviewParams), &mViewParams);
+        // one draw, an instance per eye
+        VkHelper::geometryDraw(cmdBuffer, mPipelines->current(), mVk->swapchainParam, *geometry, VIEW_COUNT);
+    }
+    vkCmdEndRenderPass(cmdBuffer);
+}
@@ -0,0 +1,44 @@
+/*!
+ * @brief  Single pass stereo, both eyes drawn into their halves of the target by one instanced draw
+ * @date 2023/8/7
+ */
+#ifndef CAMERA2VK_VKMULTIVIEWPASS_H
+#define CAMERA2VK_VKMULTIVIEWPASS_H
+
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+#include "Geometry.h"
+#include "VkPipelineVariants.h"
+
+/**
+ * One render pass instance over the whole target and one draw of the eye quad with an instance per eye: the vertex
+ * shader places instance i in half i of the target with the view transform of that eye, the fragment shader samples
+ * layer i of the 2-layer camera images. VK_KHR_multiview is not used, its views only write layers of the attachment
+ * and the side by side target has one, so the eyes would have to be copied into it every frame.
+ * Nothing clips an eye to its half, a view transform has to keep the quad inside [-1, 1].
+ */
+class VkMultiviewPass{
+public:
+    static const uint32_t VIEW_COUNT = 2;
+
+    VkMultiviewPass(VkBundle *vk, std::vector<char> &vertShaderCode, std::vector<char> &fragShaderCode, const CameraColorFormat &format);
+    ~VkMultiviewPass();
+
+    void setViewTransform(uint32_t viewIndex, float offsetX, float offsetY, float scaleX, float scaleY);
+    // the shader variant of the camera format, see VkPipelineVariants::select
+    void selectFormat(const CameraColorFormat &format) { mPipelines->select(format); };
+    VkPipelineVariants *getPipelines() { return mPipelines; };
+    // the render pass of the target, geometry == nullptr only clears it
+    void record(VkCommandBuffer cmdBuffer, VkFramebuffer framebuffer, VkDescriptorSet descriptorSet, const Geometry *geometry);
+
+private:
+    VkBundle *mVk;
+    MultiviewParams mViewParams;
+
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkShaderModule mVertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule mFragShaderModule = VK_NULL_HANDLE;
+    VkPipelineVariants *mPipelines = nullptr;
+};
+
+#endif //CAMERA2VK_VKMULTIVIEWPASS_H
@@ -0,0 +1,131 @@
+#include "VkPipelineVariants.h"
+#include <cstddef>
+#include <pthread.h>
+#include <stdexcept>
+#include "../ThreadManager.h"
+
+static const char *gColorModelNames[] = {"BT.601", "BT.709", "BT.2020"};
+
+static bool isSrgbFormat(VkFormat format) {
+    switch(format){
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+            return true;
+        default:
+            return false;
+    }
+}
+
+VkPipelineVariants::VkPipelineVariants(VkBundle *vk, const char *name, Builder builder, const CameraColorFormat &format)
+        : mVk(vk), mName(name), mBuilder(std::move(builder)) {
+    mOutputEncoding = isSrgbFormat(mVk->swapchainParam.format.format) ? OutputEncoding::LINEAR : OutputEncoding::AS_IS;
+    // the first variant is needed for the first frame, nothing to gain from building it elsewhere
+    build(format, &mCurrent);
+    mPipelines[key(format)] = mCurrent;
+    mCurrentFormat = format;
+    mRequestedFormat = format;
+    mWorker = std::thread(&VkPipelineVariants::workerLoop, this);
+}
+
+VkPipelineVariants::~VkPipelineVariants() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        bExit = true;
+    }
+    mCond.notify_all();
+    mWorker.join();
+    for(auto &item : mPipelines){
+        vkDestroyPipeline(mVk->deviceInfo.device, item.second, VK_ALLOC);
+    }
+}
+
+uint32_t VkPipelineVariants::key(const CameraColorFormat &format) {
+    return static_cast<uint32_t>(format.chromaOrder) | static_cast<uint32_t>(format.colorModel) << 4 |
+           static_cast<uint32_t>(format.colorRange) << 8;
+}
+
+void VkPipelineVariants::prepare(const CameraColorFormat &format) {
+    uint32_t variantKey = key(format);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mPipelines.count(variantKey) > 0 || mQueued.count(variantKey) > 0){
+        return;
+    }
+    mQueued.insert(variantKey);
+    mQueue.push_back(format);
+    mCond.notify_one();
+}
+
+VkPipeline VkPipelineVariants::select(const CameraColorFormat &format) {
+    if(format == mCurrentFormat){
+        return mCurrent;
+    }
+    if(format != mRequestedFormat){
+        LOG_D("%s pipelines: the camera switched to %s %s %s range", mName.c_str(), format.chromaOrder == ChromaOrder::NV21 ? "NV21" : "NV12",
+              gColorModelNames[static_cast<uint32_t>(format.colorModel)], format.colorRange == ColorRange::FULL ? "full" : "limited");
+        mRequestedFormat = format;
+        prepare(format);
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mPipelines.find(key(format));
+    if(it != mPipelines.end()){
+        mCurrent = it->second;
+        mCurrentFormat = format;
+    }
+    return mCurrent;
+}
+
+void VkPipelineVariants::build(const CameraColorFormat &format, VkPipeline *out_pipeline) {
+    CameraShaderSpec spec = {
+            .chromaOrder = static_cast<uint32_t>(format.chromaOrder),
+            .colorModel = static_cast<uint32_t>(format.colorModel),
+            .colorRange = static_cast<uint32_t>(format.colorRange),
+            .outputEncoding = static_cast<uint32_t>(mOutputEncoding)
+    };
+    VkSpecializationMapEntry entries[] = {
+            { 0, offsetof(CameraShaderSpec, chromaOrder), sizeof(uint32_t) },
+            { 1, offsetof(CameraShaderSpec, colorModel), sizeof(uint32_t) },
+            { 2, offsetof(CameraShaderSpec, colorRange), sizeof(uint32_t) },
+            { 3, offsetof(CameraShaderSpec, outputEncoding), sizeof(uint32_t) },
+    };
+    // shaders without some of the constants ignore their entries
+    VkSpecializationInfo specializationInfo = {
+            .mapEntryCount = ARRAY_SIZE(entries),
+            .pMapEntries = entries,
+            .dataSize = sizeof(spec),
+            .pData = &spec
+    };
+    uint64_t startNs = getTimeNano(CLOCK_MONOTONIC);
+    mBuilder(&specializationInfo, out_pipeline);
+    LOG_D("%s pipelines: built %s %s %s range in %.2f ms", mName.c_str(), format.chromaOrder == ChromaOrder::NV21 ? "NV21" : "NV12",
+          gColorModelNames[spec.colorModel], format.colorRange == ColorRange::FULL ? "full" : "limited",
+          (getTimeNano(CLOCK_MONOTONIC) - startNs) * 1.f / U_TIME_1MS_IN_NS);
+}
+
+void VkPipelineVariants::workerLoop() {
+    pthread_setname_np(pthread_self(), "VkPipelines");
+    ThreadManager::get().place(ThreadRole::UPLOAD, "VkPipelines");
+    std::unique_lock<std::mutex> lock(mMutex);
+    while(true){
+        mCond.wait(lock, [this]{ return bExit || !mQueue.empty(); });
+        if(bExit){
+            return;
+        }
+        CameraColorFormat format = mQueue.front();
+        mQueue.erase(mQueue.begin());
+        lock.unlock();
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        try{
+            build(format, &pipeline);
+        } catch (const std::runtime_error &e) {
+            // the variant stays queued, so it is not tried again and the current one keeps rendering
+            LOG_E("%s pipelines: %s", mName.c_str(), e.what());
+        }
+        lock.lock();
+        if(pipeline != VK_NULL_HANDLE){
+            uint32_t variantKey = key(format);
+            mQueued.erase(variantKey);
+            mPipelines[variantKey] = pipeline;
+        }
+    }
+}
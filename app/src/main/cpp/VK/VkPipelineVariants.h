@@ -0,0 +1,76 @@
+/*!
+ * @brief  Camera pipelines specialized per YUV layout and color matrix, extra variants compile on a background thread
+ * @date 2023/8/15
+ */
+#ifndef CAMERA2VK_VKPIPELINEVARIANTS_H
+#define CAMERA2VK_VKPIPELINEVARIANTS_H
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+#include "VkCameraImageV2.h"
+
+enum class OutputEncoding : uint32_t{
+    AS_IS = 0,          // UNORM target, the camera RGB is gamma encoded already
+    LINEAR = 1          // sRGB target, the shader decodes and the target encodes again on write
+};
+
+// the fragment specialization constants, constant_id 0..3 in this order
+struct CameraShaderSpec{
+    uint32_t chromaOrder;
+    uint32_t colorModel;
+    uint32_t colorRange;
+    uint32_t outputEncoding;
+};
+
+/**
+ * The camera fragment shaders pick chroma order, color matrix, range and output encoding through specialization
+ * constants, so every combination is a pipeline of its own with the conversion folded in by the driver. The variant
+ * for the format given at construction is built right away and is current, any other one is compiled on a worker
+ * thread when prepare() or select() asks for it, meanwhile the current one keeps rendering. The output encoding
+ * follows the format of the swapchain. select() and current() are render thread only.
+ */
+class VkPipelineVariants{
+public:
+    // creates one variant, fragSpecialization belongs to the fragment stage
+    typedef std::function<void(const VkSpecializationInfo *fragSpecialization, VkPipeline *out_pipeline)> Builder;
+
+    VkPipelineVariants(VkBundle *vk, const char *name, Builder builder, const CameraColorFormat &format);
+    ~VkPipelineVariants();
+
+    // queues the variant of format on the worker, nothing happens when it is built or queued already
+    void prepare(const CameraColorFormat &format);
+    // switches to the variant of format as soon as it is built, returns the current pipeline
+    VkPipeline select(const CameraColorFormat &format);
+    VkPipeline current() const { return mCurrent; };
+
+private:
+    static uint32_t key(const CameraColorFormat &format);
+    void build(const CameraColorFormat &format, VkPipeline *out_pipeline);
+    void workerLoop();
+
+    VkBundle *mVk;
+    std::string mName;
+    Builder mBuilder;
+    OutputEncoding mOutputEncoding;
+    VkPipeline mCurrent = VK_NULL_HANDLE;
+    CameraColorFormat mCurrentFormat;
+    CameraColorFormat mRequestedFormat;     // the last format select() saw
+
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    bool bExit = false;
+    std::map<uint32_t, VkPipeline> mPipelines;      // built variants by key
+    std::vector<CameraColorFormat> mQueue;
+    std::set<uint32_t> mQueued;
+};
+
+#endif //CAMERA2VK_VKPIPELINEVARIANTS_H
@@ -0,0 +1,145 @@
+#include "VkQueueTimer.h"
+
+static const uint64_t gCalibrationPeriodNs = 1000ULL * U_TIME_1MS_IN_NS;    // device and host clocks drift apart
+
+VkQueueTimer::VkQueueTimer(VkBundle *vk, uint32_t queueFamilyIndex, uint32_t slotCount, const char *name) {
+    mVk = vk;
+    mName = name;
+    mSlots.resize(slotCount);
+
+    uint32_t queueFamilyPropCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(mVk->deviceInfo.physicalDev, &queueFamilyPropCount, nullptr);
+    VkQueueFamilyProperties queueFamilyProps[queueFamilyPropCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(mVk->deviceInfo.physicalDev, &queueFamilyPropCount, queueFamilyProps);
+    const VkQueueFamilyProperties &familyProps = queueFamilyProps[queueFamilyIndex];
+    if(familyProps.timestampValidBits == 0){
+        LOG_W("VkQueueTimer %s: the queue family writes no timestamps, its occupancy will not be reported.", mName);
+        return;
+    }
+    bHostReset = (familyProps.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0;
+    if(bHostReset){
+        if(mVk->deviceInfo.features.hostQueryReset){
+            mResetQueryPool = reinterpret_cast<PFN_vkResetQueryPool>(vkGetDeviceProcAddr(mVk->deviceInfo.device, "vkResetQueryPool"));
+        }
+        LOG_D("vkResetQueryPool==%p", mResetQueryPool);
+        if(mResetQueryPool == nullptr){
+            LOG_W("VkQueueTimer %s: the queries of the queue can not be reset, its occupancy will not be reported.", mName);
+            return;
+        }
+    }
+    mValidMask = familyProps.timestampValidBits >= 64 ? UINT64_MAX : (1ul << familyProps.timestampValidBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = slotCount * 2,
+            .pipelineStatistics = 0
+    };
+    CALL_VK(vkCreateQueryPool(mVk->deviceInfo.device, &queryPoolCreateInfo, VK_ALLOC, &mQueryPool));
+    if(bHostReset){
+        mResetQueryPool(mVk->deviceInfo.device, mQueryPool, 0, slotCount * 2);
+    }
+
+    if(mVk->deviceInfo.features.calibratedTimestamps){
+        mGetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+                vkGetDeviceProcAddr(mVk->deviceInfo.device, "vkGetCalibratedTimestampsEXT"));
+    }
+    if(mGetCalibratedTimestamps != nullptr && !calibrate()){
+        mGetCalibratedTimestamps = nullptr;
+    }
+    if(mGetCalibratedTimestamps == nullptr){
+        LOG_W("VkQueueTimer %s: no calibrated timestamps, its intervals can not be compared with other queues.", mName);
+    }
+}
+
+bool VkQueueTimer::calibrate() {
+    VkCalibratedTimestampInfoEXT infos[2] = {
+            {
+                    .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+                    .pNext = nullptr,
+                    .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT
+            },
+            {
+                    .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+                    .pNext = nullptr,
+                    .timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT
+            }
+    };
+    uint64_t timestamps[2];
+    uint64_t maxDeviation = 0;
+    if(mGetCalibratedTimestamps(mVk->deviceInfo.device, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS){
+        return false;
+    }
+    double period = mVk->deviceInfo.physicalDevLimits.timestampPeriod;
+    mDeviceToMonotonicNs = (int64_t)timestamps[1] - (int64_t)((timestamps[0] & mValidMask) * period);
+    mCalibratedAtNs = timestamps[1];
+    return true;
+}
+
+VkQueueTimer::~VkQueueTimer() {
+    if(mQueryPool != VK_NULL_HANDLE){
+        vkDestroyQueryPool(mVk->deviceInfo.device, mQueryPool, VK_ALLOC);
+    }
+}
+
+void VkQueueTimer::beginSlot(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    if(mQueryPool == VK_NULL_HANDLE){
+        return;
+    }
+    QueueInterval interval;
+    collect(slot, &interval);
+    if(bHostReset){
+        mResetQueryPool(mVk->deviceInfo.device, mQueryPool, slot * 2, 2);
+    } else {
+        vkCmdResetQueryPool(cmdBuffer, mQueryPool, slot * 2, 2);
+    }
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, slot * 2);
+}
+
+void VkQueueTimer::endSlot(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    if(mQueryPool == VK_NULL_HANDLE){
+        return;
+    }
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, slot * 2 + 1);
+    mSlots[slot].bPending = true;
+}
+
+bool VkQueueTimer::collect(uint32_t slot, QueueInterval *out_interval) {
+    Slot &state = mSlots[slot];
+    if(state.bPending){
+        state.bPending = false;
+        state.bValid = false;
+        uint64_t timestamps[2];
+        VkResult result = vkGetQueryPoolResults(mVk->deviceInfo.device, mQueryPool, slot * 2, 2, sizeof(timestamps), timestamps,
+                                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        // not ready means the caller broke the contract, drop the sample rather than stall
+        if(result == VK_SUCCESS){
+            // a failed recalibration keeps the last offset, it only drifts
+            if(isCalibrated() && getTimeNano(CLOCK_MONOTONIC) - mCalibratedAtNs >= gCalibrationPeriodNs){
+                calibrate();
+            }
+            double period = mVk->deviceInfo.physicalDevLimits.timestampPeriod;
+            state.interval.startNs = static_cast<uint64_t>((timestamps[0] & mValidMask) * period + mDeviceToMonotonicNs);
+            state.interval.endNs = static_cast<uint64_t>((timestamps[1] & mValidMask) * period + mDeviceToMonotonicNs);
+            state.bValid = state.interval.endNs >= state.interval.startNs;
+        }
+        if(state.bValid){
+            mBusyNs += state.interval.endNs - state.interval.startNs;
+            mFirstStartNs = mSampleCount == 0 ? state.interval.startNs : std::min(mFirstStartNs, state.interval.startNs);
+            mLastEndNs = std::max(mLastEndNs, state.interval.endNs);
+            mSampleCount++;
+        }
+    }
+    *out_interval = state.interval;
+    return state.bValid;
+}
+
+void VkQueueTimer::printStats() {
+    if(mSampleCount == 0 || mLastEndNs <= mFirstStartNs){
+        return;
+    }
+    LOG_D("VkQueueTimer %s: %.3f ms busy per submission, %.1f%% occupancy over %u submissions", mName,
+          mBusyNs * 1.f / mSampleCount / U_TIME_1MS_IN_NS, mBusyNs * 100.f / (mLastEndNs - mFirstStartNs), mSampleCount);
+}
@@ -0,0 +1,63 @@
+/*!
+ * @brief  Timestamps around the work a queue does per slot, busy time and occupancy of that queue
+ * @date 2023/8/12
+ */
+#ifndef CAMERA2VK_VKQUEUETIMER_H
+#define CAMERA2VK_VKQUEUETIMER_H
+
+#include <vector>
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+
+struct QueueInterval{
+    uint64_t startNs = 0;
+    uint64_t endNs = 0;
+};
+
+/**
+ * One timestamp at the top and one at the bottom of the work of a slot. Families without graphics or compute can
+ * not reset queries in a command buffer, theirs are reset from the host, which needs the hostQueryReset feature.
+ * Raw timestamps of different queues share no defined time domain. With VK_EXT_calibrated_timestamps the intervals are
+ * moved onto CLOCK_MONOTONIC, recalibrated every second against drift, and only then compare across queues.
+ */
+class VkQueueTimer{
+public:
+    VkQueueTimer(VkBundle *vk, uint32_t queueFamilyIndex, uint32_t slotCount, const char *name);
+    ~VkQueueTimer();
+
+    // the previous use of the slot has to be complete, it is collected first if nobody did
+    void beginSlot(VkCommandBuffer cmdBuffer, uint32_t slot);
+    void endSlot(VkCommandBuffer cmdBuffer, uint32_t slot);
+    // interval of the last completed use of the slot, false while there is none or the queue has no timestamps
+    bool collect(uint32_t slot, QueueInterval *out_interval);
+    // the intervals are on CLOCK_MONOTONIC, comparable with those of other queues and of the CPU
+    bool isCalibrated() const { return mGetCalibratedTimestamps != nullptr; };
+    void printStats();
+
+private:
+    struct Slot{
+        bool bPending = false;
+        bool bValid = false;
+        QueueInterval interval;
+    };
+
+    bool calibrate();
+
+    VkBundle *mVk;
+    const char *mName;
+    VkQueryPool mQueryPool = VK_NULL_HANDLE;
+    bool bHostReset = false;
+    PFN_vkResetQueryPool mResetQueryPool = nullptr;
+    uint64_t mValidMask = 0;
+    PFN_vkGetCalibratedTimestampsEXT mGetCalibratedTimestamps = nullptr;
+    int64_t mDeviceToMonotonicNs = 0;
+    uint64_t mCalibratedAtNs = 0;
+    std::vector<Slot> mSlots;
+
+    uint64_t mBusyNs = 0;
+    uint64_t mFirstStartNs = 0;
+    uint64_t mLastEndNs = 0;
+    uint32_t mSampleCount = 0;
+};
+
+#endif //CAMERA2VK_VKQUEUETIMER_H
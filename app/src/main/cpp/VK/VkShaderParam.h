@@ -36,4 +36,22 @@ struct Vertex {
     }
 };
 
+// push constants of the multiview shaders, indexed by the eye, gl_InstanceIndex
+struct MultiviewParams {
+    glm::vec4 viewTransforms[2];    // xy: offset, zw: scale
+};
+
+// storage buffer entry of an overlay layer, std430
+struct OverlayLayerParams {
+    glm::mat4 transforms[2];        // layer space to target clip space, per eye
+    glm::vec4 shape;                // x: central angle of a cylinder layer, 0 for quads
+    glm::vec4 color;
+};
+
+// push constants of the overlay layer shaders
+struct OverlayDrawParams {
+    uint32_t layerIndex;
+    uint32_t eyeIndex;
+};
+
 #endif //CAMERA2VK_VKSHADERPARAM_H
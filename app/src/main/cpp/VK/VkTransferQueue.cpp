@@ -0,0 +1,82 @@
+#include "VkTransferQueue.h"
+#include <limits>
+#include "VkHelper.h"
+
+VkTransferQueue::VkTransferQueue(VkBundle *vk, uint32_t slotCount) {
+    mVk = vk;
+    if(mVk->queueInfo.transferQueue == VK_NULL_HANDLE){
+        throw std::runtime_error("VkTransferQueue: the device has no transfer queue.");
+    }
+    VkDevice device = mVk->deviceInfo.device;
+    VkHelper::createCommandPool(device, mVk->queueInfo.transferQueueIndex, &mCmdPool);
+    mSlots.resize(slotCount);
+    // fences start signaled, so the first begin of a slot does not wait
+    VkFenceCreateInfo fenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+    };
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0
+    };
+    for(auto &slot : mSlots){
+        VkHelper::allocateCommandBuffers(device, mCmdPool, 1, &slot.cmdBuffer);
+        CALL_VK(vkCreateFence(device, &fenceCreateInfo, VK_ALLOC, &slot.fence));
+        CALL_VK(vkCreateSemaphore(device, &semaphoreCreateInfo, VK_ALLOC, &slot.semaphore));
+    }
+    mTimer = new VkQueueTimer(mVk, mVk->queueInfo.transferQueueIndex, slotCount, "Transfer");
+}
+
+VkTransferQueue::~VkTransferQueue() {
+    VkDevice device = mVk->deviceInfo.device;
+    CALL_VK(vkQueueWaitIdle(mVk->queueInfo.transferQueue));
+    mTimer->printStats();
+    SAFE_DELETE(mTimer);
+    for(auto &slot : mSlots){
+        vkDestroySemaphore(device, slot.semaphore, VK_ALLOC);
+        vkDestroyFence(device, slot.fence, VK_ALLOC);
+        vkFreeCommandBuffers(device, mCmdPool, 1, &slot.cmdBuffer);
+    }
+    vkDestroyCommandPool(device, mCmdPool, VK_ALLOC);
+}
+
+VkCommandBuffer VkTransferQueue::begin(uint32_t slotIndex) {
+    mSlot = slotIndex % mSlots.size();
+    Slot &slot = mSlots[mSlot];
+    CALL_VK(vkWaitForFences(mVk->deviceInfo.device, 1, &slot.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr
+    };
+    CALL_VK(vkBeginCommandBuffer(slot.cmdBuffer, &cmdBufferBeginInfo));
+    mTimer->beginSlot(slot.cmdBuffer, mSlot);
+    return slot.cmdBuffer;
+}
+
+VkSemaphore VkTransferQueue::submit() {
+    Slot &slot = mSlots[mSlot];
+    mTimer->endSlot(slot.cmdBuffer, mSlot);
+    CALL_VK(vkEndCommandBuffer(slot.cmdBuffer));
+    VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = nullptr,
+            .pWaitDstStageMask = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &slot.cmdBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &slot.semaphore,
+    };
+    CALL_VK(vkResetFences(mVk->deviceInfo.device, 1, &slot.fence));
+    CALL_VK(vkQueueSubmit(mVk->queueInfo.transferQueue, 1, &submitInfo, slot.fence));
+    return slot.semaphore;
+}
+
+bool VkTransferQueue::collect(uint32_t slotIndex, QueueInterval *out_interval) {
+    return mTimer->collect(slotIndex % mSlots.size(), out_interval);
+}
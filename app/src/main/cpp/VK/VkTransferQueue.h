@@ -0,0 +1,46 @@
+/*!
+ * @brief  Uploads on the transfer queue, a slot per frame in flight so the copy of a frame overlaps the rendering of the last one
+ * @date 2023/8/12
+ */
+#ifndef CAMERA2VK_VKTRANSFERQUEUE_H
+#define CAMERA2VK_VKTRANSFERQUEUE_H
+
+#include "VulkanCommon.h"
+#include "VkBundle.h"
+#include "VkQueueTimer.h"
+
+/**
+ * Every submission signals the semaphore of its slot, the graphics queue has to wait on it exactly once before it
+ * touches the uploads, and acquire the images the recorded commands released to it. Render thread only.
+ */
+class VkTransferQueue{
+public:
+    VkTransferQueue(VkBundle *vk, uint32_t slotCount);
+    ~VkTransferQueue();
+
+    // waits for the last submission of the slot, the frame context index, and begins its command buffer
+    VkCommandBuffer begin(uint32_t slotIndex);
+    // the returned semaphore is signaled once the copies are done
+    VkSemaphore submit();
+    uint32_t getSlot() const { return mSlot; };
+    uint32_t getQueueFamily() const { return mVk->queueInfo.transferQueueIndex; };
+    // the last submission of the slot, once the graphics work that waited on it is complete
+    bool collect(uint32_t slotIndex, QueueInterval *out_interval);
+    bool isCalibrated() const { return mTimer->isCalibrated(); };
+    void printStats() { mTimer->printStats(); };
+
+private:
+    struct Slot{
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+    };
+
+    VkBundle *mVk;
+    VkCommandPool mCmdPool = VK_NULL_HANDLE;
+    std::vector<Slot> mSlots;
+    uint32_t mSlot = 0;
+    VkQueueTimer *mTimer = nullptr;
+};
+
+#endif //CAMERA2VK_VKTRANSFERQUEUE_H
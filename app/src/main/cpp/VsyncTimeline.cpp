@@ -0,0 +1,155 @@
+#include "VsyncTimeline.h"
+#include <algorithm>
+#include <cmath>
+#include "Common.h"
+
+// a fitted period outside of this is a broken fit, the nominal one is used instead
+static const uint64_t gMinPeriodNs = (uint64_t)(1e9 / 240);
+static const uint64_t gMaxPeriodNs = (uint64_t)(1e9 / 24);
+// how far a gap may be off a whole number of periods before it counts as a refresh rate switch
+static const double gRateSwitchTolerance = 0.25;
+
+VsyncTimeline::VsyncTimeline(uint64_t nominalPeriodNs, VsyncSource *source)
+        : mNominalPeriodNs(nominalPeriodNs), mSource(source), mWriterPeriodNs(nominalPeriodNs) {
+}
+
+VsyncTimeline::~VsyncTimeline() {
+    stop();
+}
+
+void VsyncTimeline::start() {
+    if(bStarted || mSource == nullptr){
+        return;
+    }
+    bStarted = true;
+    mSource->start(this);
+}
+
+void VsyncTimeline::stop() {
+    if(!bStarted){
+        return;
+    }
+    bStarted = false;
+    mSource->stop();
+}
+
+void VsyncTimeline::publish(uint64_t vsyncNs, uint64_t presentNs, uint64_t deadlineNs) {
+    uint32_t count = mCount.load(std::memory_order_relaxed);
+    if(count > 0 && vsyncNs <= mWriterLastNs){
+        return;
+    }
+    if(count > 0){
+        double periods = (double)(vsyncNs - mWriterLastNs) / mWriterPeriodNs;
+        double steps = std::round(periods);
+        if(steps < 1 || std::fabs(periods - steps) > gRateSwitchTolerance){
+            // the old samples are on another grid now
+            LOG_D("VsyncTimeline: %.2f ms after the last vsync, %.2f periods, restarting the history",
+                  (vsyncNs - mWriterLastNs) * 1.f / U_TIME_1MS_IN_NS, periods);
+            mWriterPeriodNs = std::min(std::max(vsyncNs - mWriterLastNs, gMinPeriodNs), gMaxPeriodNs);
+            count = 0;
+            steps = 1;
+        } else if(steps == 1){
+            // only the grid guess for the next gap, the readers fit the real period
+            mWriterPeriodNs = (mWriterPeriodNs * 7 + (vsyncNs - mWriterLastNs)) / 8;
+        }
+        mWriterIndex += (uint64_t)steps;
+    }
+    mWriterLastNs = vsyncNs;
+
+    uint32_t head = (mHead.load(std::memory_order_relaxed) + 1) % VSYNC_TIMELINE_HISTORY;
+    uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mIndices[head].store(mWriterIndex, std::memory_order_relaxed);
+    mVsyncNs[head].store(vsyncNs, std::memory_order_relaxed);
+    mPresentNs[head].store(presentNs, std::memory_order_relaxed);
+    mDeadlineNs[head].store(deadlineNs, std::memory_order_relaxed);
+    mHead.store(head, std::memory_order_relaxed);
+    mCount.store(std::min(count + 1, (uint32_t)VSYNC_TIMELINE_HISTORY), std::memory_order_relaxed);
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint32_t VsyncTimeline::snapshot(VsyncSample *out_samples) const {
+    for(;;){
+        uint32_t sequence = mSequence.load(std::memory_order_acquire);
+        if(sequence & 1){
+            continue;
+        }
+        uint32_t count = mCount.load(std::memory_order_relaxed);
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        // oldest first
+        for(uint32_t i = 0; i < count; i++){
+            uint32_t slot = (head + VSYNC_TIMELINE_HISTORY - count + 1 + i) % VSYNC_TIMELINE_HISTORY;
+            out_samples[i] = {
+                    .index = mIndices[slot].load(std::memory_order_relaxed),
+                    .vsyncNs = mVsyncNs[slot].load(std::memory_order_relaxed),
+                    .presentNs = mPresentNs[slot].load(std::memory_order_relaxed),
+                    .deadlineNs = mDeadlineNs[slot].load(std::memory_order_relaxed)
+            };
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(mSequence.load(std::memory_order_relaxed) == sequence){
+            return count;
+        }
+    }
+}
+
+VsyncTimeline::Fit VsyncTimeline::fit() const {
+    VsyncSample samples[VSYNC_TIMELINE_HISTORY];
+    Fit result = {};
+    result.count = snapshot(samples);
+    result.periodNs = mNominalPeriodNs;
+    if(result.count == 0){
+        return result;
+    }
+    result.last = samples[result.count - 1];
+    if(result.count < 2){
+        return result;
+    }
+    // least squares over (vsync index, time), both relative to the last sample to keep the doubles exact
+    double meanX = 0, meanY = 0;
+    for(uint32_t i = 0; i < result.count; i++){
+        meanX += (double)samples[i].index - (double)result.last.index;
+        meanY += (double)samples[i].vsyncNs - (double)result.last.vsyncNs;
+    }
+    meanX /= result.count;
+    meanY /= result.count;
+    double covariance = 0, variance = 0;
+    for(uint32_t i = 0; i < result.count; i++){
+        double x = (double)samples[i].index - (double)result.last.index - meanX;
+        double y = (double)samples[i].vsyncNs - (double)result.last.vsyncNs - meanY;
+        covariance += x * y;
+        variance += x * x;
+    }
+    double periodNs = covariance / variance;
+    if(periodNs < gMinPeriodNs || periodNs > gMaxPeriodNs){
+        return result;
+    }
+    result.periodNs = periodNs;
+    result.offsetNs = meanY - periodNs * meanX;
+    return result;
+}
+
+uint64_t VsyncTimeline::predictNextVsync(uint64_t afterNs) const {
+    Fit line = fit();
+    if(line.count == 0){
+        return afterNs + mNominalPeriodNs;
+    }
+    double phaseNs = (double)line.last.vsyncNs + line.offsetNs;
+    double periods = std::floor(((double)afterNs - phaseNs) / line.periodNs) + 1;
+    return (uint64_t)(phaseNs + periods * line.periodNs);
+}
+
+uint64_t VsyncTimeline::refreshPeriodNs() const {
+    return (uint64_t)fit().periodNs;
+}
+
+bool VsyncTimeline::latestSample(VsyncSample *out_sample) const {
+    VsyncSample samples[VSYNC_TIMELINE_HISTORY];
+    uint32_t count = snapshot(samples);
+    if(count == 0){
+        return false;
+    }
+    *out_sample = samples[count - 1];
+    return true;
+}
@@ -0,0 +1,85 @@
+/*!
+ * @brief  Vsync history from a platform source, with a fitted refresh period and predicted next vsync
+ * @date 2023/8/19
+ */
+#ifndef CAMERA2VK_VSYNCTIMELINE_H
+#define CAMERA2VK_VSYNCTIMELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#define VSYNC_TIMELINE_HISTORY 16
+
+struct VsyncSample{
+    uint64_t index;         // vsyncs since start(), skipped ones included
+    uint64_t vsyncNs;       // CLOCK_MONOTONIC
+    uint64_t presentNs;     // expected presentation of the preferred frame timeline, 0 before API 33
+    uint64_t deadlineNs;    // latest start of a frame for that presentation, 0 before API 33
+};
+
+class VsyncTimeline;
+
+// where the vsyncs come from, ChoreographerVsyncSource on the device. start() publishes each one from a thread of its own
+class VsyncSource{
+public:
+    virtual ~VsyncSource() = default;
+    virtual void start(VsyncTimeline *timeline) = 0;
+    virtual void stop() = 0;
+};
+
+/**
+ * The source publishes every vsync, a timeline without one, as in a host build, predicts on the nominal period.
+ * The last VSYNC_TIMELINE_HISTORY samples are published through a seqlock: the source thread never blocks and readers
+ * retry on the rare torn read. Readers fit a line through the history, so one late callback moves neither the period
+ * nor the phase much. A gap that is no whole number of periods is a refresh rate switch and restarts the history.
+ */
+class VsyncTimeline{
+public:
+    // takes the source, which may be null
+    VsyncTimeline(uint64_t nominalPeriodNs, VsyncSource *source);
+    ~VsyncTimeline();
+
+    void start();
+    void stop();
+    // source thread only
+    void publish(uint64_t vsyncNs, uint64_t presentNs, uint64_t deadlineNs);
+
+    // any thread; the first vsync after afterNs, afterNs plus the nominal period until a vsync arrived
+    uint64_t predictNextVsync(uint64_t afterNs) const;
+    // any thread; the fitted period, the nominal one until two vsyncs arrived
+    uint64_t refreshPeriodNs() const;
+    // any thread; false until the first vsync
+    bool latestSample(VsyncSample *out_sample) const;
+
+private:
+    struct Fit{
+        uint32_t count;
+        double periodNs;
+        double offsetNs;        // fitted time of the last sample, relative to its vsyncNs
+        VsyncSample last;
+    };
+
+    uint32_t snapshot(VsyncSample *out_samples) const;
+    Fit fit() const;
+
+    uint64_t mNominalPeriodNs;
+    std::unique_ptr<VsyncSource> mSource;
+    bool bStarted = false;
+
+    // source thread only
+    uint64_t mWriterIndex = 0;
+    uint64_t mWriterPeriodNs = 0;
+    uint64_t mWriterLastNs = 0;
+
+    // the seqlock, odd while the source thread writes
+    std::atomic<uint32_t> mSequence{0};
+    std::atomic<uint32_t> mCount{0};
+    std::atomic<uint32_t> mHead{0};
+    std::atomic<uint64_t> mIndices[VSYNC_TIMELINE_HISTORY];
+    std::atomic<uint64_t> mVsyncNs[VSYNC_TIMELINE_HISTORY];
+    std::atomic<uint64_t> mPresentNs[VSYNC_TIMELINE_HISTORY];
+    std::atomic<uint64_t> mDeadlineNs[VSYNC_TIMELINE_HISTORY];
+};
+
+#endif //CAMERA2VK_VSYNCTIMELINE_H
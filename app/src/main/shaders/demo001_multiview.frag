@@ -0,0 +1,50 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+precision mediump int;
+precision highp float;
+precision mediump sampler2DArray;
+
+layout(location=1) in vec2 v_texcoord;
+layout(location=2) flat in int v_eye;
+// layer == eye, both eyes live in one array image per plane
+layout(binding=0) uniform sampler2DArray y_texture;
+layout(binding=1) uniform sampler2DArray uv_texture;
+
+layout(location=0) out vec4 FragColor;
+
+// picked per pipeline from the camera format, see VkPipelineVariants, the driver folds the branches away
+layout(constant_id = 0) const int CHROMA_ORDER = 1;     // 0 NV12, 1 NV21
+layout(constant_id = 1) const int COLOR_MODEL = 0;      // 0 BT.601, 1 BT.709, 2 BT.2020
+layout(constant_id = 2) const int COLOR_RANGE = 0;      // 0 full, 1 limited
+layout(constant_id = 3) const int OUTPUT_ENCODING = 0;  // 0 as is, 1 linear for an sRGB target
+
+vec3 yuvToRgb(float y, vec2 chroma){
+    vec2 cbcr = CHROMA_ORDER == 0 ? chroma : chroma.yx;
+    if(COLOR_RANGE == 1){
+        y = (y - 16.0 / 255.0) * (255.0 / 219.0);
+        cbcr = (cbcr - 128.0 / 255.0) * (255.0 / 224.0);
+    } else {
+        cbcr = cbcr - 128.0 / 255.0;
+    }
+    float kr = COLOR_MODEL == 2 ? 0.2627 : (COLOR_MODEL == 1 ? 0.2126 : 0.299);
+    float kb = COLOR_MODEL == 2 ? 0.0593 : (COLOR_MODEL == 1 ? 0.0722 : 0.114);
+    float r = y + 2.0 * (1.0 - kr) * cbcr.y;
+    float b = y + 2.0 * (1.0 - kb) * cbcr.x;
+    float g = (y - kr * r - kb * b) / (1.0 - kr - kb);
+    return vec3(r, g, b);
+}
+
+vec3 encodeOutput(vec3 rgb){
+    if(OUTPUT_ENCODING == 1){
+        rgb = clamp(rgb, 0.0, 1.0);
+        return mix(rgb / 12.92, pow((rgb + 0.055) / 1.055, vec3(2.4)), step(0.04045, rgb));
+    }
+    return rgb;
+}
+
+void main(){
+    vec3 texcoord = vec3(v_texcoord, float(v_eye));
+    highp vec3 rgb = yuvToRgb(texture(y_texture, texcoord).r, texture(uv_texture, texcoord).rg);
+    FragColor = vec4(encodeOutput(rgb), 1.0);
+}
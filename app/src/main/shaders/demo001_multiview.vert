@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location=0) in vec3 in_pos;
+layout(location=1) in vec2 in_texcoord;
+
+// xy: offset, zw: scale of each eye inside its half of the target
+layout(push_constant) uniform ViewParams {
+    vec4 viewTransforms[2];
+} params;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location=1) out vec2 v_texcoord;
+// instance == eye, the layer of the camera images
+layout(location=2) flat out int v_eye;
+
+void main(){
+    vec4 viewTransform = params.viewTransforms[gl_InstanceIndex];
+    vec2 pos = in_pos.xy * viewTransform.zw + viewTransform.xy;
+    // into the left or right half of the side by side target
+    pos.x = pos.x * 0.5 + (gl_InstanceIndex == 0 ? -0.5 : 0.5);
+    gl_Position = vec4(pos.x, -pos.y, in_pos.z, 1.0f);    //reverse Y, same as OpenGL
+    v_texcoord = in_texcoord;
+    v_eye = gl_InstanceIndex;
+}
@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+precision mediump int;
+precision mediump float;
+precision mediump sampler2DArray;
+
+layout(location=1) in vec2 v_texcoord;
+layout(location=2) flat in int v_eye;
+// layer == eye, both eyes live in one array image per plane
+layout(binding=0) uniform sampler2DArray y_texture;
+layout(binding=1) uniform sampler2DArray uv_texture;
+
+layout(location=0) out vec4 FragColor;
+
+// picked per pipeline from the camera format, see VkPipelineVariants, the driver folds the branches away
+layout(constant_id = 0) const int CHROMA_ORDER = 1;     // 0 NV12, 1 NV21
+layout(constant_id = 1) const int COLOR_MODEL = 0;      // 0 BT.601, 1 BT.709, 2 BT.2020
+layout(constant_id = 2) const int COLOR_RANGE = 0;      // 0 full, 1 limited
+layout(constant_id = 3) const int OUTPUT_ENCODING = 0;  // 0 as is, 1 linear for an sRGB target
+
+// the demo001 conversion in half precision, 8 bit planes and an 8 bit target lose nothing visible at 11 bits of mantissa
+f16vec3 yuvToRgb(float16_t y, f16vec2 chroma){
+    f16vec2 cbcr = CHROMA_ORDER == 0 ? chroma : chroma.yx;
+    if(COLOR_RANGE == 1){
+        y = (y - float16_t(16.0 / 255.0)) * float16_t(255.0 / 219.0);
+        cbcr = (cbcr - float16_t(128.0 / 255.0)) * float16_t(255.0 / 224.0);
+    } else {
+        cbcr = cbcr - float16_t(128.0 / 255.0);
+    }
+    float16_t kr = float16_t(COLOR_MODEL == 2 ? 0.2627 : (COLOR_MODEL == 1 ? 0.2126 : 0.299));
+    float16_t kb = float16_t(COLOR_MODEL == 2 ? 0.0593 : (COLOR_MODEL == 1 ? 0.0722 : 0.114));
+    float16_t r = y + float16_t(2.0) * (float16_t(1.0) - kr) * cbcr.y;
+    float16_t b = y + float16_t(2.0) * (float16_t(1.0) - kb) * cbcr.x;
+    float16_t g = (y - kr * r - kb * b) / (float16_t(1.0) - kr - kb);
+    return f16vec3(r, g, b);
+}
+
+f16vec3 encodeOutput(f16vec3 rgb){
+    if(OUTPUT_ENCODING == 1){
+        rgb = clamp(rgb, float16_t(0.0), float16_t(1.0));
+        return mix(rgb / float16_t(12.92), pow((rgb + float16_t(0.055)) / float16_t(1.055), f16vec3(2.4)), step(float16_t(0.04045), rgb));
+    }
+    return rgb;
+}
+
+void main(){
+    vec3 texcoord = vec3(v_texcoord, float(v_eye));
+    f16vec3 rgb = yuvToRgb(float16_t(texture(y_texture, texcoord).r), f16vec2(texture(uv_texture, texcoord).rg));
+    FragColor = vec4(encodeOutput(rgb), 1.0);
+}
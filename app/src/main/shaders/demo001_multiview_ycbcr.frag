@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+precision mediump int;
+precision highp float;
+precision mediump sampler2DArray;
+
+layout(location=1) in vec2 v_texcoord;
+layout(location=2) flat in int v_eye;
+// layer == eye, NV12 array image behind an immutable YCbCr conversion sampler
+layout(binding=0) uniform sampler2DArray camera_texture;
+
+layout(location=0) out vec4 FragColor;
+
+// the conversion sampler does the YUV part, only the encoding of the target is left, see VkPipelineVariants
+layout(constant_id = 3) const int OUTPUT_ENCODING = 0;  // 0 as is, 1 linear for an sRGB target
+
+vec3 encodeOutput(vec3 rgb){
+    if(OUTPUT_ENCODING == 1){
+        rgb = clamp(rgb, 0.0, 1.0);
+        return mix(rgb / 12.92, pow((rgb + 0.055) / 1.055, vec3(2.4)), step(0.04045, rgb));
+    }
+    return rgb;
+}
+
+void main(){
+    FragColor = vec4(encodeOutput(texture(camera_texture, vec3(v_texcoord, float(v_eye))).rgb), 1.0);
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+precision mediump int;
+precision mediump float;
+precision mediump sampler2D;
+
+layout(location=1) in vec2 v_texcoord;
+// NV12 image behind an immutable YCbCr conversion sampler, the fetch already returns RGB
+layout(binding=0) uniform sampler2D camera_texture;
+
+layout(location=0) out vec4 FragColor;
+
+// the conversion sampler does the YUV part, only the encoding of the target is left, see VkPipelineVariants
+layout(constant_id = 3) const int OUTPUT_ENCODING = 0;  // 0 as is, 1 linear for an sRGB target
+
+// the encoding of demo001_ycbcr in half precision, the fetch is fixed function either way
+f16vec3 encodeOutput(f16vec3 rgb){
+    if(OUTPUT_ENCODING == 1){
+        rgb = clamp(rgb, float16_t(0.0), float16_t(1.0));
+        return mix(rgb / float16_t(12.92), pow((rgb + float16_t(0.055)) / float16_t(1.055), f16vec3(2.4)), step(float16_t(0.04045), rgb));
+    }
+    return rgb;
+}
+
+void main(){
+    FragColor = vec4(encodeOutput(f16vec3(texture(camera_texture, v_texcoord).rgb)), 1.0);
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+precision mediump int;
+precision highp float;
+precision mediump sampler2D;
+
+layout(location=1) in vec2 v_texcoord;
+layout(location=2) in vec4 v_color;
+layout(set=0, binding=0) uniform sampler2D layer_texture;
+
+layout(location=0) out vec4 FragColor;
+
+void main(){
+    FragColor = texture(layer_texture, v_texcoord) * v_color;
+}
@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location=0) in vec2 in_pos;          // layer grid, x and y in [-1, 1]
+layout(location=1) in vec2 in_texcoord;
+
+struct LayerParams {
+    mat4 transforms[2];     // layer space to target clip space, per eye
+    vec4 shape;             // x: central angle of a cylinder layer in radians, 0 for quads
+    vec4 color;
+};
+
+layout(std430, set=1, binding=0) readonly buffer Layers {
+    LayerParams layers[];
+};
+
+layout(push_constant) uniform DrawParams {
+    uint layerIndex;
+    uint eyeIndex;
+} draw;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location=1) out vec2 v_texcoord;
+layout(location=2) out vec4 v_color;
+
+void main(){
+    LayerParams layer = layers[draw.layerIndex];
+    vec3 pos = vec3(in_pos, 0.0);
+    float angle = layer.shape.x;
+    if(angle > 0.0){
+        // bend the quad around a cylinder with the same arc length, the edges come towards +z
+        float radius = 2.0 / angle;
+        float theta = in_pos.x * 0.5 * angle;
+        pos = vec3(radius * sin(theta), in_pos.y, radius * (1.0 - cos(theta)));
+    }
+    gl_Position = layer.transforms[draw.eyeIndex] * vec4(pos, 1.0);
+    gl_Position.y = -gl_Position.y;     //reverse Y, same as OpenGL
+    v_texcoord = in_texcoord;
+    v_color = layer.color;
+}
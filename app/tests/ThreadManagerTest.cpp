@@ -0,0 +1,113 @@
+// cpusFor() for every role against fake sysfs trees with one, two and three clusters
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "ThreadManager.h"
+
+namespace fs = std::filesystem;
+
+struct FakeDomain{
+    std::vector<int> cpus;
+    uint32_t capacity;
+};
+
+static int gFailures = 0;
+
+static void writeFile(const fs::path &path, const std::string &text) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path) << text << "\n";
+}
+
+static std::string formatCpus(const std::vector<int> &cpus) {
+    std::string text;
+    for(int cpu : cpus){
+        text += (text.empty() ? "" : " ") + std::to_string(cpu);
+    }
+    return text;
+}
+
+// the layout of /sys/devices/system/cpu: possible, online, cpuN/cpu_capacity, cpuN/cpufreq/related_cpus
+static fs::path makeTree(const char *name, const std::vector<FakeDomain> &domains) {
+    fs::path root = fs::temp_directory_path() / ("camera2vk-" + std::string(name) + "-" + std::to_string(getpid()));
+    fs::remove_all(root);
+    int cpuCount = 0;
+    for(const FakeDomain &domain : domains){
+        for(int cpu : domain.cpus){
+            fs::path cpuDir = root / ("cpu" + std::to_string(cpu));
+            writeFile(cpuDir / "cpu_capacity", std::to_string(domain.capacity));
+            writeFile(cpuDir / "cpufreq" / "related_cpus", formatCpus(domain.cpus));
+            cpuCount++;
+        }
+    }
+    std::string cpuList = "0-" + std::to_string(cpuCount - 1);
+    writeFile(root / "possible", cpuList);
+    writeFile(root / "online", cpuList);
+    return root;
+}
+
+static void expectCpus(const char *tree, const ThreadManager &manager, ThreadRole role, const std::vector<int> &expected) {
+    std::vector<int> cpus = manager.cpusFor(role);
+    if(cpus != expected){
+        fprintf(stderr, "FAIL %s: %s got cpus [%s], expected [%s]\n", tree, ThreadManager::roleName(role),
+                formatCpus(cpus).c_str(), formatCpus(expected).c_str());
+        gFailures++;
+    }
+}
+
+static void testOneCluster() {
+    // every role shares the only cluster
+    fs::path root = makeTree("one-cluster", {{.cpus = {0, 1, 2, 3}, .capacity = 1024}});
+    ThreadManager manager(root.string(), "/nonexistent", PriorityMode::NONE);
+    const std::vector<int> all = {0, 1, 2, 3};
+    expectCpus("one cluster", manager, ThreadRole::RENDER, all);
+    expectCpus("one cluster", manager, ThreadRole::CAMERA_ACQUIRE, all);
+    expectCpus("one cluster", manager, ThreadRole::UPLOAD, all);
+    expectCpus("one cluster", manager, ThreadRole::RECORDER, all);
+    expectCpus("one cluster", manager, ThreadRole::METRICS, all);
+    fs::remove_all(root);
+}
+
+static void testTwoClusters() {
+    // no MID, its roles move up to BIG
+    fs::path root = makeTree("two-clusters", {{.cpus = {0, 1, 2, 3}, .capacity = 512},
+                                              {.cpus = {4, 5, 6, 7}, .capacity = 1024}});
+    ThreadManager manager(root.string(), "/nonexistent", PriorityMode::NONE);
+    const std::vector<int> big = {4, 5, 6, 7};
+    expectCpus("two clusters", manager, ThreadRole::RENDER, big);
+    expectCpus("two clusters", manager, ThreadRole::CAMERA_ACQUIRE, big);
+    expectCpus("two clusters", manager, ThreadRole::UPLOAD, big);
+    expectCpus("two clusters", manager, ThreadRole::RECORDER, big);
+    expectCpus("two clusters", manager, ThreadRole::METRICS, {0, 1, 2, 3});
+    fs::remove_all(root);
+}
+
+static void testThreeClusters() {
+    // a single prime core, render needs two CPUs and borrows the MID cluster
+    fs::path root = makeTree("three-clusters", {{.cpus = {0, 1, 2, 3}, .capacity = 400},
+                                                {.cpus = {4, 5, 6}, .capacity = 800},
+                                                {.cpus = {7}, .capacity = 1024}});
+    ThreadManager manager(root.string(), "/nonexistent", PriorityMode::NONE);
+    const std::vector<int> mid = {4, 5, 6};
+    expectCpus("three clusters", manager, ThreadRole::RENDER, {4, 5, 6, 7});
+    expectCpus("three clusters", manager, ThreadRole::CAMERA_ACQUIRE, mid);
+    expectCpus("three clusters", manager, ThreadRole::UPLOAD, mid);
+    expectCpus("three clusters", manager, ThreadRole::RECORDER, mid);
+    expectCpus("three clusters", manager, ThreadRole::METRICS, {0, 1, 2, 3});
+    fs::remove_all(root);
+}
+
+int main() {
+    testOneCluster();
+    testTwoClusters();
+    testThreeClusters();
+    if(gFailures > 0){
+        fprintf(stderr, "%d checks failed\n", gFailures);
+        return EXIT_FAILURE;
+    }
+    printf("all checks passed\n");
+    return EXIT_SUCCESS;
+}
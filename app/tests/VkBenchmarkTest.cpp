@@ -0,0 +1,34 @@
+// the synthetic frame benchmark, headless against the system Vulkan loader,
+// reading the shaders and assets from the working directory
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include "VK/VkBenchmark.h"
+#include "VkHostDevice.h"
+
+static const uint32_t gFrameCount = 120;
+static const uint32_t gWarmupFrames = 10;
+// small enough for a software rasterizer
+static const uint32_t gWidth = 640;
+static const uint32_t gHeight = 320;
+
+int main() {
+    if(!hasVulkanDevice()){
+        fprintf(stderr, "no Vulkan device, skipped\n");
+        return SKIP_RETURN_CODE;
+    }
+    BenchmarkResult result;
+    try{
+        result = VkBenchmark::run(nullptr, gFrameCount, gWidth, gHeight, gWarmupFrames);
+    } catch(const std::exception &e){
+        fprintf(stderr, "FAIL: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    if(result.frameCount != gFrameCount || !(result.fps > 0)){
+        fprintf(stderr, "FAIL: %u frames at %.2f fps\n", result.frameCount, result.fps);
+        return EXIT_FAILURE;
+    }
+    printf("%u frames at %ux%u, %.2f fps, cpu %.3f ms/frame\n", result.frameCount, gWidth, gHeight, result.fps,
+           result.cpuMsPerFrame);
+    return EXIT_SUCCESS;
+}
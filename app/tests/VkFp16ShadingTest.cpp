@@ -0,0 +1,38 @@
+// the FP16 camera shaders against the FP32 ones, with and without the YCbCr sampler, fails below FP16_MIN_PSNR_DB.
+// on synthetic gradients, or on the frames recordFrame kept when they are copied into the working directory
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include "VK/VkBenchmark.h"
+#include "VkHostDevice.h"
+
+static const uint32_t gFrameCount = 30;
+// small enough for a software rasterizer
+static const uint32_t gWidth = 640;
+static const uint32_t gHeight = 320;
+
+int main() {
+    if(!hasVulkanDevice()){
+        fprintf(stderr, "no Vulkan device, skipped\n");
+        return SKIP_RETURN_CODE;
+    }
+    bool bPassed;
+    try{
+        // a single frame tells whether the device keeps FP16 shading on
+        BenchmarkResult probe = VkBenchmark::run(nullptr, 1, gWidth, gHeight, 0, false, CameraUploadMode::STAGING, 1, true, false);
+        if(!probe.bFp16Shading){
+            fprintf(stderr, "no shaderFloat16, skipped\n");
+            return SKIP_RETURN_CODE;
+        }
+        bPassed = VkBenchmark::compareFp16Shading(nullptr, gFrameCount, gWidth, gHeight);
+    } catch(const std::exception &e){
+        fprintf(stderr, "FAIL: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    if(!bPassed){
+        fprintf(stderr, "FAIL: fp16 shading below %.0f dB against fp32\n", FP16_MIN_PSNR_DB);
+        return EXIT_FAILURE;
+    }
+    printf("fp16 shading at or above %.0f dB against fp32\n", FP16_MIN_PSNR_DB);
+    return EXIT_SUCCESS;
+}
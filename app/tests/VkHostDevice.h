@@ -0,0 +1,27 @@
+// shared by the host tests that run VKRenderer headless, ctest reports exit code 77 as skipped
+#ifndef CAMERA2VK_VKHOSTDEVICE_H
+#define CAMERA2VK_VKHOSTDEVICE_H
+
+#include "VK/VulkanCommon.h"
+
+#define SKIP_RETURN_CODE 77     // a host without any Vulkan device
+
+// a loader and at least one physical device, lavapipe counts
+inline bool hasVulkanDevice() {
+    if(!InitVulkan()){
+        return false;
+    }
+    VkInstanceCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO
+    };
+    VkInstance instance;
+    if(vkCreateInstance(&createInfo, VK_ALLOC, &instance) != VK_SUCCESS){
+        return false;
+    }
+    uint32_t physicalDevCount = 0;
+    vkEnumeratePhysicalDevices(instance, &physicalDevCount, nullptr);
+    vkDestroyInstance(instance, VK_ALLOC);
+    return physicalDevCount > 0;
+}
+
+#endif //CAMERA2VK_VKHOSTDEVICE_H